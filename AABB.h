@@ -0,0 +1,63 @@
+#ifndef RAY_TRACING_AABB_H
+#define RAY_TRACING_AABB_H
+
+#include "Profile.h"
+#include "Ray.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace RayTracing
+{
+	// Axis aligned bounding box, an empty box has min > max
+	struct AABB
+	{
+		glm::vec3 min;
+		glm::vec3 max;
+
+		AABB() : min(FLOAT_INF), max(-FLOAT_INF) {}
+		AABB(const glm::vec3& a, const glm::vec3& b) : min(a), max(b) {}
+
+		bool empty() const { return min.x > max.x; }
+		void expand(const glm::vec3& p) { min = glm::min(min, p); max = glm::max(max, p); }
+		void expand(const AABB& box) { min = glm::min(min, box.min); max = glm::max(max, box.max); }
+		glm::vec3 centroid() const { return (min + max) * 0.5f; }
+		glm::vec3 extent() const { return max - min; }
+		float surfaceArea() const
+		{
+			if (empty())
+			{
+				return 0.0f;
+			}
+			glm::vec3 e = extent();
+			return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+		}
+		int longestAxis() const
+		{
+			glm::vec3 e = extent();
+			return e.x > e.y && e.x > e.z ? 0 : (e.y > e.z ? 1 : 2);
+		}
+
+		// Slab test, returns the entry t or FLOAT_INF if the ray misses the box within [0, tMax]
+		float rayCollision(const glm::vec3& origin, const glm::vec3& invDirection, float tMax) const
+		{
+			RAY_TRACING_COUNT(tests[PixelCounters::BOX]);
+			glm::vec3 t0 = (min - origin) * invDirection;
+			glm::vec3 t1 = (max - origin) * invDirection;
+			float enter = 0.0f, exit = tMax;
+			for (int axis = 0; axis < 3; axis++)
+			{
+				// A ray parallel to a face and starting in its plane gives 0 * inf = NaN, that slab doesn't limit it
+				if (std::isnan(t0[axis]) || std::isnan(t1[axis]))
+				{
+					continue;
+				}
+				enter = std::max(enter, std::min(t0[axis], t1[axis]));
+				exit = std::min(exit, std::max(t0[axis], t1[axis]));
+			}
+			return enter <= exit ? enter : FLOAT_INF;
+		}
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,167 @@
+#include "AdaptiveRenderer.h"
+
+#include <cmath>
+
+namespace RayTracing
+{
+	const unsigned int AdaptiveRenderer::DEFAULT_BASE_SAMPLES = 4;
+	const unsigned int AdaptiveRenderer::DEFAULT_MAX_SAMPLES = 64;
+	const float AdaptiveRenderer::DEFAULT_THRESHOLD = 0.05f;
+
+	namespace
+	{
+		// Errors of dark pixels are taken relative to this luminance, not to their own
+		const float MIN_LUMINANCE = 0.1f;
+
+		float radicalInverse(unsigned int i, unsigned int base)
+		{
+			float inverse = 1.0f / base;
+			float factor = inverse;
+			float result = 0.0f;
+			while (i > 0)
+			{
+				result += (i % base) * factor;
+				i /= base;
+				factor *= inverse;
+			}
+			return result;
+		}
+
+		unsigned int hash(unsigned int h)
+		{
+			h ^= h >> 16;
+			h *= 0x7feb352du;
+			h ^= h >> 15;
+			h *= 0x846ca68bu;
+			h ^= h >> 16;
+			return h;
+		}
+
+		float luminance(const glm::vec3& color)
+		{
+			return glm::dot(color, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+		}
+	}
+
+	AdaptiveRenderer::AdaptiveRenderer(const Scene& scene, unsigned int threadCount, unsigned int tileSize) :
+		_renderer(scene, threadCount, tileSize), _threshold(DEFAULT_THRESHOLD),
+		_baseSamples(DEFAULT_BASE_SAMPLES), _maxSamples(DEFAULT_MAX_SAMPLES), _seed(0),
+		_width(0), _height(0), _samples(0), _rounds(0)
+	{
+
+	}
+
+	void AdaptiveRenderer::setSampleCounts(unsigned int baseSamples, unsigned int maxSamples)
+	{
+		_baseSamples = std::max(1u, baseSamples);
+		_maxSamples = std::max(_baseSamples, maxSamples);
+	}
+
+	// Standard error of the mean luminance. Pixels with a single sample have no estimate and count as done.
+	float AdaptiveRenderer::error(size_t index) const
+	{
+		unsigned int n = _counts[index];
+		if (n < 2)
+		{
+			return 0.0f;
+		}
+		float mean = luminance(_sums[index]) / n;
+		float variance = std::max(0.0f, (_squares[index] - n * mean * mean) / (n - 1));
+		return std::sqrt(variance / n) / std::max(mean, MIN_LUMINANCE);
+	}
+
+	void AdaptiveRenderer::trace(const Camera& camera, bool adaptive)
+	{
+		SampleGrid grid;
+		grid.width = _width;
+		grid.height = _height;
+		// Filters as wide as the spacing of the base samples, pixels that get more are filtered a little wider than needed
+		grid.footprint = 1.0f / std::sqrt(float(_baseSamples));
+		grid.jitter = [&](unsigned int x, unsigned int y)
+		{
+			size_t index = (size_t)y * _width + x;
+			unsigned int h = hash(x * 73856093u ^ y * 19349663u ^ _seed * 83492791u);
+			glm::vec2 shift(float(h & 0xffff) / 65536.0f, float(h >> 16) / 65536.0f);
+			glm::vec2 p = glm::vec2(radicalInverse(_counts[index], 2), radicalInverse(_counts[index], 3)) + shift;
+			return p - glm::floor(p) - 0.5f;
+		};
+		if (adaptive)
+		{
+			grid.active = [&](unsigned int x, unsigned int y)
+			{
+				return _active[(size_t)y * _width + x] != 0;
+			};
+		}
+		grid.store = [&](unsigned int x, unsigned int y, const glm::vec3& color)
+		{
+			size_t index = (size_t)y * _width + x;
+			float l = luminance(color);
+			_sums[index] += color;
+			_squares[index] += l * l;
+			_counts[index]++;
+		};
+		_renderer.renderSamples(camera, grid);
+	}
+
+	void AdaptiveRenderer::render(const Camera& camera, FrameBuffer& frameBuffer)
+	{
+		_width = frameBuffer.getWidth();
+		_height = frameBuffer.getHeight();
+		size_t pixelCount = (size_t)_width * _height;
+		_sums.assign(pixelCount, glm::vec3(0.0f));
+		_squares.assign(pixelCount, 0.0f);
+		_counts.assign(pixelCount, 0);
+		_active.assign(pixelCount, 0);
+		_rounds = 0;
+
+		for (unsigned int i = 0; i < _baseSamples; i++)
+		{
+			trace(camera, false);
+		}
+
+		// Neighbours of a noisy pixel are sampled too: with few samples an edge that only just
+		// touches a pixel may not show in its own estimate yet
+		std::vector<unsigned char> noisy(pixelCount);
+		for (unsigned int round = _baseSamples; round < _maxSamples; round++)
+		{
+			bool any = false;
+			for (size_t i = 0; i < pixelCount; i++)
+			{
+				noisy[i] = _threshold <= 0.0f || error(i) > _threshold;
+			}
+			for (unsigned int y = 0; y < _height; y++)
+			{
+				for (unsigned int x = 0; x < _width; x++)
+				{
+					bool active = false;
+					for (unsigned int j = y > 0 ? y - 1 : 0; j <= std::min(y + 1, _height - 1) && !active; j++)
+					{
+						for (unsigned int i = x > 0 ? x - 1 : 0; i <= std::min(x + 1, _width - 1) && !active; i++)
+						{
+							active = noisy[(size_t)j * _width + i] != 0;
+						}
+					}
+					_active[(size_t)y * _width + x] = active;
+					any = any || active;
+				}
+			}
+			if (!any)
+			{
+				break;
+			}
+			trace(camera, true);
+			_rounds++;
+		}
+
+		_samples = 0;
+		for (unsigned int y = 0; y < _height; y++)
+		{
+			for (unsigned int x = 0; x < _width; x++)
+			{
+				size_t index = (size_t)y * _width + x;
+				_samples += _counts[index];
+				frameBuffer.setPixel(x, y, _sums[index] / float(_counts[index]));
+			}
+		}
+	}
+}
\ No newline at end of file
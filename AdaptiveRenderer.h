@@ -0,0 +1,56 @@
+#ifndef RAY_TRACING_ADAPTIVE_RENDERER_H
+#define RAY_TRACING_ADAPTIVE_RENDERER_H
+
+#include "Renderer.h"
+
+#include <vector>
+
+namespace RayTracing
+{
+	// Anti-aliased still frames. Every pixel gets a few base samples, then further rounds add one
+	// sample to each pixel whose estimated error is above the threshold, or that has such a pixel
+	// next to it, until none is left or they reach the max sample count. Sample positions follow a
+	// Halton (2, 3) sequence shifted by a random offset per pixel, so the samples of a pixel stay
+	// stratified over its area however many it ends up with.
+	class AdaptiveRenderer
+	{
+	public:
+		AdaptiveRenderer(const Scene& scene, unsigned int threadCount = 0, unsigned int tileSize = 32);
+		void render(const Camera& camera, FrameBuffer& frameBuffer);
+		// The quality knob: standard error of a pixel's mean luminance, relative to that luminance,
+		// below which the pixel is done. 0 gives every pixel the max sample count.
+		void setThreshold(float threshold) { _threshold = threshold; }
+		void setSampleCounts(unsigned int baseSamples, unsigned int maxSamples);
+		void setSeed(unsigned int seed) { _seed = seed; } // changes the per pixel shifts
+		void setPacketWidth(unsigned int width) { _renderer.setPacketWidth(width); } // for the base samples
+		float getThreshold() const { return _threshold; }
+		unsigned long long getSampleCount() const { return _samples; } // of the last frame
+		float getSamplesPerPixel() const { return _counts.empty() ? 0.0f : float(_samples) / _counts.size(); }
+		unsigned int getRoundCount() const { return _rounds; } // adaptive rounds of the last frame
+		Renderer& getRenderer() { return _renderer; }
+
+		static const unsigned int DEFAULT_BASE_SAMPLES;
+		static const unsigned int DEFAULT_MAX_SAMPLES;
+		static const float DEFAULT_THRESHOLD;
+	private:
+		void trace(const Camera& camera, bool adaptive);
+		float error(size_t index) const;
+
+		Renderer _renderer;
+		float _threshold;
+		unsigned int _baseSamples;
+		unsigned int _maxSamples;
+		unsigned int _seed;
+
+		unsigned int _width;
+		unsigned int _height;
+		std::vector<glm::vec3> _sums;
+		std::vector<float> _squares; // sum of the squared luminance of the samples
+		std::vector<unsigned int> _counts;
+		std::vector<unsigned char> _active; // gets a sample in the next round
+		unsigned long long _samples;
+		unsigned int _rounds;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,280 @@
+#include "Animation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace RayTracing
+{
+	namespace
+	{
+		// Keys sorted by frame, a later key at the same frame replaces the earlier one
+		template <typename Key>
+		void insertKey(std::vector<Key>& keys, const Key& key)
+		{
+			auto position = std::lower_bound(keys.begin(), keys.end(), key.frame,
+				[](const Key& k, float frame) { return k.frame < frame; });
+			if (position != keys.end() && position->frame == key.frame)
+			{
+				*position = key;
+			}
+			else
+			{
+				keys.insert(position, key);
+			}
+		}
+
+		// The two keys around frame and the weight of the second one
+		template <typename Key>
+		void findKeys(const std::vector<Key>& keys, float frame, const Key*& a, const Key*& b, float& weight)
+		{
+			auto next = std::upper_bound(keys.begin(), keys.end(), frame,
+				[](float frame, const Key& k) { return frame < k.frame; });
+			if (next == keys.begin() || next == keys.end())
+			{
+				a = b = next == keys.begin() ? &keys.front() : &keys.back();
+				weight = 0.0f;
+				return;
+			}
+			a = &*(next - 1);
+			b = &*next;
+			weight = (frame - a->frame) / (b->frame - a->frame);
+		}
+
+		glm::vec3 mix(const glm::vec3& a, const glm::vec3& b, float weight)
+		{
+			return a + (b - a) * weight;
+		}
+
+		// Directions are blended and renormalized, opposite ones fall back to the first
+		glm::vec3 mixDirection(const glm::vec3& a, const glm::vec3& b, float weight)
+		{
+			glm::vec3 direction = mix(a, b, weight);
+			float length = glm::length(direction);
+			return length > FLOAT_EPS ? direction / length : a;
+		}
+
+		// Rodrigues' formula, axis must be normalized
+		glm::vec3 rotate(const glm::vec3& v, const glm::vec3& axis, float degrees)
+		{
+			float radians = degrees * 3.14159265f / 180.0f;
+			float c = std::cos(radians), s = std::sin(radians);
+			return v * c + glm::cross(axis, v) * s + axis * (glm::dot(axis, v) * (1.0f - c));
+		}
+
+		double secondsSince(std::chrono::steady_clock::time_point begin)
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		}
+	}
+
+	void Animation::addCameraKey(float frame, const SceneCamera& camera)
+	{
+		insertKey(_cameraKeys, { frame, camera });
+	}
+
+	bool Animation::addEntityKey(const Scene& scene, EntityHandle handle, float frame, const Transform& transform)
+	{
+		if (handle.getType() == EntityHandle::OTHER)
+		{
+			return false;
+		}
+		auto track = std::find_if(_tracks.begin(), _tracks.end(),
+			[&](const Track& t) { return t.handle.value == handle.value; });
+		if (track == _tracks.end())
+		{
+			Track rest;
+			rest.handle = handle;
+			rest.restRadius = 0.0f;
+			const EntityStore& store = scene.getStore();
+			unsigned int slot = store.getSlot(handle);
+			switch (handle.getType())
+			{
+			case EntityHandle::SPHERE:
+				rest.rest[0] = store.getSphere(slot).getCenter();
+				rest.restRadius = store.getSphere(slot).getRadius();
+				break;
+			case EntityHandle::PLANE:
+				rest.rest[0] = store.getPlane(slot).getAPoint();
+				rest.rest[1] = store.getPlane(slot).getNormal();
+				break;
+			default:
+				store.getTriangle(slot).getVertice(rest.rest[0], rest.rest[1], rest.rest[2]);
+				break;
+			}
+			_tracks.push_back(rest);
+			track = _tracks.end() - 1;
+		}
+		Transform normalized = transform;
+		float length = glm::length(transform.axis);
+		normalized.axis = length > FLOAT_EPS ? transform.axis / length : glm::vec3(0.0f, 1.0f, 0.0f);
+		insertKey(track->keys, { frame, normalized });
+		return true;
+	}
+
+	unsigned int Animation::getFrameCount() const
+	{
+		if (_frameCount > 0)
+		{
+			return _frameCount;
+		}
+		float last = 0.0f;
+		if (!_cameraKeys.empty())
+		{
+			last = _cameraKeys.back().frame;
+		}
+		for (const auto& track : _tracks)
+		{
+			last = std::max(last, track.keys.back().frame);
+		}
+		return (unsigned int)std::max(0.0f, std::floor(last)) + 1;
+	}
+
+	SceneCamera Animation::getCamera(float frame, const SceneCamera& camera) const
+	{
+		if (_cameraKeys.empty())
+		{
+			return camera;
+		}
+		const CameraKey* a;
+		const CameraKey* b;
+		float weight;
+		findKeys(_cameraKeys, frame, a, b, weight);
+		SceneCamera result;
+		result.position = mix(a->camera.position, b->camera.position, weight);
+		result.front = mixDirection(a->camera.front, b->camera.front, weight);
+		result.up = mixDirection(a->camera.up, b->camera.up, weight);
+		return result;
+	}
+
+	void Animation::apply(Scene& scene, float frame) const
+	{
+		if (_tracks.empty())
+		{
+			return;
+		}
+		for (const auto& track : _tracks)
+		{
+			const TransformKey* a;
+			const TransformKey* b;
+			float weight;
+			findKeys(track.keys, frame, a, b, weight);
+			glm::vec3 translation = mix(a->transform.translation, b->transform.translation, weight);
+			glm::vec3 axis = mixDirection(a->transform.axis, b->transform.axis, weight);
+			float angle = a->transform.angle + (b->transform.angle - a->transform.angle) * weight;
+			float scale = a->transform.scale + (b->transform.scale - a->transform.scale) * weight;
+
+			switch (track.handle.getType())
+			{
+			case EntityHandle::SPHERE:
+				scene.setSphere(track.handle, track.rest[0] + translation, track.restRadius * scale);
+				break;
+			case EntityHandle::PLANE:
+				scene.setPlane(track.handle, track.rest[0] + translation, rotate(track.rest[1], axis, angle));
+				break;
+			default:
+			{
+				glm::vec3 center = (track.rest[0] + track.rest[1] + track.rest[2]) / 3.0f;
+				glm::vec3 vertices[3];
+				for (int i = 0; i < 3; i++)
+				{
+					vertices[i] = center + translation + rotate((track.rest[i] - center) * scale, axis, angle);
+				}
+				scene.setTriangle(track.handle, vertices[0], vertices[1], vertices[2]);
+				break;
+			}
+			}
+		}
+		scene.refitBVH();
+	}
+
+	AnimationRenderer::AnimationRenderer(Scene& scene0, Scene& scene1, const Animation& animation,
+		unsigned int threadCount, unsigned int tileSize) :
+		_scenes{ &scene0, &scene1 },
+		_renderers{ { scene0, threadCount, tileSize }, { scene1, threadCount, tileSize } },
+		_animation(animation),
+		_pipelined(true)
+	{
+
+	}
+
+	bool AnimationRenderer::render(unsigned int width, unsigned int height, const SceneCamera& camera,
+		const std::string& prefix, const std::string& extension)
+	{
+		_stats = Stats();
+		unsigned int frameCount = _animation.getFrameCount();
+		FrameBuffer frameBuffers[2] = { FrameBuffer(width, height), FrameBuffer(width, height) };
+		bool written = true;
+		auto begin = std::chrono::steady_clock::now();
+
+		auto write = [&](unsigned int frame)
+		{
+			auto writeBegin = std::chrono::steady_clock::now();
+			std::ostringstream path;
+			path << prefix << std::setw(4) << std::setfill('0') << frame << extension;
+			if (!frameBuffers[frame % 2].write(path.str()))
+			{
+				std::cout << "Failed to write " << path.str() << std::endl;
+				written = false;
+			}
+			_stats.writeSeconds += secondsSince(writeBegin);
+		};
+		auto update = [&](unsigned int frame)
+		{
+			auto updateBegin = std::chrono::steady_clock::now();
+			_animation.apply(*_scenes[frame % 2], float(frame));
+			_stats.updateSeconds += secondsSince(updateBegin);
+		};
+
+		if (frameCount > 0)
+		{
+			update(0);
+		}
+		for (unsigned int frame = 0; frame < frameCount; frame++)
+		{
+			// Everything but the tracing touches only the other scene and frame buffer
+			auto background = [&, frame]()
+			{
+				if (frame > 0)
+				{
+					write(frame - 1);
+				}
+				if (frame + 1 < frameCount)
+				{
+					update(frame + 1);
+				}
+			};
+			std::thread worker;
+			if (_pipelined)
+			{
+				worker = std::thread(background);
+			}
+
+			auto traceBegin = std::chrono::steady_clock::now();
+			SceneCamera pose = _animation.getCamera(float(frame), camera);
+			Camera view(pose.position, pose.front, pose.up, float(width) / height);
+			_renderers[frame % 2].render(view, frameBuffers[frame % 2]);
+			_stats.traceSeconds += secondsSince(traceBegin);
+
+			if (_pipelined)
+			{
+				worker.join();
+			}
+			else
+			{
+				background();
+			}
+			_stats.frames++;
+		}
+		if (frameCount > 0)
+		{
+			write(frameCount - 1);
+		}
+		_stats.seconds = secondsSince(begin);
+		return written;
+	}
+}
\ No newline at end of file
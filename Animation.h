@@ -0,0 +1,104 @@
+#ifndef RAY_TRACING_ANIMATION_H
+#define RAY_TRACING_ANIMATION_H
+
+#include "Renderer.h"
+#include "SceneLoader.h"
+
+#include <string>
+#include <vector>
+
+namespace RayTracing
+{
+	// Keyframed camera and entity motion. Keys sit at frame numbers, may be added in any order and
+	// are interpolated linearly; before the first and after the last key the nearest one holds.
+	// Only the spheres, planes and triangles of the EntityStore can be moved.
+	class Animation
+	{
+	public:
+		// Applied to the entity as it was when its first key was added: scale and rotation of angle
+		// degrees about axis around the entity's center, then translation
+		struct Transform
+		{
+			glm::vec3 translation = glm::vec3(0.0f);
+			glm::vec3 axis = glm::vec3(0.0f, 1.0f, 0.0f);
+			float angle = 0.0f;
+			float scale = 1.0f;
+		};
+
+		Animation() : _frameCount(0) {}
+		void addCameraKey(float frame, const SceneCamera& camera);
+		// The first key of an entity records its current geometry in scene as the rest pose.
+		// False for entities outside the EntityStore.
+		bool addEntityKey(const Scene& scene, EntityHandle handle, float frame, const Transform& transform);
+		// 0 means up to and including the last key
+		void setFrameCount(unsigned int count) { _frameCount = count; }
+		unsigned int getFrameCount() const;
+		bool empty() const { return _cameraKeys.empty() && _tracks.empty(); }
+
+		// camera is returned as it is if there are no camera keys
+		SceneCamera getCamera(float frame, const SceneCamera& camera) const;
+		// Moves the animated entities of scene to frame and refits its BVH. The scene must hold the same
+		// entities, added in the same order, as the one the keys were added with; it may be a copy of it.
+		void apply(Scene& scene, float frame) const;
+	private:
+		struct CameraKey
+		{
+			float frame;
+			SceneCamera camera;
+		};
+		struct TransformKey
+		{
+			float frame;
+			Transform transform;
+		};
+		struct Track
+		{
+			EntityHandle handle;
+			glm::vec3 rest[3]; // sphere center, plane point and normal, or triangle vertices
+			float restRadius;
+			std::vector<TransformKey> keys;
+		};
+
+		unsigned int _frameCount;
+		std::vector<CameraKey> _cameraKeys;
+		std::vector<Track> _tracks;
+	};
+
+	// Renders every frame of an animation to its own image. Two copies of the scene take turns:
+	// while one is traced, a second thread moves the other to the next frame, refits its BVH and
+	// writes out the image of the frame before.
+	class AnimationRenderer
+	{
+	public:
+		// The scenes must be built the same way, e.g. by loading one scene file twice
+		AnimationRenderer(Scene& scene0, Scene& scene1, const Animation& animation,
+			unsigned int threadCount = 0, unsigned int tileSize = 32);
+		// Frame i goes to prefix + i with 4 digits + extension, e.g. "frame0007.ppm". camera is used
+		// if the animation has no camera keys. False if an image can't be written.
+		bool render(unsigned int width, unsigned int height, const SceneCamera& camera,
+			const std::string& prefix, const std::string& extension);
+		// Off, each frame is updated, traced and written one step after another
+		void setPipelined(bool pipelined) { _pipelined = pipelined; }
+
+		// Of the last render. The stage times are summed over the frames; with pipelining the
+		// updates and writes overlap the tracing, so they can add up to more than the total.
+		struct Stats
+		{
+			unsigned int frames = 0;
+			double seconds = 0.0;
+			double traceSeconds = 0.0;
+			double updateSeconds = 0.0; // moving the entities and refitting the BVH
+			double writeSeconds = 0.0;
+			double getFramesPerMinute() const { return seconds > 0.0 ? frames * 60.0 / seconds : 0.0; }
+		};
+		const Stats& getStats() const { return _stats; }
+	private:
+		Scene* _scenes[2];
+		Renderer _renderers[2];
+		const Animation& _animation;
+		bool _pipelined;
+		Stats _stats;
+	};
+}
+
+#endif
\ No newline at end of file
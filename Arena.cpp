@@ -0,0 +1,59 @@
+#include "Arena.h"
+
+#include <cstdint>
+
+namespace RayTracing
+{
+	Arena::Arena(size_t blockSize) : _cursor(nullptr), _end(nullptr), _blockSize(blockSize), _capacity(0)
+	{
+
+	}
+
+	Arena::~Arena()
+	{
+		clear();
+	}
+
+	void* Arena::allocate(size_t size, size_t alignment)
+	{
+		uintptr_t aligned = (uintptr_t(_cursor) + alignment - 1) & ~uintptr_t(alignment - 1);
+		if (_cursor == nullptr || aligned + size > uintptr_t(_end))
+		{
+			// Oversized requests get a block of their own and the current block stays open
+			size_t blockSize = size + alignment > _blockSize ? size + alignment : _blockSize;
+			char* block = new char[blockSize];
+			_blocks.push_back(block);
+			_capacity += blockSize;
+			aligned = (uintptr_t(block) + alignment - 1) & ~uintptr_t(alignment - 1);
+			if (blockSize == _blockSize)
+			{
+				_end = block + blockSize;
+				_cursor = reinterpret_cast<char*>(aligned + size);
+			}
+			return reinterpret_cast<void*>(aligned);
+		}
+		_cursor = reinterpret_cast<char*>(aligned + size);
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	void Arena::swap(Arena& other)
+	{
+		std::swap(_blocks, other._blocks);
+		std::swap(_cursor, other._cursor);
+		std::swap(_end, other._end);
+		std::swap(_blockSize, other._blockSize);
+		std::swap(_capacity, other._capacity);
+	}
+
+	void Arena::clear()
+	{
+		for (char* block : _blocks)
+		{
+			delete[] block;
+		}
+		_blocks.clear();
+		_cursor = nullptr;
+		_end = nullptr;
+		_capacity = 0;
+	}
+}
\ No newline at end of file
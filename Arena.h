@@ -0,0 +1,117 @@
+#ifndef RAY_TRACING_ARENA_H
+#define RAY_TRACING_ARENA_H
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace RayTracing
+{
+	// Bump allocator over large blocks. Nothing is freed on its own, all memory goes at once
+	// when the arena is cleared or destroyed, so allocation is a pointer increment.
+	class Arena
+	{
+	public:
+		explicit Arena(size_t blockSize = DEFAULT_BLOCK_SIZE);
+		~Arena();
+		Arena(const Arena&) = delete;
+		Arena& operator=(const Arena&) = delete;
+
+		// alignment must be a power of two. Requests larger than a block get a block of their own.
+		void* allocate(size_t size, size_t alignment = CACHE_LINE);
+		// Frees every block, whatever was allocated must not be used anymore
+		void clear();
+		void swap(Arena& other);
+		size_t getCapacity() const { return _capacity; } // bytes held in blocks
+
+		static const size_t DEFAULT_BLOCK_SIZE = 1 << 16;
+		static const size_t CACHE_LINE = 64;
+	private:
+		std::vector<char*> _blocks;
+		char* _cursor;
+		char* _end;
+		size_t _blockSize;
+		size_t _capacity;
+	};
+
+	// Contiguous array whose storage comes from an Arena. Growing moves the elements to a block
+	// twice the size; the old one stays in the arena until it is cleared. Pointers to elements
+	// are valid until the next push_back.
+	template <typename T>
+	class ArenaArray
+	{
+	public:
+		explicit ArenaArray(Arena& arena) : _arena(&arena), _data(nullptr), _size(0), _capacity(0) {}
+		~ArenaArray() { clear(); }
+		ArenaArray(const ArenaArray&) = delete;
+		ArenaArray& operator=(const ArenaArray&) = delete;
+
+		void reserve(size_t capacity)
+		{
+			if (capacity <= _capacity)
+			{
+				return;
+			}
+			T* data = static_cast<T*>(_arena->allocate(capacity * sizeof(T), alignof(T) > Arena::CACHE_LINE ? alignof(T) : Arena::CACHE_LINE));
+			for (size_t i = 0; i < _size; i++)
+			{
+				new (data + i) T(std::move(_data[i]));
+				_data[i].~T();
+			}
+			_data = data;
+			_capacity = capacity;
+		}
+		void push_back(const T& value)
+		{
+			if (_size == _capacity)
+			{
+				reserve(_capacity == 0 ? 64 : _capacity * 2);
+			}
+			new (_data + _size) T(value);
+			_size++;
+		}
+		// Moves the elements into a block of arena just large enough for them, element i is taken
+		// from order[i], or from i if order is nullptr. The array keeps allocating from its own arena.
+		void reorder(Arena& arena, const unsigned int* order)
+		{
+			T* data = _size == 0 ? nullptr :
+				static_cast<T*>(arena.allocate(_size * sizeof(T), alignof(T) > Arena::CACHE_LINE ? alignof(T) : Arena::CACHE_LINE));
+			for (size_t i = 0; i < _size; i++)
+			{
+				new (data + i) T(std::move(_data[order != nullptr ? order[i] : i]));
+			}
+			for (size_t i = 0; i < _size; i++)
+			{
+				_data[i].~T();
+			}
+			_data = data;
+			_capacity = _size;
+		}
+		// Destroys the elements, the storage stays with the arena
+		void clear()
+		{
+			for (size_t i = 0; i < _size; i++)
+			{
+				_data[i].~T();
+			}
+			_size = 0;
+		}
+
+		size_t size() const { return _size; }
+		bool empty() const { return _size == 0; }
+		T* data() { return _data; }
+		const T* data() const { return _data; }
+		T& operator[](size_t i) { return _data[i]; }
+		const T& operator[](size_t i) const { return _data[i]; }
+		const T* begin() const { return _data; }
+		const T* end() const { return _data + _size; }
+	private:
+		Arena* _arena;
+		T* _data;
+		size_t _size;
+		size_t _capacity;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace RayTracing
+{
+	const unsigned int BVH::BIN_COUNT = 16;
+	const unsigned int BVH::MAX_LEAF_SIZE = 8;
+
+	void BVH::build(const std::vector<AABB>& primitiveBounds)
+	{
+		clear();
+		if (primitiveBounds.empty())
+		{
+			return;
+		}
+
+		std::vector<BuildEntry> entries(primitiveBounds.size());
+		for (size_t i = 0; i < primitiveBounds.size(); i++)
+		{
+			entries[i].bounds = primitiveBounds[i];
+			entries[i].centroid = primitiveBounds[i].centroid();
+			entries[i].primitive = (unsigned int)i;
+		}
+
+		_nodes.reserve(primitiveBounds.size() * 2);
+		Node root;
+		root.first = 0;
+		root.count = (unsigned int)primitiveBounds.size();
+		_nodes.push_back(root);
+		subdivide(0, 0, entries);
+
+		_primitives.resize(entries.size());
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			_primitives[i] = entries[i].primitive;
+		}
+	}
+
+	void BVH::clear()
+	{
+		_nodes.clear();
+		_primitives.clear();
+	}
+
+	void BVH::assign(const Node* nodes, size_t nodeCount, const unsigned int* primitives, size_t primitiveCount)
+	{
+		_nodes.assign(nodes, nodes + nodeCount);
+		_primitives.assign(primitives, primitives + primitiveCount);
+	}
+
+	void BVH::remapPrimitives(const std::vector<unsigned int>& map)
+	{
+		for (auto& primitive : _primitives)
+		{
+			primitive = map[primitive];
+		}
+	}
+
+	void BVH::refit(const std::vector<AABB>& primitiveBounds)
+	{
+		// Children are always stored after their parent, so walking backwards visits them first
+		for (size_t i = _nodes.size(); i-- > 0;)
+		{
+			Node& node = _nodes[i];
+			node.bounds = AABB();
+			if (node.count > 0)
+			{
+				for (unsigned int j = node.first; j < node.first + node.count; j++)
+				{
+					node.bounds.expand(primitiveBounds[_primitives[j]]);
+				}
+			}
+			else
+			{
+				node.bounds.expand(_nodes[node.first].bounds);
+				node.bounds.expand(_nodes[node.first + 1].bounds);
+			}
+		}
+	}
+
+	void BVH::subdivide(unsigned int nodeIndex, unsigned int depth, std::vector<BuildEntry>& entries)
+	{
+		unsigned int first = _nodes[nodeIndex].first;
+		unsigned int count = _nodes[nodeIndex].count;
+
+		AABB bounds, centroidBounds;
+		for (unsigned int i = first; i < first + count; i++)
+		{
+			bounds.expand(entries[i].bounds);
+			centroidBounds.expand(entries[i].centroid);
+		}
+		_nodes[nodeIndex].bounds = bounds;
+		if (count <= 2 || depth + 1 >= MAX_DEPTH)
+		{
+			return;
+		}
+
+		// Find the cheapest bin boundary over all three axes
+		float bestCost = std::numeric_limits<float>::max(); // costs grow past FLOAT_INF on big scenes
+		int bestAxis = -1;
+		unsigned int bestBin = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float lo = centroidBounds.min[axis];
+			float extent = centroidBounds.max[axis] - lo;
+			if (extent < FLOAT_EPS)
+			{
+				continue;
+			}
+			float scale = BIN_COUNT / extent;
+
+			AABB binBounds[BIN_COUNT];
+			unsigned int binCount[BIN_COUNT] = { 0 };
+			for (unsigned int i = first; i < first + count; i++)
+			{
+				unsigned int bin = std::min(BIN_COUNT - 1, (unsigned int)((entries[i].centroid[axis] - lo) * scale));
+				binCount[bin]++;
+				binBounds[bin].expand(entries[i].bounds);
+			}
+
+			// Sweep from the right to get the cost of every right side, then from the left
+			float rightArea[BIN_COUNT];
+			unsigned int rightCount[BIN_COUNT];
+			AABB box;
+			unsigned int sum = 0;
+			for (unsigned int bin = BIN_COUNT - 1; bin > 0; bin--)
+			{
+				box.expand(binBounds[bin]);
+				sum += binCount[bin];
+				rightArea[bin] = box.surfaceArea();
+				rightCount[bin] = sum;
+			}
+			box = AABB();
+			sum = 0;
+			for (unsigned int bin = 0; bin < BIN_COUNT - 1; bin++)
+			{
+				box.expand(binBounds[bin]);
+				sum += binCount[bin];
+				float cost = box.surfaceArea() * sum + rightArea[bin + 1] * rightCount[bin + 1];
+				if (sum > 0 && rightCount[bin + 1] > 0 && cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin;
+				}
+			}
+		}
+
+		auto begin = entries.begin() + first;
+		auto end = begin + count;
+		unsigned int leftCount;
+		if (bestAxis < 0)
+		{
+			// All centroids coincide, split in the middle if the leaf would be too big
+			if (count <= MAX_LEAF_SIZE)
+			{
+				return;
+			}
+			leftCount = count / 2;
+		}
+		else
+		{
+			float leafCost = bounds.surfaceArea() * count;
+			if (bestCost >= leafCost && count <= MAX_LEAF_SIZE)
+			{
+				return;
+			}
+			float lo = centroidBounds.min[bestAxis];
+			float scale = BIN_COUNT / (centroidBounds.max[bestAxis] - lo);
+			auto middle = std::partition(begin, end, [&](const BuildEntry& entry)
+			{
+				return std::min(BIN_COUNT - 1, (unsigned int)((entry.centroid[bestAxis] - lo) * scale)) <= bestBin;
+			});
+			leftCount = (unsigned int)(middle - begin);
+		}
+
+		unsigned int leftIndex = (unsigned int)_nodes.size();
+		Node left, right;
+		left.first = first;
+		left.count = leftCount;
+		right.first = first + leftCount;
+		right.count = count - leftCount;
+		_nodes.push_back(left);
+		_nodes.push_back(right);
+		_nodes[nodeIndex].first = leftIndex;
+		_nodes[nodeIndex].count = 0;
+
+		subdivide(leftIndex, depth + 1, entries);
+		subdivide(leftIndex + 1, depth + 1, entries);
+	}
+}
\ No newline at end of file
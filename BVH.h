@@ -0,0 +1,195 @@
+#ifndef RAY_TRACING_BVH_H
+#define RAY_TRACING_BVH_H
+
+#include "AABB.h"
+
+#include <vector>
+
+namespace RayTracing
+{
+	// Bounding volume hierarchy over primitives given by their bounds, built with binned SAH.
+	// Primitives are referred to by their index in the bounds array passed to build.
+	class BVH
+	{
+	public:
+		void build(const std::vector<AABB>& primitiveBounds);
+		void clear();
+		bool empty() const { return _nodes.empty(); }
+		size_t getNodeCount() const { return _nodes.size(); }
+		size_t getMemoryUsage() const { return _nodes.capacity() * sizeof(Node) + _primitives.capacity() * sizeof(unsigned int); }
+		AABB getBounds() const { return _nodes.empty() ? AABB() : _nodes[0].bounds; }
+
+		// Visits the leaves along the ray, nearer ones first, skipping everything behind the closest hit so far.
+		// intersect(primitive, tMax) tests one primitive and returns the new closest t, or tMax if it missed.
+		// Returns the closest t found, tMax if nothing was hit.
+		template <typename Intersect>
+		float traverse(const Ray& ray, float tMax, Intersect intersect) const;
+		// Any hit query: stops at the first primitive for which occluded(primitive, tMax) returns true
+		template <typename Occluded>
+		bool traverseAny(const Ray& ray, float tMax, Occluded occluded) const;
+
+		struct Node
+		{
+			AABB bounds;
+			unsigned int first; // first primitive for a leaf, left child for an interior node (right child is first + 1)
+			unsigned int count; // 0 for interior nodes
+		};
+		// Flat node array and leaf primitive order, for traversals outside this class
+		const std::vector<Node>& getNodes() const { return _nodes; }
+		const std::vector<unsigned int>& getPrimitives() const { return _primitives; }
+		// Takes the nodes and leaf order of a BVH built earlier, e.g. loaded from a scene cache
+		void assign(const Node* nodes, size_t nodeCount, const unsigned int* primitives, size_t primitiveCount);
+		// Primitive i is referred to as map[i] from now on, after the caller moved its primitives around
+		void remapPrimitives(const std::vector<unsigned int>& map);
+		// Recomputes the node bounds after primitives moved, keeping the tree as it is. Much cheaper
+		// than build, but the tree gets looser the further primitives move from where they were built.
+		void refit(const std::vector<AABB>& primitiveBounds);
+
+		static const unsigned int BIN_COUNT;
+		static const unsigned int MAX_LEAF_SIZE;
+		static const unsigned int MAX_DEPTH = 64;
+	private:
+		struct BuildEntry
+		{
+			AABB bounds;
+			glm::vec3 centroid;
+			unsigned int primitive;
+		};
+		void subdivide(unsigned int nodeIndex, unsigned int depth, std::vector<BuildEntry>& entries);
+
+		std::vector<Node> _nodes;
+		std::vector<unsigned int> _primitives;
+	};
+
+	template <typename Intersect>
+	float BVH::traverse(const Ray& ray, float tMax, Intersect intersect) const
+	{
+		if (_nodes.empty())
+		{
+			return tMax;
+		}
+
+		glm::vec3 origin = ray.getVertex();
+		glm::vec3 invDirection = ray.getInvDirection();
+		float minT = tMax;
+
+		// Nodes waiting to be visited, with the t at which the ray enters them
+		struct StackEntry
+		{
+			unsigned int node;
+			float t;
+		};
+		StackEntry stack[MAX_DEPTH]; // at most one entry per level
+		int size = 0;
+
+		float rootT = _nodes[0].bounds.rayCollision(origin, invDirection, minT);
+		if (rootT < FLOAT_INF)
+		{
+			stack[size++] = { 0, rootT };
+		}
+		while (size > 0)
+		{
+			StackEntry entry = stack[--size];
+			if (entry.t >= minT)
+			{
+				continue; // a closer hit was found after this node was pushed
+			}
+
+			const Node* node = &_nodes[entry.node];
+			while (node->count == 0)
+			{
+				unsigned int nearIndex = node->first;
+				unsigned int farIndex = node->first + 1;
+				float nearT = _nodes[nearIndex].bounds.rayCollision(origin, invDirection, minT);
+				float farT = _nodes[farIndex].bounds.rayCollision(origin, invDirection, minT);
+				if (farT < nearT)
+				{
+					std::swap(nearIndex, farIndex);
+					std::swap(nearT, farT);
+				}
+				if (nearT == FLOAT_INF)
+				{
+					node = nullptr;
+					break;
+				}
+				if (farT < FLOAT_INF)
+				{
+					stack[size++] = { farIndex, farT };
+				}
+				node = &_nodes[nearIndex];
+			}
+			if (node == nullptr)
+			{
+				continue;
+			}
+
+			for (unsigned int i = node->first; i < node->first + node->count; i++)
+			{
+				minT = intersect(_primitives[i], minT);
+			}
+		}
+		return minT;
+	}
+
+	template <typename Occluded>
+	bool BVH::traverseAny(const Ray& ray, float tMax, Occluded occluded) const
+	{
+		if (_nodes.empty())
+		{
+			return false;
+		}
+
+		glm::vec3 origin = ray.getVertex();
+		glm::vec3 invDirection = ray.getInvDirection();
+
+		// Like traverse, but any hit ends the walk. The near child is still visited first since
+		// occluders close to the ray origin (neighbouring geometry) are the most likely.
+		unsigned int stack[MAX_DEPTH]; // at most one entry per level
+		int size = 0;
+		if (_nodes[0].bounds.rayCollision(origin, invDirection, tMax) < FLOAT_INF)
+		{
+			stack[size++] = 0;
+		}
+		while (size > 0)
+		{
+			const Node* node = &_nodes[stack[--size]];
+			while (node->count == 0)
+			{
+				unsigned int nearIndex = node->first;
+				unsigned int farIndex = node->first + 1;
+				float nearT = _nodes[nearIndex].bounds.rayCollision(origin, invDirection, tMax);
+				float farT = _nodes[farIndex].bounds.rayCollision(origin, invDirection, tMax);
+				if (farT < nearT)
+				{
+					std::swap(nearIndex, farIndex);
+					std::swap(nearT, farT);
+				}
+				if (nearT == FLOAT_INF)
+				{
+					node = nullptr;
+					break;
+				}
+				if (farT < FLOAT_INF)
+				{
+					stack[size++] = farIndex;
+				}
+				node = &_nodes[nearIndex];
+			}
+			if (node == nullptr)
+			{
+				continue;
+			}
+
+			for (unsigned int i = node->first; i < node->first + node->count; i++)
+			{
+				if (occluded(_primitives[i], tMax))
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,2660 @@
+#include "Benchmark.h"
+#include "AdaptiveRenderer.h"
+#include "Animation.h"
+#include "DistributedRenderer.h"
+#include "Instance.h"
+#include "MeshLoader.h"
+#include "PacketTracer.h"
+#include "ProgressiveRenderer.h"
+#include "Rasterizer.h"
+#include "Renderer.h"
+#include "SceneCache.h"
+#include "TextureCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace RayTracing
+{
+	namespace
+	{
+		// Best of a few runs, the first frame of a pool also pays for waking its threads
+		double timeFrame(Renderer& renderer, const Camera& camera, FrameBuffer& frameBuffer, unsigned int runs = 3)
+		{
+			double best = 0.0;
+			for (unsigned int i = 0; i < runs; i++)
+			{
+				auto begin = std::chrono::steady_clock::now();
+				renderer.render(camera, frameBuffer);
+				auto end = std::chrono::steady_clock::now();
+				double seconds = std::chrono::duration<double>(end - begin).count();
+				if (i == 0 || seconds < best)
+				{
+					best = seconds;
+				}
+			}
+			return best;
+		}
+
+		// Rays from a shell around the [-size, size] cube aimed at random points inside it
+		std::vector<Ray> randomRays(unsigned int count, float size, std::mt19937& random)
+		{
+			std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+			std::vector<Ray> rays;
+			rays.reserve(count);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				glm::vec3 src(uniform(random), uniform(random), uniform(random));
+				glm::vec3 dest(uniform(random), uniform(random), uniform(random));
+				rays.push_back(Ray(glm::normalize(src) * size * 2.0f, dest * size));
+			}
+			return rays;
+		}
+
+		// Unit sphere made of rings x segments quads, two triangles each
+		void sphereMeshData(unsigned int rings, unsigned int segments, std::vector<glm::vec3>& positions, std::vector<unsigned int>& indices)
+		{
+			for (unsigned int i = 0; i <= rings; i++)
+			{
+				float theta = 3.14159265f * i / rings;
+				for (unsigned int j = 0; j < segments; j++)
+				{
+					float phi = 2.0f * 3.14159265f * j / segments;
+					positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)));
+				}
+			}
+			for (unsigned int i = 0; i < rings; i++)
+			{
+				for (unsigned int j = 0; j < segments; j++)
+				{
+					unsigned int a = i * segments + j;
+					unsigned int b = i * segments + (j + 1) % segments;
+					unsigned int c = a + segments;
+					unsigned int d = b + segments;
+					unsigned int quad[6] = { a, c, b, b, c, d };
+					indices.insert(indices.end(), quad, quad + 6);
+				}
+			}
+		}
+
+		// The sphere mesh written as OBJ with normals and as binary PLY
+		void writeSphereMesh(const std::string& objPath, const std::string& plyPath, unsigned int rings, unsigned int segments)
+		{
+			std::vector<glm::vec3> positions;
+			std::vector<unsigned int> indices;
+			sphereMeshData(rings, segments, positions, indices);
+
+			std::FILE* obj = std::fopen(objPath.c_str(), "wb");
+			for (const auto& p : positions)
+			{
+				std::fprintf(obj, "v %f %f %f\n", p.x, p.y, p.z);
+			}
+			for (const auto& p : positions)
+			{
+				std::fprintf(obj, "vn %f %f %f\n", p.x, p.y, p.z);
+			}
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				std::fprintf(obj, "f %u//%u %u//%u %u//%u\n", indices[i] + 1, indices[i] + 1,
+					indices[i + 1] + 1, indices[i + 1] + 1, indices[i + 2] + 1, indices[i + 2] + 1);
+			}
+			std::fclose(obj);
+
+			std::ofstream ply(plyPath, std::ios::binary);
+			ply << "ply\nformat binary_little_endian 1.0\n"
+				<< "element vertex " << positions.size() << "\n"
+				<< "property float x\nproperty float y\nproperty float z\n"
+				<< "property float nx\nproperty float ny\nproperty float nz\n"
+				<< "element face " << indices.size() / 3 << "\n"
+				<< "property list uchar int vertex_indices\nend_header\n";
+			for (const auto& p : positions)
+			{
+				float vertex[6] = { p.x, p.y, p.z, p.x, p.y, p.z };
+				ply.write(reinterpret_cast<const char*>(vertex), sizeof(vertex));
+			}
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				unsigned char count = 3;
+				ply.write(reinterpret_cast<const char*>(&count), 1);
+				ply.write(reinterpret_cast<const char*>(&indices[i]), 3 * sizeof(unsigned int));
+			}
+		}
+
+		// Closest hits of every pixel's primary ray, traced with the given packet width (1 is scalar)
+		double packetSeconds(const Scene& scene, const PacketTracer& packets, const std::vector<Ray>& rays,
+			unsigned int width, std::vector<HitRecord>& hits)
+		{
+			hits.resize(rays.size());
+			double best = 0.0;
+			for (unsigned int run = 0; run < 3; run++)
+			{
+				auto begin = std::chrono::steady_clock::now();
+				if (width == 1)
+				{
+					for (size_t i = 0; i < rays.size(); i++)
+					{
+						hits[i] = scene.getIntersection(rays[i]);
+					}
+				}
+				else
+				{
+					RayPacket packet;
+					for (size_t i = 0; i < rays.size(); i += width)
+					{
+						packet.count = (unsigned int)std::min<size_t>(width, rays.size() - i);
+						for (unsigned int lane = 0; lane < packet.count; lane++)
+						{
+							PacketTracer::setRay(packet, lane, rays[i + lane]);
+						}
+						packets.intersect(packet);
+						for (unsigned int lane = 0; lane < packet.count; lane++)
+						{
+							hits[i + lane] = packets.getHitRecord(packet, lane);
+						}
+					}
+				}
+				auto end = std::chrono::steady_clock::now();
+				double seconds = std::chrono::duration<double>(end - begin).count();
+				if (run == 0 || seconds < best)
+				{
+					best = seconds;
+				}
+			}
+			return best;
+		}
+
+		// The closure based material shading worked with before the MaterialTable, kept for comparison
+		struct FunctionMaterial
+		{
+			std::function<glm::vec3(const glm::vec3& pos)> ambient;
+			std::function<glm::vec3(const glm::vec3& pos)> diffuse;
+			std::function<glm::vec3(const glm::vec3& pos)> specular;
+			std::function<float(const glm::vec3& pos)> shininess;
+		};
+
+		struct FunctionLight
+		{
+			virtual ~FunctionLight() {}
+			virtual glm::vec3 calLight(const FunctionMaterial& material, const glm::vec3& fragPos, const glm::vec3& norm, const glm::vec3& viewDir) const = 0;
+		};
+
+		struct FunctionDirLight : public FunctionLight
+		{
+			FunctionDirLight(glm::vec3 a, glm::vec3 d, glm::vec3 s, glm::vec3 dir) : ambient(a), diffuse(d), specular(s), direction(dir) {}
+			glm::vec3 ambient, diffuse, specular, direction;
+
+			glm::vec3 calLight(const FunctionMaterial& material, const glm::vec3& fragPos, const glm::vec3& norm, const glm::vec3& viewDir) const
+			{
+				glm::vec3 lightDir = glm::normalize(-direction);
+				float diff = std::max(glm::dot(norm, lightDir), 0.0f);
+				glm::vec3 middle = glm::normalize(-viewDir + lightDir);
+				float spec = glm::pow(std::max(glm::dot(middle, norm), 0.0f), material.shininess(fragPos));
+				return ambient * material.ambient(fragPos) + diff * diffuse * material.diffuse(fragPos) +
+					specular * spec * material.specular(fragPos);
+			}
+		};
+
+		// Unit sphere mesh of rings x segments quads, scaled and moved
+		Mesh* sphereMesh(unsigned int rings, unsigned int segments, const glm::vec3& center, float radius)
+		{
+			std::vector<glm::vec3> positions;
+			std::vector<unsigned int> indices;
+			sphereMeshData(rings, segments, positions, indices);
+			Mesh* mesh = new Mesh;
+			mesh->reserve(positions.size(), indices.size() / 3);
+			for (const auto& p : positions)
+			{
+				mesh->addPosition(p * radius + center);
+			}
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				mesh->addTriangle(&indices[i]);
+			}
+			mesh->build();
+			return mesh;
+		}
+
+		// 10k small spheres in front of the camera over a plane, and two lights if asked for
+		void buildSphereField(Scene& scene, bool addLights)
+		{
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> position(-4.0f, 4.0f);
+			std::uniform_real_distribution<float> radius(0.02f, 0.1f);
+			scene.reserve(10000, 1, 0);
+			for (unsigned int i = 0; i < 10000; i++)
+			{
+				scene.addSphere(glm::vec3(position(random), position(random), position(random) - 8.0f), radius(random));
+			}
+			scene.addPlane(glm::vec3(0.0f, -4.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			if (addLights)
+			{
+				scene.addLight(new DirLight(glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(1.0f), glm::vec3(-0.5f, -1.0f, -1.0f)));
+				scene.addLight(new DirLight(glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(1.0f), glm::vec3(0.5f, -1.0f, 0.2f)));
+			}
+		}
+
+		// Records the closest t of every ray; building the BVH moves the entities, so their addresses can't be compared
+		double traceSeconds(const Scene& scene, const std::vector<Ray>& rays, unsigned int count, std::vector<float>& hits)
+		{
+			hits.resize(count);
+			auto begin = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < count; i++)
+			{
+				hits[i] = scene.getIntersection(rays[i]).t;
+			}
+			auto end = std::chrono::steady_clock::now();
+			return std::chrono::duration<double>(end - begin).count();
+		}
+	}
+
+	void benchmarkScaling(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height,
+		unsigned int maxThreads, unsigned int tileSize, std::ostream& out)
+	{
+		FrameBuffer reference(width, height);
+		FrameBuffer frameBuffer(width, height);
+		double baseSeconds = 0.0;
+
+		out << "threads  ms        speedup  efficiency  identical" << std::endl;
+		for (unsigned int threads = 1; threads <= maxThreads; threads++)
+		{
+			Renderer renderer(scene, threads, tileSize);
+			double seconds = timeFrame(renderer, camera, threads == 1 ? reference : frameBuffer);
+			if (threads == 1)
+			{
+				baseSeconds = seconds;
+			}
+			bool identical = threads == 1 ||
+				std::memcmp(reference.getData(), frameBuffer.getData(), sizeof(float) * 3 * width * height) == 0;
+
+			double speedup = baseSeconds / seconds;
+			out << std::fixed << std::setprecision(2)
+				<< std::setw(7) << threads << "  "
+				<< std::setw(8) << seconds * 1000.0 << "  "
+				<< std::setw(7) << speedup << "  "
+				<< std::setw(10) << speedup / threads << "  "
+				<< (identical ? "yes" : "NO") << std::endl;
+
+			const auto& stats = renderer.getThreadStats();
+			for (unsigned int i = 0; i < stats.size(); i++)
+			{
+				out << "         thread " << i << ": " << stats[i].tasks << " tiles, "
+					<< stats[i].stolen << " stolen, "
+					<< stats[i].busySeconds * 1000.0 << " ms busy" << std::endl;
+			}
+		}
+	}
+
+	void benchmarkDistributed(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height,
+		const std::string& program, std::ostream& out)
+	{
+		FrameBuffer reference(width, height);
+		FrameBuffer frameBuffer(width, height);
+		Renderer local(scene, 1);
+		local.setPacketWidth(16);
+		double localSeconds = timeFrame(local, camera, reference);
+		out << "in-process renderer, 1 thread: " << std::fixed << std::setprecision(2) << localSeconds * 1000.0 << " ms" << std::endl;
+
+		auto timeDistributed = [&](DistributedRenderer& renderer)
+		{
+			double best = 0.0;
+			for (unsigned int i = 0; i < 3; i++)
+			{
+				auto begin = std::chrono::steady_clock::now();
+				if (!renderer.render(camera, frameBuffer))
+				{
+					return -1.0;
+				}
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+				best = i == 0 ? seconds : std::min(best, seconds);
+			}
+			return best;
+		};
+		auto identical = [&]()
+		{
+			return std::memcmp(reference.getData(), frameBuffer.getData(), sizeof(float) * 3 * width * height) == 0;
+		};
+
+		unsigned int maxWorkers = std::max(4u, std::thread::hardware_concurrency());
+		double baseSeconds = 0.0;
+		out << "workers  scene ms  ms        speedup  efficiency  vs in-process  requests  identical" << std::endl;
+		for (unsigned int workers = 1; workers <= maxWorkers; workers *= 2)
+		{
+			DistributedRenderer renderer(program, workers, 1);
+			renderer.setPacketWidth(16);
+			auto begin = std::chrono::steady_clock::now();
+			bool started = renderer.setScene(scene);
+			double sceneSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			double seconds = started ? timeDistributed(renderer) : -1.0;
+			if (seconds < 0.0)
+			{
+				out << std::setw(7) << workers << "  workers failed" << std::endl;
+				return;
+			}
+			if (workers == 1)
+			{
+				baseSeconds = seconds;
+			}
+			double speedup = baseSeconds / seconds;
+			out << std::setw(7) << workers << "  "
+				<< std::setw(8) << sceneSeconds * 1000.0 << "  "
+				<< std::setw(8) << seconds * 1000.0 << "  "
+				<< std::setw(7) << speedup << "  "
+				<< std::setw(10) << speedup / workers << "  "
+				<< std::setw(13) << localSeconds / seconds << "  "
+				<< std::setw(8) << renderer.getStats().requests << "  "
+				<< (identical() ? "yes" : "NO") << std::endl;
+		}
+
+		// Kill worker 0 halfway through a frame, the others render the range it had
+		unsigned int workers = std::max(2u, std::min(maxWorkers, std::thread::hardware_concurrency()));
+		DistributedRenderer renderer(program, workers, 1);
+		renderer.setPacketWidth(16);
+		double seconds = renderer.setScene(scene) ? timeDistributed(renderer) : -1.0;
+		frameBuffer.clear();
+		std::thread killer([&]()
+		{
+			std::this_thread::sleep_for(std::chrono::duration<double>(seconds / 2));
+			renderer.stopWorker(0);
+		});
+		auto begin = std::chrono::steady_clock::now();
+		bool rendered = seconds >= 0.0 && renderer.render(camera, frameBuffer);
+		double killedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		killer.join();
+		out << workers << " workers, worker 0 killed after " << seconds * 500.0 << " ms: "
+			<< (rendered ? "" : "FAILED, ") << killedSeconds * 1000.0 << " ms, "
+			<< renderer.getStats().redispatched << " ranges sent again, "
+			<< renderer.getWorkerCount() << " workers left, identical: " << (rendered && identical() ? "yes" : "NO") << std::endl;
+	}
+
+	void benchmarkBVH(std::ostream& out)
+	{
+		const unsigned int rayCount = 200000;
+		std::mt19937 random(1);
+
+		out << "entities  build ms  nodes    linear Mrays/s  bvh Mrays/s  speedup  mismatches" << std::endl;
+		for (unsigned int entityCount : { 100u, 1000u, 10000u, 100000u })
+		{
+			// Keep the sphere density constant so the number of hits per ray stays comparable
+			float size = 10.0f * std::cbrt(entityCount / 1000.0f);
+			std::uniform_real_distribution<float> position(-size, size);
+			std::uniform_real_distribution<float> radius(0.1f, 0.5f);
+			Scene scene;
+			for (unsigned int i = 0; i < entityCount; i++)
+			{
+				scene.addEntity(new Sphere(glm::vec3(position(random), position(random), position(random)), radius(random)));
+			}
+			auto rays = randomRays(rayCount, size, random);
+
+			// The linear scan gets fewer rays on big scenes, otherwise it takes minutes
+			unsigned int linearCount = std::min(rayCount, std::max(1000u, 20000000u / entityCount));
+			std::vector<float> linearHits, bvhHits;
+			double linearSeconds = traceSeconds(scene, rays, linearCount, linearHits);
+
+			auto begin = std::chrono::steady_clock::now();
+			scene.buildBVH();
+			auto end = std::chrono::steady_clock::now();
+			double buildSeconds = std::chrono::duration<double>(end - begin).count();
+
+			double bvhSeconds = traceSeconds(scene, rays, rayCount, bvhHits);
+			unsigned int mismatches = 0;
+			for (unsigned int i = 0; i < linearCount; i++)
+			{
+				mismatches += linearHits[i] != bvhHits[i] ? 1 : 0;
+			}
+
+			double linearRate = linearCount / linearSeconds;
+			double bvhRate = rayCount / bvhSeconds;
+			out << std::fixed << std::setprecision(2)
+				<< std::setw(8) << entityCount << "  "
+				<< std::setw(8) << buildSeconds * 1000.0 << "  "
+				<< std::setw(7) << scene.getBVHNodeCount() << "  "
+				<< std::setprecision(4)
+				<< std::setw(14) << linearRate / 1e6 << "  "
+				<< std::setw(11) << bvhRate / 1e6 << "  "
+				<< std::setprecision(2)
+				<< std::setw(7) << bvhRate / linearRate << "  "
+				<< mismatches << std::endl;
+		}
+	}
+
+	void benchmarkAnimation(std::ostream& out)
+	{
+		const unsigned int entityCount = 10000;
+		const unsigned int rayCount = 200000;
+		const unsigned int frameCount = 33;
+		std::mt19937 random(1);
+		float size = 10.0f * std::cbrt(entityCount / 1000.0f);
+		std::uniform_real_distribution<float> position(-size, size);
+		std::uniform_real_distribution<float> radius(0.1f, 0.5f);
+		std::uniform_real_distribution<float> speed(-0.1f, 0.1f); // per frame, a fifth of the scene by the last frame
+
+		// Half spheres, half triangles, every one drifting in its own direction
+		Scene refitScene, rebuildScene;
+		Animation animation;
+		for (unsigned int i = 0; i < entityCount; i++)
+		{
+			glm::vec3 center(position(random), position(random), position(random));
+			float r = radius(random);
+			Animation::Transform last;
+			last.translation = glm::vec3(speed(random), speed(random), speed(random)) * float(frameCount - 1);
+			last.axis = glm::vec3(position(random), position(random), position(random));
+			last.angle = 180.0f;
+			EntityHandle handle;
+			if (i % 2 == 0)
+			{
+				handle = refitScene.addSphere(center, r);
+				rebuildScene.addSphere(center, r);
+			}
+			else
+			{
+				glm::vec3 A = center + glm::vec3(r, 0.0f, 0.0f), B = center + glm::vec3(0.0f, r, 0.0f), C = center + glm::vec3(0.0f, 0.0f, r);
+				handle = refitScene.addTriangle(A, B, C);
+				rebuildScene.addTriangle(A, B, C);
+			}
+			animation.addEntityKey(refitScene, handle, 0.0f, Animation::Transform());
+			animation.addEntityKey(refitScene, handle, float(frameCount - 1), last);
+		}
+		refitScene.buildBVH();
+		rebuildScene.buildBVH();
+		auto rays = randomRays(rayCount, size, random);
+
+		auto seconds = [](std::chrono::steady_clock::time_point begin)
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		};
+
+		out << entityCount << " moving spheres and triangles, " << rayCount << " random rays per frame" << std::endl;
+		out << "frame  refit ms  rebuild ms  refit Mrays/s  rebuild Mrays/s  mismatches" << std::endl;
+		for (unsigned int frame = 0; frame < frameCount; frame++)
+		{
+			// Animation::apply moves the entities and refits, the rebuilt scene then builds a new BVH on top
+			auto begin = std::chrono::steady_clock::now();
+			animation.apply(refitScene, float(frame));
+			double refitSeconds = seconds(begin);
+			begin = std::chrono::steady_clock::now();
+			animation.apply(rebuildScene, float(frame));
+			rebuildScene.buildBVH();
+			double rebuildSeconds = seconds(begin);
+
+			if (frame % 8 != 0)
+			{
+				continue;
+			}
+			std::vector<float> refitHits, rebuildHits;
+			double refitTrace = traceSeconds(refitScene, rays, rayCount, refitHits);
+			double rebuildTrace = traceSeconds(rebuildScene, rays, rayCount, rebuildHits);
+			unsigned int mismatches = 0;
+			for (unsigned int i = 0; i < rayCount; i++)
+			{
+				mismatches += refitHits[i] != rebuildHits[i] ? 1 : 0;
+			}
+			out << std::fixed << std::setprecision(3)
+				<< std::setw(5) << frame << "  "
+				<< std::setw(8) << refitSeconds * 1000.0 << "  "
+				<< std::setw(10) << rebuildSeconds * 1000.0 << "  "
+				<< std::setw(13) << rayCount / refitTrace / 1e6 << "  "
+				<< std::setw(15) << rayCount / rebuildTrace / 1e6 << "  "
+				<< mismatches << std::endl;
+		}
+	}
+
+	void benchmarkInstance(std::ostream& out)
+	{
+		const unsigned int rayCount = 200000;
+		const unsigned int maxFlatCopies = 1000; // 10k flattened copies need gigabytes
+		std::vector<glm::vec3> positions;
+		std::vector<unsigned int> indices;
+		sphereMeshData(12, 24, positions, indices);
+		std::shared_ptr<Mesh> geometry(sphereMesh(12, 24, glm::vec3(0.0f), 1.0f));
+		std::mt19937 random(1);
+
+		out << geometry->getTriangleCount() << " triangle mesh placed with random rotation and scale" << std::endl;
+		out << "copies  kind       MB       build ms  Mrays/s  mismatches" << std::endl;
+		for (unsigned int copyCount : { 100u, 1000u, 10000u })
+		{
+			float size = 10.0f * std::cbrt(copyCount / 1000.0f);
+			std::uniform_real_distribution<float> position(-size, size);
+			std::uniform_real_distribution<float> scale(0.3f, 0.6f);
+			std::uniform_real_distribution<float> angle(0.0f, 6.2831853f);
+			std::vector<glm::mat4> transforms;
+			for (unsigned int i = 0; i < copyCount; i++)
+			{
+				glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random), position(random)));
+				transform = glm::rotate(transform, angle(random), glm::vec3(position(random), position(random), position(random)));
+				transforms.push_back(glm::scale(transform, glm::vec3(scale(random), scale(random), scale(random))));
+			}
+			auto rays = randomRays(rayCount, size, random);
+
+			// Instances: the scene BVH over the instances, one shared mesh below
+			Scene instanced;
+			auto begin = std::chrono::steady_clock::now();
+			for (const auto& transform : transforms)
+			{
+				instanced.addEntity(new Instance(geometry, transform));
+			}
+			instanced.buildBVH();
+			double instancedBuild = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			size_t instancedBytes = instanced.getBVH().getMemoryUsage() + copyCount * sizeof(Instance) + geometry->getMemoryUsage();
+			std::vector<float> instancedHits, flatHits;
+			double instancedSeconds = traceSeconds(instanced, rays, rayCount, instancedHits);
+
+			out << std::fixed << std::setprecision(2)
+				<< std::setw(6) << copyCount << "  instanced  "
+				<< std::setw(7) << instancedBytes / 1e6 << "  "
+				<< std::setw(8) << instancedBuild * 1000.0 << "  "
+				<< std::setw(7) << rayCount / instancedSeconds / 1e6 << std::endl;
+			if (copyCount > maxFlatCopies)
+			{
+				continue;
+			}
+
+			// Flattened: every copy a mesh of its own with the transform baked into its vertices
+			Scene flat;
+			begin = std::chrono::steady_clock::now();
+			size_t flatBytes = 0;
+			for (const auto& transform : transforms)
+			{
+				Mesh* mesh = new Mesh;
+				mesh->reserve(positions.size(), indices.size() / 3);
+				for (const auto& p : positions)
+				{
+					mesh->addPosition(glm::vec3(transform * glm::vec4(p, 1.0f)));
+				}
+				for (size_t i = 0; i < indices.size(); i += 3)
+				{
+					mesh->addTriangle(&indices[i]);
+				}
+				mesh->build();
+				flatBytes += sizeof(Mesh) + mesh->getMemoryUsage();
+				flat.addEntity(mesh);
+			}
+			flat.buildBVH();
+			double flatBuild = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+			flatBytes += flat.getBVH().getMemoryUsage();
+			double flatSeconds = traceSeconds(flat, rays, rayCount, flatHits);
+
+			// The two transform the same points in different order, so hits may differ in the last bits
+			unsigned int mismatches = 0;
+			for (unsigned int i = 0; i < rayCount; i++)
+			{
+				mismatches += std::abs(instancedHits[i] - flatHits[i]) > 1e-3f * std::max(1.0f, flatHits[i]) ? 1 : 0;
+			}
+			out << std::fixed << std::setprecision(2)
+				<< std::setw(6) << copyCount << "  flattened  "
+				<< std::setw(7) << flatBytes / 1e6 << "  "
+				<< std::setw(8) << flatBuild * 1000.0 << "  "
+				<< std::setw(7) << rayCount / flatSeconds / 1e6 << "  "
+				<< mismatches << std::endl;
+		}
+	}
+
+	void benchmarkLayout(std::ostream& out)
+	{
+		const unsigned int rayCount = 200000;
+		std::mt19937 random(1);
+
+		out << "closest hits in Mrays/s; pointers: one heap block per entity, virtual rayIntersect" << std::endl;
+		out << "entities  pointer B/entity  store B/entity  pointer bvh  store bvh  speedup  pointer linear  store linear  speedup  mismatches" << std::endl;
+		for (unsigned int entityCount : { 1000u, 10000u, 100000u, 1000000u })
+		{
+			// Half spheres, half triangles, at constant density
+			float size = 10.0f * std::cbrt(entityCount / 1000.0f);
+			std::uniform_real_distribution<float> position(-size, size);
+			std::uniform_real_distribution<float> offset(-0.5f, 0.5f);
+			std::uniform_real_distribution<float> radius(0.1f, 0.5f);
+			Scene scene;
+			std::vector<Entity*> pointers;
+			size_t pointerBytes = 0;
+			for (unsigned int i = 0; i < entityCount; i++)
+			{
+				glm::vec3 center(position(random), position(random), position(random));
+				if (i % 2 == 0)
+				{
+					float r = radius(random);
+					scene.addSphere(center, r);
+					pointers.push_back(new Sphere(center, r));
+					pointerBytes += sizeof(Sphere);
+				}
+				else
+				{
+					glm::vec3 B = center + glm::vec3(offset(random), offset(random), offset(random));
+					glm::vec3 C = center + glm::vec3(offset(random), offset(random), offset(random));
+					scene.addTriangle(center, B, C);
+					pointers.push_back(new Triangle(center, B, C));
+					pointerBytes += sizeof(Triangle);
+				}
+				pointerBytes += sizeof(Entity*);
+			}
+			auto rays = randomRays(rayCount, size, random);
+			unsigned int linearCount = entityCount <= 10000 ? std::min(rayCount, 20000000u / entityCount) : 0;
+
+			auto pointerIntersection = [&](const BVH* bvh, const Ray& ray)
+			{
+				HitRecord hit;
+				if (bvh == nullptr)
+				{
+					for (auto pEntity : pointers)
+					{
+						pEntity->rayIntersect(ray, hit);
+					}
+					return hit;
+				}
+				bvh->traverse(ray, FLOAT_INF, [&](unsigned int index, float tMax)
+				{
+					pointers[index]->rayIntersect(ray, hit);
+					return hit.t;
+				});
+				return hit;
+			};
+			auto rate = [](unsigned int count, std::chrono::steady_clock::time_point begin)
+			{
+				return count / std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() / 1e6;
+			};
+
+			// Linear scans, before the BVH is built
+			std::vector<float> pointerT(rayCount), storeT(rayCount);
+			double pointerLinear = 0.0, storeLinear = 0.0;
+			if (linearCount > 0)
+			{
+				auto begin = std::chrono::steady_clock::now();
+				for (unsigned int i = 0; i < linearCount; i++)
+				{
+					pointerT[i] = pointerIntersection(nullptr, rays[i]).t;
+				}
+				pointerLinear = rate(linearCount, begin);
+				begin = std::chrono::steady_clock::now();
+				for (unsigned int i = 0; i < linearCount; i++)
+				{
+					storeT[i] = scene.getIntersection(rays[i]).t;
+				}
+				storeLinear = rate(linearCount, begin);
+			}
+
+			std::vector<AABB> bounds;
+			for (auto pEntity : pointers)
+			{
+				bounds.push_back(pEntity->getBounds());
+			}
+			BVH bvh;
+			bvh.build(bounds);
+			scene.buildBVH();
+			unsigned int mismatches = 0;
+			auto begin = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < rayCount; i++)
+			{
+				float t = pointerIntersection(&bvh, rays[i]).t;
+				mismatches += i < linearCount && t != pointerT[i] ? 1 : 0;
+				pointerT[i] = t;
+			}
+			double pointerBVH = rate(rayCount, begin);
+			begin = std::chrono::steady_clock::now();
+			for (unsigned int i = 0; i < rayCount; i++)
+			{
+				float t = scene.getIntersection(rays[i]).t;
+				mismatches += t != pointerT[i] || (i < linearCount && t != storeT[i]) ? 1 : 0;
+			}
+			double storeBVH = rate(rayCount, begin);
+
+			out << std::fixed << std::setprecision(2)
+				<< std::setw(8) << entityCount << "  "
+				<< std::setw(16) << double(pointerBytes) / entityCount << "  "
+				<< std::setw(14) << double(scene.getStore().getMemoryUsage()) / entityCount << "  "
+				<< std::setprecision(4)
+				<< std::setw(11) << pointerBVH << "  "
+				<< std::setw(9) << storeBVH << "  "
+				<< std::setprecision(2)
+				<< std::setw(7) << storeBVH / pointerBVH << "  ";
+			if (linearCount > 0)
+			{
+				out << std::setprecision(4)
+					<< std::setw(14) << pointerLinear << "  "
+					<< std::setw(12) << storeLinear << "  "
+					<< std::setprecision(2)
+					<< std::setw(7) << storeLinear / pointerLinear << "  ";
+			}
+			else
+			{
+				out << "             -             -        -  ";
+			}
+			out << mismatches << std::endl;
+
+			for (auto pEntity : pointers)
+			{
+				delete pEntity;
+			}
+		}
+		out << "pointer bytes leave out the allocator's block headers" << std::endl;
+	}
+
+	void benchmarkTriangle(std::ostream& out)
+	{
+		const unsigned int count = 1000000;
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+		struct Case
+		{
+			Triangle triangle;
+			Ray ray;
+			float t, u, v;
+			bool hit;
+		};
+		std::vector<Case> cases;
+		cases.reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			glm::vec3 A(uniform(random), uniform(random), uniform(random));
+			glm::vec3 B(uniform(random), uniform(random), uniform(random));
+			glm::vec3 C(uniform(random), uniform(random), uniform(random));
+			if (glm::length(glm::cross(B - A, C - A)) < 0.01f)
+			{
+				i--;
+				continue; // skip degenerate triangles
+			}
+
+			// Aim at a point inside the triangle for even cases and outside of it for odd ones,
+			// keeping clear of the edges so rounding can't flip the expected answer
+			float u = unit(random), v = unit(random);
+			bool hit = i % 2 == 0;
+			if (hit)
+			{
+				if (u + v > 1.0f)
+				{
+					u = 1.0f - u;
+					v = 1.0f - v;
+				}
+				u = 0.01f + 0.97f * u;
+				v = 0.01f + 0.97f * v;
+			}
+			else
+			{
+				u = 0.6f + u;
+				v = 0.6f + v;
+			}
+			glm::vec3 target = (1.0f - u - v) * A + u * B + v * C;
+			glm::vec3 src = target + 3.0f * glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)));
+			Triangle triangle(A, B, C);
+			if (std::abs(glm::dot(glm::normalize(target - src), triangle.getNormal())) < 0.01f)
+			{
+				i--;
+				continue; // grazing rays, the expected values themselves are not precise enough
+			}
+			cases.push_back({ triangle, Ray(src, target), glm::distance(src, target), u, v, hit });
+		}
+
+		unsigned int wrongHits = 0, wrongValues = 0;
+		for (const auto& c : cases)
+		{
+			float t, u, v;
+			bool hit = c.triangle.intersect(c.ray, t, u, v) && t > 0.0f;
+			if (hit != c.hit)
+			{
+				wrongHits++;
+			}
+			else if (hit && (std::abs(t - c.t) > 1e-3f || std::abs(u - c.u) > 1e-3f || std::abs(v - c.v) > 1e-3f))
+			{
+				wrongValues++;
+			}
+		}
+		out << "cases: " << count << ", wrong hit/miss: " << wrongHits
+			<< ", wrong t or barycentrics: " << wrongValues << std::endl;
+
+		// Rays aimed at points on the shared edges of a closed mesh must hit one of the two triangles.
+		// A ray that falls through hits the far side of the mesh instead, or nothing.
+		for (const glm::vec3& center : { glm::vec3(0.0f), glm::vec3(1000.0f, -500.0f, 300.0f) })
+		{
+			Scene scene;
+			Mesh* mesh = sphereMesh(64, 128, center, 1.0f);
+			scene.addEntity(mesh);
+			scene.buildBVH();
+			PacketTracer packets;
+			packets.build(scene);
+			packets.setWidth(PacketTracer::getSupportedWidth());
+			std::vector<Ray> rays;
+			std::vector<float> distances;
+			while (rays.size() < count / 4)
+			{
+				unsigned int triangle = (unsigned int)(unit(random) * mesh->getTriangleCount()) % mesh->getTriangleCount();
+				int corner = int(unit(random) * 3.0f) % 3;
+				glm::vec3 A = mesh->getVertex(triangle, corner), B = mesh->getVertex(triangle, (corner + 1) % 3);
+				glm::vec3 target = A + unit(random) * (B - A);
+				if (std::abs(target.y - center.y) > 0.998f)
+				{
+					continue; // the rows at the poles, where the last ring folds over the pole by rounding
+				}
+				glm::vec3 direction = glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)));
+				if (glm::dot(direction, target - center) < 0.5f * glm::length(target - center))
+				{
+					continue; // from outside the mesh, not grazing it
+				}
+				glm::vec3 src = target + 0.5f * direction;
+				rays.push_back(Ray(src, target));
+				distances.push_back(glm::distance(src, target));
+			}
+			auto fellThrough = [&](size_t i, float t)
+			{
+				return !(std::abs(t - distances[i]) < 1e-3f);
+			};
+			unsigned int scalarMisses = 0, packetMisses = 0;
+			RayPacket packet;
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				HitRecord hit = scene.getIntersection(rays[i]);
+				scalarMisses += hit.entity == nullptr || fellThrough(i, hit.t);
+			}
+			if (packets.isComplete() && packets.getWidth() > 1)
+			{
+				for (size_t i = 0; i < rays.size(); i += packets.getWidth())
+				{
+					packet.count = (unsigned int)std::min<size_t>(packets.getWidth(), rays.size() - i);
+					for (unsigned int lane = 0; lane < packet.count; lane++)
+					{
+						PacketTracer::setRay(packet, lane, rays[i + lane]);
+					}
+					packets.intersect(packet);
+					for (unsigned int lane = 0; lane < packet.count; lane++)
+					{
+						packetMisses += packet.primitive[lane] < 0 || fellThrough(i + lane, packet.t[lane]);
+					}
+				}
+			}
+			out << "rays at shared edges, mesh at (" << center.x << ", " << center.y << ", " << center.z << "): " << rays.size()
+				<< ", fell through: " << scalarMisses << " scalar, " << packetMisses << " packets" << std::endl;
+		}
+
+		// Throughput through the virtual Entity interface, the way the scene calls it
+		std::vector<const Entity*> entities;
+		for (const auto& c : cases)
+		{
+			entities.push_back(&c.triangle);
+		}
+		for (int pass = 0; pass < 2; pass++)
+		{
+			bool hitPass = pass == 0;
+			float sum = 0.0f;
+			unsigned int tests = 0;
+			auto begin = std::chrono::steady_clock::now();
+			for (unsigned int i = hitPass ? 0 : 1; i < count; i += 2)
+			{
+				sum += entities[i]->rayCollision(cases[i].ray);
+				tests++;
+			}
+			auto end = std::chrono::steady_clock::now();
+			double seconds = std::chrono::duration<double>(end - begin).count();
+			out << std::fixed << std::setprecision(2) << (hitPass ? "hits:   " : "misses: ")
+				<< tests / seconds / 1e6 << " Mtests/s, " << seconds * 1e9 / tests << " ns/test"
+				<< " (checksum " << sum << ")" << std::endl;
+		}
+	}
+
+	namespace
+	{
+		// The sphere and plane tests as they were before the rays carried tMin and unit directions,
+		// kept to measure the current ones against
+		float legacySphereCollide(const Ray& ray, const glm::vec3& center, float radiusSquared)
+		{
+			glm::vec3 vc = ray.getVertex() - center;
+			float A = glm::dot(ray.getDirection(), ray.getDirection());
+			float B = 2 * glm::dot(vc, ray.getDirection());
+			float C = glm::dot(vc, vc) - radiusSquared;
+			if (std::abs(C) < FLOAT_EPS)
+			{
+				C = 0;
+			}
+			float delta = B * B - 4 * A * C;
+			if (delta < FLOAT_EPS)
+			{
+				return -1;
+			}
+			delta = std::sqrt(delta);
+			float t1 = (-B + delta) / 2 / A;
+			float t2 = (-B - delta) / 2 / A;
+			if (t1 < FLOAT_EPS && t2 < FLOAT_EPS)
+			{
+				return -1;
+			}
+			return t2 > FLOAT_EPS ? t2 : t1;
+		}
+
+		float legacyPlaneCollide(const Ray& ray, const glm::vec3& aPoint, const glm::vec3& normal)
+		{
+			float v1 = glm::dot(ray.getVertex() - aPoint, normal);
+			float v2 = glm::dot(normal, ray.getDirection());
+			if (std::abs(v2) < FLOAT_EPS)
+			{
+				return -1;
+			}
+			return -v1 / v2;
+		}
+
+		// Closer root above FLOAT_EPS in double precision, the reference for both sphere tests
+		double exactSphereCollide(const Ray& ray, const glm::vec3& center, float radius)
+		{
+			glm::vec3 o = ray.getVertex() - center, d = ray.getDirection();
+			double ox = o.x, oy = o.y, oz = o.z, dx = d.x, dy = d.y, dz = d.z;
+			double a = dx * dx + dy * dy + dz * dz;
+			double b = ox * dx + oy * dy + oz * dz;
+			double c = ox * ox + oy * oy + oz * oz - double(radius) * radius;
+			double discriminant = b * b - a * c;
+			if (discriminant < 0.0)
+			{
+				return -1.0;
+			}
+			double t1 = (-b - std::sqrt(discriminant)) / a, t2 = (-b + std::sqrt(discriminant)) / a;
+			return t1 > FLOAT_EPS ? t1 : (t2 > FLOAT_EPS ? t2 : -1.0);
+		}
+
+		volatile float testSink; // keeps the compiler from dropping tests whose results are unused
+
+		// ns per test of f over all cases, best of three runs
+		template <typename F>
+		double timeTests(size_t count, F f)
+		{
+			double best = 0.0;
+			for (int run = 0; run < 3; run++)
+			{
+				float checksum = 0.0f;
+				auto begin = std::chrono::steady_clock::now();
+				for (size_t i = 0; i < count; i++)
+				{
+					checksum += f(i);
+				}
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+				testSink = checksum;
+				best = run == 0 ? seconds : std::min(best, seconds);
+			}
+			return best * 1e9 / count;
+		}
+	}
+
+	void benchmarkPrimitive(std::ostream& out)
+	{
+		const unsigned int count = 1000000;
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		auto direction = [&]() { return glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)) + glm::vec3(0.0f, 0.0f, 1e-3f)); };
+
+		out << "primitive       old ns  new ns  speedup  old+normal  new+normal  wrong hit/miss old/new  max rel t error old/new" << std::endl;
+		// Spheres of radius 1 seen from nearby, then spheres of radius 0.01 seen from 1000 units away,
+		// where b^2 - c of the old test loses most of its digits. Rays aim near the center so about half hit.
+		const float radii[2] = { 1.0f, 0.01f };
+		const float distances[2] = { 5.0f, 1000.0f };
+		for (int set = 0; set < 2; set++)
+		{
+			std::vector<Ray> rays;
+			std::vector<SphereRecord> spheres;
+			rays.reserve(count);
+			spheres.reserve(count);
+			for (unsigned int i = 0; i < count; i++)
+			{
+				float radius = radii[set] * (0.5f + unit(random));
+				glm::vec3 center(uniform(random), uniform(random), uniform(random));
+				glm::vec3 target = center + 1.5f * radius * glm::vec3(uniform(random), uniform(random), uniform(random));
+				glm::vec3 origin = target - distances[set] * direction();
+				rays.push_back(Ray(origin, target));
+				spheres.push_back({ center, radius * radius, 1.0f / radius });
+			}
+
+			unsigned int wrong[2] = { 0, 0 };
+			double error[2] = { 0.0, 0.0 };
+			for (unsigned int i = 0; i < count; i++)
+			{
+				double exact = exactSphereCollide(rays[i], spheres[i].center, 1.0f / spheres[i].invRadius);
+				float t[2] = { legacySphereCollide(rays[i], spheres[i].center, spheres[i].radiusSquared),
+					Sphere::collide(rays[i], spheres[i].center, spheres[i].radiusSquared) };
+				for (int k = 0; k < 2; k++)
+				{
+					if ((t[k] > FLOAT_EPS) != (exact > FLOAT_EPS))
+					{
+						wrong[k]++;
+					}
+					else if (exact > FLOAT_EPS)
+					{
+						error[k] = std::max(error[k], std::abs(t[k] - exact) / exact);
+					}
+				}
+			}
+
+			double oldTime = timeTests(count, [&](size_t i) { return legacySphereCollide(rays[i], spheres[i].center, spheres[i].radiusSquared); });
+			double newTime = timeTests(count, [&](size_t i) { return Sphere::collide(rays[i], spheres[i].center, spheres[i].radiusSquared); });
+			// With the normal of the hit, normalized from the hit point before and scaled by the stored 1 / radius now
+			double oldNormal = timeTests(count, [&](size_t i)
+			{
+				float t = legacySphereCollide(rays[i], spheres[i].center, spheres[i].radiusSquared);
+				return t > FLOAT_EPS ? t + glm::normalize(rays[i].pointAtT(t) - spheres[i].center).x : t;
+			});
+			double newNormal = timeTests(count, [&](size_t i)
+			{
+				float t = Sphere::collide(rays[i], spheres[i].center, spheres[i].radiusSquared);
+				return t > FLOAT_EPS ? t + ((rays[i].pointAtT(t) - spheres[i].center) * spheres[i].invRadius).x : t;
+			});
+			out << std::fixed << std::setprecision(2) << (set == 0 ? "sphere near   " : "sphere far    ")
+				<< std::setw(8) << oldTime << std::setw(8) << newTime << std::setw(8) << oldTime / newTime << "x"
+				<< std::setw(12) << oldNormal << std::setw(12) << newNormal
+				<< std::setw(14) << wrong[0] << "/" << wrong[1]
+				<< std::setw(16) << std::scientific << std::setprecision(1) << error[0] << "/" << error[1] << std::endl;
+		}
+
+		// Planes through random points with random normals, rays from up to 10 units away
+		std::vector<Ray> rays;
+		std::vector<Plane> planes;
+		std::vector<PlaneRecord> records;
+		rays.reserve(count);
+		planes.reserve(count);
+		records.reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			glm::vec3 origin = 10.0f * glm::vec3(uniform(random), uniform(random), uniform(random));
+			rays.push_back(Ray(origin, origin + direction()));
+			planes.push_back(Plane(glm::vec3(uniform(random), uniform(random), uniform(random)), direction()));
+			records.push_back({ planes.back().getNormal(), planes.back().getDistance() });
+		}
+		unsigned int wrong[2] = { 0, 0 };
+		for (unsigned int i = 0; i < count; i++)
+		{
+			const Plane& plane = planes[i];
+			glm::vec3 o = rays[i].getVertex() - plane.getAPoint(), n = plane.getNormal(), d = rays[i].getDirection();
+			double cosine = double(n.x) * d.x + double(n.y) * d.y + double(n.z) * d.z;
+			double exact = -(double(n.x) * o.x + double(n.y) * o.y + double(n.z) * o.z) / cosine;
+			bool hit = std::abs(cosine) >= FLOAT_EPS && exact > FLOAT_EPS;
+			wrong[0] += (legacyPlaneCollide(rays[i], plane.getAPoint(), n) > FLOAT_EPS) != hit;
+			wrong[1] += (Plane::collide(rays[i], records[i].normal, records[i].distance) > FLOAT_EPS) != hit;
+		}
+		double oldTime = timeTests(count, [&](size_t i) { return legacyPlaneCollide(rays[i], planes[i].getAPoint(), planes[i].getNormal()); });
+		double newTime = timeTests(count, [&](size_t i) { return Plane::collide(rays[i], records[i].normal, records[i].distance); });
+		out << std::fixed << std::setprecision(2) << "plane         "
+			<< std::setw(8) << oldTime << std::setw(8) << newTime << std::setw(8) << oldTime / newTime << "x"
+			<< std::setw(12) << "-" << std::setw(12) << "-"
+			<< std::setw(14) << wrong[0] << "/" << wrong[1] << std::setw(16) << "-" << std::endl;
+	}
+
+	void benchmarkMesh(const std::string& path, std::ostream& out)
+	{
+		std::vector<std::string> paths;
+		if (path.empty())
+		{
+			out << "writing a 1M triangle sphere..." << std::endl;
+			writeSphereMesh("mesh_benchmark.obj", "mesh_benchmark.ply", 500, 1000);
+			paths.push_back("mesh_benchmark.obj");
+			paths.push_back("mesh_benchmark.ply");
+		}
+		else
+		{
+			paths.push_back(path);
+		}
+
+		out << "file                  MB        triangles  load ms   MB/s     Mtris/s  build ms  bytes/tri  hits" << std::endl;
+		for (const auto& file : paths)
+		{
+			std::ifstream stream(file, std::ios::binary | std::ios::ate);
+			double megabytes = double(stream.tellg()) / (1 << 20);
+
+			Mesh mesh;
+			auto begin = std::chrono::steady_clock::now();
+			if (!loadMesh(file, mesh))
+			{
+				continue;
+			}
+			auto end = std::chrono::steady_clock::now();
+			double seconds = std::chrono::duration<double>(end - begin).count();
+			begin = std::chrono::steady_clock::now();
+			mesh.build();
+			end = std::chrono::steady_clock::now();
+			double buildSeconds = std::chrono::duration<double>(end - begin).count();
+
+			// Rays from outside aimed through the bounding box center, all of them should hit a closed mesh
+			std::mt19937 random(1);
+			AABB bounds = mesh.getBounds();
+			auto rays = randomRays(1000, glm::length(bounds.extent()), random);
+			unsigned int hits = 0;
+			for (const auto& ray : rays)
+			{
+				Ray centered(ray.getVertex() + bounds.centroid(), bounds.centroid());
+				HitRecord hit;
+				hits += mesh.rayIntersect(centered, hit) ? 1 : 0;
+			}
+
+			size_t triangles = mesh.getTriangleCount();
+			out << std::fixed << std::setprecision(2)
+				<< std::left << std::setw(20) << file << std::right << "  "
+				<< std::setw(8) << megabytes << "  "
+				<< std::setw(9) << triangles << "  "
+				<< std::setw(8) << seconds * 1000.0 << "  "
+				<< std::setw(7) << megabytes / seconds << "  "
+				<< std::setw(7) << triangles / seconds / 1e6 << "  "
+				<< std::setw(8) << buildSeconds * 1000.0 << "  "
+				<< std::setw(9) << double(mesh.getMemoryUsage()) / triangles << "  "
+				<< hits << "/" << rays.size() << std::endl;
+		}
+		out << "a Triangle entity alone takes " << sizeof(Triangle) << " bytes plus its pointer and heap block" << std::endl;
+
+		if (path.empty())
+		{
+			std::remove("mesh_benchmark.obj");
+			std::remove("mesh_benchmark.ply");
+		}
+	}
+
+	void benchmarkScene(std::ostream& out)
+	{
+		out << "writing a 1M sphere scene and a 1M triangle mesh scene..." << std::endl;
+		const char* header =
+			"camera position 0 2 3 front 0 0 -1 up 0 1 0\n"
+			"dirlight ambient 0.2 0.2 0.2 diffuse 0.6 0.6 0.6 specular 1 1 1 direction -0.5 -1 -1\n"
+			"checker board color1 1 1 1 color2 0 0 0 size 1\n"
+			"material floor ambient board diffuse board specular board shade 0.7 reflect 0.3\n"
+			"material ball ambient 1 1 1 diffuse 1 1 1 specular 0.6 0.6 0.6 shade 0.6 reflect 0.2 refract 0.2 ior 1.5\n"
+			"plane point 0 0 0 normal 0 1 0 material floor\n";
+		std::FILE* spheres = std::fopen("scene_benchmark_spheres.scene", "wb");
+		std::fputs(header, spheres);
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+		for (unsigned int i = 0; i < 1000000; i++)
+		{
+			std::fprintf(spheres, "sphere center %g %g %g radius %g material ball\n",
+				uniform(random) * 100.0f - 50.0f, uniform(random) * 10.0f, uniform(random) * -100.0f, 0.02f + uniform(random) * 0.08f);
+		}
+		std::fclose(spheres);
+		writeSphereMesh("scene_benchmark.obj", "scene_benchmark.ply", 500, 1000);
+		std::FILE* mesh = std::fopen("scene_benchmark_mesh.scene", "wb");
+		std::fputs(header, mesh);
+		std::fputs("mesh path scene_benchmark.obj material ball\n", mesh);
+		std::fclose(mesh);
+
+		auto fileSize = [](const std::string& path)
+		{
+			std::ifstream stream(path, std::ios::binary | std::ios::ate);
+			return double(stream.tellg()) / (1 << 20);
+		};
+		auto seconds = [](std::chrono::steady_clock::time_point begin)
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		};
+
+		// The files were just written, so both loads read from the page cache
+		const unsigned int width = 320, height = 240;
+		// Text sizes include the OBJ file the mesh scene refers to
+		out << "scene     text MB  text load ms  cache MB  save ms  cache load ms  speedup  image" << std::endl;
+		const char* names[2] = { "spheres", "mesh" };
+		for (const char* name : names)
+		{
+			std::string textPath = std::string("scene_benchmark_") + name + ".scene";
+			std::string cachePath = std::string("scene_benchmark_") + name + ".rtsc";
+			Scene text;
+			SceneCamera camera;
+			auto begin = std::chrono::steady_clock::now();
+			if (!loadScene(textPath, text, camera))
+			{
+				continue;
+			}
+			double textSeconds = seconds(begin);
+
+			begin = std::chrono::steady_clock::now();
+			if (!saveSceneCache(cachePath, text, camera))
+			{
+				continue;
+			}
+			double saveSeconds = seconds(begin);
+
+			Scene cached;
+			SceneCamera cachedCamera;
+			begin = std::chrono::steady_clock::now();
+			if (!loadSceneCache(cachePath, cached, cachedCamera))
+			{
+				continue;
+			}
+			double cacheSeconds = seconds(begin);
+
+			FrameBuffer reference(width, height);
+			FrameBuffer frameBuffer(width, height);
+			Renderer textRenderer(text);
+			textRenderer.render(Camera(camera.position, camera.front, camera.up, float(width) / height), reference);
+			Renderer cachedRenderer(cached);
+			cachedRenderer.render(Camera(cachedCamera.position, cachedCamera.front, cachedCamera.up, float(width) / height), frameBuffer);
+			bool identical = std::memcmp(reference.getData(), frameBuffer.getData(), sizeof(float) * 3 * width * height) == 0;
+
+			out << std::fixed << std::setprecision(2)
+				<< std::left << std::setw(8) << name << std::right << "  "
+				<< std::setw(7) << fileSize(textPath) + (name == names[1] ? fileSize("scene_benchmark.obj") : 0.0) << "  "
+				<< std::setw(12) << textSeconds * 1000.0 << "  "
+				<< std::setw(8) << fileSize(cachePath) << "  "
+				<< std::setw(7) << saveSeconds * 1000.0 << "  "
+				<< std::setw(13) << cacheSeconds * 1000.0 << "  "
+				<< std::setw(6) << textSeconds / cacheSeconds << "x  "
+				<< (identical ? "identical" : "DIFFERENT") << std::endl;
+			std::remove(cachePath.c_str());
+		}
+
+		std::remove("scene_benchmark_spheres.scene");
+		std::remove("scene_benchmark_mesh.scene");
+		std::remove("scene_benchmark.obj");
+		std::remove("scene_benchmark.ply");
+	}
+
+	void benchmarkPacket(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out)
+	{
+		unsigned int supported = PacketTracer::getSupportedWidth();
+		out << "widest packet supported by this CPU: " << supported << std::endl;
+
+		// The given scene and two heavier ones seen through the same kind of camera
+		Scene spheres;
+		buildSphereField(spheres, false);
+		spheres.buildBVH();
+
+		Scene meshScene;
+		meshScene.addEntity(sphereMesh(256, 512, glm::vec3(0.0f, 0.0f, -5.0f), 2.0f));
+		meshScene.addEntity(new Plane(glm::vec3(0.0f, -2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+		meshScene.buildBVH();
+
+		float aspect = float(width) / height;
+		Camera sceneCamera(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), aspect);
+		struct Case
+		{
+			const char* name;
+			const Scene& scene;
+			const Camera& camera;
+		};
+		Case cases[] = { { "default", scene, camera }, { "10k spheres", spheres, sceneCamera }, { "262k triangles", meshScene, sceneCamera } };
+
+		out << "scene           width  Mrays/s  speedup  mismatches" << std::endl;
+		for (const Case& c : cases)
+		{
+			std::vector<Ray> rays;
+			rays.reserve(width * height);
+			for (unsigned int j = 0; j < height; j++)
+			{
+				for (unsigned int i = 0; i < width; i++)
+				{
+					rays.push_back(c.camera.generateRay(float(i) * 2 / width - 1.0f, float(j) * 2 / height - 1.0f));
+				}
+			}
+
+			PacketTracer packets;
+			packets.build(c.scene);
+			if (!packets.isComplete())
+			{
+				out << std::setw(14) << std::left << c.name << std::right << "  has entities packets can't trace" << std::endl;
+				continue;
+			}
+
+			std::vector<HitRecord> reference, hits;
+			double scalarSeconds = packetSeconds(c.scene, packets, rays, 1, reference);
+			for (unsigned int packetWidth = 1; packetWidth <= supported; packetWidth *= packetWidth == 1 ? 4 : 2)
+			{
+				double seconds = scalarSeconds;
+				unsigned int mismatches = 0;
+				if (packetWidth > 1)
+				{
+					packets.setWidth(packetWidth);
+					seconds = packetSeconds(c.scene, packets, rays, packetWidth, hits);
+					// Same primitive and t up to rounding, the SIMD code may order the arithmetic differently
+					for (size_t i = 0; i < rays.size(); i++)
+					{
+						const HitRecord& a = reference[i];
+						const HitRecord& b = hits[i];
+						bool same = a.entity == b.entity && (a.entity == nullptr ||
+							(a.primitive == b.primitive && std::abs(a.t - b.t) <= 1e-4f * std::max(1.0f, a.t)));
+						mismatches += same ? 0 : 1;
+					}
+				}
+				out << std::setw(14) << std::left << c.name << std::right << "  "
+					<< std::setw(5) << packetWidth << "  "
+					<< std::fixed << std::setprecision(2)
+					<< std::setw(7) << rays.size() / seconds / 1e6 << "  "
+					<< std::setw(7) << scalarSeconds / seconds << "  "
+					<< mismatches << std::endl;
+			}
+		}
+	}
+
+	void benchmarkMaterial(std::ostream& out)
+	{
+		const unsigned int hitCount = 1000000;
+		std::mt19937 random(1);
+		std::uniform_real_distribution<float> uniform(-10.0f, 10.0f);
+		struct Hit
+		{
+			glm::vec3 pos, normal, viewDir;
+		};
+		std::vector<Hit> hits(hitCount);
+		for (auto& hit : hits)
+		{
+			hit.pos = glm::vec3(uniform(random), 0.0f, uniform(random));
+			hit.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+			hit.viewDir = glm::normalize(hit.pos - glm::vec3(0.0f, 2.0f, 3.0f));
+		}
+
+		// The two materials of the default scene, once as closures and once as table entries
+		auto isBlack = [](const glm::vec3& pos) { return std::fmod(std::floor(pos.x) + std::floor(pos.z), 2.0f) == 0; };
+		auto checkerColor = [=](const glm::vec3& pos) { return isBlack(pos) ? glm::vec3(1.0f) : glm::vec3(0.0f); };
+		FunctionMaterial functionChecker = { checkerColor, checkerColor, checkerColor, [](const glm::vec3&) { return 32.0f; } };
+		FunctionMaterial functionConstant = {
+			[](const glm::vec3&) { return glm::vec3(1.0f); },
+			[](const glm::vec3&) { return glm::vec3(1.0f); },
+			[](const glm::vec3&) { return glm::vec3(0.6f); },
+			[](const glm::vec3&) { return 32.0f; } };
+
+		MaterialTable table;
+		Material m;
+		Texture checker = table.addChecker(glm::vec3(1.0f), glm::vec3(0.0f));
+		m.ambient = m.diffuse = m.specular = checker;
+		unsigned int tableChecker = table.addMaterial(m);
+		m.ambient = m.diffuse = glm::vec3(1.0f);
+		m.specular = glm::vec3(0.6f);
+		unsigned int tableConstant = table.addMaterial(m);
+		m.ambient = m.diffuse = m.specular = table.addFunction(checkerColor);
+		unsigned int tableFunction = table.addMaterial(m);
+
+		out << "sizeof(Material): " << sizeof(FunctionMaterial) << " bytes with closures, "
+			<< sizeof(Material) << " bytes as table entry" << std::endl;
+		out << "material   lights  closures ns/hit  table ns/hit  speedup  escape hatch ns/hit" << std::endl;
+		for (unsigned int lightCount : { 1u, 4u, 16u })
+		{
+			std::vector<FunctionLight*> functionLights;
+			std::vector<Light*> lights;
+			for (unsigned int i = 0; i < lightCount; i++)
+			{
+				glm::vec3 direction(-0.5f + 0.1f * i, -1.0f, -1.0f);
+				functionLights.push_back(new FunctionDirLight(glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(1.0f), direction));
+				lights.push_back(new DirLight(glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(1.0f), direction));
+			}
+
+			struct Case
+			{
+				const char* name;
+				const FunctionMaterial& closures;
+				unsigned int material;
+			};
+			Case cases[] = { { "checker", functionChecker, tableChecker }, { "constant", functionConstant, tableConstant } };
+			for (const Case& c : cases)
+			{
+				// Best of three runs; the sum keeps the compiler from dropping the work
+				glm::vec3 sum(0.0f);
+				auto nsPerHit = [&](const std::function<void(const Hit& hit)>& shadeHit)
+				{
+					double best = 0.0;
+					for (unsigned int run = 0; run < 3; run++)
+					{
+						auto begin = std::chrono::steady_clock::now();
+						for (const auto& hit : hits)
+						{
+							shadeHit(hit);
+						}
+						auto end = std::chrono::steady_clock::now();
+						double ns = std::chrono::duration<double, std::nano>(end - begin).count() / hitCount;
+						best = run == 0 ? ns : std::min(best, ns);
+					}
+					return best;
+				};
+				double closureNs = nsPerHit([&](const Hit& hit)
+				{
+					for (auto pLight : functionLights)
+					{
+						sum += pLight->calLight(c.closures, hit.pos, hit.normal, hit.viewDir);
+					}
+				});
+				auto tableShade = [&](unsigned int material)
+				{
+					return [&, material](const Hit& hit)
+					{
+						SurfaceColor surface = table.evaluate(material, hit.pos, glm::vec2(0.0f));
+						for (auto pLight : lights)
+						{
+							sum += pLight->calLight(surface, hit.pos, hit.normal, hit.viewDir);
+						}
+					};
+				};
+				double tableNs = nsPerHit(tableShade(c.material));
+				double functionNs = nsPerHit(tableShade(tableFunction));
+				out << std::setw(8) << std::left << c.name << std::right << "  "
+					<< std::setw(6) << lightCount << "  "
+					<< std::fixed << std::setprecision(1)
+					<< std::setw(15) << closureNs << "  "
+					<< std::setw(12) << tableNs << "  "
+					<< std::setprecision(2) << std::setw(7) << closureNs / tableNs << "  "
+					<< std::setprecision(1) << std::setw(19) << functionNs
+					<< (sum.x == -1.0f ? " " : "") << std::endl;
+			}
+			for (unsigned int i = 0; i < lightCount; i++)
+			{
+				delete functionLights[i];
+				delete lights[i];
+			}
+		}
+	}
+
+	void benchmarkTrace(Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out)
+	{
+		unsigned int maxDepth = scene.getMaxDepth();
+		float minWeight = scene.getMinWeight();
+
+		// Reference: deep and without culling
+		FrameBuffer reference(width, height);
+		FrameBuffer frameBuffer(width, height);
+		Renderer renderer(scene);
+		renderer.setPacketWidth(16);
+		scene.setMaxDepth(Scene::MAX_TRACE_DEPTH);
+		scene.setMinWeight(0.0f);
+		renderer.render(camera, reference);
+
+		double pixels = double(width) * height;
+		out << "depth  min weight  ms       rays/pixel  culled/pixel  mean error  max error" << std::endl;
+		for (unsigned int depth = 1; depth <= 8; depth++)
+		{
+			for (float weight : { Scene::DEFAULT_MIN_WEIGHT, 0.01f, 0.05f, 0.1f })
+			{
+				scene.setMaxDepth(depth);
+				scene.setMinWeight(weight);
+				double seconds = timeFrame(renderer, camera, frameBuffer);
+				TraceStats stats = renderer.getTraceStats();
+
+				// Difference to the reference in 8 bit steps
+				double errorSum = 0.0, errorMax = 0.0;
+				for (size_t i = 0; i < (size_t)width * height * 3; i++)
+				{
+					double error = std::abs(std::min(frameBuffer.getData()[i], 1.0f) - std::min(reference.getData()[i], 1.0f)) * 255.0;
+					errorSum += error;
+					errorMax = std::max(errorMax, error);
+				}
+				out << std::fixed << std::setw(5) << depth << "  "
+					<< std::setprecision(5) << std::setw(10) << weight << "  "
+					<< std::setprecision(2) << std::setw(7) << seconds * 1000.0 << "  "
+					<< std::setw(10) << stats.rays / pixels << "  "
+					<< std::setw(12) << stats.culled / pixels << "  "
+					<< std::setprecision(3) << std::setw(10) << errorSum / (pixels * 3) << "  "
+					<< std::setprecision(1) << std::setw(9) << errorMax << std::endl;
+			}
+		}
+
+		scene.setMaxDepth(maxDepth);
+		scene.setMinWeight(minWeight);
+	}
+
+	void benchmarkProgressive(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out)
+	{
+		// Convergence while the camera stays still, against a 32 sample reference
+		const unsigned int referenceSamples = 32;
+		FrameBuffer reference(width, height);
+		FrameBuffer frameBuffer(width, height);
+		ProgressiveRenderer renderer(scene);
+		renderer.setPacketWidth(16);
+		for (unsigned int i = 0; i < referenceSamples; i++)
+		{
+			renderer.render(camera, reference);
+		}
+
+		auto rmsError = [&]()
+		{
+			double sum = 0.0;
+			for (size_t i = 0; i < (size_t)width * height * 3; i++)
+			{
+				double error = std::min(frameBuffer.getData()[i], 1.0f) - std::min(reference.getData()[i], 1.0f);
+				sum += error * error;
+			}
+			return std::sqrt(sum / ((double)width * height * 3)) * 255.0;
+		};
+
+		out << "static camera, " << referenceSamples << " samples per pixel as reference" << std::endl;
+		out << "samples  ms/pass  rms error (8 bit)" << std::endl;
+		renderer.reset();
+		double totalSeconds = 0.0;
+		for (unsigned int samples = 1; samples <= 16; samples++)
+		{
+			auto begin = std::chrono::steady_clock::now();
+			renderer.render(camera, frameBuffer);
+			auto end = std::chrono::steady_clock::now();
+			totalSeconds += std::chrono::duration<double>(end - begin).count();
+			if ((samples & (samples - 1)) == 0)
+			{
+				out << std::fixed << std::setw(7) << samples << "  "
+					<< std::setprecision(2) << std::setw(7) << totalSeconds * 1000.0 / samples << "  "
+					<< std::setprecision(3) << std::setw(17) << rmsError() << std::endl;
+			}
+		}
+
+		// A camera moving every frame: pass times with a fixed step and with frame budgets
+		const unsigned int frames = 24;
+		out << "moving camera, " << frames << " frames" << std::endl;
+		out << "budget ms  step  mean ms  max ms" << std::endl;
+		for (double budget : { 0.0, 0.033, 0.016 })
+		{
+			ProgressiveRenderer moving(scene);
+			moving.setPacketWidth(16);
+			moving.setFrameBudget(budget);
+			double sum = 0.0, longest = 0.0;
+			for (unsigned int i = 0; i < frames; i++)
+			{
+				Camera frameCamera(camera.getPosition() + glm::vec3(0.02f * i, 0.0f, 0.0f), camera.getFront(), camera.getUp(), camera.getAspect());
+				auto begin = std::chrono::steady_clock::now();
+				moving.render(frameCamera, frameBuffer);
+				auto end = std::chrono::steady_clock::now();
+				double seconds = std::chrono::duration<double>(end - begin).count();
+				if (i > 0) // the first frame has nothing to estimate the step from
+				{
+					sum += seconds;
+					longest = std::max(longest, seconds);
+				}
+			}
+			out << std::fixed << std::setprecision(0) << std::setw(9) << budget * 1000.0 << "  "
+				<< std::setw(4) << moving.getStep() << "  "
+				<< std::setprecision(2) << std::setw(7) << sum * 1000.0 / (frames - 1) << "  "
+				<< std::setw(6) << longest * 1000.0 << std::endl;
+		}
+	}
+
+	namespace
+	{
+		// Samples per pixel a uniform run needs for the given error, interpolated on a log-log scale
+		// between the measured runs and extrapolated beyond them with error ~ 1 / sqrt(samples)
+		double samplesAtError(const std::vector<double>& samples, const std::vector<double>& errors, double error)
+		{
+			size_t last = errors.size() - 1;
+			if (error >= errors[0] || error <= errors[last])
+			{
+				size_t i = error >= errors[0] ? 0 : last;
+				return samples[i] * (errors[i] / error) * (errors[i] / error);
+			}
+			size_t i = 0;
+			while (errors[i + 1] > error)
+			{
+				i++;
+			}
+			double f = std::log(error / errors[i]) / std::log(errors[i + 1] / errors[i]);
+			return samples[i] * std::pow(samples[i + 1] / samples[i], f);
+		}
+	}
+
+	void benchmarkAdaptive(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out)
+	{
+		// A quarter of the frame size keeps the reference affordable, its own error must stay well below
+		// that of the runs compared against it
+		width = std::max(1u, width / 4);
+		height = std::max(1u, height / 4);
+		const unsigned int referenceSamples = 1024;
+		FrameBuffer reference(width, height);
+		FrameBuffer frameBuffer(width, height);
+		AdaptiveRenderer renderer(scene);
+		renderer.setThreshold(0.0f);
+		renderer.setSampleCounts(referenceSamples, referenceSamples);
+		renderer.setSeed(1); // other sample positions than the runs compared against it
+		renderer.render(camera, reference);
+		renderer.setSeed(0);
+
+		auto rmsError = [&]()
+		{
+			double sum = 0.0;
+			for (size_t i = 0; i < (size_t)width * height * 3; i++)
+			{
+				double error = std::min(frameBuffer.getData()[i], 1.0f) - std::min(reference.getData()[i], 1.0f);
+				sum += error * error;
+			}
+			return std::sqrt(sum / ((double)width * height * 3)) * 255.0;
+		};
+		auto run = [&](double& error)
+		{
+			auto begin = std::chrono::steady_clock::now();
+			renderer.render(camera, frameBuffer);
+			auto end = std::chrono::steady_clock::now();
+			error = rmsError();
+			return std::chrono::duration<double>(end - begin).count();
+		};
+
+		out << width << "x" << height << ", " << referenceSamples << " samples per pixel as reference" << std::endl;
+		out << "uniform  samples/pixel  rms error (8 bit)  ms" << std::endl;
+		std::vector<double> uniformSamples, uniformErrors;
+		for (unsigned int samples = 1; samples <= 64; samples *= 2)
+		{
+			double error;
+			renderer.setSampleCounts(samples, samples);
+			double seconds = run(error);
+			uniformSamples.push_back(samples);
+			uniformErrors.push_back(error);
+			out << std::fixed << std::setprecision(2) << std::setw(22) << double(samples) << "  "
+				<< std::setprecision(3) << std::setw(17) << error << "  "
+				<< std::setprecision(1) << seconds * 1000.0 << std::endl;
+		}
+
+		out << "threshold  samples/pixel  rms error (8 bit)  ms      uniform samples at equal error  saving" << std::endl;
+		renderer.setSampleCounts(AdaptiveRenderer::DEFAULT_BASE_SAMPLES, AdaptiveRenderer::DEFAULT_MAX_SAMPLES);
+		for (float threshold : { 0.2f, 0.1f, 0.05f, 0.02f, 0.01f })
+		{
+			double error;
+			renderer.setThreshold(threshold);
+			double seconds = run(error);
+			double equivalent = samplesAtError(uniformSamples, uniformErrors, error);
+			out << std::fixed << std::setprecision(3) << std::setw(9) << threshold << "  "
+				<< std::setprecision(2) << std::setw(13) << renderer.getSamplesPerPixel() << "  "
+				<< std::setprecision(3) << std::setw(17) << error << "  "
+				<< std::setprecision(1) << std::setw(6) << seconds * 1000.0 << "  "
+				<< std::setprecision(2) << std::setw(30) << equivalent << "  "
+				<< std::setw(6) << equivalent / renderer.getSamplesPerPixel() << "x" << std::endl;
+		}
+	}
+
+	void benchmarkShadow(Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out)
+	{
+		bool shadows = scene.getShadows();
+		FrameBuffer frameBuffer(width, height);
+		Renderer renderer(scene);
+		renderer.setPacketWidth(16);
+		out << "shadows  ms" << std::endl;
+		for (bool enabled : { false, true })
+		{
+			scene.setShadows(enabled);
+			double seconds = timeFrame(renderer, camera, frameBuffer);
+			out << std::setw(7) << (enabled ? "on" : "off") << "  "
+				<< std::fixed << std::setprecision(2) << seconds * 1000.0 << std::endl;
+		}
+		scene.setShadows(shadows);
+
+		Scene spheres;
+		buildSphereField(spheres, true);
+		spheres.buildBVH();
+
+		// A closed mesh over a plane, lit from behind so most visible points are shadowed by the mesh itself
+		Scene meshScene;
+		meshScene.addEntity(sphereMesh(256, 512, glm::vec3(0.0f, 0.0f, -5.0f), 2.0f));
+		meshScene.addEntity(new Plane(glm::vec3(0.0f, -2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+		meshScene.addLight(new DirLight(glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(1.0f), glm::vec3(0.5f, -0.5f, 1.0f))); // from behind
+		meshScene.buildBVH();
+
+		Camera sceneCamera(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), float(width) / height);
+		struct Case
+		{
+			const char* name;
+			const Scene& scene;
+			const Camera& camera;
+		};
+		Case cases[] = { { "default", scene, camera }, { "10k spheres", spheres, sceneCamera }, { "262k triangles", meshScene, sceneCamera } };
+
+		out << "scene           shadow rays  occluded  closest hit Mrays/s  any hit Mrays/s  speedup  mismatches" << std::endl;
+		for (const Case& c : cases)
+		{
+			// One shadow ray per primary hit and light, built the way Scene::shade does
+			std::vector<Ray> rays;
+			std::vector<float> distances;
+			for (unsigned int j = 0; j < height; j++)
+			{
+				for (unsigned int i = 0; i < width; i++)
+				{
+					Ray ray = c.camera.generateRay(float(i) * 2 / width - 1.0f, float(j) * 2 / height - 1.0f);
+					HitRecord hit = c.scene.getIntersection(ray);
+					if (hit.entity == nullptr)
+					{
+						continue;
+					}
+					glm::vec3 fragPos = ray.pointAtT(hit.t);
+					glm::vec3 normal = hit.entity->calNormal(fragPos, hit);
+					for (auto pLight : c.scene.getLights())
+					{
+						LightSample light = pLight->sample(fragPos);
+						glm::vec3 origin = fragPos + Scene::SHADOW_BIAS * (glm::dot(normal, light.direction) < 0.0f ? -normal : normal);
+						rays.push_back(Ray(origin, origin + light.direction));
+						distances.push_back(light.distance);
+					}
+				}
+			}
+
+			// Best of three runs each
+			std::vector<char> closest(rays.size()), any(rays.size());
+			auto bestSeconds = [&](const std::function<void()>& run)
+			{
+				double best = 0.0;
+				for (unsigned int i = 0; i < 3; i++)
+				{
+					auto begin = std::chrono::steady_clock::now();
+					run();
+					auto end = std::chrono::steady_clock::now();
+					double seconds = std::chrono::duration<double>(end - begin).count();
+					best = i == 0 ? seconds : std::min(best, seconds);
+				}
+				return best;
+			};
+			double closestSeconds = bestSeconds([&]()
+			{
+				for (size_t i = 0; i < rays.size(); i++)
+				{
+					HitRecord hit = c.scene.getIntersection(rays[i]);
+					closest[i] = hit.entity != nullptr && hit.t < distances[i];
+				}
+			});
+			double anySeconds = bestSeconds([&]()
+			{
+				for (size_t i = 0; i < rays.size(); i++)
+				{
+					any[i] = c.scene.isOccluded(rays[i], distances[i]);
+				}
+			});
+
+			size_t occluded = 0, mismatches = 0;
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				occluded += closest[i] ? 1 : 0;
+				mismatches += closest[i] != any[i] ? 1 : 0;
+			}
+			out << std::setw(14) << std::left << c.name << std::right << "  "
+				<< std::setw(11) << rays.size() << "  "
+				<< std::fixed << std::setprecision(2)
+				<< std::setw(8) << (rays.empty() ? 0.0 : 100.0 * occluded / rays.size()) << "%  "
+				<< std::setw(19) << rays.size() / closestSeconds / 1e6 << "  "
+				<< std::setw(15) << rays.size() / anySeconds / 1e6 << "  "
+				<< std::setw(7) << closestSeconds / anySeconds << "  "
+				<< mismatches << std::endl;
+		}
+	}
+
+	void benchmarkLights(std::ostream& out)
+	{
+		const unsigned int width = 160, height = 120;
+		const unsigned int maxExactCount = 256; // shading every light of larger scenes takes minutes
+		FrameBuffer frameBuffer(width, height), reference(width, height);
+		Camera camera(glm::vec3(0.0f, 8.0f, 12.0f), glm::normalize(glm::vec3(0.0f, -0.6f, -1.0f)), glm::vec3(0.0f, 1.0f, 0.0f), float(width) / height);
+
+		out << "lights  every light ms  tree ms  speedup  tree nodes  mean error  max error" << std::endl;
+		for (unsigned int count : { 1u, 4u, 16u, 64u, 256u, 1024u, 4096u, 16384u })
+		{
+			// A floor with a 20 x 20 grid of spheres, lit by point lights scattered just above them.
+			// The total light stays the same whatever the count, so the images can be compared.
+			Scene scene;
+			for (int i = 0; i < 20; i++)
+			{
+				for (int j = 0; j < 20; j++)
+				{
+					scene.addSphere(glm::vec3(i - 9.5f, 0.3f, j - 9.5f), 0.3f);
+				}
+			}
+			scene.addPlane(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+			std::uniform_real_distribution<float> above(0.7f, 3.0f);
+			std::uniform_real_distribution<float> unit(0.2f, 1.0f);
+			float scale = 40.0f / count;
+			for (unsigned int i = 0; i < count; i++)
+			{
+				glm::vec3 color = scale * glm::vec3(unit(random), unit(random), unit(random));
+				scene.addLight(new PointLight(glm::vec3(0.0f), color, color, glm::vec3(position(random), above(random), position(random))));
+			}
+			scene.buildBVH();
+
+			Renderer renderer(scene);
+			renderer.setPacketWidth(16);
+			double exactSeconds = 0.0;
+			if (count <= maxExactCount)
+			{
+				scene.setLightSamples(0);
+				exactSeconds = timeFrame(renderer, camera, reference, 1);
+			}
+			scene.setLightSamples(Scene::DEFAULT_LIGHT_SAMPLES);
+			double treeSeconds = timeFrame(renderer, camera, frameBuffer);
+
+			out << std::setw(6) << count << "  " << std::fixed << std::setprecision(2);
+			if (count <= maxExactCount)
+			{
+				out << std::setw(14) << exactSeconds * 1000.0;
+			}
+			else
+			{
+				out << std::setw(14) << "-";
+			}
+			out << std::setw(9) << treeSeconds * 1000.0;
+			if (count <= maxExactCount)
+			{
+				out << std::setw(8) << exactSeconds / treeSeconds << "x";
+			}
+			else
+			{
+				out << std::setw(9) << "-";
+			}
+			out << std::setw(12) << scene.getLightTree().getNodeCount();
+			if (count <= maxExactCount)
+			{
+				// In 8 bit steps, a single pass: the noise of the picked lights averages out over progressive passes
+				double errorSum = 0.0, errorMax = 0.0;
+				size_t values = size_t(width) * height * 3;
+				for (size_t i = 0; i < values; i++)
+				{
+					double error = std::abs(std::min(frameBuffer.getData()[i], 1.0f) - std::min(reference.getData()[i], 1.0f)) * 255.0;
+					errorSum += error;
+					errorMax = std::max(errorMax, error);
+				}
+				out << std::setprecision(3) << std::setw(12) << errorSum / values << std::setprecision(1) << std::setw(11) << errorMax;
+			}
+			out << std::endl;
+		}
+	}
+
+	void benchmarkRaster(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out)
+	{
+		// A 4 x 4 grid of coarse spheres, one finely tessellated sphere, and the grid with fine spheres.
+		// Rasterizing pays per triangle and ray casting per pixel, the triangle size decides.
+		Scene coarseGrid;
+		Scene bigMesh;
+		bigMesh.addEntity(sphereMesh(256, 512, glm::vec3(0.0f, 0.0f, -5.0f), 2.0f));
+		Scene meshGrid;
+		for (int i = 0; i < 16; i++)
+		{
+			glm::vec3 center(-3.0f + 2.0f * (i % 4), -3.0f + 2.0f * (i / 4), -8.0f);
+			coarseGrid.addEntity(sphereMesh(32, 32, center, 0.9f));
+			meshGrid.addEntity(sphereMesh(256, 256, center, 0.9f));
+		}
+		for (Scene* s : { &coarseGrid, &bigMesh, &meshGrid })
+		{
+			s->addEntity(new Plane(glm::vec3(0.0f, -4.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+			s->addLight(new DirLight(glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(1.0f), glm::vec3(-0.5f, -1.0f, -1.0f)));
+			s->buildBVH();
+		}
+
+		Camera sceneCamera(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), float(width) / height);
+		struct Case
+		{
+			const char* name;
+			const Scene& scene;
+			const Camera& camera;
+		};
+		Case cases[] = { { "default", scene, camera }, { "32k triangles", coarseGrid, sceneCamera },
+			{ "262k triangles", bigMesh, sceneCamera }, { "1M triangles", meshGrid, sceneCamera } };
+
+		unsigned int supported = PacketTracer::getSupportedWidth();
+		const unsigned int tileSize = 32;
+		out << "first hits, packets " << supported << " wide" << std::endl;
+		out << "scene           scalar ms  packet ms  raster ms  speedup vs packets  mismatches" << std::endl;
+		for (const Case& c : cases)
+		{
+			std::vector<Ray> rays;
+			rays.reserve(width * height);
+			for (unsigned int j = 0; j < height; j++)
+			{
+				for (unsigned int i = 0; i < width; i++)
+				{
+					rays.push_back(c.camera.generateRay(float(i) * 2 / width - 1.0f, float(j) * 2 / height - 1.0f));
+				}
+			}
+
+			PacketTracer packets;
+			packets.build(c.scene);
+			std::vector<HitRecord> reference, hits;
+			double scalarSeconds = packetSeconds(c.scene, packets, rays, 1, reference);
+			double packetSecondsBest = scalarSeconds;
+			if (supported > 1)
+			{
+				packets.setWidth(supported);
+				packetSecondsBest = packetSeconds(c.scene, packets, rays, supported, hits);
+			}
+
+			// Setup, every tile and the hit records, best of three
+			Rasterizer rasterizer;
+			rasterizer.build(c.scene);
+			hits.resize(rays.size());
+			double rasterSeconds = 0.0;
+			for (unsigned int run = 0; run < 3; run++)
+			{
+				auto begin = std::chrono::steady_clock::now();
+				rasterizer.setup(c.camera, width, height, tileSize);
+				for (unsigned int tile = 0; tile < rasterizer.getTileCount(); tile++)
+				{
+					rasterizer.rasterizeTile(tile);
+				}
+				for (unsigned int j = 0; j < height; j++)
+				{
+					for (unsigned int i = 0; i < width; i++)
+					{
+						hits[j * width + i] = rasterizer.getHitRecord(i, j, rays[j * width + i]);
+					}
+				}
+				auto end = std::chrono::steady_clock::now();
+				double seconds = std::chrono::duration<double>(end - begin).count();
+				rasterSeconds = run == 0 ? seconds : std::min(rasterSeconds, seconds);
+			}
+
+			unsigned int mismatches = 0;
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				const HitRecord& a = reference[i];
+				const HitRecord& b = hits[i];
+				bool same = a.entity == b.entity && (a.entity == nullptr ||
+					(a.primitive == b.primitive && std::abs(a.t - b.t) <= 1e-4f * std::max(1.0f, a.t)));
+				mismatches += same ? 0 : 1;
+			}
+			out << std::setw(14) << std::left << c.name << std::right << "  "
+				<< std::fixed << std::setprecision(2)
+				<< std::setw(9) << scalarSeconds * 1000.0 << "  "
+				<< std::setw(9) << packetSecondsBest * 1000.0 << "  "
+				<< std::setw(9) << rasterSeconds * 1000.0 << "  "
+				<< std::setw(18) << packetSecondsBest / rasterSeconds << "  "
+				<< mismatches << std::endl;
+		}
+
+		out << "whole frames with shading and secondary rays" << std::endl;
+		out << "scene           ray cast ms  hybrid ms  speedup  identical" << std::endl;
+		for (const Case& c : cases)
+		{
+			FrameBuffer reference(width, height);
+			FrameBuffer frameBuffer(width, height);
+			Renderer renderer(c.scene, 0, tileSize);
+			renderer.setPacketWidth(16);
+			double castSeconds = timeFrame(renderer, c.camera, reference);
+			renderer.setRasterize(true);
+			double hybridSeconds = timeFrame(renderer, c.camera, frameBuffer);
+			bool identical = std::memcmp(reference.getData(), frameBuffer.getData(), sizeof(float) * 3 * width * height) == 0;
+			out << std::setw(14) << std::left << c.name << std::right << "  "
+				<< std::fixed << std::setprecision(2)
+				<< std::setw(11) << castSeconds * 1000.0 << "  "
+				<< std::setw(9) << hybridSeconds * 1000.0 << "  "
+				<< std::setw(7) << castSeconds / hybridSeconds << "  "
+				<< (identical ? "yes" : "no") << std::endl;
+		}
+	}
+
+	namespace
+	{
+		// Every scene of the suite is rendered at this size, a first frame warms the thread pool up
+		const unsigned int SUITE_WIDTH = 320;
+		const unsigned int SUITE_HEIGHT = 240;
+		const unsigned int SUITE_FRAMES = 16;
+
+		// Peak resident memory of the process so far in bytes, 0 where it can't be queried
+		size_t peakMemory()
+		{
+#ifdef _WIN32
+			PROCESS_MEMORY_COUNTERS counters;
+			return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PeakWorkingSetSize : 0;
+#else
+			struct rusage usage;
+			if (getrusage(RUSAGE_SELF, &usage) != 0)
+			{
+				return 0;
+			}
+#ifdef __APPLE__
+			return size_t(usage.ru_maxrss);
+#else
+			return size_t(usage.ru_maxrss) * 1024; // kilobytes on Linux
+#endif
+#endif
+		}
+
+		// Entities, BVHs and meshes of a scene
+		size_t sceneMemory(const Scene& scene)
+		{
+			size_t bytes = scene.getStore().getMemoryUsage() + scene.getBVH().getMemoryUsage();
+			for (const Entity* entity : scene.getOtherEntitys())
+			{
+				if (auto mesh = dynamic_cast<const Mesh*>(entity))
+				{
+					bytes += mesh->getMemoryUsage();
+				}
+			}
+			return bytes;
+		}
+
+		// The built-in scene: a glass ball on a reflective checkerboard
+		void buildSuiteDefault(Scene& scene)
+		{
+			MaterialTable& materials = scene.getMaterials();
+			Material planeMaterial;
+			planeMaterial.kShade = 0.7f;
+			planeMaterial.kReflect = 0.3f;
+			Texture checker = materials.addChecker(glm::vec3(1.0f), glm::vec3(0.0f));
+			planeMaterial.ambient = checker;
+			planeMaterial.diffuse = checker;
+			planeMaterial.specular = checker;
+			Material ballMaterial;
+			ballMaterial.kShade = 0.6f;
+			ballMaterial.kReflect = 0.2f;
+			ballMaterial.kRefract = 0.2f;
+			ballMaterial.refractiveIndex = 1.5f;
+			ballMaterial.ambient = glm::vec3(1.0f);
+			ballMaterial.diffuse = glm::vec3(1.0f);
+			ballMaterial.specular = glm::vec3(0.6f);
+			scene.addPlane(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), materials.addMaterial(planeMaterial));
+			scene.addSphere(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, materials.addMaterial(ballMaterial));
+			scene.addLight(new DirLight(glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(1.0f), glm::vec3(-0.5f, -1.0f, -1.0f)));
+		}
+
+		// 10k small spheres in front of the camera over a plane, two lights
+		void buildSuiteSpheres(Scene& scene)
+		{
+			buildSphereField(scene, true);
+		}
+
+		// A quarter million triangle mesh over a plane
+		void buildSuiteMesh(Scene& scene)
+		{
+			scene.addEntity(sphereMesh(256, 512, glm::vec3(0.0f, 0.0f, -5.0f), 2.0f));
+			scene.addPlane(glm::vec3(0.0f, -2.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			scene.addLight(new DirLight(glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(1.0f), glm::vec3(-0.5f, -1.0f, -1.0f)));
+		}
+
+		// Two mirrors facing each other with the camera between them, most rays bounce until the max depth
+		void buildSuiteMirrors(Scene& scene)
+		{
+			MaterialTable& materials = scene.getMaterials();
+			Material mirror;
+			mirror.kShade = 0.1f;
+			mirror.kReflect = 0.9f;
+			mirror.ambient = glm::vec3(0.8f, 0.9f, 1.0f);
+			mirror.diffuse = glm::vec3(0.8f, 0.9f, 1.0f);
+			mirror.specular = glm::vec3(1.0f);
+			unsigned int mirrorMaterial = materials.addMaterial(mirror);
+			Material floor;
+			floor.kShade = 0.8f;
+			floor.kReflect = 0.2f;
+			Texture checker = materials.addChecker(glm::vec3(1.0f), glm::vec3(0.2f));
+			floor.ambient = checker;
+			floor.diffuse = checker;
+			floor.specular = checker;
+			Material ball;
+			ball.kShade = 0.5f;
+			ball.kReflect = 0.5f;
+			ball.ambient = glm::vec3(1.0f, 0.3f, 0.3f);
+			ball.diffuse = glm::vec3(1.0f, 0.3f, 0.3f);
+			ball.specular = glm::vec3(1.0f);
+			scene.addPlane(glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.0f, 0.0f, 1.0f), mirrorMaterial);
+			scene.addPlane(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f, 0.0f, -1.0f), mirrorMaterial);
+			scene.addPlane(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), materials.addMaterial(floor));
+			scene.addSphere(glm::vec3(0.0f, 1.0f, -2.0f), 0.7f, materials.addMaterial(ball));
+			scene.addLight(new DirLight(glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(1.0f), glm::vec3(-0.5f, -1.0f, -0.3f)));
+			scene.setMaxDepth(Scene::MAX_TRACE_DEPTH);
+		}
+
+		struct SuiteCase
+		{
+			const char* name;
+			void (*build)(Scene& scene);
+			glm::vec3 position;
+			glm::vec3 front;
+		};
+
+		const SuiteCase SUITE_CASES[] = {
+			{ "default", buildSuiteDefault, glm::vec3(0.0f, 2.0f, 3.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+			{ "spheres", buildSuiteSpheres, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+			{ "mesh", buildSuiteMesh, glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+			{ "mirrors", buildSuiteMirrors, glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f) },
+		};
+
+		// Results by name, "scene.frame_ms.p50" is p50 in frame_ms in scene in the JSON file
+		typedef std::vector<std::pair<std::string, double>> SuiteResults;
+
+		double percentile(std::vector<double> values, double p)
+		{
+			std::sort(values.begin(), values.end());
+			size_t rank = size_t(std::ceil(p * values.size()));
+			return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+		}
+
+		// ns per test of one ray against one primitive, from the EntityStore loops over all primitives of a type.
+		// The loops live in another translation unit, so their results need not be used.
+		void measureIntersections(SuiteResults& results)
+		{
+			std::mt19937 random(1);
+			std::uniform_real_distribution<float> uniform(-10.0f, 10.0f);
+			std::uniform_real_distribution<float> radius(0.1f, 0.5f);
+			const unsigned int count = 1024;
+			EntityStore store;
+			for (unsigned int i = 0; i < count; i++)
+			{
+				glm::vec3 p(uniform(random), uniform(random), uniform(random));
+				store.addSphere(Sphere(p, radius(random)));
+				store.addPlane(Plane(p, glm::normalize(glm::vec3(uniform(random), uniform(random), uniform(random)))));
+				store.addTriangle(Triangle(p, p + glm::vec3(uniform(random), uniform(random), uniform(random)) * 0.1f,
+					p + glm::vec3(uniform(random), uniform(random), uniform(random)) * 0.1f));
+			}
+			auto rays = randomRays(4096, 10.0f, random);
+
+			const char* names[] = { "sphere", "plane", "triangle" };
+			for (int type = 0; type < 3; type++)
+			{
+				double best = 0.0;
+				for (int run = 0; run < 3; run++)
+				{
+					auto begin = std::chrono::steady_clock::now();
+					for (const Ray& ray : rays)
+					{
+						HitRecord hit;
+						if (type == 0) store.intersectSpheres(ray, hit);
+						else if (type == 1) store.intersectPlanes(ray, hit);
+						else store.intersectTriangles(ray, hit);
+					}
+					auto end = std::chrono::steady_clock::now();
+					double seconds = std::chrono::duration<double>(end - begin).count();
+					best = run == 0 ? seconds : std::min(best, seconds);
+				}
+				results.push_back({ std::string("intersection_ns.") + names[type], best * 1e9 / (double(rays.size()) * count) });
+			}
+		}
+
+		void runSuite(SuiteResults& results, std::ostream& out)
+		{
+			unsigned int threadCount = 0;
+			out << "scene     entities  frame ms min     p50     p90     p99  Mrays/s  rays/frame  scene MB" << std::endl;
+			for (const SuiteCase& c : SUITE_CASES)
+			{
+				Scene scene;
+				c.build(scene);
+				scene.buildBVH();
+				Camera camera(c.position, c.front, glm::vec3(0.0f, 1.0f, 0.0f), float(SUITE_WIDTH) / SUITE_HEIGHT);
+				FrameBuffer frameBuffer(SUITE_WIDTH, SUITE_HEIGHT);
+				Renderer renderer(scene);
+				threadCount = renderer.getThreadCount();
+				renderer.render(camera, frameBuffer);
+
+				std::vector<double> frames;
+				unsigned long long rays = 0;
+				for (unsigned int i = 0; i < SUITE_FRAMES; i++)
+				{
+					auto begin = std::chrono::steady_clock::now();
+					renderer.render(camera, frameBuffer);
+					auto end = std::chrono::steady_clock::now();
+					frames.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+					rays += renderer.getTraceStats().rays;
+				}
+				double total = 0.0;
+				for (double frame : frames)
+				{
+					total += frame;
+				}
+
+				std::string prefix = std::string("scenes.") + c.name + ".";
+				size_t memory = sceneMemory(scene);
+				results.push_back({ prefix + "entities", double(scene.getEntityCount()) });
+				results.push_back({ prefix + "rays_per_frame", double(rays / SUITE_FRAMES) });
+				results.push_back({ prefix + "rays_per_second", rays / (total / 1000.0) });
+				results.push_back({ prefix + "frame_ms.min", percentile(frames, 0.0) });
+				results.push_back({ prefix + "frame_ms.p50", percentile(frames, 0.5) });
+				results.push_back({ prefix + "frame_ms.p90", percentile(frames, 0.9) });
+				results.push_back({ prefix + "frame_ms.p99", percentile(frames, 0.99) });
+				results.push_back({ prefix + "memory_bytes", double(memory) });
+				out << std::setw(8) << std::left << c.name << std::right << "  "
+					<< std::setw(8) << scene.getEntityCount() << "  "
+					<< std::fixed << std::setprecision(2)
+					<< std::setw(12) << percentile(frames, 0.0) << "  "
+					<< std::setw(6) << percentile(frames, 0.5) << "  "
+					<< std::setw(6) << percentile(frames, 0.9) << "  "
+					<< std::setw(6) << percentile(frames, 0.99) << "  "
+					<< std::setw(7) << rays / (total / 1000.0) / 1e6 << "  "
+					<< std::setw(10) << rays / SUITE_FRAMES << "  "
+					<< std::setw(8) << memory / 1e6 << std::endl;
+			}
+
+			measureIntersections(results);
+			out << "ns per intersection test:";
+			for (const auto& result : results)
+			{
+				if (result.first.compare(0, 16, "intersection_ns.") == 0)
+				{
+					out << " " << result.first.substr(16) << " " << std::setprecision(2) << result.second;
+				}
+			}
+			out << std::endl;
+			results.push_back({ "peak_memory_bytes", double(peakMemory()) });
+			out << "peak memory " << std::setprecision(1) << peakMemory() / 1e6 << " MB" << std::endl;
+
+			results.insert(results.begin(), {
+				{ "settings.width", double(SUITE_WIDTH) },
+				{ "settings.height", double(SUITE_HEIGHT) },
+				{ "settings.frames", double(SUITE_FRAMES) },
+				{ "settings.threads", double(threadCount) },
+			});
+		}
+
+		// Nested objects, one per name component. Names sharing a prefix must be next to each other.
+		bool writeSuiteJSON(const std::string& path, const SuiteResults& results)
+		{
+			std::ofstream file(path);
+			if (!file)
+			{
+				std::cout << "Failed to write " << path << std::endl;
+				return false;
+			}
+			file << std::setprecision(9);
+			std::vector<std::string> open; // object names down to the current one
+			file << "{";
+			bool first = true;
+			for (const auto& result : results)
+			{
+				std::vector<std::string> parts;
+				for (size_t begin = 0, end; begin <= result.first.size(); begin = end + 1)
+				{
+					end = std::min(result.first.find('.', begin), result.first.size());
+					parts.push_back(result.first.substr(begin, end - begin));
+				}
+				size_t common = 0;
+				while (common < open.size() && common + 1 < parts.size() && open[common] == parts[common])
+				{
+					common++;
+				}
+				while (open.size() > common)
+				{
+					open.pop_back();
+					file << "\n" << std::string(open.size() + 1, '\t') << "}";
+				}
+				for (size_t i = common; i + 1 < parts.size(); i++)
+				{
+					file << (first ? "\n" : ",\n") << std::string(open.size() + 1, '\t') << "\"" << parts[i] << "\": {";
+					open.push_back(parts[i]);
+					first = true;
+				}
+				file << (first ? "\n" : ",\n") << std::string(open.size() + 1, '\t') << "\"" << parts.back() << "\": " << result.second;
+				first = false;
+			}
+			while (!open.empty())
+			{
+				open.pop_back();
+				file << "\n" << std::string(open.size() + 1, '\t') << "}";
+			}
+			file << "\n}\n";
+			return bool(file);
+		}
+
+		// Reads what writeSuiteJSON writes: nested objects of numbers, flattened back to dotted names.
+		// Strings, booleans and null are skipped so that other tools may add fields.
+		class SuiteJSONReader
+		{
+		public:
+			SuiteJSONReader(const std::string& text) : _p(text.c_str()) {}
+			bool read(SuiteResults& results)
+			{
+				return readValue("", results) && (skipSpaces(), *_p == '\0');
+			}
+		private:
+			void skipSpaces()
+			{
+				while (*_p == ' ' || *_p == '\t' || *_p == '\n' || *_p == '\r')
+				{
+					_p++;
+				}
+			}
+			bool readString(std::string& s)
+			{
+				if (*_p != '"')
+				{
+					return false;
+				}
+				for (_p++; *_p != '"'; _p++)
+				{
+					if (*_p == '\0')
+					{
+						return false;
+					}
+					if (*_p == '\\' && _p[1] != '\0')
+					{
+						_p++;
+					}
+					s += *_p;
+				}
+				_p++;
+				return true;
+			}
+			bool readValue(const std::string& name, SuiteResults& results)
+			{
+				skipSpaces();
+				if (*_p == '{')
+				{
+					_p++;
+					skipSpaces();
+					if (*_p == '}')
+					{
+						_p++;
+						return true;
+					}
+					while (true)
+					{
+						std::string key;
+						skipSpaces();
+						if (!readString(key))
+						{
+							return false;
+						}
+						skipSpaces();
+						if (*_p++ != ':' || !readValue(name.empty() ? key : name + "." + key, results))
+						{
+							return false;
+						}
+						skipSpaces();
+						if (*_p == '}')
+						{
+							_p++;
+							return true;
+						}
+						if (*_p++ != ',')
+						{
+							return false;
+						}
+					}
+				}
+				std::string ignored;
+				if (*_p == '"')
+				{
+					return readString(ignored);
+				}
+				for (const char* word : { "true", "false", "null" })
+				{
+					if (std::strncmp(_p, word, std::strlen(word)) == 0)
+					{
+						_p += std::strlen(word);
+						return true;
+					}
+				}
+				char* end;
+				double value = std::strtod(_p, &end);
+				if (end == _p)
+				{
+					return false;
+				}
+				_p = end;
+				results.push_back({ name, value });
+				return true;
+			}
+
+			const char* _p;
+		};
+
+		bool endsWith(const std::string& s, const std::string& suffix)
+		{
+			return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+		}
+
+		// +1 if a larger value is better, -1 if a smaller one is, 0 for results that aren't compared:
+		// settings, counts and the frame time tails, which are too noisy to flag
+		int suiteDirection(const std::string& name)
+		{
+			if (endsWith(name, "rays_per_second"))
+			{
+				return 1;
+			}
+			if (endsWith(name, "frame_ms.min") || endsWith(name, "frame_ms.p50") || endsWith(name, "memory_bytes") ||
+				name.compare(0, 16, "intersection_ns.") == 0)
+			{
+				return -1;
+			}
+			return 0;
+		}
+	}
+
+	bool benchmarkSuite(const std::string& jsonPath, std::ostream& out)
+	{
+		SuiteResults results;
+		runSuite(results, out);
+		return jsonPath.empty() || writeSuiteJSON(jsonPath, results);
+	}
+
+	bool compareBenchmarkSuite(const std::string& baselinePath, double threshold, const std::string& jsonPath, std::ostream& out)
+	{
+		std::ifstream file(baselinePath);
+		std::stringstream text;
+		text << file.rdbuf();
+		SuiteResults baseline;
+		if (!file || !SuiteJSONReader(text.str()).read(baseline))
+		{
+			std::cout << "Failed to read benchmark baseline " << baselinePath << std::endl;
+			return false;
+		}
+
+		SuiteResults results;
+		runSuite(results, out);
+		if (!jsonPath.empty() && !writeSuiteJSON(jsonPath, results))
+		{
+			return false;
+		}
+
+		out << std::endl << "result                            baseline       current   change" << std::endl;
+		unsigned int regressions = 0;
+		bool sameSettings = true;
+		for (const auto& result : results)
+		{
+			auto old = std::find_if(baseline.begin(), baseline.end(),
+				[&](const std::pair<std::string, double>& b) { return b.first == result.first; });
+			if (old == baseline.end())
+			{
+				continue;
+			}
+			if (result.first.compare(0, 9, "settings.") == 0)
+			{
+				sameSettings = sameSettings && old->second == result.second;
+				continue;
+			}
+			int direction = suiteDirection(result.first);
+			double change = old->second != 0.0 ? (result.second - old->second) / old->second : 0.0;
+			bool regression = direction != 0 && change * direction < -threshold;
+			regressions += regression ? 1 : 0;
+			out << std::setw(32) << std::left << result.first << std::right << "  "
+				<< std::setprecision(4) << std::defaultfloat
+				<< std::setw(12) << old->second << "  "
+				<< std::setw(12) << result.second << "  "
+				<< std::fixed << std::setprecision(1) << std::showpos << std::setw(6) << change * 100.0 << "%" << std::noshowpos
+				<< (regression ? "  REGRESSION" : direction == 0 ? "  (not compared)" : "") << std::endl;
+		}
+		if (!sameSettings)
+		{
+			out << "The baseline was taken with other settings (frame size, frame count or threads), results may not compare" << std::endl;
+		}
+		out << regressions << " regression" << (regressions == 1 ? "" : "s") << " beyond " << threshold * 100.0 << "%" << std::endl;
+		return regressions == 0;
+	}
+
+	void benchmarkWavefront(Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out)
+	{
+		Scene mirrors;
+		buildSuiteMirrors(mirrors);
+		mirrors.buildBVH();
+		Camera mirrorsCamera(glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), float(width) / height);
+		struct Case
+		{
+			const char* name;
+			Scene& scene;
+			const Camera& camera;
+		};
+		Case cases[] = { { "default", scene, camera }, { "mirrors", mirrors, mirrorsCamera } };
+
+		double pixels = double(width) * height;
+		out << "scene    depth  rays/pixel  recursive ms  Mrays/s  wavefront 32 ms  Mrays/s  wavefront 128 ms  Mrays/s  max error" << std::endl;
+		for (const Case& c : cases)
+		{
+			unsigned int maxDepth = c.scene.getMaxDepth();
+			FrameBuffer reference(width, height);
+			FrameBuffer frameBuffer(width, height);
+			Renderer recursive(c.scene);
+			recursive.setPacketWidth(16);
+			Renderer wavefront(c.scene);
+			wavefront.setPacketWidth(16);
+			wavefront.setWavefront(true);
+			Renderer wideWavefront(c.scene, 0, 128);
+			wideWavefront.setPacketWidth(16);
+			wideWavefront.setWavefront(true);
+			for (unsigned int depth = 1; depth <= 8; depth++)
+			{
+				c.scene.setMaxDepth(depth);
+				double recursiveSeconds = timeFrame(recursive, c.camera, reference);
+				double rays = double(recursive.getTraceStats().rays);
+				double wavefrontSeconds = timeFrame(wavefront, c.camera, frameBuffer);
+				double wideSeconds = timeFrame(wideWavefront, c.camera, frameBuffer);
+
+				// The hits are the same, only the order the colors are summed in differs
+				double errorMax = 0.0;
+				for (size_t i = 0; i < (size_t)width * height * 3; i++)
+				{
+					errorMax = std::max(errorMax, std::abs(std::min(frameBuffer.getData()[i], 1.0f) - std::min(reference.getData()[i], 1.0f)) * 255.0);
+				}
+				out << std::fixed << std::setw(7) << std::left << c.name << std::right << "  "
+					<< std::setw(5) << depth << "  "
+					<< std::setprecision(2) << std::setw(10) << rays / pixels << "  "
+					<< std::setw(12) << recursiveSeconds * 1000.0 << "  "
+					<< std::setw(7) << rays / recursiveSeconds / 1e6 << "  "
+					<< std::setw(15) << wavefrontSeconds * 1000.0 << "  "
+					<< std::setw(7) << rays / wavefrontSeconds / 1e6 << "  "
+					<< std::setw(16) << wideSeconds * 1000.0 << "  "
+					<< std::setw(7) << rays / wideSeconds / 1e6 << "  "
+					<< std::setprecision(1) << std::setw(9) << errorMax << std::endl;
+			}
+			c.scene.setMaxDepth(maxDepth);
+		}
+	}
+
+	void benchmarkTexture(std::ostream& out)
+	{
+		const unsigned int size = 4096, width = 640, height = 480;
+		const char* path = "texture_benchmark.rttx";
+		std::vector<glm::vec3> texels(size_t(size) * size);
+		for (unsigned int y = 0; y < size; y++)
+		{
+			for (unsigned int x = 0; x < size; x++)
+			{
+				bool line = x % 64 == 0 || y % 64 == 0;
+				texels[size_t(y) * size + x] = line ? glm::vec3(0.0f) :
+					glm::vec3(float(x) / size, float(y) / size, 0.5f + 0.5f * std::sin(x * 0.05f) * std::cos(y * 0.05f));
+			}
+		}
+		auto begin = std::chrono::steady_clock::now();
+		if (!writeTiledTexture(path, size, size, texels))
+		{
+			return;
+		}
+		double writeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		std::ifstream file(path, std::ios::binary | std::ios::ate);
+		double fileMB = double(file.tellg()) / (1 << 20);
+		file.close();
+		out << "wrote a " << size << "x" << size << " texture with its mip chain, " << std::fixed << std::setprecision(1)
+			<< fileMB << " MB, in " << writeSeconds * 1000.0 << " ms" << std::endl;
+
+		// The floor repeats the texture every unit, so far away many texels fall in one pixel
+		auto buildScene = [](Scene& scene, const Texture& texture)
+		{
+			scene.addLight(new DirLight(glm::vec3(0.2f), glm::vec3(0.6f), glm::vec3(1.0f), glm::vec3(-0.5f, -1.0f, -1.0f)));
+			Material material;
+			material.ambient = texture;
+			material.diffuse = texture;
+			material.specular = glm::vec3(0.3f);
+			unsigned int index = scene.getMaterials().addMaterial(material);
+			scene.addPlane(glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f), index);
+			scene.addSphere(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f, index);
+			scene.buildBVH();
+		};
+		Camera camera(glm::vec3(0.0f, 2.0f, 3.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f), float(width) / height);
+		FrameBuffer frameBuffer(width, height);
+
+		Scene tiled;
+		Texture texture;
+		if (!tiled.getMaterials().addTiledImage(path, texture))
+		{
+			std::remove(path);
+			return;
+		}
+		buildScene(tiled, texture);
+		TextureCache& cache = tiled.getMaterials().getTextureCache();
+		Renderer renderer(tiled);
+		// The file was just written, so misses cost a read call but no disk access
+		// Without filtering every lookup reads the full resolution level, with it the mip level of the pixel footprint
+		out << "filtering  budget MB  cold ms  warm ms  lookups/pixel  warm hit rate  resident MB  read MB" << std::endl;
+		const size_t budgets[] = { 1, 4, 16, 64, 256 };
+		for (bool filtering : { false, true })
+		{
+			tiled.setTextureFiltering(filtering);
+			for (size_t budget : budgets)
+			{
+				cache.setBudget(budget << 20);
+				double coldSeconds = timeFrame(renderer, camera, frameBuffer, 1);
+				double readMB = double(cache.getStats().readBytes) / (1 << 20);
+				cache.resetStats();
+				double warmSeconds = timeFrame(renderer, camera, frameBuffer, 1);
+				TextureCache::Stats stats = cache.getStats();
+				readMB += double(stats.readBytes) / (1 << 20);
+				out << std::setw(9) << (filtering ? "on" : "off") << "  "
+					<< std::setw(9) << budget << "  "
+					<< std::setprecision(1) << std::setw(7) << coldSeconds * 1000.0 << "  "
+					<< std::setw(7) << warmSeconds * 1000.0 << "  "
+					<< std::setprecision(2) << std::setw(13) << double(stats.lookups) / (double(width) * height) << "  "
+					<< std::setprecision(1) << std::setw(12) << stats.getHitRate() * 100.0 << "%  "
+					<< std::setw(11) << double(stats.residentBytes) / (1 << 20) << "  "
+					<< std::setw(7) << readMB << std::endl;
+			}
+		}
+		std::remove(path);
+
+		Scene image;
+		buildScene(image, image.getMaterials().addImage(size, size, texels));
+		image.setTextureFiltering(false); // images have no mip levels
+		Renderer imageRenderer(image);
+		double imageSeconds = timeFrame(imageRenderer, camera, frameBuffer);
+		out << "in memory IMAGE: " << std::setprecision(1) << imageSeconds * 1000.0 << " ms per frame, "
+			<< double(texels.size() * sizeof(glm::vec3)) / (1 << 20) << " MB resident" << std::endl;
+	}
+
+	void benchmarkFiltering(Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out)
+	{
+		// Same setup as benchmarkAdaptive: a quarter of the frame size, the reference traced with other sample positions
+		bool filtering = scene.getTextureFiltering();
+		width = std::max(1u, width / 4);
+		height = std::max(1u, height / 4);
+		const unsigned int referenceSamples = 256;
+		FrameBuffer reference(width, height);
+		FrameBuffer frameBuffer(width, height);
+		AdaptiveRenderer renderer(scene);
+		renderer.setThreshold(0.0f);
+		scene.setTextureFiltering(false);
+		renderer.setSampleCounts(referenceSamples, referenceSamples);
+		renderer.setSeed(1);
+		renderer.render(camera, reference);
+		renderer.setSeed(0);
+
+		auto rmsError = [&]()
+		{
+			double sum = 0.0;
+			for (size_t i = 0; i < (size_t)width * height * 3; i++)
+			{
+				double error = std::min(frameBuffer.getData()[i], 1.0f) - std::min(reference.getData()[i], 1.0f);
+				sum += error * error;
+			}
+			return std::sqrt(sum / ((double)width * height * 3)) * 255.0;
+		};
+
+		out << width << "x" << height << ", " << referenceSamples << " samples per pixel without filtering as reference" << std::endl;
+		out << "samples/pixel  point ms  point error  filtered ms  filtered error  point samples at equal error" << std::endl;
+		std::vector<double> sampleCounts, pointErrors, filteredErrors, filteredSeconds, pointSeconds;
+		for (unsigned int samples = 1; samples <= 64; samples *= 2)
+		{
+			renderer.setSampleCounts(samples, samples);
+			for (bool enabled : { false, true })
+			{
+				scene.setTextureFiltering(enabled);
+				auto begin = std::chrono::steady_clock::now();
+				renderer.render(camera, frameBuffer);
+				auto end = std::chrono::steady_clock::now();
+				(enabled ? filteredSeconds : pointSeconds).push_back(std::chrono::duration<double>(end - begin).count());
+				(enabled ? filteredErrors : pointErrors).push_back(rmsError());
+			}
+			sampleCounts.push_back(samples);
+		}
+		for (size_t i = 0; i < sampleCounts.size(); i++)
+		{
+			out << std::fixed << std::setprecision(0) << std::setw(13) << sampleCounts[i] << "  "
+				<< std::setprecision(1) << std::setw(8) << pointSeconds[i] * 1000.0 << "  "
+				<< std::setprecision(3) << std::setw(11) << pointErrors[i] << "  "
+				<< std::setprecision(1) << std::setw(11) << filteredSeconds[i] * 1000.0 << "  "
+				<< std::setprecision(3) << std::setw(14) << filteredErrors[i] << "  "
+				<< std::setprecision(2) << std::setw(28) << samplesAtError(sampleCounts, pointErrors, filteredErrors[i]) << std::endl;
+		}
+		scene.setTextureFiltering(filtering);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,125 @@
+#ifndef RAY_TRACING_BENCHMARK_H
+#define RAY_TRACING_BENCHMARK_H
+
+#include "Camera.h"
+#include "RayTracing.h"
+
+#include <ostream>
+#include <string>
+
+namespace RayTracing
+{
+	// Renders the same frame with 1..maxThreads threads and prints time, speedup and
+	// per-thread stats. Every image is compared against the single threaded one.
+	void benchmarkScaling(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height,
+		unsigned int maxThreads, unsigned int tileSize, std::ostream& out);
+
+	// Frame time of a DistributedRenderer with 1 to max(4, hardware threads) single threaded workers started
+	// from program, with the scaling efficiency against one worker and the time of an in-process single
+	// threaded Renderer, then a frame during which a worker is killed. Every image must match the in-process one.
+	void benchmarkDistributed(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height,
+		const std::string& program, std::ostream& out);
+
+	// 10k spheres and triangles drifting apart over 33 frames: per frame BVH update time of
+	// Scene::refitBVH against buildBVH, and how the closest hit throughput of the refit tree falls
+	// behind the rebuilt one as the entities move away from where the tree was built
+	void benchmarkAnimation(std::ostream& out);
+
+	// 100 to 10k copies of one mesh as Instances sharing it, against flattened copies with their own
+	// transformed vertices (up to 1k copies): memory, build time and closest hit throughput.
+	// Hits farther apart than a relative 1e-3 are counted as mismatches.
+	void benchmarkInstance(std::ostream& out);
+
+	// Random sphere scenes of growing size: BVH build time and closest hit
+	// throughput of the BVH against the linear scan over all entities
+	void benchmarkBVH(std::ostream& out);
+
+	// Closest hit throughput and memory per entity of the EntityStore against separately allocated
+	// entities called through Entity pointers, on random spheres and triangles of growing count.
+	// Hits whose t differs between the two are counted as mismatches.
+	void benchmarkLayout(std::ostream& out);
+
+	// Checks Triangle::intersect against rays aimed at known barycentric points, counts the rays aimed at
+	// shared edges of a sphere mesh that fall through it, and reports throughput for hitting and missing rays
+	void benchmarkTriangle(std::ostream& out);
+
+	// ns per sphere and plane test of the current formulas against the ones used before rays carried
+	// unit directions, without and with the hit normal, on nearby spheres and on small distant ones.
+	// Hit/miss answers and t are checked against a double precision solution.
+	void benchmarkPrimitive(std::ostream& out);
+
+	// Load throughput and memory per triangle of the mesh loaders. Without a path a
+	// tessellated sphere with about a million triangles is written as OBJ and PLY and loaded back.
+	void benchmarkMesh(const std::string& path, std::ostream& out);
+
+	// Primary ray closest hit throughput of the scalar path against every packet width
+	// the CPU supports, on the given scene, 10k spheres and a quarter million triangle mesh.
+	// Packet hits that differ from the scalar ones are counted as mismatches.
+	void benchmarkPacket(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out);
+
+	// Shading cost per hit of the closure based materials used before the MaterialTable against
+	// the table, for the checkerboard and constant materials of the default scene and 1 to 16 lights.
+	// The last column is the table with a FUNCTION texture, the std::function escape hatch.
+	void benchmarkMaterial(std::ostream& out);
+
+	// A 4096x4096 tiled texture on a floor and a ball, rendered through the TextureCache at budgets of
+	// 1 to 256 MB without and with texture filtering: cold and warm frame times, tile hit rate, resident and
+	// read memory, against the same texture held in memory as an IMAGE. The texture file is written to the
+	// working directory and removed.
+	void benchmarkTexture(std::ostream& out);
+
+	// Error against a 256 sample reference at a quarter of the frame size for 1 to 64 samples per pixel, textures
+	// sampled at points against textures filtered over the ray differential footprint, with frame times and how
+	// many point samples per pixel give the error of the filtered run. The scene's filtering setting is restored.
+	void benchmarkFiltering(Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out);
+
+	// Frame time, rays per pixel and culled branches for max depths 1 to 8 and a few min weights,
+	// with the error against a render at MAX_TRACE_DEPTH without culling. The scene's settings are restored.
+	void benchmarkTrace(Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out);
+
+	// ProgressiveRenderer: error against a 32 sample reference while the camera is still,
+	// and pass times with a camera moving every frame, without and with frame budgets
+	void benchmarkProgressive(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out);
+
+	// AdaptiveRenderer at a few thresholds against uniform sampling with the same sample positions:
+	// error against a 1024 sample reference at a quarter of the frame size, samples per pixel spent, and how
+	// many samples per pixel uniform sampling needs for the same error
+	void benchmarkAdaptive(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out);
+
+	// Frame time without and with shadows, then the shadow rays of every primary hit and light
+	// answered by Scene::isOccluded against a closest hit from getIntersection, on the given
+	// scene and 10k spheres. Rays on which the two disagree are counted as mismatches.
+	void benchmarkShadow(Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out);
+
+	// Frame time against the number of point lights, 1 to 16k, shading every light and shading
+	// Scene::DEFAULT_LIGHT_SAMPLES lights picked from the light tree, with the error of a single
+	// pass of the latter against the former up to 256 lights
+	void benchmarkLights(std::ostream& out);
+
+	// First hit time of the rasterized visibility buffer against ray casting (scalar and the widest packets)
+	// and frame times of the hybrid and ray cast renderers, on the given scene and 262k and 1M triangle
+	// meshes. First hits that differ from Scene::getIntersection are counted as mismatches.
+	void benchmarkRaster(const Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out);
+
+	// Start up cost of a million sphere scene and a million triangle mesh scene: the text scene
+	// (parse and BVH builds) against saving and mapping the binary cache. The two loads are
+	// rendered and must give the same image.
+	void benchmarkScene(std::ostream& out);
+
+	// Regression suite on fixed scenes, no window needed: the built-in scene, 10k spheres, a quarter
+	// million triangle mesh and two facing mirrors traced to MAX_TRACE_DEPTH. Reports frame time
+	// percentiles, rays per second and memory per scene, ns per intersection test of each primitive
+	// type and the peak memory of the process, and writes them as JSON unless jsonPath is empty.
+	bool benchmarkSuite(const std::string& jsonPath, std::ostream& out);
+	// Runs the suite and compares it with a JSON file written by benchmarkSuite. Results worse than
+	// the baseline by more than threshold (0.1 for 10%) are flagged as regressions.
+	// Returns false on any regression or if the baseline can't be read.
+	bool compareBenchmarkSuite(const std::string& baselinePath, double threshold, const std::string& jsonPath, std::ostream& out);
+
+	// Frame time and rays per second of the recursive tracer against the wavefront mode at 32 and 128 pixel
+	// tiles for max depths 1 to 8, on the given scene and on two facing mirrors, with the largest difference
+	// between the two images in 8 bit steps. The scene's max depth is restored.
+	void benchmarkWavefront(Scene& scene, const Camera& camera, unsigned int width, unsigned int height, std::ostream& out);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "Camera.h"
+
+#include <cmath>
+
+namespace RayTracing
+{
+	Camera::Camera(const glm::vec3& position, const glm::vec3& front, const glm::vec3& up, float aspect) :
+		_position(position),
+		_front(front),
+		_up(up),
+		_right(glm::normalize(glm::cross(front, up))),
+		_aspect(aspect)
+	{
+
+	}
+
+	Ray Camera::generateRay(float x, float y) const
+	{
+		glm::vec3 globalPos = _position + _front + x * _right * _aspect + y * _up;
+		return Ray(_position, globalPos);
+	}
+
+	Ray Camera::generateRay(float x, float y, float dx, float dy) const
+	{
+		// The direction is normalize(w), its derivative along dw is (dw * |w|^2 - w * dot(w, dw)) / |w|^3
+		glm::vec3 w = _front + x * _right * _aspect + y * _up;
+		glm::vec3 dwdx = dx * _right * _aspect;
+		glm::vec3 dwdy = dy * _up;
+		float lengthSquared = glm::dot(w, w);
+		float scale = 1.0f / (lengthSquared * std::sqrt(lengthSquared));
+		RayDifferential differential;
+		differential.dOdx = glm::vec3(0.0f);
+		differential.dOdy = glm::vec3(0.0f);
+		differential.dDdx = (dwdx * lengthSquared - w * glm::dot(w, dwdx)) * scale;
+		differential.dDdy = (dwdy * lengthSquared - w * glm::dot(w, dwdy)) * scale;
+		Ray ray = generateRay(x, y);
+		ray.setDifferential(differential);
+		return ray;
+	}
+}
\ No newline at end of file
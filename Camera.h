@@ -0,0 +1,29 @@
+#ifndef RAY_TRACING_CAMERA_H
+#define RAY_TRACING_CAMERA_H
+
+#include "Ray.h"
+
+namespace RayTracing
+{
+	class Camera
+	{
+	public:
+		Camera(const glm::vec3& position, const glm::vec3& front, const glm::vec3& up, float aspect);
+		Ray generateRay(float x, float y) const; // x, y in [-1, 1], (-1, -1) is the bottom left corner
+		// With the ray differentials of a step of dx, dy, the size of a pixel in the same units
+		Ray generateRay(float x, float y, float dx, float dy) const;
+		glm::vec3 getPosition() const { return _position; }
+		glm::vec3 getFront() const { return _front; }
+		glm::vec3 getUp() const { return _up; }
+		glm::vec3 getRight() const { return _right; }
+		float getAspect() const { return _aspect; }
+	private:
+		glm::vec3 _position;
+		glm::vec3 _front;
+		glm::vec3 _up;
+		glm::vec3 _right;
+		float _aspect;
+	};
+}
+
+#endif
\ No newline at end of file
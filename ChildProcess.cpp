@@ -0,0 +1,291 @@
+#include "ChildProcess.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <csignal>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cerrno>
+
+namespace RayTracing
+{
+#ifdef _WIN32
+	ChildProcess::ChildProcess() : _process(nullptr), _input(nullptr), _output(nullptr)
+	{
+
+	}
+
+	bool ChildProcess::start(const std::string& program, const std::vector<std::string>& arguments)
+	{
+		close();
+		// Only the child's ends are inherited
+		SECURITY_ATTRIBUTES security = { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+		HANDLE childInput, childOutput, input, output;
+		if (!CreatePipe(&childInput, &input, &security, 0))
+		{
+			return false;
+		}
+		if (!CreatePipe(&output, &childOutput, &security, 0))
+		{
+			CloseHandle(childInput);
+			CloseHandle(input);
+			return false;
+		}
+		SetHandleInformation(input, HANDLE_FLAG_INHERIT, 0);
+		SetHandleInformation(output, HANDLE_FLAG_INHERIT, 0);
+
+		std::string commandLine = "\"" + program + "\"";
+		for (const auto& argument : arguments)
+		{
+			commandLine += " \"" + argument + "\"";
+		}
+		STARTUPINFOA startup = {};
+		startup.cb = sizeof(startup);
+		startup.dwFlags = STARTF_USESTDHANDLES;
+		startup.hStdInput = childInput;
+		startup.hStdOutput = childOutput;
+		startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+		PROCESS_INFORMATION info = {};
+		bool started = CreateProcessA(program.c_str(), &commandLine[0], nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startup, &info) != 0;
+		CloseHandle(childInput);
+		CloseHandle(childOutput);
+		if (!started)
+		{
+			CloseHandle(input);
+			CloseHandle(output);
+			return false;
+		}
+		CloseHandle(info.hThread);
+		_process = info.hProcess;
+		_input = input;
+		_output = output;
+		return true;
+	}
+
+	bool ChildProcess::isStarted() const
+	{
+		return _process != nullptr;
+	}
+
+	bool ChildProcess::write(const void* data, size_t size)
+	{
+		const char* bytes = (const char*)data;
+		while (size > 0)
+		{
+			DWORD written;
+			if (_input == nullptr || !WriteFile(_input, bytes, DWORD(std::min<size_t>(size, 1 << 30)), &written, nullptr))
+			{
+				return false;
+			}
+			bytes += written;
+			size -= written;
+		}
+		return true;
+	}
+
+	bool ChildProcess::read(void* data, size_t size)
+	{
+		char* bytes = (char*)data;
+		while (size > 0)
+		{
+			DWORD read;
+			if (_output == nullptr || !ReadFile(_output, bytes, DWORD(std::min<size_t>(size, 1 << 30)), &read, nullptr) || read == 0)
+			{
+				return false;
+			}
+			bytes += read;
+			size -= read;
+		}
+		return true;
+	}
+
+	void ChildProcess::kill()
+	{
+		if (_process != nullptr)
+		{
+			TerminateProcess(_process, 1);
+		}
+	}
+
+	void ChildProcess::close()
+	{
+		if (_input != nullptr)
+		{
+			CloseHandle(_input);
+		}
+		if (_output != nullptr)
+		{
+			CloseHandle(_output);
+		}
+		if (_process != nullptr)
+		{
+			WaitForSingleObject(_process, INFINITE);
+			CloseHandle(_process);
+		}
+		_process = nullptr;
+		_input = nullptr;
+		_output = nullptr;
+	}
+
+	std::string ChildProcess::getProgramPath()
+	{
+		char path[MAX_PATH];
+		DWORD length = GetModuleFileNameA(nullptr, path, MAX_PATH);
+		return length > 0 && length < MAX_PATH ? std::string(path, length) : std::string();
+	}
+#else
+	ChildProcess::ChildProcess() : _pid(-1), _input(-1), _output(-1)
+	{
+
+	}
+
+	bool ChildProcess::start(const std::string& program, const std::vector<std::string>& arguments)
+	{
+		close();
+		// A child that died must show up as a failed write, not end this process
+		std::signal(SIGPIPE, SIG_IGN);
+
+		int input[2], output[2];
+		if (pipe(input) != 0)
+		{
+			return false;
+		}
+		if (pipe(output) != 0)
+		{
+			::close(input[0]);
+			::close(input[1]);
+			return false;
+		}
+		// Later children must not inherit the parent's ends, or a closed stdin would never reach this child
+		fcntl(input[1], F_SETFD, FD_CLOEXEC);
+		fcntl(output[0], F_SETFD, FD_CLOEXEC);
+
+		std::vector<char*> argv;
+		argv.push_back(const_cast<char*>(program.c_str()));
+		for (const auto& argument : arguments)
+		{
+			argv.push_back(const_cast<char*>(argument.c_str()));
+		}
+		argv.push_back(nullptr);
+
+		int pid = fork();
+		if (pid == 0)
+		{
+			dup2(input[0], STDIN_FILENO);
+			dup2(output[1], STDOUT_FILENO);
+			::close(input[0]);
+			::close(input[1]);
+			::close(output[0]);
+			::close(output[1]);
+			execv(program.c_str(), argv.data());
+			_exit(127);
+		}
+		::close(input[0]);
+		::close(output[1]);
+		if (pid < 0)
+		{
+			::close(input[1]);
+			::close(output[0]);
+			return false;
+		}
+		_pid = pid;
+		_input = input[1];
+		_output = output[0];
+		return true;
+	}
+
+	bool ChildProcess::isStarted() const
+	{
+		return _pid > 0;
+	}
+
+	bool ChildProcess::write(const void* data, size_t size)
+	{
+		const char* bytes = (const char*)data;
+		while (size > 0)
+		{
+			ssize_t written = _input < 0 ? -1 : ::write(_input, bytes, size);
+			if (written < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (written <= 0)
+			{
+				return false;
+			}
+			bytes += written;
+			size -= size_t(written);
+		}
+		return true;
+	}
+
+	bool ChildProcess::read(void* data, size_t size)
+	{
+		char* bytes = (char*)data;
+		while (size > 0)
+		{
+			ssize_t read = _output < 0 ? -1 : ::read(_output, bytes, size);
+			if (read < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (read <= 0)
+			{
+				return false;
+			}
+			bytes += read;
+			size -= size_t(read);
+		}
+		return true;
+	}
+
+	void ChildProcess::kill()
+	{
+		if (_pid > 0)
+		{
+			::kill(_pid, SIGKILL);
+		}
+	}
+
+	void ChildProcess::close()
+	{
+		if (_input >= 0)
+		{
+			::close(_input);
+		}
+		if (_output >= 0)
+		{
+			::close(_output);
+		}
+		if (_pid > 0)
+		{
+			int status;
+			while (waitpid(_pid, &status, 0) < 0 && errno == EINTR)
+			{
+			}
+		}
+		_pid = -1;
+		_input = -1;
+		_output = -1;
+	}
+
+	std::string ChildProcess::getProgramPath()
+	{
+		char path[4096];
+		ssize_t length = readlink("/proc/self/exe", path, sizeof(path));
+		return length > 0 && size_t(length) < sizeof(path) ? std::string(path, size_t(length)) : std::string();
+	}
+#endif
+
+	ChildProcess::~ChildProcess()
+	{
+		close();
+	}
+}
\ No newline at end of file
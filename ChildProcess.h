@@ -0,0 +1,42 @@
+#ifndef RAY_TRACING_CHILD_PROCESS_H
+#define RAY_TRACING_CHILD_PROCESS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace RayTracing
+{
+	// A program started with its stdin and stdout connected to pipes held by this object,
+	// its stderr is shared with the parent. Reads and writes block until all bytes went through
+	// and fail once the pipe is broken, which is how a dead child shows up.
+	class ChildProcess
+	{
+	public:
+		ChildProcess();
+		~ChildProcess(); // close()
+		ChildProcess(const ChildProcess&) = delete;
+		ChildProcess& operator=(const ChildProcess&) = delete;
+
+		bool start(const std::string& program, const std::vector<std::string>& arguments);
+		bool isStarted() const;
+		bool write(const void* data, size_t size);
+		bool read(void* data, size_t size);
+		void kill(); // ends the child at once, may be called while another thread reads or writes
+		void close(); // closes the pipes, which ends a child serving requests, and waits for it to exit
+
+		static std::string getProgramPath(); // of the running program, empty if the OS can't tell
+	private:
+#ifdef _WIN32
+		void* _process;
+		void* _input; // child's stdin
+		void* _output; // child's stdout
+#else
+		int _pid;
+		int _input;
+		int _output;
+#endif
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,464 @@
+#include "DistributedRenderer.h"
+#include "SceneCache.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace RayTracing
+{
+	namespace
+	{
+		const char MESSAGE_MAGIC[4] = { 'R', 'T', 'D', 'R' };
+
+		enum MessageType : uint32_t
+		{
+			MESSAGE_SCENE, // SceneSettings then a scene cache, answered with an empty MESSAGE_SCENE once loaded
+			MESSAGE_FRAME, // FrameSettings for the ranges that follow
+			MESSAGE_TILES, // TileRange, answered with MESSAGE_PIXELS
+			MESSAGE_PIXELS // TileRange then RGB floats, tile after tile, each tile row by row from its lowest row
+		};
+
+		struct MessageHeader
+		{
+			char magic[4];
+			uint32_t type;
+			uint64_t size; // bytes that follow
+		};
+
+		enum SettingFlag : uint32_t
+		{
+			SETTING_SHADOWS = 1,
+			SETTING_TEXTURE_FILTERING = 2
+		};
+
+		// 16 bytes, so the cache after it stays aligned in the worker's buffer
+		struct SceneSettings
+		{
+			uint32_t maxDepth;
+			float minWeight;
+			uint32_t flags; // SETTING_SHADOWS, SETTING_TEXTURE_FILTERING
+			uint32_t lightSamples;
+		};
+
+		struct FrameSettings
+		{
+			float position[3];
+			float front[3];
+			float up[3];
+			float aspect;
+			uint32_t width;
+			uint32_t height;
+			uint32_t tileSize;
+			uint32_t packetWidth;
+		};
+
+		struct TileRange
+		{
+			uint32_t first;
+			uint32_t count;
+		};
+
+		MessageHeader makeHeader(MessageType type, uint64_t size)
+		{
+			MessageHeader header;
+			std::memcpy(header.magic, MESSAGE_MAGIC, 4);
+			header.type = type;
+			header.size = size;
+			return header;
+		}
+
+		// Calls f(x, y) for every pixel of the range, in the order of MESSAGE_PIXELS
+		template <typename F>
+		void forEachPixel(const FrameSettings& frame, const TileRange& range, F f)
+		{
+			unsigned int tilesX = (frame.width + frame.tileSize - 1) / frame.tileSize;
+			for (unsigned int tile = range.first; tile < range.first + range.count; tile++)
+			{
+				unsigned int x0 = tile % tilesX * frame.tileSize;
+				unsigned int y0 = tile / tilesX * frame.tileSize;
+				unsigned int x1 = std::min(x0 + frame.tileSize, frame.width);
+				unsigned int y1 = std::min(y0 + frame.tileSize, frame.height);
+				for (unsigned int y = y0; y < y1; y++)
+				{
+					for (unsigned int x = x0; x < x1; x++)
+					{
+						f(x, y);
+					}
+				}
+			}
+		}
+
+		// The tiles of one frame, shared by the threads that talk to the workers. Ranges are cut from
+		// what is left, half of it spread over the workers, and ranges handed back go out first.
+		class TileQueue
+		{
+		public:
+			TileQueue(unsigned int tileCount, unsigned int workerCount) :
+				requests(0), redispatched(0), _next(0), _count(tileCount), _workers(workerCount), _pending(0)
+			{
+
+			}
+
+			// Waits while ranges are out that may still come back. False once every tile is done,
+			// or nothing is left to hand out.
+			bool take(TileRange& range)
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				while (true)
+				{
+					if (!_returned.empty())
+					{
+						range = _returned.back();
+						_returned.pop_back();
+						break;
+					}
+					if (_next < _count)
+					{
+						range.first = _next;
+						range.count = std::max(1u, (_count - _next) / (2 * std::max(1u, _workers)));
+						_next += range.count;
+						break;
+					}
+					if (_pending == 0)
+					{
+						return false;
+					}
+					_changed.wait(lock);
+				}
+				_pending++;
+				requests++;
+				return true;
+			}
+
+			void done()
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_pending--;
+				_changed.notify_all();
+			}
+
+			// The worker of a range taken died, or a worker died before taking any (range nullptr)
+			void giveBack(const TileRange* range)
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_workers--;
+				if (range != nullptr)
+				{
+					_pending--;
+					_returned.push_back(*range);
+					redispatched++;
+				}
+				_changed.notify_all();
+			}
+
+			bool finished()
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				return _next == _count && _returned.empty() && _pending == 0;
+			}
+
+			unsigned int requests;
+			unsigned int redispatched;
+		private:
+			std::mutex _mutex;
+			std::condition_variable _changed;
+			std::vector<TileRange> _returned;
+			unsigned int _next;
+			unsigned int _count;
+			unsigned int _workers;
+			unsigned int _pending; // ranges out at workers
+		};
+
+		bool readInput(void* data, size_t size)
+		{
+			return std::fread(data, 1, size, stdin) == size;
+		}
+
+		bool writeOutput(const void* data, size_t size)
+		{
+			return std::fwrite(data, 1, size, stdout) == size;
+		}
+	}
+
+	DistributedRenderer::DistributedRenderer(const std::string& program, unsigned int workerCount, unsigned int threadsPerWorker, unsigned int tileSize) :
+		_program(program), _threadsPerWorker(std::max(1u, threadsPerWorker)), _tileSize(std::max(1u, tileSize)), _packetWidth(1)
+	{
+		for (unsigned int i = 0; i < std::max(1u, workerCount); i++)
+		{
+			_workers.emplace_back(new Worker);
+		}
+	}
+
+	DistributedRenderer::~DistributedRenderer()
+	{
+		// A closed stdin ends a worker
+		for (auto& worker : _workers)
+		{
+			worker->process.close();
+		}
+	}
+
+	bool DistributedRenderer::setScene(const Scene& scene)
+	{
+		std::vector<unsigned char> cache;
+		if (!saveSceneCache(cache, scene, SceneCamera()))
+		{
+			return false;
+		}
+		uint32_t flags = (scene.getShadows() ? SETTING_SHADOWS : 0u) | (scene.getTextureFiltering() ? SETTING_TEXTURE_FILTERING : 0u);
+		SceneSettings settings = { scene.getMaxDepth(), scene.getMinWeight(), flags, scene.getLightSamples() };
+		MessageHeader header = makeHeader(MESSAGE_SCENE, sizeof(settings) + cache.size());
+		std::vector<std::string> arguments = { "--worker", "--threads", std::to_string(_threadsPerWorker) };
+
+		// Send to every worker first, so they load the scene at the same time
+		for (auto& worker : _workers)
+		{
+			if (!worker->running)
+			{
+				worker->process.close();
+				worker->running = worker->process.start(_program, arguments);
+			}
+			if (worker->running && !(worker->process.write(&header, sizeof(header)) &&
+				worker->process.write(&settings, sizeof(settings)) && worker->process.write(cache.data(), cache.size())))
+			{
+				fail(*worker);
+			}
+		}
+		for (auto& worker : _workers)
+		{
+			MessageHeader reply;
+			if (worker->running && !(worker->process.read(&reply, sizeof(reply)) &&
+				std::memcmp(reply.magic, MESSAGE_MAGIC, 4) == 0 && reply.type == MESSAGE_SCENE && reply.size == 0))
+			{
+				fail(*worker);
+			}
+		}
+		if (getWorkerCount() == 0)
+		{
+			std::cout << "Failed to start workers from " << _program << std::endl;
+			return false;
+		}
+		return true;
+	}
+
+	bool DistributedRenderer::render(const Camera& camera, FrameBuffer& frameBuffer)
+	{
+		FrameSettings frame;
+		glm::vec3 position = camera.getPosition(), front = camera.getFront(), up = camera.getUp();
+		for (int i = 0; i < 3; i++)
+		{
+			frame.position[i] = position[i];
+			frame.front[i] = front[i];
+			frame.up[i] = up[i];
+		}
+		frame.aspect = camera.getAspect();
+		frame.width = frameBuffer.getWidth();
+		frame.height = frameBuffer.getHeight();
+		frame.tileSize = _tileSize;
+		frame.packetWidth = _packetWidth;
+		unsigned int tilesX = (frame.width + _tileSize - 1) / _tileSize;
+		unsigned int tilesY = (frame.height + _tileSize - 1) / _tileSize;
+
+		TileQueue queue(tilesX * tilesY, getWorkerCount());
+		_stats = Stats();
+		_stats.tiles.assign(_workers.size(), 0);
+		auto serve = [&](unsigned int index)
+		{
+			Worker& worker = *_workers[index];
+			MessageHeader header = makeHeader(MESSAGE_FRAME, sizeof(frame));
+			if (!worker.process.write(&header, sizeof(header)) || !worker.process.write(&frame, sizeof(frame)))
+			{
+				fail(worker);
+				queue.giveBack(nullptr);
+				return;
+			}
+			TileRange range;
+			std::vector<float> pixels;
+			while (queue.take(range))
+			{
+				size_t count = 0;
+				forEachPixel(frame, range, [&](unsigned int x, unsigned int y) { count++; });
+				pixels.resize(count * 3);
+				header = makeHeader(MESSAGE_TILES, sizeof(range));
+				MessageHeader reply;
+				TileRange replyRange;
+				bool received = worker.process.write(&header, sizeof(header)) && worker.process.write(&range, sizeof(range)) &&
+					worker.process.read(&reply, sizeof(reply)) && std::memcmp(reply.magic, MESSAGE_MAGIC, 4) == 0 &&
+					reply.type == MESSAGE_PIXELS && reply.size == sizeof(range) + pixels.size() * sizeof(float) &&
+					worker.process.read(&replyRange, sizeof(replyRange)) && replyRange.first == range.first && replyRange.count == range.count &&
+					worker.process.read(pixels.data(), pixels.size() * sizeof(float));
+				if (!received)
+				{
+					fail(worker);
+					queue.giveBack(&range);
+					return;
+				}
+				const float* p = pixels.data();
+				forEachPixel(frame, range, [&](unsigned int x, unsigned int y)
+				{
+					frameBuffer.setPixel(x, y, glm::vec3(p[0], p[1], p[2]));
+					p += 3;
+				});
+				_stats.tiles[index] += range.count;
+				queue.done();
+			}
+		};
+
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < _workers.size(); i++)
+		{
+			if (_workers[i]->running)
+			{
+				threads.emplace_back(serve, i);
+			}
+		}
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+		_stats.requests = queue.requests;
+		_stats.redispatched = queue.redispatched;
+		return queue.finished();
+	}
+
+	unsigned int DistributedRenderer::getWorkerCount() const
+	{
+		unsigned int count = 0;
+		for (const auto& worker : _workers)
+		{
+			count += worker->running ? 1 : 0;
+		}
+		return count;
+	}
+
+	void DistributedRenderer::stopWorker(unsigned int worker)
+	{
+		if (worker < _workers.size())
+		{
+			_workers[worker]->process.kill();
+		}
+	}
+
+	// The process is only closed by setScene and the destructor, so kill stays safe from other threads
+	void DistributedRenderer::fail(Worker& worker)
+	{
+		worker.running = false;
+		worker.process.kill();
+	}
+
+	bool runWorker(unsigned int threadCount)
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+		_setmode(_fileno(stdout), _O_BINARY);
+#endif
+		// stdout carries the replies
+		std::streambuf* console = std::cout.rdbuf(std::cerr.rdbuf());
+
+		std::unique_ptr<Scene> scene;
+		std::unique_ptr<Renderer> renderer;
+		std::unique_ptr<FrameBuffer> frameBuffer;
+		FrameSettings frame;
+		unsigned int packetWidth = 0;
+		std::vector<unsigned char> data;
+		std::vector<float> pixels;
+		bool served = true;
+		MessageHeader message;
+		while (served && readInput(&message, sizeof(message)))
+		{
+			served = std::memcmp(message.magic, MESSAGE_MAGIC, 4) == 0;
+			if (served)
+			{
+				data.resize(size_t(message.size));
+				served = readInput(data.data(), data.size());
+			}
+			if (!served)
+			{
+				break;
+			}
+
+			if (message.type == MESSAGE_SCENE && data.size() >= sizeof(SceneSettings))
+			{
+				SceneSettings settings;
+				std::memcpy(&settings, data.data(), sizeof(settings));
+				renderer.reset();
+				scene.reset(new Scene);
+				SceneCamera camera;
+				served = loadSceneCache(data.data() + sizeof(settings), data.size() - sizeof(settings), *scene, camera);
+				if (served)
+				{
+					scene->setMaxDepth(settings.maxDepth);
+					scene->setMinWeight(settings.minWeight);
+					scene->setShadows((settings.flags & SETTING_SHADOWS) != 0);
+					scene->setTextureFiltering((settings.flags & SETTING_TEXTURE_FILTERING) != 0);
+					scene->setLightSamples(settings.lightSamples);
+					renderer.reset(new Renderer(*scene, threadCount));
+					packetWidth = 0;
+					MessageHeader reply = makeHeader(MESSAGE_SCENE, 0);
+					served = writeOutput(&reply, sizeof(reply)) && std::fflush(stdout) == 0;
+				}
+			}
+			else if (message.type == MESSAGE_FRAME && data.size() == sizeof(FrameSettings) && renderer)
+			{
+				std::memcpy(&frame, data.data(), sizeof(frame));
+				renderer->setTileSize(frame.tileSize);
+				if (frame.packetWidth != packetWidth)
+				{
+					renderer->setPacketWidth(frame.packetWidth);
+					packetWidth = frame.packetWidth;
+				}
+				if (!frameBuffer || frameBuffer->getWidth() != frame.width || frameBuffer->getHeight() != frame.height)
+				{
+					frameBuffer.reset(new FrameBuffer(frame.width, frame.height));
+				}
+			}
+			else if (message.type == MESSAGE_TILES && data.size() == sizeof(TileRange) && frameBuffer)
+			{
+				TileRange range;
+				std::memcpy(&range, data.data(), sizeof(range));
+				Camera camera(glm::vec3(frame.position[0], frame.position[1], frame.position[2]),
+					glm::vec3(frame.front[0], frame.front[1], frame.front[2]), glm::vec3(frame.up[0], frame.up[1], frame.up[2]), frame.aspect);
+				SampleGrid grid;
+				grid.width = frame.width;
+				grid.height = frame.height;
+				grid.firstTile = range.first;
+				grid.tileCount = range.count;
+				grid.store = [&](unsigned int x, unsigned int y, const glm::vec3& color)
+				{
+					frameBuffer->setPixel(x, y, color);
+				};
+				renderer->renderSamples(camera, grid);
+
+				pixels.clear();
+				forEachPixel(frame, range, [&](unsigned int x, unsigned int y)
+				{
+					glm::vec3 color = frameBuffer->getPixel(x, y);
+					pixels.insert(pixels.end(), { color.x, color.y, color.z });
+				});
+				MessageHeader reply = makeHeader(MESSAGE_PIXELS, sizeof(range) + pixels.size() * sizeof(float));
+				served = writeOutput(&reply, sizeof(reply)) && writeOutput(&range, sizeof(range)) &&
+					writeOutput(pixels.data(), pixels.size() * sizeof(float)) && std::fflush(stdout) == 0;
+			}
+			else
+			{
+				served = false;
+			}
+		}
+		if (!served)
+		{
+			std::cout << "Failed to serve a request, worker stops" << std::endl;
+		}
+		std::cout.rdbuf(console);
+		return served;
+	}
+}
\ No newline at end of file
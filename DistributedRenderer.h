@@ -0,0 +1,67 @@
+#ifndef RAY_TRACING_DISTRIBUTED_RENDERER_H
+#define RAY_TRACING_DISTRIBUTED_RENDERER_H
+
+#include "ChildProcess.h"
+#include "Renderer.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace RayTracing
+{
+	// Splits frames over worker processes on this machine. A worker is this program started with
+	// --worker; it is sent the scene once as a scene cache, then renders ranges of tiles on request
+	// and sends their pixels back over its stdin and stdout. Ranges are handed to whichever worker
+	// is free and shrink towards the end of the frame, so fast and slow workers finish together.
+	// When a worker dies its range goes to the others and it is restarted on the next setScene.
+	class DistributedRenderer
+	{
+	public:
+		struct Stats
+		{
+			unsigned int requests = 0; // tile ranges sent
+			unsigned int redispatched = 0; // ranges lost with a worker and sent again
+			std::vector<unsigned int> tiles; // rendered by each worker
+		};
+
+		// program is started workerCount times with --worker --threads threadsPerWorker
+		DistributedRenderer(const std::string& program, unsigned int workerCount, unsigned int threadsPerWorker = 1, unsigned int tileSize = 32);
+		~DistributedRenderer();
+		DistributedRenderer(const DistributedRenderer&) = delete;
+		DistributedRenderer& operator=(const DistributedRenderer&) = delete;
+
+		// Starts the workers that are not running and sends the scene and its settings to all of them.
+		// Call again after the scene changes. False if the scene can't be saved as a cache or no worker took it.
+		bool setScene(const Scene& scene);
+		// One sample per pixel, the same image as Renderer gives. False if the workers died before the frame was done.
+		bool render(const Camera& camera, FrameBuffer& frameBuffer);
+		void setPacketWidth(unsigned int width) { _packetWidth = width; } // of the workers' renderers, see Renderer
+		unsigned int getWorkerCount() const; // running ones
+		// Kills a worker, at any time and from any thread. Meant for trying out the recovery.
+		void stopWorker(unsigned int worker);
+		const Stats& getStats() const { return _stats; } // of the last frame
+	private:
+		struct Worker
+		{
+			ChildProcess process;
+			std::atomic<bool> running{ false };
+		};
+		void fail(Worker& worker);
+
+		std::string _program;
+		unsigned int _threadsPerWorker;
+		unsigned int _tileSize;
+		unsigned int _packetWidth;
+		std::vector<std::unique_ptr<Worker>> _workers;
+		std::vector<unsigned char> _scene; // settings and cache as sent
+		Stats _stats;
+	};
+
+	// The worker side: serves requests from stdin on stdout until stdin is closed.
+	// Messages meant for the console go to stderr meanwhile. False if a request was broken.
+	bool runWorker(unsigned int threadCount);
+}
+
+#endif
\ No newline at end of file
@@ -1,9 +1,42 @@
 #include "Entity.h"
+#include "Profile.h"
+
+#include <cmath>
 
 namespace RayTracing
 {
+	// Entity
+	bool Entity::rayIntersect(const Ray& ray, HitRecord& hit) const
+	{
+		float t = rayCollision(ray);
+		if (t > ray.getTMin() && t < hit.t)
+		{
+			hit.t = t;
+			hit.entity = this;
+			hit.primitive = 0;
+			return true;
+		}
+		return false;
+	}
+
+	bool Entity::rayOccluded(const Ray& ray, float tMax) const
+	{
+		float t = rayCollision(ray);
+		return t > ray.getTMin() && t < tMax;
+	}
+
+	void Entity::calTangents(const glm::vec3& p, const HitRecord& hit, glm::vec3& dpdu, glm::vec3& dpdv) const
+	{
+		// The axis least aligned with the normal, projected onto the surface
+		glm::vec3 n = hit.normal;
+		glm::vec3 axis = std::abs(n.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		dpdu = glm::normalize(axis - glm::dot(axis, n) * n);
+		dpdv = glm::cross(n, dpdu);
+	}
+
 	// Plane
-	Plane::Plane(const glm::vec3& aPoint, const glm::vec3& normal) : _normal(glm::normalize(normal)), _aPoint(aPoint)
+	Plane::Plane(const glm::vec3& aPoint, const glm::vec3& normal) :
+		_normal(glm::normalize(normal)), _aPoint(aPoint), _distance(glm::dot(_normal, aPoint))
 	{
 
 	}
@@ -14,95 +47,163 @@ namespace RayTracing
 
 	float Plane::rayCollision(const Ray& ray) const
 	{
-		float v1 = glm::dot(ray.getVertex() - _aPoint, _normal);
-		float v2 = glm::dot(_normal, ray.getDirection());
-		if (abs(v2) < FLOAT_EPS) // v2 == 0
+		return collide(ray, _normal, _distance);
+	}
+	bool Plane::rayIntersect(const Ray& ray, HitRecord& hit) const
+	{
+		float t = collide(ray, _normal, _distance);
+		if (t > ray.getTMin() && t < hit.t)
 		{
-			return -1;
+			hit.t = t;
+			hit.entity = this;
+			hit.primitive = 0;
+			hit.normal = _normal;
+			return true;
 		}
-		else
+		return false;
+	}
+	float Plane::collide(const Ray& ray, const glm::vec3& normal, float distance)
+	{
+		RAY_TRACING_COUNT(tests[PixelCounters::PLANE]);
+		float cosine = glm::dot(normal, ray.getDirection());
+		if (std::abs(cosine) < FLOAT_EPS) // parallel
 		{
-			return -v1 / v2;
+			return -1;
 		}
+		return (distance - glm::dot(normal, ray.getVertex())) / cosine;
 	}
 	glm::vec3 Plane::calNormal(const glm::vec3& p) const
 	{
 		return _normal;
 	}
+	glm::vec2 Plane::calUV(const glm::vec3& p, const HitRecord& hit) const
+	{
+		glm::vec3 dpdu, dpdv;
+		calTangents(p, hit, dpdu, dpdv);
+		return glm::vec2(glm::dot(p, dpdu), glm::dot(p, dpdv));
+	}
+	void Plane::calTangents(const glm::vec3& p, const HitRecord& hit, glm::vec3& dpdu, glm::vec3& dpdv) const
+	{
+		glm::vec3 axis = std::abs(_normal.x) < 0.9f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		dpdu = glm::normalize(axis - glm::dot(axis, _normal) * _normal);
+		dpdv = glm::cross(_normal, dpdu);
+	}
 	// Triangle
 
 	Triangle::Triangle(const glm::vec3& A, const glm::vec3& B, const glm::vec3& C) :
-		_vertice{ A, B, C }
+		_vertice{ A, B, C },
+		_edge1(B - A),
+		_edge2(C - A),
+		_normal(glm::normalize(glm::cross(B - A, C - A)))
 	{
 
 	}
 
 	bool Triangle::inTriangle(const glm::vec3& p) const
 	{
-		auto plane = getPlane();
-
-		if (!plane.onPlane(p))
+		glm::vec3 AP = p - _vertice[0];
+		if (std::abs(glm::dot(AP, _normal)) > FLOAT_EPS)
 		{
 			return false;
 		}
 
-		glm::vec3 vectorToP[3];
-		glm::vec3 crosses[3];
-		for (int i = 0; i < 3; i++)
-		{
-			vectorToP[3] = p - _vertice[i];
-		}
-		for (int i = 0; i < 3; i++)
+		// Barycentric coordinates of p in the triangle plane
+		float d11 = glm::dot(_edge1, _edge1);
+		float d12 = glm::dot(_edge1, _edge2);
+		float d22 = glm::dot(_edge2, _edge2);
+		float dp1 = glm::dot(AP, _edge1);
+		float dp2 = glm::dot(AP, _edge2);
+		float denom = d11 * d22 - d12 * d12;
+		float u = (d22 * dp1 - d12 * dp2) / denom;
+		float v = (d11 * dp2 - d12 * dp1) / denom;
+		return u >= -FLOAT_EPS && v >= -FLOAT_EPS && u + v <= 1.0f + FLOAT_EPS;
+	}
+
+	Plane Triangle::getPlane() const
+	{
+		return Plane(_vertice[0], _normal);
+	}
+
+	void Triangle::getVertice(glm::vec3& A, glm::vec3& B, glm::vec3& C) const
+	{
+		A = _vertice[0];
+		B = _vertice[1];
+		C = _vertice[2];
+	}
+
+	bool Triangle::intersect(const Ray& ray, float& t, float& u, float& v) const
+	{
+		return intersect(ray, _vertice[0], _edge1, _edge2, t, u, v);
+	}
+
+	bool Triangle::intersect(const Ray& ray, const glm::vec3& A, const glm::vec3& edge1, const glm::vec3& edge2,
+		float& t, float& u, float& v)
+	{
+		RAY_TRACING_COUNT(tests[PixelCounters::TRIANGLE]);
+		glm::vec3 direction = ray.getDirection();
+		glm::vec3 p = glm::cross(direction, edge2);
+		float det = glm::dot(edge1, p);
+		if (det == 0.0f) // ray is parallel to the triangle
 		{
-			crosses[i] = glm::normalize(glm::cross(vectorToP[i], vectorToP[(i + 1) % 3]));
+			return false;
 		}
+		float invDet = 1.0f / det;
 
-		// Three cross vectors are in same direction
-		if (glm::distance(crosses[0], crosses[1]) < FLOAT_EPS &&
-			glm::distance(crosses[1], crosses[2]) < FLOAT_EPS)
+		glm::vec3 s = ray.getVertex() - A;
+		u = glm::dot(s, p) * invDet;
+		if (u < -BARYCENTRIC_EPS || u > 1.0f + BARYCENTRIC_EPS)
 		{
-			return true;
+			return false;
 		}
-		else
+
+		glm::vec3 q = glm::cross(s, edge1);
+		v = glm::dot(direction, q) * invDet;
+		if (v < -BARYCENTRIC_EPS || u + v > 1.0f + BARYCENTRIC_EPS)
 		{
 			return false;
 		}
+
+		t = glm::dot(edge2, q) * invDet;
+		return true;
 	}
 
-	Plane Triangle::getPlane() const
+	float Triangle::rayCollision(const Ray& ray) const
 	{
-		return Plane(_vertice[0], getNormal());
+		float t, u, v;
+		if (!intersect(ray, t, u, v) || t <= ray.getTMin()) // no collision
+		{
+			return -1;
+		}
+		return t;
 	}
 
-	glm::vec3 Triangle::getNormal() const
+	bool Triangle::rayIntersect(const Ray& ray, HitRecord& hit) const
 	{
-		auto AB = _vertice[1] - _vertice[0];
-		auto AC = _vertice[2] - _vertice[0];
-		return glm::normalize(glm::cross(AB, AC));
+		float t, u, v;
+		if (!intersect(ray, t, u, v) || t <= ray.getTMin() || t >= hit.t)
+		{
+			return false;
+		}
+		hit.t = t;
+		hit.entity = this;
+		hit.primitive = 0;
+		hit.uv = glm::vec2(u, v);
+		return true;
 	}
 
-	void Triangle::getVertice(glm::vec3& A, glm::vec3& B, glm::vec3 C) const
+	glm::vec3 Triangle::calNormal(const glm::vec3& p) const
 	{
-		A = _vertice[0];
-		B = _vertice[1];
-		C = _vertice[2];
+		return _normal;
 	}
 
-	float Triangle::rayCollision(const Ray& ray) const
+	AABB Triangle::getBounds() const
 	{
-		auto plane = getPlane();
-
-		float t = plane.rayCollision(ray);
-		if (t < -FLOAT_EPS) // no collision
+		AABB box;
+		for (int i = 0; i < 3; i++)
 		{
-			return -1;
+			box.expand(_vertice[i]);
 		}
-		return inTriangle(ray.pointAtT(t));
-	}
-
-	glm::vec3 Triangle::calNormal(const glm::vec3& p) const
-	{
-		return getNormal();
+		return box;
 	}
 
 	// Sphere
@@ -118,43 +219,80 @@ namespace RayTracing
 
 	float Sphere::rayCollision(const Ray& ray) const
 	{
-		glm::vec3 vc = ray.getVertex() - _center;
-	
-		float A = glm::dot(ray.getDirection(), ray.getDirection());
-		float B = 2 * glm::dot(vc, ray.getDirection());
-		float C = glm::dot(vc, vc) - _radius * _radius;
-		if (abs(C) < FLOAT_EPS)
+		return collide(ray, _center, _radius * _radius);
+	}
+	bool Sphere::rayIntersect(const Ray& ray, HitRecord& hit) const
+	{
+		float t = collide(ray, _center, _radius * _radius);
+		if (t > ray.getTMin() && t < hit.t)
 		{
-			C = 0;
+			hit.t = t;
+			hit.entity = this;
+			hit.primitive = 0;
+			hit.normal = (ray.pointAtT(t) - _center) / _radius;
+			return true;
 		}
-
-		float delta = B * B - 4 * A * C;
-		if (delta < FLOAT_EPS)
+		return false;
+	}
+	float Sphere::collide(const Ray& ray, const glm::vec3& center, float radiusSquared)
+	{
+		RAY_TRACING_COUNT(tests[PixelCounters::SPHERE]);
+		// t^2 + 2bt + c = 0 for a unit direction. The discriminant is taken as r^2 - |oc - b * d|^2
+		// rather than b^2 - c, which cancels badly for small or distant spheres
+		glm::vec3 direction = ray.getDirection();
+		glm::vec3 oc = ray.getVertex() - center;
+		float b = glm::dot(oc, direction);
+		glm::vec3 h = oc - b * direction;
+		float discriminant = radiusSquared - glm::dot(h, h);
+		if (discriminant < 0.0f)
 		{
 			return -1;
 		}
-		delta = sqrt(delta);
-		float t1 = (-B + delta) / 2 / A;
-		float t2 = (-B - delta) / 2 / A;
-		if (t1 < FLOAT_EPS && t2 < FLOAT_EPS)
+		// q is the root of larger magnitude, the other one is c / q: one division and no cancellation
+		float root = std::sqrt(discriminant);
+		float q = b >= 0.0f ? -b - root : -b + root;
+		if (q == 0.0f)
 		{
 			return -1;
 		}
-		if (t2 > FLOAT_EPS)
-		{
-			return t2;
-		}
-		else
+		float c = glm::dot(oc, oc) - radiusSquared;
+		float t1 = std::min(c / q, q);
+		float t2 = std::max(c / q, q);
+		if (t1 > ray.getTMin())
 		{
 			return t1;
 		}
+		return t2 > ray.getTMin() ? t2 : -1;
 	}
 	glm::vec3 Sphere::calNormal(const glm::vec3& p) const
 	{
 		return glm::normalize(p - _center);
 	}
-	bool Sphere::rayInEntity(const Ray& ray) const
+	glm::vec2 Sphere::calUV(const glm::vec3& p, const HitRecord& hit) const
+	{
+		glm::vec3 n = calNormal(p, hit);
+		const float PI = 3.14159265f;
+		return glm::vec2(0.5f + std::atan2(n.z, n.x) / (2.0f * PI), std::acos(glm::clamp(-n.y, -1.0f, 1.0f)) / PI);
+	}
+	void Sphere::calTangents(const glm::vec3& p, const HitRecord& hit, glm::vec3& dpdu, glm::vec3& dpdv) const
+	{
+		// East is the derivative of the longitude's cosine and sine, undefined at the poles
+		glm::vec3 n = calNormal(p, hit);
+		glm::vec3 east(-n.z, 0.0f, n.x);
+		float length = glm::length(east);
+		if (length < FLOAT_EPS)
+		{
+			Entity::calTangents(p, hit, dpdu, dpdv);
+			return;
+		}
+		// u turns once around in 2 pi, v goes from pole to pole in pi
+		const float PI = 3.14159265f;
+		dpdu = 2.0f * PI * _radius * east;
+		dpdv = PI * _radius * glm::cross(east / length, n);
+	}
+	glm::vec3 Sphere::calNormalDerivative(const glm::vec3& p, const HitRecord& hit, const glm::vec3& dp) const
 	{
-		return inSphere(ray.getVertex()) && rayCollision(ray) > FLOAT_EPS;
+		glm::vec3 n = calNormal(p, hit);
+		return (dp - glm::dot(dp, n) * n) / _radius;
 	}
 }
\ No newline at end of file
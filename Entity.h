@@ -1,21 +1,59 @@
 #ifndef RAY_TRACING_ENTITY_H
 #define RAY_TRACING_ENTITY_H
 
+#include "AABB.h"
 #include "PhongShader.h"
 #include "Ray.h"
 
 namespace RayTracing
 {
+	class Entity;
+
+	// Closest hit found so far along a ray
+	struct HitRecord
+	{
+		float t = FLOAT_INF;
+		const Entity* entity = nullptr;
+		unsigned int primitive = 0; // triangle index inside a mesh
+		glm::vec2 uv; // barycentric coordinates on triangles
+		glm::vec3 normal; // unit surface normal, filled in by the intersection of spheres and planes, by Scene::completeHit for all
+		// Filled in by Scene::completeHit, once for the closest hit
+		glm::vec3 point;
+		glm::vec2 texCoord; // Entity::calUV at the point
+		glm::vec3 dpdx, dpdy; // how far the point moves to the next pixel in x and y, zero for rays without differentials
+		bool frontFace = true; // false if the ray leaves a closed entity, normal then points along the ray
+	};
+
 	class Entity
 	{
 	public:
+		virtual ~Entity() {}
 		virtual float rayCollision(const Ray& ray) const = 0; // return parameter t
+		// Fills hit and returns true if the entity is hit with ray.getTMin() < t < hit.t
+		virtual bool rayIntersect(const Ray& ray, HitRecord& hit) const;
+		// True if the entity is hit anywhere with ray.getTMin() < t < tMax, for shadow rays
+		virtual bool rayOccluded(const Ray& ray, float tMax) const;
 		virtual glm::vec3 calNormal(const glm::vec3& p) const = 0;
-		virtual bool rayInEntity(const Ray& ray) const = 0;
-		void setMaterial(const Material& m) { _material = m; }
-		const Material& getMaterial() const { return _material; }
+		virtual glm::vec3 calNormal(const glm::vec3& p, const HitRecord& hit) const { return calNormal(p); }
+		// Closed entities have an inside: a ray that starts in them hits their back face
+		virtual bool isClosed() const { return false; }
+		virtual AABB getBounds() const = 0;
+		virtual bool isBounded() const { return true; } // unbounded entities are kept out of the BVH
+		// Texture coordinates at a hit, the hit's uv unless the entity has its own mapping
+		virtual glm::vec2 calUV(const glm::vec3& p, const HitRecord& hit) const { return hit.uv; }
+		// Derivatives of the point along calUV's u and v at a hit, for normal maps and texture footprints.
+		// Entities without a texture mapping of their own return two unit directions perpendicular to
+		// hit.normal and to each other.
+		virtual void calTangents(const glm::vec3& p, const HitRecord& hit, glm::vec3& dpdu, glm::vec3& dpdv) const;
+		// Change of the unit normal calNormal(p, hit) when the hit point moves by dp in the surface, to bend
+		// ray differentials on reflection and refraction. Flat surfaces keep their normal.
+		virtual glm::vec3 calNormalDerivative(const glm::vec3& p, const HitRecord& hit, const glm::vec3& dp) const { return glm::vec3(0.0f); }
+		// Index into the scene's MaterialTable
+		void setMaterial(unsigned int material) { _material = material; }
+		unsigned int getMaterial() const { return _material; }
+		virtual unsigned int getMaterial(const HitRecord& hit) const { return _material; }
 	protected:
-		Material _material;
+		unsigned int _material = 0;
 	};
 
 	class Plane : public Entity
@@ -25,29 +63,52 @@ namespace RayTracing
 		bool onPlane(const glm::vec3& p) const;
 		glm::vec3 getNormal() const { return _normal; }
 		glm::vec3 getAPoint() const { return _aPoint; }
+		float getDistance() const { return _distance; } // of the plane from the origin along the normal
+		// rayCollision for a plane given by its unit normal and distance, one dot product less than from a point
+		static float collide(const Ray& ray, const glm::vec3& normal, float distance);
 
 		float rayCollision(const Ray& ray) const;
+		bool rayIntersect(const Ray& ray, HitRecord& hit) const;
 		glm::vec3 calNormal(const glm::vec3& p) const;
-		bool rayInEntity(const Ray& ray) const { return false; }
+		glm::vec3 calNormal(const glm::vec3& p, const HitRecord& hit) const { return _normal; }
+		// Distances along two axes in the plane, so textures repeat every unit of uv in world units.
+		// u runs along the world axis least aligned with the normal, v along normal x u.
+		glm::vec2 calUV(const glm::vec3& p, const HitRecord& hit) const;
+		void calTangents(const glm::vec3& p, const HitRecord& hit, glm::vec3& dpdu, glm::vec3& dpdv) const;
+		AABB getBounds() const { return AABB(glm::vec3(-FLOAT_INF), glm::vec3(FLOAT_INF)); }
+		bool isBounded() const { return false; }
 	private:
 		glm::vec3 _normal;
 		glm::vec3 _aPoint;
+		float _distance; // dot(_normal, _aPoint)
 	};
 
+	// Triangle::intersect is plain float Moller-Trumbore, not watertight: a ray through a shared edge can
+	// miss both triangles by rounding. The barycentric bounds are widened by this much so it hits one of them.
+	static const float BARYCENTRIC_EPS = 1e-5f;
+
 	class Triangle : public Entity
 	{
 	public:
 		Triangle(const glm::vec3& A, const glm::vec3& B, const glm::vec3& C);
 		bool inTriangle(const glm::vec3& p) const;
 		Plane getPlane() const;
-		glm::vec3 getNormal() const;
-		void getVertice(glm::vec3& A, glm::vec3& B, glm::vec3 C) const;
+		glm::vec3 getNormal() const { return _normal; }
+		void getVertice(glm::vec3& A, glm::vec3& B, glm::vec3& C) const;
+		// Moller-Trumbore with bounds widened by BARYCENTRIC_EPS, hit point is (1 - u - v) * A + u * B + v * C
+		bool intersect(const Ray& ray, float& t, float& u, float& v) const;
+		static bool intersect(const Ray& ray, const glm::vec3& A, const glm::vec3& edge1, const glm::vec3& edge2,
+			float& t, float& u, float& v);
 
 		float rayCollision(const Ray& ray) const;
+		bool rayIntersect(const Ray& ray, HitRecord& hit) const;
 		glm::vec3 calNormal(const glm::vec3& p) const;
-		bool rayInEntity(const Ray& ray) const { return false; }
+		AABB getBounds() const;
 	private:
 		glm::vec3 _vertice[3];
+		glm::vec3 _edge1; // B - A
+		glm::vec3 _edge2; // C - A
+		glm::vec3 _normal;
 	};
 
 	class Sphere : public Entity
@@ -57,10 +118,19 @@ namespace RayTracing
 		bool inSphere(const glm::vec3& p) const;
 		glm::vec3 getCenter() const { return _center; }
 		float getRadius() const { return _radius; }
+		// rayCollision for a sphere given by its data, the closer root above ray.getTMin()
+		static float collide(const Ray& ray, const glm::vec3& center, float radiusSquared);
 
 		float rayCollision(const Ray& ray) const;
+		bool rayIntersect(const Ray& ray, HitRecord& hit) const;
 		glm::vec3 calNormal(const glm::vec3& p) const;
-		bool rayInEntity(const Ray& ray) const;
+		// The normal found by the intersection if the hit is on this sphere
+		glm::vec3 calNormal(const glm::vec3& p, const HitRecord& hit) const { return hit.entity == this ? hit.normal : calNormal(p); }
+		glm::vec2 calUV(const glm::vec3& p, const HitRecord& hit) const; // longitude and latitude
+		void calTangents(const glm::vec3& p, const HitRecord& hit, glm::vec3& dpdu, glm::vec3& dpdv) const; // east and north
+		glm::vec3 calNormalDerivative(const glm::vec3& p, const HitRecord& hit, const glm::vec3& dp) const;
+		bool isClosed() const { return true; }
+		AABB getBounds() const { return AABB(_center - glm::vec3(_radius), _center + glm::vec3(_radius)); }
 	private:
 		glm::vec3 _center;
 		float _radius;
@@ -0,0 +1,198 @@
+#include "EntityStore.h"
+
+namespace RayTracing
+{
+	EntityStore::EntityStore() :
+		_sphereRecords(_arena),
+		_planeRecords(_arena),
+		_triangleRecords(_arena),
+		_spheres(_arena),
+		_planes(_arena),
+		_triangles(_arena)
+	{
+
+	}
+
+	EntityHandle EntityStore::addSphere(const Sphere& sphere)
+	{
+		float radius = sphere.getRadius();
+		_sphereRecords.push_back({ sphere.getCenter(), radius * radius, 1.0f / radius });
+		_spheres.push_back(sphere);
+		_sphereSlots.push_back((unsigned int)_spheres.size() - 1);
+		return EntityHandle::make(EntityHandle::SPHERE, (unsigned int)_sphereSlots.size() - 1);
+	}
+
+	EntityHandle EntityStore::addPlane(const Plane& plane)
+	{
+		_planeRecords.push_back({ plane.getNormal(), plane.getDistance() });
+		_planes.push_back(plane);
+		return EntityHandle::make(EntityHandle::PLANE, (unsigned int)_planes.size() - 1);
+	}
+
+	EntityHandle EntityStore::addTriangle(const Triangle& triangle)
+	{
+		glm::vec3 A, B, C;
+		triangle.getVertice(A, B, C);
+		_triangleRecords.push_back({ A, B - A, C - A });
+		_triangles.push_back(triangle);
+		_triangleSlots.push_back((unsigned int)_triangles.size() - 1);
+		return EntityHandle::make(EntityHandle::TRIANGLE, (unsigned int)_triangleSlots.size() - 1);
+	}
+
+	void EntityStore::reserve(size_t sphereCount, size_t planeCount, size_t triangleCount)
+	{
+		_sphereRecords.reserve(sphereCount);
+		_spheres.reserve(sphereCount);
+		_planeRecords.reserve(planeCount);
+		_planes.reserve(planeCount);
+		_triangleRecords.reserve(triangleCount);
+		_triangles.reserve(triangleCount);
+		_sphereSlots.reserve(sphereCount);
+		_triangleSlots.reserve(triangleCount);
+	}
+
+	void EntityStore::reorder(const std::vector<unsigned int>& sphereOrder, const std::vector<unsigned int>& triangleOrder)
+	{
+		Arena arena;
+		_sphereRecords.reorder(arena, sphereOrder.data());
+		_spheres.reorder(arena, sphereOrder.data());
+		_triangleRecords.reorder(arena, triangleOrder.data());
+		_triangles.reorder(arena, triangleOrder.data());
+		_planeRecords.reorder(arena, nullptr);
+		_planes.reorder(arena, nullptr);
+		_arena.swap(arena); // the old blocks go with the local arena
+
+		// Handles still point at the old slots
+		std::vector<unsigned int> newSlots(sphereOrder.size());
+		for (unsigned int i = 0; i < sphereOrder.size(); i++)
+		{
+			newSlots[sphereOrder[i]] = i;
+		}
+		for (auto& slot : _sphereSlots)
+		{
+			slot = newSlots[slot];
+		}
+		newSlots.resize(triangleOrder.size());
+		for (unsigned int i = 0; i < triangleOrder.size(); i++)
+		{
+			newSlots[triangleOrder[i]] = i;
+		}
+		for (auto& slot : _triangleSlots)
+		{
+			slot = newSlots[slot];
+		}
+	}
+
+	void EntityStore::setSphere(EntityHandle handle, const glm::vec3& center, float radius)
+	{
+		unsigned int slot = getSlot(handle);
+		unsigned int material = _spheres[slot].getMaterial();
+		_spheres[slot] = Sphere(center, radius);
+		_spheres[slot].setMaterial(material);
+		_sphereRecords[slot] = { center, radius * radius, 1.0f / radius };
+	}
+
+	void EntityStore::setPlane(EntityHandle handle, const glm::vec3& aPoint, const glm::vec3& normal)
+	{
+		unsigned int slot = getSlot(handle);
+		unsigned int material = _planes[slot].getMaterial();
+		_planes[slot] = Plane(aPoint, normal);
+		_planes[slot].setMaterial(material);
+		_planeRecords[slot] = { _planes[slot].getNormal(), _planes[slot].getDistance() };
+	}
+
+	void EntityStore::setTriangle(EntityHandle handle, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C)
+	{
+		unsigned int slot = getSlot(handle);
+		unsigned int material = _triangles[slot].getMaterial();
+		_triangles[slot] = Triangle(A, B, C);
+		_triangles[slot].setMaterial(material);
+		_triangleRecords[slot] = { A, B - A, C - A };
+	}
+
+	unsigned int EntityStore::getSlot(EntityHandle handle) const
+	{
+		switch (handle.getType())
+		{
+		case EntityHandle::SPHERE: return _sphereSlots[handle.getIndex()];
+		case EntityHandle::TRIANGLE: return _triangleSlots[handle.getIndex()];
+		default: return handle.getIndex();
+		}
+	}
+
+	const Entity* EntityStore::getEntity(EntityHandle handle) const
+	{
+		switch (handle.getType())
+		{
+		case EntityHandle::SPHERE: return &_spheres[getSlot(handle)];
+		case EntityHandle::PLANE: return &_planes[getSlot(handle)];
+		case EntityHandle::TRIANGLE: return &_triangles[getSlot(handle)];
+		default: return nullptr;
+		}
+	}
+
+	size_t EntityStore::getMemoryUsage() const
+	{
+		return _arena.getCapacity() + (_sphereSlots.capacity() + _triangleSlots.capacity()) * sizeof(unsigned int);
+	}
+
+	void EntityStore::intersectSpheres(const Ray& ray, HitRecord& hit) const
+	{
+		for (unsigned int i = 0; i < _spheres.size(); i++)
+		{
+			intersectSphere(i, ray, hit);
+		}
+	}
+
+	void EntityStore::intersectPlanes(const Ray& ray, HitRecord& hit) const
+	{
+		for (unsigned int i = 0; i < _planes.size(); i++)
+		{
+			intersectPlane(i, ray, hit);
+		}
+	}
+
+	void EntityStore::intersectTriangles(const Ray& ray, HitRecord& hit) const
+	{
+		for (unsigned int i = 0; i < _triangles.size(); i++)
+		{
+			intersectTriangle(i, ray, hit);
+		}
+	}
+
+	bool EntityStore::occludedSpheres(const Ray& ray, float tMax) const
+	{
+		for (unsigned int i = 0; i < _spheres.size(); i++)
+		{
+			if (occludedSphere(i, ray, tMax))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool EntityStore::occludedPlanes(const Ray& ray, float tMax) const
+	{
+		for (unsigned int i = 0; i < _planes.size(); i++)
+		{
+			if (occludedPlane(i, ray, tMax))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool EntityStore::occludedTriangles(const Ray& ray, float tMax) const
+	{
+		for (unsigned int i = 0; i < _triangles.size(); i++)
+		{
+			if (occludedTriangle(i, ray, tMax))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
\ No newline at end of file
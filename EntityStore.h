@@ -0,0 +1,176 @@
+#ifndef RAY_TRACING_ENTITY_STORE_H
+#define RAY_TRACING_ENTITY_STORE_H
+
+#include "Arena.h"
+#include "Entity.h"
+
+#include <vector>
+
+namespace RayTracing
+{
+	// Refers to an entity of a Scene by its type and its index among the entities of that type,
+	// in the order they were added
+	struct EntityHandle
+	{
+		enum Type : unsigned int { SPHERE, PLANE, TRIANGLE, OTHER };
+
+		unsigned int value;
+
+		static EntityHandle make(Type type, unsigned int index) { return { (unsigned int)type << TYPE_SHIFT | index }; }
+		Type getType() const { return Type(value >> TYPE_SHIFT); }
+		unsigned int getIndex() const { return value & INDEX_MASK; }
+
+		static const unsigned int TYPE_SHIFT = 30;
+		static const unsigned int INDEX_MASK = (1u << TYPE_SHIFT) - 1;
+	};
+
+	// What intersection reads of each type, kept apart from the entity objects used for shading
+	struct SphereRecord
+	{
+		glm::vec3 center;
+		float radiusSquared;
+		float invRadius; // turns the hit point into the unit normal with a multiplication
+	};
+
+	struct PlaneRecord
+	{
+		glm::vec3 normal; // unit length
+		float distance; // dot(normal, any point of the plane)
+	};
+
+	struct TriangleRecord
+	{
+		glm::vec3 A;
+		glm::vec3 edge1; // B - A
+		glm::vec3 edge2; // C - A
+	};
+
+	// Spheres, planes and triangles of a scene, each type in its own contiguous arrays backed by
+	// one arena. Intersection walks the compact records of a type and calls no virtual function;
+	// the Sphere, Plane and Triangle objects are only touched to shade a hit.
+	// An entity sits at a slot of its type's arrays. Slots change when the store is reordered,
+	// handles don't. Adding or reordering invalidates pointers to the records and entities.
+	class EntityStore
+	{
+	public:
+		EntityStore();
+		EntityHandle addSphere(const Sphere& sphere);
+		EntityHandle addPlane(const Plane& plane);
+		EntityHandle addTriangle(const Triangle& triangle);
+		void reserve(size_t sphereCount, size_t planeCount, size_t triangleCount);
+		// Slot i of the spheres gets the sphere at slot sphereOrder[i], same for the triangles.
+		// Everything is moved into a fresh arena, which also drops the blocks left behind by growth.
+		void reorder(const std::vector<unsigned int>& sphereOrder, const std::vector<unsigned int>& triangleOrder);
+		// Move an entity in place, its material, handle and slot stay the same
+		void setSphere(EntityHandle handle, const glm::vec3& center, float radius);
+		void setPlane(EntityHandle handle, const glm::vec3& aPoint, const glm::vec3& normal);
+		void setTriangle(EntityHandle handle, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C);
+
+		size_t getSphereCount() const { return _spheres.size(); }
+		size_t getPlaneCount() const { return _planes.size(); }
+		size_t getTriangleCount() const { return _triangles.size(); }
+		const SphereRecord* getSphereRecords() const { return _sphereRecords.data(); }
+		const PlaneRecord* getPlaneRecords() const { return _planeRecords.data(); }
+		const TriangleRecord* getTriangleRecords() const { return _triangleRecords.data(); }
+		const Sphere& getSphere(unsigned int slot) const { return _spheres[slot]; }
+		const Plane& getPlane(unsigned int slot) const { return _planes[slot]; }
+		const Triangle& getTriangle(unsigned int slot) const { return _triangles[slot]; }
+		unsigned int getSlot(EntityHandle handle) const; // of type SPHERE, PLANE or TRIANGLE
+		const Entity* getEntity(EntityHandle handle) const;
+		size_t getMemoryUsage() const;
+
+		// The entity's rayIntersect and rayOccluded, without the virtual call
+		bool intersectSphere(unsigned int slot, const Ray& ray, HitRecord& hit) const;
+		bool intersectPlane(unsigned int slot, const Ray& ray, HitRecord& hit) const;
+		bool intersectTriangle(unsigned int slot, const Ray& ray, HitRecord& hit) const;
+		bool occludedSphere(unsigned int slot, const Ray& ray, float tMax) const;
+		bool occludedPlane(unsigned int slot, const Ray& ray, float tMax) const;
+		bool occludedTriangle(unsigned int slot, const Ray& ray, float tMax) const;
+		// All entities of a type, one tight loop each
+		void intersectSpheres(const Ray& ray, HitRecord& hit) const;
+		void intersectPlanes(const Ray& ray, HitRecord& hit) const;
+		void intersectTriangles(const Ray& ray, HitRecord& hit) const;
+		bool occludedSpheres(const Ray& ray, float tMax) const;
+		bool occludedPlanes(const Ray& ray, float tMax) const;
+		bool occludedTriangles(const Ray& ray, float tMax) const;
+	private:
+		Arena _arena; // declared first, the arrays live in it
+		ArenaArray<SphereRecord> _sphereRecords;
+		ArenaArray<PlaneRecord> _planeRecords;
+		ArenaArray<TriangleRecord> _triangleRecords;
+		ArenaArray<Sphere> _spheres;
+		ArenaArray<Plane> _planes;
+		ArenaArray<Triangle> _triangles;
+		std::vector<unsigned int> _sphereSlots; // by handle index, planes are never reordered
+		std::vector<unsigned int> _triangleSlots;
+	};
+
+	// Inline, they are called for every primitive of a BVH leaf
+	inline bool EntityStore::intersectSphere(unsigned int slot, const Ray& ray, HitRecord& hit) const
+	{
+		const SphereRecord& record = _sphereRecords[slot];
+		float t = Sphere::collide(ray, record.center, record.radiusSquared);
+		if (t > ray.getTMin() && t < hit.t)
+		{
+			hit.t = t;
+			hit.entity = &_spheres[slot];
+			hit.primitive = 0;
+			hit.normal = (ray.pointAtT(t) - record.center) * record.invRadius;
+			return true;
+		}
+		return false;
+	}
+
+	inline bool EntityStore::intersectPlane(unsigned int slot, const Ray& ray, HitRecord& hit) const
+	{
+		const PlaneRecord& record = _planeRecords[slot];
+		float t = Plane::collide(ray, record.normal, record.distance);
+		if (t > ray.getTMin() && t < hit.t)
+		{
+			hit.t = t;
+			hit.entity = &_planes[slot];
+			hit.primitive = 0;
+			hit.normal = record.normal;
+			return true;
+		}
+		return false;
+	}
+
+	inline bool EntityStore::intersectTriangle(unsigned int slot, const Ray& ray, HitRecord& hit) const
+	{
+		const TriangleRecord& record = _triangleRecords[slot];
+		float t, u, v;
+		if (!Triangle::intersect(ray, record.A, record.edge1, record.edge2, t, u, v) || t <= ray.getTMin() || t >= hit.t)
+		{
+			return false;
+		}
+		hit.t = t;
+		hit.entity = &_triangles[slot];
+		hit.primitive = 0;
+		hit.uv = glm::vec2(u, v);
+		return true;
+	}
+
+	inline bool EntityStore::occludedSphere(unsigned int slot, const Ray& ray, float tMax) const
+	{
+		const SphereRecord& record = _sphereRecords[slot];
+		float t = Sphere::collide(ray, record.center, record.radiusSquared);
+		return t > ray.getTMin() && t < tMax;
+	}
+
+	inline bool EntityStore::occludedPlane(unsigned int slot, const Ray& ray, float tMax) const
+	{
+		const PlaneRecord& record = _planeRecords[slot];
+		float t = Plane::collide(ray, record.normal, record.distance);
+		return t > ray.getTMin() && t < tMax;
+	}
+
+	inline bool EntityStore::occludedTriangle(unsigned int slot, const Ray& ray, float tMax) const
+	{
+		const TriangleRecord& record = _triangleRecords[slot];
+		float t, u, v;
+		return Triangle::intersect(ray, record.A, record.edge1, record.edge2, t, u, v) && t > ray.getTMin() && t < tMax;
+	}
+}
+
+#endif
\ No newline at end of file
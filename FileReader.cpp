@@ -0,0 +1,150 @@
+#include "FileReader.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace RayTracing
+{
+	FileReader::FileReader(const std::string& path) :
+		_file(std::fopen(path.c_str(), "rb")), _buffer(BLOCK_SIZE + 1, 0), _begin(0), _end(0)
+	{
+
+	}
+
+	FileReader::~FileReader()
+	{
+		if (_file != nullptr)
+		{
+			std::fclose(_file);
+		}
+	}
+
+	bool FileReader::readLine(const char*& begin, const char*& end)
+	{
+		while (true)
+		{
+			char* first = &_buffer[_begin];
+			char* newline = (char*)std::memchr(first, '\n', _end - _begin);
+			if (newline != nullptr)
+			{
+				begin = first;
+				end = newline;
+				_begin = newline - _buffer.data() + 1;
+				if (end > begin && end[-1] == '\r')
+				{
+					end--;
+				}
+				return true;
+			}
+			if (!fill())
+			{
+				if (_begin == _end)
+				{
+					return false;
+				}
+				begin = &_buffer[_begin];
+				end = &_buffer[_end];
+				_begin = _end;
+				return true;
+			}
+		}
+	}
+
+	bool FileReader::read(void* data, size_t size)
+	{
+		while (_end - _begin < size)
+		{
+			if (!fill())
+			{
+				return false;
+			}
+		}
+		std::memcpy(data, &_buffer[_begin], size);
+		_begin += size;
+		return true;
+	}
+
+	// Moves the unread bytes to the front and appends the next block, growing the
+	// buffer when a single line doesn't fit
+	bool FileReader::fill()
+	{
+		size_t remaining = _end - _begin;
+		std::memmove(_buffer.data(), _buffer.data() + _begin, remaining);
+		_begin = 0;
+		_end = remaining;
+		if (_end + 1 >= _buffer.size())
+		{
+			_buffer.resize(_buffer.size() * 2);
+		}
+		size_t count = std::fread(&_buffer[_end], 1, _buffer.size() - 1 - _end, _file);
+		_end += count;
+		_buffer[_end] = 0;
+		return count > 0;
+	}
+
+	void skipSpaces(const char*& p)
+	{
+		while (*p == ' ' || *p == '\t')
+		{
+			p++;
+		}
+	}
+
+	bool isDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	long parseInt(const char*& p)
+	{
+		skipSpaces(p);
+		bool negative = *p == '-';
+		if (*p == '-' || *p == '+')
+		{
+			p++;
+		}
+		long value = 0;
+		while (isDigit(*p))
+		{
+			value = value * 10 + (*p++ - '0');
+		}
+		return negative ? -value : value;
+	}
+
+	float parseFloat(const char*& p)
+	{
+		skipSpaces(p);
+		bool negative = *p == '-';
+		if (*p == '-' || *p == '+')
+		{
+			p++;
+		}
+		double value = 0.0;
+		while (isDigit(*p))
+		{
+			value = value * 10.0 + (*p++ - '0');
+		}
+		if (*p == '.')
+		{
+			p++;
+			double scale = 0.1;
+			while (isDigit(*p))
+			{
+				value += (*p++ - '0') * scale;
+				scale *= 0.1;
+			}
+		}
+		if (*p == 'e' || *p == 'E')
+		{
+			p++;
+			value *= std::pow(10.0, (double)parseInt(p));
+		}
+		return float(negative ? -value : value);
+	}
+
+	bool startsWith(const char* p, const char* end, const char* keyword)
+	{
+		size_t length = std::strlen(keyword);
+		return size_t(end - p) > length && std::memcmp(p, keyword, length) == 0 && (p[length] == ' ' || p[length] == '\t');
+	}
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#ifndef RAY_TRACING_FILE_READER_H
+#define RAY_TRACING_FILE_READER_H
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace RayTracing
+{
+	// Reads a file in large blocks. Lines handed out stay valid until the next call.
+	// Shared by the text formats (OBJ, PLY headers, scene files).
+	class FileReader
+	{
+	public:
+		explicit FileReader(const std::string& path);
+		~FileReader();
+		FileReader(const FileReader&) = delete;
+		FileReader& operator=(const FileReader&) = delete;
+		bool isOpen() const { return _file != nullptr; }
+
+		// The line excludes the line break. The character at end is always '\n', '\r' or '\0',
+		// so parsing can stop at any of them without checking end.
+		bool readLine(const char*& begin, const char*& end);
+		bool read(void* data, size_t size);
+	private:
+		bool fill();
+
+		static const size_t BLOCK_SIZE = 1 << 20;
+		std::FILE* _file;
+		std::vector<char> _buffer;
+		size_t _begin;
+		size_t _end;
+	};
+
+	// In place parsing of a line from FileReader, p is advanced past what was read
+	void skipSpaces(const char*& p);
+	bool isDigit(char c);
+	long parseInt(const char*& p);
+	float parseFloat(const char*& p);
+	// True if the line at p starts with keyword followed by a space or tab
+	bool startsWith(const char* p, const char* end, const char* keyword);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,273 @@
+#include "FrameBuffer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace RayTracing
+{
+	namespace
+	{
+		void putU32BE(std::vector<unsigned char>& out, uint32_t v)
+		{
+			out.push_back((v >> 24) & 0xff);
+			out.push_back((v >> 16) & 0xff);
+			out.push_back((v >> 8) & 0xff);
+			out.push_back(v & 0xff);
+		}
+
+		uint32_t crc32(const unsigned char* data, size_t size, uint32_t crc = 0)
+		{
+			// Built once; initializing a function-local static is thread-safe, PNGs may be written from several threads
+			static const std::array<uint32_t, 256> table = []()
+			{
+				std::array<uint32_t, 256> result;
+				for (uint32_t n = 0; n < 256; n++)
+				{
+					uint32_t c = n;
+					for (int k = 0; k < 8; k++)
+					{
+						c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+					}
+					result[n] = c;
+				}
+				return result;
+			}();
+			crc = ~crc;
+			for (size_t i = 0; i < size; i++)
+			{
+				crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+			}
+			return ~crc;
+		}
+
+		void writePNGChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data)
+		{
+			std::vector<unsigned char> chunk;
+			putU32BE(chunk, uint32_t(data.size()));
+			chunk.insert(chunk.end(), type, type + 4);
+			chunk.insert(chunk.end(), data.begin(), data.end());
+			putU32BE(chunk, crc32(chunk.data() + 4, chunk.size() - 4));
+			file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+		}
+
+		template <typename T>
+		void putLE(std::vector<unsigned char>& out, T v)
+		{
+			// EXR is little endian, as are all the platforms we build for
+			unsigned char bytes[sizeof(T)];
+			std::memcpy(bytes, &v, sizeof(T));
+			out.insert(out.end(), bytes, bytes + sizeof(T));
+		}
+
+		void putEXRAttribute(std::vector<unsigned char>& out, const char* name, const char* type, const std::vector<unsigned char>& value)
+		{
+			out.insert(out.end(), name, name + strlen(name) + 1);
+			out.insert(out.end(), type, type + strlen(type) + 1);
+			putLE<int32_t>(out, int32_t(value.size()));
+			out.insert(out.end(), value.begin(), value.end());
+		}
+
+		bool endsWith(const std::string& s, const std::string& suffix)
+		{
+			return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+		}
+	}
+
+	FrameBuffer::FrameBuffer(unsigned int width, unsigned int height) :
+		_width(width), _height(height), _data(size_t(width) * height * 3, 0.0f)
+	{
+
+	}
+
+	void FrameBuffer::setPixel(unsigned int x, unsigned int y, const glm::vec3& color)
+	{
+		float* p = &_data[(size_t(y) * _width + x) * 3];
+		p[0] = color.x;
+		p[1] = color.y;
+		p[2] = color.z;
+	}
+
+	glm::vec3 FrameBuffer::getPixel(unsigned int x, unsigned int y) const
+	{
+		const float* p = &_data[(size_t(y) * _width + x) * 3];
+		return glm::vec3(p[0], p[1], p[2]);
+	}
+
+	void FrameBuffer::clear(const glm::vec3& color)
+	{
+		for (size_t i = 0; i < _data.size(); i += 3)
+		{
+			_data[i] = color.x;
+			_data[i + 1] = color.y;
+			_data[i + 2] = color.z;
+		}
+	}
+
+	bool FrameBuffer::write(const std::string& path) const
+	{
+		if (endsWith(path, ".png"))
+		{
+			return writePNG(path);
+		}
+		if (endsWith(path, ".exr"))
+		{
+			return writeEXR(path);
+		}
+		return writePPM(path);
+	}
+
+	std::vector<unsigned char> FrameBuffer::toBytes() const
+	{
+		std::vector<unsigned char> bytes(_data.size());
+		for (unsigned int y = 0; y < _height; y++)
+		{
+			const float* src = &_data[size_t(_height - 1 - y) * _width * 3];
+			unsigned char* dst = &bytes[size_t(y) * _width * 3];
+			for (unsigned int i = 0; i < _width * 3; i++)
+			{
+				dst[i] = (unsigned char)(std::min(std::max(src[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+			}
+		}
+		return bytes;
+	}
+
+	bool FrameBuffer::writePPM(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+		file << "P6\n" << _width << " " << _height << "\n255\n";
+		auto bytes = toBytes();
+		file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+		return bool(file);
+	}
+
+	bool FrameBuffer::writePNG(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+		static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+		file.write(reinterpret_cast<const char*>(signature), 8);
+
+		std::vector<unsigned char> header;
+		putU32BE(header, _width);
+		putU32BE(header, _height);
+		header.push_back(8); // bit depth
+		header.push_back(2); // RGB
+		header.push_back(0);
+		header.push_back(0);
+		header.push_back(0);
+		writePNGChunk(file, "IHDR", header);
+
+		// Every row starts with filter type 0, the rows are stored in uncompressed deflate blocks
+		auto bytes = toBytes();
+		size_t rowSize = size_t(_width) * 3;
+		std::vector<unsigned char> raw;
+		raw.reserve((rowSize + 1) * _height);
+		for (unsigned int y = 0; y < _height; y++)
+		{
+			raw.push_back(0);
+			raw.insert(raw.end(), bytes.begin() + y * rowSize, bytes.begin() + (y + 1) * rowSize);
+		}
+
+		std::vector<unsigned char> zlib = { 0x78, 0x01 };
+		size_t pos = 0;
+		do
+		{
+			size_t blockSize = std::min<size_t>(raw.size() - pos, 65535);
+			bool last = pos + blockSize == raw.size();
+			zlib.push_back(last ? 1 : 0);
+			zlib.push_back(blockSize & 0xff);
+			zlib.push_back((blockSize >> 8) & 0xff);
+			zlib.push_back(~blockSize & 0xff);
+			zlib.push_back((~blockSize >> 8) & 0xff);
+			zlib.insert(zlib.end(), raw.begin() + pos, raw.begin() + pos + blockSize);
+			pos += blockSize;
+		} while (pos < raw.size());
+
+		uint32_t a = 1, b = 0;
+		for (unsigned char c : raw)
+		{
+			a = (a + c) % 65521;
+			b = (b + a) % 65521;
+		}
+		putU32BE(zlib, (b << 16) | a);
+		writePNGChunk(file, "IDAT", zlib);
+		writePNGChunk(file, "IEND", {});
+		return bool(file);
+	}
+
+	bool FrameBuffer::writeEXR(const std::string& path) const
+	{
+		std::ofstream file(path, std::ios::binary);
+		if (!file)
+		{
+			return false;
+		}
+		std::vector<unsigned char> out;
+		putLE<uint32_t>(out, 20000630); // magic number
+		putLE<uint32_t>(out, 2); // version 2, scanline file
+
+		// Channels have to be sorted by name
+		std::vector<unsigned char> channels;
+		for (const char* name : { "B", "G", "R" })
+		{
+			channels.insert(channels.end(), name, name + 2);
+			putLE<int32_t>(channels, 2); // FLOAT
+			putLE<int32_t>(channels, 0); // pLinear and reserved
+			putLE<int32_t>(channels, 1); // x sampling
+			putLE<int32_t>(channels, 1); // y sampling
+		}
+		channels.push_back(0);
+		putEXRAttribute(out, "channels", "chlist", channels);
+		putEXRAttribute(out, "compression", "compression", { 0 });
+		std::vector<unsigned char> window;
+		putLE<int32_t>(window, 0);
+		putLE<int32_t>(window, 0);
+		putLE<int32_t>(window, int32_t(_width) - 1);
+		putLE<int32_t>(window, int32_t(_height) - 1);
+		putEXRAttribute(out, "dataWindow", "box2i", window);
+		putEXRAttribute(out, "displayWindow", "box2i", window);
+		putEXRAttribute(out, "lineOrder", "lineOrder", { 0 });
+		std::vector<unsigned char> value;
+		putLE<float>(value, 1.0f);
+		putEXRAttribute(out, "pixelAspectRatio", "float", value);
+		putEXRAttribute(out, "screenWindowWidth", "float", value);
+		value.clear();
+		putLE<float>(value, 0.0f);
+		putLE<float>(value, 0.0f);
+		putEXRAttribute(out, "screenWindowCenter", "v2f", value);
+		out.push_back(0);
+
+		// One scanline per block, top row first
+		uint64_t blockSize = 8 + uint64_t(_width) * 3 * sizeof(float);
+		uint64_t offset = out.size() + uint64_t(_height) * 8;
+		for (unsigned int y = 0; y < _height; y++)
+		{
+			putLE<uint64_t>(out, offset + y * blockSize);
+		}
+		for (unsigned int y = 0; y < _height; y++)
+		{
+			putLE<int32_t>(out, int32_t(y));
+			putLE<int32_t>(out, int32_t(_width * 3 * sizeof(float)));
+			const float* row = &_data[size_t(_height - 1 - y) * _width * 3];
+			for (int channel = 2; channel >= 0; channel--)
+			{
+				for (unsigned int x = 0; x < _width; x++)
+				{
+					putLE<float>(out, row[x * 3 + channel]);
+				}
+			}
+		}
+		file.write(reinterpret_cast<const char*>(out.data()), out.size());
+		return bool(file);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,36 @@
+#ifndef RAY_TRACING_FRAME_BUFFER_H
+#define RAY_TRACING_FRAME_BUFFER_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+namespace RayTracing
+{
+	// Contiguous RGB float image. Row 0 is the bottom row, the same as an OpenGL texture.
+	class FrameBuffer
+	{
+	public:
+		FrameBuffer(unsigned int width, unsigned int height);
+		unsigned int getWidth() const { return _width; }
+		unsigned int getHeight() const { return _height; }
+		void setPixel(unsigned int x, unsigned int y, const glm::vec3& color);
+		glm::vec3 getPixel(unsigned int x, unsigned int y) const;
+		const float* getData() const { return _data.data(); }
+		void clear(const glm::vec3& color = glm::vec3(0.0f));
+
+		// Format is chosen by extension: .ppm, .png or .exr
+		bool write(const std::string& path) const;
+		bool writePPM(const std::string& path) const;
+		bool writePNG(const std::string& path) const;
+		bool writeEXR(const std::string& path) const;
+	private:
+		std::vector<unsigned char> toBytes() const; // 8 bit RGB, top row first
+		unsigned int _width;
+		unsigned int _height;
+		std::vector<float> _data;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "Instance.h"
+
+namespace RayTracing
+{
+	Instance::Instance(std::shared_ptr<const Entity> geometry, const glm::mat4& transform) :
+		_geometry(std::move(geometry)), _inverse(glm::inverse(transform)), _ownMaterial(false)
+	{
+		// The box around the eight transformed corners
+		AABB local = _geometry->getBounds();
+		for (int i = 0; i < 8; i++)
+		{
+			glm::vec3 corner((i & 1) ? local.max.x : local.min.x, (i & 2) ? local.max.y : local.min.y, (i & 4) ? local.max.z : local.min.z);
+			_bounds.expand(glm::vec3(transform * glm::vec4(corner, 1.0f)));
+		}
+	}
+
+	glm::mat4 Instance::getTransform() const
+	{
+		return glm::inverse(_inverse);
+	}
+
+	Ray Instance::toLocal(const Ray& ray, float& scale) const
+	{
+		glm::vec3 origin = pointToLocal(ray.getVertex());
+		glm::vec3 direction = glm::vec3(_inverse * glm::vec4(ray.getDirection(), 0.0f));
+		scale = glm::length(direction);
+		return Ray(origin, direction / scale, Ray::UnitDirection(), ray.getTMin() * scale, ray.getTMax() * scale); // t scales with the direction
+	}
+
+	float Instance::rayCollision(const Ray& ray) const
+	{
+		float scale;
+		float t = _geometry->rayCollision(toLocal(ray, scale));
+		return t > 0.0f ? t / scale : t;
+	}
+
+	bool Instance::rayIntersect(const Ray& ray, HitRecord& hit) const
+	{
+		float scale;
+		Ray local = toLocal(ray, scale);
+		HitRecord localHit;
+		localHit.t = hit.t * scale;
+		if (!_geometry->rayIntersect(local, localHit))
+		{
+			return false;
+		}
+		// The geometry's primitive and uv are kept for calNormal, calUV and getMaterial
+		hit.t = localHit.t / scale;
+		hit.entity = this;
+		hit.primitive = localHit.primitive;
+		hit.uv = localHit.uv;
+		return true;
+	}
+
+	bool Instance::rayOccluded(const Ray& ray, float tMax) const
+	{
+		float scale;
+		Ray local = toLocal(ray, scale);
+		return _geometry->rayOccluded(local, tMax * scale);
+	}
+
+	glm::vec3 Instance::calNormal(const glm::vec3& p) const
+	{
+		glm::vec3 normal = _geometry->calNormal(pointToLocal(p));
+		return glm::normalize(glm::vec3(glm::transpose(_inverse) * glm::vec4(normal, 0.0f)));
+	}
+
+	glm::vec3 Instance::calNormal(const glm::vec3& p, const HitRecord& hit) const
+	{
+		glm::vec3 normal = _geometry->calNormal(pointToLocal(p), hit);
+		return glm::normalize(glm::vec3(glm::transpose(_inverse) * glm::vec4(normal, 0.0f)));
+	}
+
+	glm::vec2 Instance::calUV(const glm::vec3& p, const HitRecord& hit) const
+	{
+		return _geometry->calUV(pointToLocal(p), hit);
+	}
+
+	void Instance::calTangents(const glm::vec3& p, const HitRecord& hit, glm::vec3& dpdu, glm::vec3& dpdv) const
+	{
+		// Directions in the surface go back with the transform itself
+		_geometry->calTangents(pointToLocal(p), hit, dpdu, dpdv);
+		glm::mat4 transform = getTransform();
+		dpdu = glm::vec3(transform * glm::vec4(dpdu, 0.0f));
+		dpdv = glm::vec3(transform * glm::vec4(dpdv, 0.0f));
+	}
+
+	glm::vec3 Instance::calNormalDerivative(const glm::vec3& p, const HitRecord& hit, const glm::vec3& dp) const
+	{
+		// The change of the geometry's normal goes back like the normal itself, then through its normalization
+		glm::vec3 local = pointToLocal(p);
+		glm::vec3 dn = _geometry->calNormalDerivative(local, hit, glm::vec3(_inverse * glm::vec4(dp, 0.0f)));
+		glm::mat4 normalTransform = glm::transpose(_inverse);
+		glm::vec3 normal = glm::vec3(normalTransform * glm::vec4(_geometry->calNormal(local, hit), 0.0f));
+		float length = glm::length(normal);
+		normal /= length;
+		dn = glm::vec3(normalTransform * glm::vec4(dn, 0.0f));
+		return (dn - glm::dot(dn, normal) * normal) / length;
+	}
+
+	unsigned int Instance::getMaterial(const HitRecord& hit) const
+	{
+		return _ownMaterial ? _material : _geometry->getMaterial(hit);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef RAY_TRACING_INSTANCE_H
+#define RAY_TRACING_INSTANCE_H
+
+#include "Entity.h"
+
+#include <memory>
+
+namespace RayTracing
+{
+	// A placed copy of an entity. Any number of instances share one geometry, typically a Mesh, and
+	// each only adds its transform: rays are taken into the geometry's space to be intersected and
+	// normals are brought back. The scene BVH over the instances and the geometry's own BVH make a
+	// two level hierarchy, so the geometry is stored and built once however often it is placed.
+	// The geometry must not be added to the scene itself.
+	class Instance : public Entity
+	{
+	public:
+		// transform must be affine and invertible, non-uniform scales are fine (a scaled sphere is an ellipsoid)
+		Instance(std::shared_ptr<const Entity> geometry, const glm::mat4& transform);
+		const Entity& getGeometry() const { return *_geometry; }
+		glm::mat4 getTransform() const;
+		// The instance's own material instead of the geometry's, e.g. to color copies of a mesh differently
+		void overrideMaterial(unsigned int material) { _material = material; _ownMaterial = true; }
+
+		float rayCollision(const Ray& ray) const;
+		bool rayIntersect(const Ray& ray, HitRecord& hit) const;
+		bool rayOccluded(const Ray& ray, float tMax) const;
+		glm::vec3 calNormal(const glm::vec3& p) const;
+		glm::vec3 calNormal(const glm::vec3& p, const HitRecord& hit) const;
+		glm::vec2 calUV(const glm::vec3& p, const HitRecord& hit) const;
+		void calTangents(const glm::vec3& p, const HitRecord& hit, glm::vec3& dpdu, glm::vec3& dpdv) const;
+		glm::vec3 calNormalDerivative(const glm::vec3& p, const HitRecord& hit, const glm::vec3& dp) const;
+		bool isClosed() const { return _geometry->isClosed(); }
+		AABB getBounds() const { return _bounds; }
+		using Entity::getMaterial;
+		unsigned int getMaterial(const HitRecord& hit) const;
+	private:
+		// The ray in the geometry's space. Its direction is normalized again, so t along it is
+		// scale times t along the world ray.
+		Ray toLocal(const Ray& ray, float& scale) const;
+		glm::vec3 pointToLocal(const glm::vec3& p) const { return glm::vec3(_inverse * glm::vec4(p, 1.0f)); }
+
+		std::shared_ptr<const Entity> _geometry;
+		glm::mat4 _inverse; // world to geometry space; normals go back with its transpose
+		AABB _bounds; // of the transformed geometry bounds
+		bool _ownMaterial;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,109 @@
+#include "LightTree.h"
+
+#include <algorithm>
+
+namespace RayTracing
+{
+	void LightTree::build(const std::vector<Light*>& lights)
+	{
+		clear();
+		std::vector<BuildEntry> entries;
+		for (const Light* light : lights)
+		{
+			if (light->isBounded() && light->getPower() > 0.0f)
+			{
+				AABB bounds = light->getBounds();
+				entries.push_back({ bounds, bounds.centroid(), light->getPower(), (unsigned int)_lights.size() });
+				_lights.push_back(light);
+			}
+		}
+		if (entries.empty())
+		{
+			return;
+		}
+
+		_nodes.reserve(entries.size() * 2 - 1);
+		_nodes.push_back(Node());
+		subdivide(0, entries.data(), entries.data() + entries.size());
+	}
+
+	void LightTree::subdivide(unsigned int nodeIndex, BuildEntry* begin, BuildEntry* end)
+	{
+		AABB bounds, centroids;
+		float power = 0.0f;
+		for (BuildEntry* entry = begin; entry != end; entry++)
+		{
+			bounds.expand(entry->bounds);
+			centroids.expand(entry->centroid);
+			power += entry->power;
+		}
+		_nodes[nodeIndex].bounds = bounds;
+		_nodes[nodeIndex].power = power;
+		if (end - begin == 1)
+		{
+			_nodes[nodeIndex].first = begin->light;
+			_nodes[nodeIndex].count = 1;
+			return;
+		}
+
+		// Median split along the longest axis of the centroids, which keeps the tree balanced
+		int axis = centroids.longestAxis();
+		BuildEntry* middle = begin + (end - begin) / 2;
+		std::nth_element(begin, middle, end, [axis](const BuildEntry& a, const BuildEntry& b)
+		{
+			return a.centroid[axis] < b.centroid[axis];
+		});
+
+		unsigned int left = (unsigned int)_nodes.size();
+		_nodes[nodeIndex].first = left;
+		_nodes[nodeIndex].count = 0;
+		_nodes.push_back(Node());
+		_nodes.push_back(Node());
+		subdivide(left, begin, middle);
+		subdivide(left + 1, middle, end);
+	}
+
+	float LightTree::importance(const Node& node, const glm::vec3& p) const
+	{
+		// Power over the squared distance to the node's center, but never closer than its half diagonal:
+		// from inside or next to a node the lights in it could be anywhere around the point
+		glm::vec3 toCenter = node.bounds.centroid() - p;
+		glm::vec3 extent = node.bounds.extent();
+		float distance2 = std::max(glm::dot(toCenter, toCenter), std::max(0.25f * glm::dot(extent, extent), FLOAT_EPS));
+		return node.power / distance2;
+	}
+
+	const Light* LightTree::pick(const glm::vec3& p, float u, float& pdf) const
+	{
+		pdf = 0.0f;
+		if (_nodes.empty())
+		{
+			return nullptr;
+		}
+
+		pdf = 1.0f;
+		unsigned int index = 0;
+		while (_nodes[index].count == 0)
+		{
+			unsigned int left = _nodes[index].first;
+			float leftImportance = importance(_nodes[left], p);
+			float rightImportance = importance(_nodes[left + 1], p);
+			float total = leftImportance + rightImportance;
+			float leftProbability = total > 0.0f ? leftImportance / total : 0.5f;
+			// u is rescaled to [0, 1) within the chosen side and reused further down
+			if (u < leftProbability)
+			{
+				u = u / leftProbability;
+				pdf *= leftProbability;
+				index = left;
+			}
+			else
+			{
+				u = std::min((u - leftProbability) / (1.0f - leftProbability), 0.99999994f);
+				pdf *= 1.0f - leftProbability;
+				index = left + 1;
+			}
+		}
+		return _lights[_nodes[index].first];
+	}
+}
\ No newline at end of file
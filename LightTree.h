@@ -0,0 +1,51 @@
+#ifndef RAY_TRACING_LIGHT_TREE_H
+#define RAY_TRACING_LIGHT_TREE_H
+
+#include "AABB.h"
+#include "PhongShader.h"
+
+#include <vector>
+
+namespace RayTracing
+{
+	// Binary tree over lights with a position, for picking one light per shading point with a
+	// probability close to how much it contributes there. Every node stores the bounds and total power
+	// of its lights; picking walks down from the root, choosing a child by its power over its squared
+	// distance to the point, so it costs O(log n) however many lights there are. Every light with
+	// power keeps a nonzero probability, so weighting a picked light by 1 / pdf is unbiased.
+	class LightTree
+	{
+	public:
+		// Unbounded lights and lights without power are left out
+		void build(const std::vector<Light*>& lights);
+		void clear() { _nodes.clear(); _lights.clear(); }
+		bool empty() const { return _nodes.empty(); }
+		size_t getLightCount() const { return _lights.size(); }
+		size_t getNodeCount() const { return _nodes.size(); }
+		// Picks a light for point p with u in [0, 1), pdf is the probability it was picked with.
+		// nullptr if the tree is empty.
+		const Light* pick(const glm::vec3& p, float u, float& pdf) const;
+	private:
+		struct Node
+		{
+			AABB bounds;
+			float power;
+			unsigned int first; // light for a leaf, left child for an interior node (right child is first + 1)
+			unsigned int count; // 1 for leaves, 0 for interior nodes
+		};
+		struct BuildEntry
+		{
+			AABB bounds;
+			glm::vec3 centroid;
+			float power;
+			unsigned int light;
+		};
+		void subdivide(unsigned int nodeIndex, BuildEntry* begin, BuildEntry* end);
+		float importance(const Node& node, const glm::vec3& p) const;
+
+		std::vector<Node> _nodes;
+		std::vector<const Light*> _lights;
+	};
+}
+
+#endif
\ No newline at end of file
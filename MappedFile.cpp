@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace RayTracing
+{
+#ifdef _WIN32
+	MappedFile::MappedFile() : _data(nullptr), _size(0), _file(INVALID_HANDLE_VALUE), _mapping(nullptr)
+	{
+
+	}
+
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+		_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER size;
+		if (_file == INVALID_HANDLE_VALUE || !GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+		{
+			close();
+			return false;
+		}
+		_mapping = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (_mapping != nullptr)
+		{
+			_data = (const unsigned char*)MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+		}
+		if (_data == nullptr)
+		{
+			close();
+			return false;
+		}
+		_size = size_t(size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (_data != nullptr)
+		{
+			UnmapViewOfFile(_data);
+		}
+		if (_mapping != nullptr)
+		{
+			CloseHandle(_mapping);
+		}
+		if (_file != INVALID_HANDLE_VALUE)
+		{
+			CloseHandle(_file);
+		}
+		_data = nullptr;
+		_size = 0;
+		_file = INVALID_HANDLE_VALUE;
+		_mapping = nullptr;
+	}
+#else
+	MappedFile::MappedFile() : _data(nullptr), _size(0)
+	{
+
+	}
+
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+		struct stat info;
+		if (fstat(file, &info) == 0 && info.st_size > 0)
+		{
+			void* data = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+			if (data != MAP_FAILED)
+			{
+				_data = (const unsigned char*)data;
+				_size = size_t(info.st_size);
+			}
+		}
+		::close(file); // the mapping keeps the file alive
+		return _data != nullptr;
+	}
+
+	void MappedFile::close()
+	{
+		if (_data != nullptr)
+		{
+			munmap((void*)_data, _size);
+		}
+		_data = nullptr;
+		_size = 0;
+	}
+#endif
+
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef RAY_TRACING_MAPPED_FILE_H
+#define RAY_TRACING_MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace RayTracing
+{
+	// A whole file mapped read only into memory. Pages are read by the OS on first access,
+	// nothing is copied or parsed when the file is opened.
+	class MappedFile
+	{
+	public:
+		MappedFile();
+		~MappedFile();
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		bool open(const std::string& path); // empty files fail to map
+		void close();
+		bool isOpen() const { return _data != nullptr; }
+		const unsigned char* getData() const { return _data; }
+		size_t getSize() const { return _size; }
+	private:
+		const unsigned char* _data;
+		size_t _size;
+#ifdef _WIN32
+		void* _file;
+		void* _mapping;
+#endif
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "Material.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// Average over [x - width / 2, x + width / 2] of the square wave that is +1 on even cells and -1 on odd
+	// ones. Its integral is -2 |fract(x / 2) - 0.5| up to a constant.
+	float filterSquareWave(float x, float width)
+	{
+		if (width == 0.0f)
+		{
+			float half = std::floor(x) * 0.5f;
+			return half == std::floor(half) ? 1.0f : -1.0f;
+		}
+		auto triangle = [](float t)
+		{
+			t *= 0.5f;
+			return std::abs(t - std::floor(t) - 0.5f);
+		};
+		float average = 2.0f * (triangle(x - 0.5f * width) - triangle(x + 0.5f * width)) / width;
+		return std::max(-1.0f, std::min(average, 1.0f));
+	}
+}
+
+MaterialTable::MaterialTable()
+{
+	_materials.push_back(Material());
+}
+
+unsigned int MaterialTable::addMaterial(const Material& m)
+{
+	_materials.push_back(m);
+	return (unsigned int)_materials.size() - 1;
+}
+
+Texture MaterialTable::addChecker(const glm::vec3& color1, const glm::vec3& color2, float size)
+{
+	Texture texture;
+	texture.type = Texture::CHECKER;
+	texture.index = (unsigned int)_checkers.size();
+	_checkers.push_back({ color1, color2, 1.0f / size });
+	return texture;
+}
+
+Texture MaterialTable::addImage(unsigned int width, unsigned int height, const std::vector<glm::vec3>& texels)
+{
+	Texture texture;
+	texture.type = Texture::IMAGE;
+	texture.index = (unsigned int)_images.size();
+	_images.push_back({ width, height, _texels.size() });
+	_texels.insert(_texels.end(), texels.begin(), texels.begin() + (size_t)width * height);
+	return texture;
+}
+
+bool MaterialTable::addTiledImage(const std::string& path, Texture& texture, float size)
+{
+	// A file used by several channels or materials is opened and cached once
+	unsigned int file = 0;
+	while (file < _textureCache.getTextureCount() && _textureCache.getPath(file) != path)
+	{
+		file++;
+	}
+	if (file == _textureCache.getTextureCount() && !_textureCache.addTexture(path, file))
+	{
+		return false;
+	}
+	texture.type = Texture::TILED;
+	texture.index = (unsigned int)_tiledImages.size();
+	_tiledImages.push_back({ file, 1.0f / size });
+	return true;
+}
+
+Texture MaterialTable::addFunction(const std::function<glm::vec3(const glm::vec3& pos)>& function)
+{
+	Texture texture;
+	texture.type = Texture::FUNCTION;
+	texture.index = (unsigned int)_functions.size();
+	_functions.push_back(function);
+	return texture;
+}
+
+void MaterialTable::getChecker(unsigned int index, glm::vec3& color1, glm::vec3& color2, float& size) const
+{
+	const Checker& checker = _checkers[index];
+	color1 = checker.color1;
+	color2 = checker.color2;
+	size = 1.0f / checker.invSize;
+}
+
+const glm::vec3* MaterialTable::getImage(unsigned int index, unsigned int& width, unsigned int& height) const
+{
+	const Image& image = _images[index];
+	width = image.width;
+	height = image.height;
+	return &_texels[image.offset];
+}
+
+void MaterialTable::getTiledImage(unsigned int index, std::string& path, float& size) const
+{
+	const TiledImage& image = _tiledImages[index];
+	path = _textureCache.getPath(image.texture);
+	size = 1.0f / image.invSize;
+}
+
+glm::vec3 MaterialTable::evaluateTable(const Texture& texture, const glm::vec3& pos, const glm::vec2& uv, const TextureFootprint& footprint) const
+{
+	switch (texture.type)
+	{
+	case Texture::CHECKER:
+	{
+		const Checker& checker = _checkers[texture.index];
+		float x = pos.x * checker.invSize, z = pos.z * checker.invSize;
+		// Filter widths in cells along x and z, the box around the point that the pixel covers
+		float widthX = std::max(std::abs(footprint.dpdx.x), std::abs(footprint.dpdy.x)) * checker.invSize;
+		float widthZ = std::max(std::abs(footprint.dpdx.z), std::abs(footprint.dpdy.z)) * checker.invSize;
+		if (widthX == 0.0f && widthZ == 0.0f)
+		{
+			float sum = std::floor(x) + std::floor(z);
+			float half = sum * 0.5f; // sum is even exactly when half is whole, cheaper than fmod
+			return half == std::floor(half) ? checker.color1 : checker.color2;
+		}
+		// The pattern is the product of a square wave along x and one along z, +1 on even cells. The box
+		// filter is separable, so its result is the product of the wave's averages over the two widths,
+		// each the difference of the wave's integral (a triangle wave) at the ends of the box.
+		float ax = filterSquareWave(x, widthX), az = filterSquareWave(z, widthZ);
+		float weight = 0.5f + 0.5f * ax * az;
+		return weight * checker.color1 + (1.0f - weight) * checker.color2;
+	}
+	case Texture::IMAGE:
+		return sampleImage(_images[texture.index], uv);
+	case Texture::TILED:
+	{
+		const TiledImage& image = _tiledImages[texture.index];
+		// The longer of the two steps in uv, so the texture blurs rather than aliases where the footprint is stretched
+		float width = std::sqrt(std::max(glm::dot(footprint.duvdx, footprint.duvdx), glm::dot(footprint.duvdy, footprint.duvdy)));
+		float lod = _textureCache.getLevelOfDetail(image.texture, width * image.invSize);
+		return _textureCache.sample(image.texture, uv * image.invSize, lod);
+	}
+	case Texture::FUNCTION:
+		return _functions[texture.index](pos);
+	default:
+		return texture.color;
+	}
+}
+
+SurfaceColor MaterialTable::evaluate(unsigned int material, const glm::vec3& pos, const glm::vec2& uv, const TextureFootprint& footprint) const
+{
+	const Material& m = _materials[material];
+	SurfaceColor surface;
+	surface.ambient = evaluate(m.ambient, pos, uv, footprint);
+	// Ambient and diffuse often share a texture, which is then looked up once
+	bool shared = m.diffuse.type != Texture::CONSTANT && m.diffuse.type == m.ambient.type && m.diffuse.index == m.ambient.index;
+	surface.diffuse = shared ? surface.ambient : evaluate(m.diffuse, pos, uv, footprint);
+	surface.specular = evaluate(m.specular, pos, uv, footprint);
+	surface.shininess = m.shininess;
+	return surface;
+}
+
+bool MaterialTable::usesTexCoordFootprint(unsigned int material) const
+{
+	const Material& m = _materials[material];
+	return m.ambient.type == Texture::TILED || m.diffuse.type == Texture::TILED ||
+		m.specular.type == Texture::TILED || m.normal.type == Texture::TILED;
+}
+
+glm::vec3 MaterialTable::sampleImage(const Image& image, const glm::vec2& uv) const
+{
+	// Repeat outside [0, 1), texel centers at half integers
+	float x = (uv.x - std::floor(uv.x)) * image.width - 0.5f;
+	float y = (uv.y - std::floor(uv.y)) * image.height - 0.5f;
+	float fx = std::floor(x), fy = std::floor(y);
+	float wx = x - fx, wy = y - fy;
+	int x0 = (int)fx, y0 = (int)fy;
+	auto texel = [&](int i, int j)
+	{
+		unsigned int u = (unsigned int)((i % (int)image.width + (int)image.width) % (int)image.width);
+		unsigned int v = (unsigned int)((j % (int)image.height + (int)image.height) % (int)image.height);
+		return _texels[image.offset + (size_t)v * image.width + u];
+	};
+	return (1.0f - wy) * ((1.0f - wx) * texel(x0, y0) + wx * texel(x0 + 1, y0)) +
+		wy * ((1.0f - wx) * texel(x0, y0 + 1) + wx * texel(x0 + 1, y0 + 1));
+}
\ No newline at end of file
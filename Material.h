@@ -0,0 +1,143 @@
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "TextureCache.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// One color channel of a material. Constants are stored inline; checkers, images, tiled images and
+// functions live in the MaterialTable and are referred to by index.
+struct Texture
+{
+	enum Type : unsigned char
+	{
+		CONSTANT,
+		CHECKER,  // checkerboard in the xz plane
+		IMAGE,    // sampled with the hit's uv, bilinear and repeating
+		TILED,    // like IMAGE, from a mipmapped texture file paged in through the table's TextureCache
+		FUNCTION  // std::function of the hit position, the slow escape hatch
+	};
+
+	Texture(const glm::vec3& c = glm::vec3(1.0f)) : type(CONSTANT), index(0), color(c) {}
+
+	Type type;
+	unsigned int index;
+	glm::vec3 color;
+};
+
+struct Material
+{
+	Texture ambient;
+	Texture diffuse;
+	Texture specular;
+	// Tangent space normal map, x along the entity's tangent (Entity::calTangents) and z along the
+	// normal, stored as color = 0.5 * (normal + 1). Constants leave the normal alone.
+	Texture normal = Texture(glm::vec3(0.5f, 0.5f, 1.0f));
+	float shininess = 32.0f;
+
+	float kShade = 1.0f;
+	float kReflect = 0.0f;
+	float kRefract = 0.0f;
+	float refractiveIndex = 1.0f;
+};
+
+// The area around a hit that textures are filtered over: how the point and its texture coordinates
+// move to the next pixel in x and y, from ray differentials. All zero samples a single point.
+struct TextureFootprint
+{
+	glm::vec3 dpdx = glm::vec3(0.0f);
+	glm::vec3 dpdy = glm::vec3(0.0f);
+	glm::vec2 duvdx = glm::vec2(0.0f);
+	glm::vec2 duvdy = glm::vec2(0.0f);
+};
+
+// A material evaluated at one hit point, what the lights work with
+struct SurfaceColor
+{
+	glm::vec3 ambient;
+	glm::vec3 diffuse;
+	glm::vec3 specular;
+	float shininess;
+};
+
+// All materials of a scene in one array, entities keep an index into it.
+// Evaluation is a switch over the texture type, no per-channel indirect calls
+// unless a FUNCTION texture is used.
+class MaterialTable
+{
+public:
+	MaterialTable(); // material 0 is plain white
+
+	unsigned int addMaterial(const Material& m);
+	Material& getMaterial(unsigned int index) { return _materials[index]; }
+	const Material& getMaterial(unsigned int index) const { return _materials[index]; }
+	size_t getMaterialCount() const { return _materials.size(); }
+
+	// Texture factories, the returned texture can be assigned to any channel
+	Texture addChecker(const glm::vec3& color1, const glm::vec3& color2, float size = 1.0f);
+	Texture addImage(unsigned int width, unsigned int height, const std::vector<glm::vec3>& texels); // row 0 at v = 0
+	// A tiled texture file (see writeTiledTexture) repeating every size units of uv. Only its header is
+	// read here. Prints why and returns false if the file can't be opened.
+	bool addTiledImage(const std::string& path, Texture& texture, float size = 1.0f);
+	Texture addFunction(const std::function<glm::vec3(const glm::vec3& pos)>& function);
+	// Read back what the factories were given, for saving the table
+	size_t getCheckerCount() const { return _checkers.size(); }
+	void getChecker(unsigned int index, glm::vec3& color1, glm::vec3& color2, float& size) const;
+	size_t getImageCount() const { return _images.size(); }
+	const glm::vec3* getImage(unsigned int index, unsigned int& width, unsigned int& height) const;
+	size_t getTiledImageCount() const { return _tiledImages.size(); }
+	void getTiledImage(unsigned int index, std::string& path, float& size) const;
+	size_t getFunctionCount() const { return _functions.size(); }
+	// Holds the tiles of the tiled images, its budget bounds their memory
+	RayTracing::TextureCache& getTextureCache() { return _textureCache; }
+	const RayTracing::TextureCache& getTextureCache() const { return _textureCache; }
+
+	// The footprint picks the mip level of tiled images from its uv part and box filters checkers with
+	// its position part. Images and functions are sampled at pos and uv only.
+	glm::vec3 evaluate(const Texture& texture, const glm::vec3& pos, const glm::vec2& uv,
+		const TextureFootprint& footprint = TextureFootprint()) const
+	{
+		return texture.type == Texture::CONSTANT ? texture.color : evaluateTable(texture, pos, uv, footprint);
+	}
+	SurfaceColor evaluate(unsigned int material, const glm::vec3& pos, const glm::vec2& uv,
+		const TextureFootprint& footprint = TextureFootprint()) const;
+	// True if a channel of the material is a tiled image, whose filtering needs the uv part of the footprint
+	bool usesTexCoordFootprint(unsigned int material) const;
+private:
+	struct Checker
+	{
+		glm::vec3 color1; // where floor(x / size) + floor(z / size) is even
+		glm::vec3 color2;
+		float invSize;
+	};
+	struct Image
+	{
+		unsigned int width;
+		unsigned int height;
+		size_t offset; // first texel in _texels
+	};
+	struct TiledImage
+	{
+		unsigned int texture; // in _textureCache
+		float invSize;
+	};
+
+	glm::vec3 evaluateTable(const Texture& texture, const glm::vec3& pos, const glm::vec2& uv, const TextureFootprint& footprint) const;
+	glm::vec3 sampleImage(const Image& image, const glm::vec2& uv) const;
+
+	std::vector<Material> _materials;
+	std::vector<Checker> _checkers;
+	std::vector<Image> _images;
+	std::vector<glm::vec3> _texels; // of all images
+	std::vector<TiledImage> _tiledImages;
+	RayTracing::TextureCache _textureCache;
+	std::vector<std::function<glm::vec3(const glm::vec3& pos)>> _functions;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,325 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace RayTracing
+{
+	namespace
+	{
+		// Indices of attributes that only some triangles have are padded with NO_INDEX
+		void appendIndices(std::vector<unsigned int>& indices, const unsigned int* index, size_t triangle)
+		{
+			if (index == nullptr && indices.empty())
+			{
+				return;
+			}
+			indices.resize(triangle * 3, Mesh::NO_INDEX);
+			for (int i = 0; i < 3; i++)
+			{
+				indices.push_back(index == nullptr ? Mesh::NO_INDEX : index[i]);
+			}
+		}
+	}
+
+	const unsigned int Mesh::NO_INDEX = 0xffffffffu;
+
+	void Mesh::reserve(size_t vertexCount, size_t triangleCount)
+	{
+		_positions.reserve(vertexCount);
+		_positionIndices.reserve(triangleCount * 3);
+	}
+
+	unsigned int Mesh::addPosition(const glm::vec3& p)
+	{
+		_positions.push_back(p);
+		return (unsigned int)_positions.size() - 1;
+	}
+
+	unsigned int Mesh::addNormal(const glm::vec3& n)
+	{
+		_normals.push_back(n);
+		return (unsigned int)_normals.size() - 1;
+	}
+
+	unsigned int Mesh::addUV(const glm::vec2& uv)
+	{
+		_uvs.push_back(uv);
+		return (unsigned int)_uvs.size() - 1;
+	}
+
+	void Mesh::addTriangle(const unsigned int position[3], const unsigned int* normal, const unsigned int* uv)
+	{
+		size_t triangle = getTriangleCount();
+		_positionIndices.insert(_positionIndices.end(), position, position + 3);
+		appendIndices(_normalIndices, normal, triangle);
+		appendIndices(_uvIndices, uv, triangle);
+	}
+
+	void Mesh::beginSubmesh(const std::string& name)
+	{
+		unsigned int first = (unsigned int)getTriangleCount();
+		if (!_submeshes.empty() && _submeshes.back().firstTriangle == first)
+		{
+			_submeshes.pop_back(); // the previous one stayed empty
+		}
+		_submeshes.push_back({ first, name, -1 });
+	}
+
+	void Mesh::setSubmeshMaterial(unsigned int submesh, unsigned int material)
+	{
+		_submeshes[submesh].material = (int)material;
+	}
+
+	void Mesh::build()
+	{
+		size_t triangleCount = getTriangleCount();
+		if (!_normalIndices.empty())
+		{
+			_normalIndices.resize(triangleCount * 3, NO_INDEX);
+		}
+		if (!_uvIndices.empty())
+		{
+			_uvIndices.resize(triangleCount * 3, NO_INDEX);
+		}
+
+		std::vector<AABB> bounds(triangleCount);
+		for (unsigned int i = 0; i < triangleCount; i++)
+		{
+			bounds[i].expand(vertex(i, 0));
+			bounds[i].expand(vertex(i, 1));
+			bounds[i].expand(vertex(i, 2));
+		}
+		_bvh.build(bounds);
+	}
+
+	Mesh::Data Mesh::getData() const
+	{
+		Data data;
+		data.positions = _positions.data();
+		data.positionCount = _positions.size();
+		data.normals = _normals.data();
+		data.normalCount = _normals.size();
+		data.uvs = _uvs.data();
+		data.uvCount = _uvs.size();
+		data.positionIndices = _positionIndices.data();
+		data.normalIndices = _normalIndices.empty() ? nullptr : _normalIndices.data();
+		data.uvIndices = _uvIndices.empty() ? nullptr : _uvIndices.data();
+		data.triangleCount = getTriangleCount();
+		data.nodes = _bvh.getNodes().data();
+		data.nodeCount = _bvh.getNodes().size();
+		data.primitives = _bvh.getPrimitives().data();
+		data.submeshes = _submeshes.data();
+		data.submeshCount = _submeshes.size();
+		return data;
+	}
+
+	void Mesh::assign(const Data& data)
+	{
+		size_t indexCount = data.triangleCount * 3;
+		_positions.assign(data.positions, data.positions + data.positionCount);
+		_normals.assign(data.normals, data.normals + data.normalCount);
+		_uvs.assign(data.uvs, data.uvs + data.uvCount);
+		_positionIndices.assign(data.positionIndices, data.positionIndices + indexCount);
+		_normalIndices.clear();
+		if (data.normalIndices != nullptr)
+		{
+			_normalIndices.assign(data.normalIndices, data.normalIndices + indexCount);
+		}
+		_uvIndices.clear();
+		if (data.uvIndices != nullptr)
+		{
+			_uvIndices.assign(data.uvIndices, data.uvIndices + indexCount);
+		}
+		_submeshes.assign(data.submeshes, data.submeshes + data.submeshCount);
+		_bvh.assign(data.nodes, data.nodeCount, data.primitives, data.triangleCount);
+	}
+
+	size_t Mesh::getMemoryUsage() const
+	{
+		return sizeof(Mesh) +
+			_positions.capacity() * sizeof(glm::vec3) +
+			_normals.capacity() * sizeof(glm::vec3) +
+			_uvs.capacity() * sizeof(glm::vec2) +
+			(_positionIndices.capacity() + _normalIndices.capacity() + _uvIndices.capacity()) * sizeof(unsigned int) +
+			_submeshes.capacity() * sizeof(Submesh) +
+			_bvh.getMemoryUsage();
+	}
+
+	float Mesh::rayCollision(const Ray& ray) const
+	{
+		HitRecord hit;
+		return rayIntersect(ray, hit) ? hit.t : -1;
+	}
+
+	bool Mesh::rayIntersect(const Ray& ray, HitRecord& hit) const
+	{
+		unsigned int hitTriangle = NO_INDEX;
+		glm::vec2 hitUV;
+		float minT = _bvh.traverse(ray, hit.t, [&](unsigned int triangle, float tMax)
+		{
+			glm::vec3 A = vertex(triangle, 0);
+			float t, u, v;
+			if (Triangle::intersect(ray, A, vertex(triangle, 1) - A, vertex(triangle, 2) - A, t, u, v) &&
+				t > ray.getTMin() && t < tMax)
+			{
+				hitTriangle = triangle;
+				hitUV = glm::vec2(u, v);
+				return t;
+			}
+			return tMax;
+		});
+		if (hitTriangle == NO_INDEX)
+		{
+			return false;
+		}
+		hit.t = minT;
+		hit.entity = this;
+		hit.primitive = hitTriangle;
+		hit.uv = hitUV;
+		return true;
+	}
+
+	bool Mesh::rayOccluded(const Ray& ray, float tMax) const
+	{
+		return _bvh.traverseAny(ray, tMax, [&](unsigned int triangle, float tMax)
+		{
+			glm::vec3 A = vertex(triangle, 0);
+			float t, u, v;
+			return Triangle::intersect(ray, A, vertex(triangle, 1) - A, vertex(triangle, 2) - A, t, u, v) &&
+				t > ray.getTMin() && t < tMax;
+		});
+	}
+
+	glm::vec3 Mesh::geometricNormal(unsigned int triangle) const
+	{
+		glm::vec3 A = vertex(triangle, 0);
+		return glm::normalize(glm::cross(vertex(triangle, 1) - A, vertex(triangle, 2) - A));
+	}
+
+	glm::vec3 Mesh::calNormal(const glm::vec3& p) const
+	{
+		// p alone doesn't say which triangle was hit; only the overload with the hit record is right
+		if (_positionIndices.empty())
+		{
+			return glm::vec3(0.0f, 1.0f, 0.0f);
+		}
+		return geometricNormal(0);
+	}
+
+	glm::vec3 Mesh::calNormal(const glm::vec3& p, const HitRecord& hit) const
+	{
+		const unsigned int* indices = normalIndices(hit.primitive);
+		if (indices == nullptr)
+		{
+			return geometricNormal(hit.primitive);
+		}
+
+		// Smooth shading normal
+		float u = hit.uv.x, v = hit.uv.y;
+		return glm::normalize((1.0f - u - v) * _normals[indices[0]] + u * _normals[indices[1]] + v * _normals[indices[2]]);
+	}
+
+	glm::vec3 Mesh::calNormalDerivative(const glm::vec3& p, const HitRecord& hit, const glm::vec3& dp) const
+	{
+		const unsigned int* indices = normalIndices(hit.primitive);
+		if (indices == nullptr)
+		{
+			return glm::vec3(0.0f);
+		}
+		// Barycentric change of dp (dp = du * edge1 + dv * edge2 in the least squares sense),
+		// then the change of the interpolated normal projected off the normal
+		glm::vec3 A = vertex(hit.primitive, 0);
+		glm::vec3 edge1 = vertex(hit.primitive, 1) - A, edge2 = vertex(hit.primitive, 2) - A;
+		float a = glm::dot(edge1, edge1), b = glm::dot(edge1, edge2), c = glm::dot(edge2, edge2);
+		float det = a * c - b * b;
+		if (std::abs(det) < FLOAT_EPS * FLOAT_EPS)
+		{
+			return glm::vec3(0.0f);
+		}
+		float d1 = glm::dot(dp, edge1), d2 = glm::dot(dp, edge2);
+		float du = (c * d1 - b * d2) / det, dv = (a * d2 - b * d1) / det;
+		const glm::vec3& n0 = _normals[indices[0]];
+		float u = hit.uv.x, v = hit.uv.y;
+		glm::vec3 normal = (1.0f - u - v) * n0 + u * _normals[indices[1]] + v * _normals[indices[2]];
+		float length = glm::length(normal);
+		normal /= length;
+		glm::vec3 dn = du * (_normals[indices[1]] - n0) + dv * (_normals[indices[2]] - n0);
+		return (dn - glm::dot(dn, normal) * normal) / length;
+	}
+
+	const unsigned int* Mesh::normalIndices(unsigned int triangle) const
+	{
+		if (!_normalIndices.empty() && _normalIndices[triangle * 3] != NO_INDEX)
+		{
+			return &_normalIndices[triangle * 3];
+		}
+		if (_normalIndices.empty() && !_normals.empty() && _normals.size() == _positions.size())
+		{
+			return &_positionIndices[triangle * 3]; // PLY vertex normals, one per position
+		}
+		return nullptr;
+	}
+
+	const unsigned int* Mesh::uvIndices(unsigned int triangle) const
+	{
+		if (!_uvIndices.empty() && _uvIndices[triangle * 3] != NO_INDEX)
+		{
+			return &_uvIndices[triangle * 3];
+		}
+		if (!_uvs.empty() && _uvs.size() == _positions.size())
+		{
+			return &_positionIndices[triangle * 3];
+		}
+		return nullptr;
+	}
+
+	glm::vec2 Mesh::calUV(const glm::vec3& p, const HitRecord& hit) const
+	{
+		const unsigned int* indices = uvIndices(hit.primitive);
+		if (indices == nullptr)
+		{
+			return hit.uv;
+		}
+		float u = hit.uv.x, v = hit.uv.y;
+		return (1.0f - u - v) * _uvs[indices[0]] + u * _uvs[indices[1]] + v * _uvs[indices[2]];
+	}
+
+	void Mesh::calTangents(const glm::vec3& p, const HitRecord& hit, glm::vec3& dpdu, glm::vec3& dpdv) const
+	{
+		const unsigned int* indices = uvIndices(hit.primitive);
+		glm::vec3 A = vertex(hit.primitive, 0);
+		glm::vec3 edge1 = vertex(hit.primitive, 1) - A, edge2 = vertex(hit.primitive, 2) - A;
+		glm::vec2 uv1, uv2;
+		float det = 0.0f;
+		if (indices != nullptr)
+		{
+			uv1 = _uvs[indices[1]] - _uvs[indices[0]];
+			uv2 = _uvs[indices[2]] - _uvs[indices[0]];
+			det = uv1.x * uv2.y - uv2.x * uv1.y;
+		}
+		if (std::abs(det) < FLOAT_EPS * FLOAT_EPS) // no or degenerate texture coordinates
+		{
+			Entity::calTangents(p, hit, dpdu, dpdv);
+			return;
+		}
+		// Solve edge = duv.x * dP/du + duv.y * dP/dv for both edges
+		dpdu = (uv2.y * edge1 - uv1.y * edge2) / det;
+		dpdv = (uv1.x * edge2 - uv2.x * edge1) / det;
+	}
+
+	unsigned int Mesh::getMaterial(const HitRecord& hit) const
+	{
+		if (_submeshes.empty())
+		{
+			return _material;
+		}
+		auto next = std::upper_bound(_submeshes.begin(), _submeshes.end(), hit.primitive,
+			[](unsigned int triangle, const Submesh& submesh) { return triangle < submesh.firstTriangle; });
+		if (next == _submeshes.begin() || (next - 1)->material < 0)
+		{
+			return _material;
+		}
+		return (unsigned int)(next - 1)->material;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef RAY_TRACING_MESH_H
+#define RAY_TRACING_MESH_H
+
+#include "BVH.h"
+#include "Entity.h"
+
+#include <string>
+#include <vector>
+
+namespace RayTracing
+{
+	// Indexed triangle mesh. All triangles share one vertex buffer and one index buffer
+	// and are found through the mesh's own BVH, so a mesh is a single entity in the scene.
+	class Mesh : public Entity
+	{
+	public:
+		struct Submesh
+		{
+			unsigned int firstTriangle;
+			std::string name;
+			int material; // index into the scene's MaterialTable, -1 uses the mesh material
+		};
+		// Views of the buffers of a built mesh, BVH included. Index arrays other than
+		// positionIndices are either nullptr or 3 per triangle.
+		struct Data
+		{
+			const glm::vec3* positions;
+			size_t positionCount;
+			const glm::vec3* normals;
+			size_t normalCount;
+			const glm::vec2* uvs;
+			size_t uvCount;
+			const unsigned int* positionIndices;
+			const unsigned int* normalIndices;
+			const unsigned int* uvIndices;
+			size_t triangleCount;
+			const BVH::Node* nodes;
+			size_t nodeCount;
+			const unsigned int* primitives; // triangleCount of them
+			const Submesh* submeshes;
+			size_t submeshCount;
+		};
+
+		void reserve(size_t vertexCount, size_t triangleCount);
+		unsigned int addPosition(const glm::vec3& p);
+		unsigned int addNormal(const glm::vec3& n);
+		unsigned int addUV(const glm::vec2& uv);
+		// normal and uv may be nullptr. Without normal indices a triangle uses its position indices
+		// if there is one normal per position, and its geometric normal otherwise.
+		void addTriangle(const unsigned int position[3], const unsigned int* normal = nullptr, const unsigned int* uv = nullptr);
+		// Triangles added from now on belong to a new submesh
+		void beginSubmesh(const std::string& name);
+		void setSubmeshMaterial(unsigned int submesh, unsigned int material);
+		// Builds the BVH, call once all triangles are added
+		void build();
+		// Bulk copy of the whole mesh, for saving and loading a built mesh without rebuilding it
+		Data getData() const;
+		void assign(const Data& data);
+
+		size_t getVertexCount() const { return _positions.size(); }
+		size_t getTriangleCount() const { return _positionIndices.size() / 3; }
+		const std::vector<Submesh>& getSubmeshes() const { return _submeshes; }
+		glm::vec3 getVertex(unsigned int triangle, int corner) const { return vertex(triangle, corner); }
+		const std::vector<glm::vec3>& getPositions() const { return _positions; }
+		unsigned int getPositionIndex(unsigned int triangle, int corner) const { return _positionIndices[triangle * 3 + corner]; }
+		size_t getMemoryUsage() const; // bytes held by the buffers and the BVH
+
+		float rayCollision(const Ray& ray) const;
+		bool rayIntersect(const Ray& ray, HitRecord& hit) const;
+		bool rayOccluded(const Ray& ray, float tMax) const;
+		glm::vec3 calNormal(const glm::vec3& p) const; // wrong for meshes: callers must pass the hit, this returns the first triangle's normal
+		glm::vec3 calNormal(const glm::vec3& p, const HitRecord& hit) const;
+		glm::vec2 calUV(const glm::vec3& p, const HitRecord& hit) const; // interpolated texture coordinates
+		void calTangents(const glm::vec3& p, const HitRecord& hit, glm::vec3& dpdu, glm::vec3& dpdv) const; // of the triangle
+		glm::vec3 calNormalDerivative(const glm::vec3& p, const HitRecord& hit, const glm::vec3& dp) const; // of the smooth normal
+		AABB getBounds() const { return _bvh.getBounds(); }
+		using Entity::getMaterial;
+		unsigned int getMaterial(const HitRecord& hit) const;
+
+		static const unsigned int NO_INDEX;
+	private:
+		glm::vec3 geometricNormal(unsigned int triangle) const;
+		const unsigned int* uvIndices(unsigned int triangle) const; // nullptr if the triangle has no texture coordinates
+		const unsigned int* normalIndices(unsigned int triangle) const; // nullptr if the triangle has no vertex normals
+		glm::vec3 vertex(unsigned int triangle, int corner) const { return _positions[_positionIndices[triangle * 3 + corner]]; }
+
+		std::vector<glm::vec3> _positions;
+		std::vector<glm::vec3> _normals;
+		std::vector<glm::vec2> _uvs;
+		std::vector<unsigned int> _positionIndices; // 3 per triangle
+		std::vector<unsigned int> _normalIndices; // empty or 3 per triangle
+		std::vector<unsigned int> _uvIndices; // empty or 3 per triangle
+		std::vector<Submesh> _submeshes;
+		BVH _bvh;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,399 @@
+#include "MeshLoader.h"
+#include "FileReader.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+namespace RayTracing
+{
+	namespace
+	{
+		// OBJ indices start at 1, negative ones count back from the last element
+		bool resolveIndex(long index, size_t count, unsigned int& result)
+		{
+			long resolved = index > 0 ? index - 1 : long(count) + index;
+			result = (unsigned int)resolved;
+			return index != 0 && resolved >= 0 && size_t(resolved) < count;
+		}
+
+		struct FaceVertex
+		{
+			unsigned int position = 0;
+			unsigned int uv = 0;
+			unsigned int normal = 0;
+			bool hasUV = false;
+			bool hasNormal = false;
+		};
+
+		// Parses "v", "v/t", "v//n" or "v/t/n". Returns false at the end of the line or on a bad index.
+		bool parseFaceVertex(const char*& p, const Mesh& mesh, size_t uvCount, size_t normalCount, FaceVertex& vertex, bool& error)
+		{
+			skipSpaces(p);
+			if (!isDigit(*p) && *p != '-')
+			{
+				return false;
+			}
+			error = !resolveIndex(parseInt(p), mesh.getVertexCount(), vertex.position);
+			vertex.hasUV = false;
+			vertex.hasNormal = false;
+			if (*p == '/')
+			{
+				p++;
+				if (*p != '/')
+				{
+					vertex.hasUV = true;
+					error = error || !resolveIndex(parseInt(p), uvCount, vertex.uv);
+				}
+				if (*p == '/')
+				{
+					p++;
+					vertex.hasNormal = true;
+					error = error || !resolveIndex(parseInt(p), normalCount, vertex.normal);
+				}
+			}
+			return !error;
+		}
+
+		enum PLYType { PLY_INT8, PLY_UINT8, PLY_INT16, PLY_UINT16, PLY_INT32, PLY_UINT32, PLY_FLOAT32, PLY_FLOAT64, PLY_INVALID };
+
+		PLYType parsePLYType(const std::string& name)
+		{
+			if (name == "char" || name == "int8") return PLY_INT8;
+			if (name == "uchar" || name == "uint8") return PLY_UINT8;
+			if (name == "short" || name == "int16") return PLY_INT16;
+			if (name == "ushort" || name == "uint16") return PLY_UINT16;
+			if (name == "int" || name == "int32") return PLY_INT32;
+			if (name == "uint" || name == "uint32") return PLY_UINT32;
+			if (name == "float" || name == "float32") return PLY_FLOAT32;
+			if (name == "double" || name == "float64") return PLY_FLOAT64;
+			return PLY_INVALID;
+		}
+
+		struct PLYProperty
+		{
+			std::string name;
+			PLYType type;
+			PLYType countType; // PLY_INVALID unless this is a list
+		};
+
+		struct PLYElement
+		{
+			std::string name;
+			size_t count;
+			std::vector<PLYProperty> properties;
+		};
+
+		bool readPLYValue(FileReader& reader, PLYType type, bool bigEndian, double& value)
+		{
+			static const size_t sizes[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+			unsigned char bytes[8];
+			size_t size = sizes[type];
+			if (!reader.read(bytes, size))
+			{
+				return false;
+			}
+			if (bigEndian)
+			{
+				std::reverse(bytes, bytes + size);
+			}
+			switch (type)
+			{
+			case PLY_INT8: { int8_t v; std::memcpy(&v, bytes, size); value = v; break; }
+			case PLY_UINT8: { uint8_t v; std::memcpy(&v, bytes, size); value = v; break; }
+			case PLY_INT16: { int16_t v; std::memcpy(&v, bytes, size); value = v; break; }
+			case PLY_UINT16: { uint16_t v; std::memcpy(&v, bytes, size); value = v; break; }
+			case PLY_INT32: { int32_t v; std::memcpy(&v, bytes, size); value = v; break; }
+			case PLY_UINT32: { uint32_t v; std::memcpy(&v, bytes, size); value = v; break; }
+			case PLY_FLOAT32: { float v; std::memcpy(&v, bytes, size); value = v; break; }
+			default: { double v; std::memcpy(&v, bytes, size); value = v; break; }
+			}
+			return true;
+		}
+
+		bool fail(const std::string& path, const std::string& reason)
+		{
+			std::cout << "Failed to load " << path << ": " << reason << std::endl;
+			return false;
+		}
+	}
+
+	bool loadOBJ(const std::string& path, Mesh& mesh)
+	{
+		FileReader reader(path);
+		if (!reader.isOpen())
+		{
+			return fail(path, "cannot open file");
+		}
+
+		size_t uvCount = 0, normalCount = 0;
+		size_t lineNumber = 0;
+		const char* line;
+		const char* end;
+		while (reader.readLine(line, end))
+		{
+			lineNumber++;
+			const char* p = line;
+			skipSpaces(p);
+			if (startsWith(p, end, "v"))
+			{
+				p++;
+				float x = parseFloat(p);
+				float y = parseFloat(p);
+				float z = parseFloat(p);
+				mesh.addPosition(glm::vec3(x, y, z));
+			}
+			else if (startsWith(p, end, "vn"))
+			{
+				p += 2;
+				float x = parseFloat(p);
+				float y = parseFloat(p);
+				float z = parseFloat(p);
+				mesh.addNormal(glm::vec3(x, y, z));
+				normalCount++;
+			}
+			else if (startsWith(p, end, "vt"))
+			{
+				p += 2;
+				float u = parseFloat(p);
+				float v = parseFloat(p);
+				mesh.addUV(glm::vec2(u, v));
+				uvCount++;
+			}
+			else if (startsWith(p, end, "f"))
+			{
+				// Polygons are split into a triangle fan around the first vertex
+				p++;
+				FaceVertex first, previous, current;
+				bool error = false;
+				int count = 0;
+				while (parseFaceVertex(p, mesh, uvCount, normalCount, current, error))
+				{
+					if (count == 0)
+					{
+						first = current;
+					}
+					else if (count >= 2)
+					{
+						unsigned int positions[3] = { first.position, previous.position, current.position };
+						unsigned int normals[3] = { first.normal, previous.normal, current.normal };
+						unsigned int uvs[3] = { first.uv, previous.uv, current.uv };
+						bool hasNormals = first.hasNormal && previous.hasNormal && current.hasNormal;
+						bool hasUVs = first.hasUV && previous.hasUV && current.hasUV;
+						mesh.addTriangle(positions, hasNormals ? normals : nullptr, hasUVs ? uvs : nullptr);
+					}
+					previous = current;
+					count++;
+				}
+				if (error)
+				{
+					return fail(path, "bad index on line " + std::to_string(lineNumber));
+				}
+			}
+			else if (startsWith(p, end, "usemtl"))
+			{
+				p += 6;
+				skipSpaces(p);
+				mesh.beginSubmesh(std::string(p, end));
+			}
+		}
+
+		return true;
+	}
+
+	bool loadPLY(const std::string& path, Mesh& mesh)
+	{
+		FileReader reader(path);
+		if (!reader.isOpen())
+		{
+			return fail(path, "cannot open file");
+		}
+
+		// Header
+		const char* line;
+		const char* end;
+		if (!reader.readLine(line, end) || std::string(line, end) != "ply")
+		{
+			return fail(path, "not a PLY file");
+		}
+		bool bigEndian = false;
+		std::vector<PLYElement> elements;
+		while (true)
+		{
+			if (!reader.readLine(line, end))
+			{
+				return fail(path, "unexpected end of header");
+			}
+			std::istringstream words(std::string(line, end));
+			std::string keyword;
+			words >> keyword;
+			if (keyword == "end_header")
+			{
+				break;
+			}
+			if (keyword == "format")
+			{
+				std::string format;
+				words >> format;
+				if (format != "binary_little_endian" && format != "binary_big_endian")
+				{
+					return fail(path, "only binary PLY files are supported");
+				}
+				bigEndian = format == "binary_big_endian";
+			}
+			else if (keyword == "element")
+			{
+				PLYElement element;
+				words >> element.name >> element.count;
+				elements.push_back(element);
+			}
+			else if (keyword == "property" && !elements.empty())
+			{
+				PLYProperty property;
+				std::string type;
+				words >> type;
+				property.countType = PLY_INVALID;
+				if (type == "list")
+				{
+					std::string countType;
+					words >> countType >> type;
+					property.countType = parsePLYType(countType);
+					if (property.countType == PLY_INVALID)
+					{
+						return fail(path, "unknown type " + countType);
+					}
+				}
+				property.type = parsePLYType(type);
+				if (property.type == PLY_INVALID)
+				{
+					return fail(path, "unknown type " + type);
+				}
+				words >> property.name;
+				elements.back().properties.push_back(property);
+			}
+		}
+
+		// Body, elements come in header order
+		for (const auto& element : elements)
+		{
+			if (element.name == "vertex")
+			{
+				// Slot of every property: 0-2 position, 3-5 normal, 6-7 uv, -1 ignored
+				std::vector<int> slots;
+				bool hasNormal = false, hasUV = false;
+				for (const auto& property : element.properties)
+				{
+					const std::string& name = property.name;
+					int slot = -1;
+					if (name == "x") slot = 0;
+					else if (name == "y") slot = 1;
+					else if (name == "z") slot = 2;
+					else if (name == "nx") slot = 3;
+					else if (name == "ny") slot = 4;
+					else if (name == "nz") slot = 5;
+					else if (name == "u" || name == "s" || name == "texture_u" || name == "texture_s") slot = 6;
+					else if (name == "v" || name == "t" || name == "texture_v" || name == "texture_t") slot = 7;
+					hasNormal = hasNormal || slot == 3;
+					hasUV = hasUV || slot == 6;
+					slots.push_back(property.countType == PLY_INVALID ? slot : -1);
+				}
+
+				mesh.reserve(element.count, element.count * 2);
+				for (size_t i = 0; i < element.count; i++)
+				{
+					double values[8] = { 0 };
+					for (size_t j = 0; j < element.properties.size(); j++)
+					{
+						const PLYProperty& property = element.properties[j];
+						double value, count = 1;
+						if (property.countType != PLY_INVALID && !readPLYValue(reader, property.countType, bigEndian, count))
+						{
+							return fail(path, "unexpected end of file");
+						}
+						for (size_t k = 0; k < size_t(count); k++)
+						{
+							if (!readPLYValue(reader, property.type, bigEndian, value))
+							{
+								return fail(path, "unexpected end of file");
+							}
+							if (slots[j] >= 0)
+							{
+								values[slots[j]] = value;
+							}
+						}
+					}
+					mesh.addPosition(glm::vec3(values[0], values[1], values[2]));
+					if (hasNormal)
+					{
+						mesh.addNormal(glm::vec3(values[3], values[4], values[5]));
+					}
+					if (hasUV)
+					{
+						mesh.addUV(glm::vec2(values[6], values[7]));
+					}
+				}
+			}
+			else
+			{
+				bool isFace = element.name == "face";
+				for (size_t i = 0; i < element.count; i++)
+				{
+					for (const auto& property : element.properties)
+					{
+						bool isIndices = isFace && (property.name == "vertex_indices" || property.name == "vertex_index");
+						double value, count = 1;
+						if (property.countType != PLY_INVALID && !readPLYValue(reader, property.countType, bigEndian, count))
+						{
+							return fail(path, "unexpected end of file");
+						}
+
+						// Polygons are split into a triangle fan around the first vertex
+						unsigned int indices[3];
+						for (size_t k = 0; k < size_t(count); k++)
+						{
+							if (!readPLYValue(reader, property.type, bigEndian, value))
+							{
+								return fail(path, "unexpected end of file");
+							}
+							if (!isIndices)
+							{
+								continue;
+							}
+							if (value < 0 || value >= mesh.getVertexCount())
+							{
+								return fail(path, "bad vertex index in face " + std::to_string(i));
+							}
+							indices[std::min<size_t>(k, 2)] = (unsigned int)value;
+							if (k >= 2)
+							{
+								mesh.addTriangle(indices);
+								indices[1] = indices[2];
+							}
+						}
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	bool loadMesh(const std::string& path, Mesh& mesh)
+	{
+		std::string extension = path.substr(path.find_last_of('.') + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == "obj")
+		{
+			return loadOBJ(path, mesh);
+		}
+		if (extension == "ply")
+		{
+			return loadPLY(path, mesh);
+		}
+		return fail(path, "unknown mesh format");
+	}
+}
\ No newline at end of file
@@ -0,0 +1,18 @@
+#ifndef RAY_TRACING_MESH_LOADER_H
+#define RAY_TRACING_MESH_LOADER_H
+
+#include "Mesh.h"
+
+#include <string>
+
+namespace RayTracing
+{
+	// Streaming loaders: the file is read in large blocks and parsed in place, geometry goes
+	// straight into the mesh buffers. Call mesh.build() afterwards.
+	// On failure the reason is printed and false is returned.
+	bool loadOBJ(const std::string& path, Mesh& mesh);
+	bool loadPLY(const std::string& path, Mesh& mesh); // binary little or big endian
+	bool loadMesh(const std::string& path, Mesh& mesh); // chosen by extension
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,76 @@
+// Compiled for AVX2 regardless of the project's target, only called after a CPU check.
+// Nothing but intrinsics and PacketKernel.h may be included below the target switch.
+// Contraction into FMA is off so the results match the scalar code bit for bit.
+#include "RayPacket.h"
+
+#ifdef RAY_TRACING_PACKET_X86
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#pragma GCC target("avx2")
+#endif
+
+#include <immintrin.h>
+
+#include "PacketKernel.h"
+
+namespace RayTracing
+{
+	namespace
+	{
+		struct SimdAVX2
+		{
+			static const unsigned int WIDTH = 8;
+			typedef __m256 Float;
+			typedef __m256i Int;
+			typedef __m256 Mask;
+
+			static Float load(const float* p) { return _mm256_loadu_ps(p); }
+			static void store(float* p, Float a) { _mm256_storeu_ps(p, a); }
+			static Float set(float a) { return _mm256_set1_ps(a); }
+			static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+			static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+			static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+			static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+			static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+			static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+			static Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+			static Float abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+			static Mask lt(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+			static Mask le(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+			static Mask ge(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+			static Mask andMask(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+			static Mask orMask(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+			static Mask andNotMask(Mask a, Mask b) { return _mm256_andnot_ps(b, a); }
+			static bool any(Mask m) { return _mm256_movemask_ps(m) != 0; }
+			static Mask lowLanes(unsigned int n)
+			{
+				return _mm256_castsi256_ps(_mm256_cmpgt_epi32(_mm256_set1_epi32((int)n), _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0)));
+			}
+
+			static Float select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+			static Int selectInt(Mask m, Int a, Int b)
+			{
+				return _mm256_castps_si256(_mm256_blendv_ps(_mm256_castsi256_ps(b), _mm256_castsi256_ps(a), m));
+			}
+			static Int loadInt(const int* p) { return _mm256_loadu_si256((const __m256i*)p); }
+			static void storeInt(int* p, Int a) { _mm256_storeu_si256((__m256i*)p, a); }
+			static Int setInt(int a) { return _mm256_set1_epi32(a); }
+		};
+	}
+
+	void intersectPacketAVX2(const PacketScene& scene, RayPacket& packet)
+	{
+		intersectPacket<SimdAVX2>(scene, packet);
+	}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#endif
\ No newline at end of file
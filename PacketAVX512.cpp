@@ -0,0 +1,70 @@
+// Compiled for AVX-512F regardless of the project's target, only called after a CPU check.
+// Nothing but intrinsics and PacketKernel.h may be included below the target switch.
+// Contraction into FMA is off so the results match the scalar code bit for bit.
+#include "RayPacket.h"
+
+#ifdef RAY_TRACING_PACKET_X86
+
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx512f,avx2"))), apply_to = function)
+#pragma clang fp contract(off)
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#pragma GCC target("avx512f,avx2")
+#endif
+
+#include <immintrin.h>
+
+#include "PacketKernel.h"
+
+namespace RayTracing
+{
+	namespace
+	{
+		struct SimdAVX512
+		{
+			static const unsigned int WIDTH = 16;
+			typedef __m512 Float;
+			typedef __m512i Int;
+			typedef __mmask16 Mask;
+
+			static Float load(const float* p) { return _mm512_loadu_ps(p); }
+			static void store(float* p, Float a) { _mm512_storeu_ps(p, a); }
+			static Float set(float a) { return _mm512_set1_ps(a); }
+			static Float add(Float a, Float b) { return _mm512_add_ps(a, b); }
+			static Float sub(Float a, Float b) { return _mm512_sub_ps(a, b); }
+			static Float mul(Float a, Float b) { return _mm512_mul_ps(a, b); }
+			static Float div(Float a, Float b) { return _mm512_div_ps(a, b); }
+			static Float min(Float a, Float b) { return _mm512_min_ps(a, b); }
+			static Float max(Float a, Float b) { return _mm512_max_ps(a, b); }
+			static Float sqrt(Float a) { return _mm512_sqrt_ps(a); }
+			static Float abs(Float a) { return _mm512_abs_ps(a); }
+
+			static Mask lt(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+			static Mask le(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+			static Mask ge(Float a, Float b) { return _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ); }
+			static Mask andMask(Mask a, Mask b) { return (Mask)(a & b); }
+			static Mask orMask(Mask a, Mask b) { return (Mask)(a | b); }
+			static Mask andNotMask(Mask a, Mask b) { return (Mask)(a & ~b); }
+			static bool any(Mask m) { return m != 0; }
+			static Mask lowLanes(unsigned int n) { return (Mask)(n >= 16 ? 0xffffu : (1u << n) - 1); }
+
+			static Float select(Mask m, Float a, Float b) { return _mm512_mask_blend_ps(m, b, a); }
+			static Int selectInt(Mask m, Int a, Int b) { return _mm512_mask_blend_epi32(m, b, a); }
+			static Int loadInt(const int* p) { return _mm512_loadu_si512(p); }
+			static void storeInt(int* p, Int a) { _mm512_storeu_si512(p, a); }
+			static Int setInt(int a) { return _mm512_set1_epi32(a); }
+		};
+	}
+
+	void intersectPacketAVX512(const PacketScene& scene, RayPacket& packet)
+	{
+		intersectPacket<SimdAVX512>(scene, packet);
+	}
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#endif
\ No newline at end of file
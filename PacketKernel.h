@@ -0,0 +1,239 @@
+#ifndef RAY_TRACING_PACKET_KERNEL_H
+#define RAY_TRACING_PACKET_KERNEL_H
+
+#include "RayPacket.h"
+
+// Packet traversal written once against a small SIMD interface and included only by the
+// per instruction set translation units (PacketSSE.cpp, PacketAVX2.cpp, PacketAVX512.cpp).
+// S provides WIDTH, the types Float, Int and Mask, and:
+//   load, store, set, add, sub, mul, div, min, max, sqrt, abs   on Float
+//   lt, le, ge                                                    Float comparisons giving a Mask
+//   andMask, orMask, andNotMask(a, b) = a & ~b, any, lowLanes(n)  on Mask
+//   select(m, a, b), selectInt(m, a, b)                           m ? a : b per lane
+//   loadInt, storeInt, setInt                                     on Int
+// The scalar formulas of Sphere, Plane and Triangle are followed step by step so that
+// the packet path finds the same hits as Scene::getIntersection.
+
+namespace RayTracing
+{
+	namespace
+	{
+		const float PACKET_EPS = 1e-5f; // FLOAT_EPS, Ray.h can't be included here
+		const float PACKET_BARYCENTRIC_EPS = 1e-5f; // BARYCENTRIC_EPS
+
+		template <typename S>
+		struct PacketState
+		{
+			typename S::Float originX, originY, originZ;
+			typename S::Float directionX, directionY, directionZ;
+			typename S::Float invX, invY, invZ;
+			typename S::Float tMin;
+			typename S::Float t, u, v; // t starts at tMax
+			typename S::Int primitive;
+			typename S::Mask active;
+		};
+
+		template <typename S>
+		void recordHit(PacketState<S>& state, typename S::Mask hit, typename S::Float t,
+			typename S::Float u, typename S::Float v, int primitive)
+		{
+			state.t = S::select(hit, t, state.t);
+			state.u = S::select(hit, u, state.u);
+			state.v = S::select(hit, v, state.v);
+			state.primitive = S::selectInt(hit, S::setInt(primitive), state.primitive);
+		}
+
+		template <typename S>
+		typename S::Mask intersectBox(const PacketState<S>& state, const PacketNode& node)
+		{
+			typename S::Float x0 = S::mul(S::sub(S::set(node.min[0]), state.originX), state.invX);
+			typename S::Float x1 = S::mul(S::sub(S::set(node.max[0]), state.originX), state.invX);
+			typename S::Float y0 = S::mul(S::sub(S::set(node.min[1]), state.originY), state.invY);
+			typename S::Float y1 = S::mul(S::sub(S::set(node.max[1]), state.originY), state.invY);
+			typename S::Float z0 = S::mul(S::sub(S::set(node.min[2]), state.originZ), state.invZ);
+			typename S::Float z1 = S::mul(S::sub(S::set(node.max[2]), state.originZ), state.invZ);
+			typename S::Float enter = S::max(S::max(S::min(x0, x1), S::min(y0, y1)), S::max(S::min(z0, z1), S::set(0.0f)));
+			typename S::Float exit = S::min(S::min(S::max(x0, x1), S::max(y0, y1)), S::min(S::max(z0, z1), state.t));
+			return S::andMask(S::le(enter, exit), state.active);
+		}
+
+		template <typename S>
+		void intersectSphere(PacketState<S>& state, const float* sphere, int primitive)
+		{
+			typename S::Float ocX = S::sub(state.originX, S::set(sphere[0]));
+			typename S::Float ocY = S::sub(state.originY, S::set(sphere[1]));
+			typename S::Float ocZ = S::sub(state.originZ, S::set(sphere[2]));
+			typename S::Float zero = S::set(0.0f);
+
+			typename S::Float b = S::add(S::add(S::mul(ocX, state.directionX), S::mul(ocY, state.directionY)), S::mul(ocZ, state.directionZ));
+			typename S::Float hX = S::sub(ocX, S::mul(b, state.directionX));
+			typename S::Float hY = S::sub(ocY, S::mul(b, state.directionY));
+			typename S::Float hZ = S::sub(ocZ, S::mul(b, state.directionZ));
+			typename S::Float discriminant = S::sub(S::set(sphere[3]), S::add(S::add(S::mul(hX, hX), S::mul(hY, hY)), S::mul(hZ, hZ)));
+			typename S::Mask hit = S::andMask(S::ge(discriminant, zero), state.active);
+			if (!S::any(hit))
+			{
+				return;
+			}
+			typename S::Float root = S::sqrt(S::max(discriminant, zero));
+			typename S::Float negB = S::sub(zero, b);
+			typename S::Float q = S::select(S::ge(b, zero), S::sub(negB, root), S::add(negB, root));
+			hit = S::andNotMask(hit, S::andMask(S::le(q, zero), S::ge(q, zero))); // q == 0
+			typename S::Float c = S::sub(S::add(S::add(S::mul(ocX, ocX), S::mul(ocY, ocY)), S::mul(ocZ, ocZ)), S::set(sphere[3]));
+			typename S::Float r = S::div(c, q);
+			typename S::Float t1 = S::min(r, q);
+			typename S::Float t2 = S::max(r, q);
+			typename S::Float t = S::select(S::lt(state.tMin, t1), t1, t2);
+			hit = S::andMask(hit, S::andMask(S::lt(state.tMin, t), S::lt(t, state.t)));
+			recordHit(state, hit, t, zero, zero, primitive);
+		}
+
+		template <typename S>
+		void intersectTriangle(PacketState<S>& state, const float* triangle, int primitive)
+		{
+			typename S::Float e1X = S::set(triangle[3]), e1Y = S::set(triangle[4]), e1Z = S::set(triangle[5]);
+			typename S::Float e2X = S::set(triangle[6]), e2Y = S::set(triangle[7]), e2Z = S::set(triangle[8]);
+
+			// p = direction x edge2
+			typename S::Float pX = S::sub(S::mul(state.directionY, e2Z), S::mul(state.directionZ, e2Y));
+			typename S::Float pY = S::sub(S::mul(state.directionZ, e2X), S::mul(state.directionX, e2Z));
+			typename S::Float pZ = S::sub(S::mul(state.directionX, e2Y), S::mul(state.directionY, e2X));
+			typename S::Float det = S::add(S::add(S::mul(e1X, pX), S::mul(e1Y, pY)), S::mul(e1Z, pZ));
+			typename S::Float zero = S::set(0.0f), one = S::set(1.0f);
+			typename S::Float low = S::set(-PACKET_BARYCENTRIC_EPS), high = S::set(1.0f + PACKET_BARYCENTRIC_EPS);
+			typename S::Mask hit = S::andNotMask(state.active, S::andMask(S::le(det, zero), S::ge(det, zero)));
+			if (!S::any(hit))
+			{
+				return;
+			}
+			typename S::Float invDet = S::div(one, det);
+
+			typename S::Float sX = S::sub(state.originX, S::set(triangle[0]));
+			typename S::Float sY = S::sub(state.originY, S::set(triangle[1]));
+			typename S::Float sZ = S::sub(state.originZ, S::set(triangle[2]));
+			typename S::Float u = S::mul(S::add(S::add(S::mul(sX, pX), S::mul(sY, pY)), S::mul(sZ, pZ)), invDet);
+			hit = S::andMask(hit, S::andMask(S::ge(u, low), S::le(u, high)));
+			if (!S::any(hit))
+			{
+				return;
+			}
+
+			// q = s x edge1
+			typename S::Float qX = S::sub(S::mul(sY, e1Z), S::mul(sZ, e1Y));
+			typename S::Float qY = S::sub(S::mul(sZ, e1X), S::mul(sX, e1Z));
+			typename S::Float qZ = S::sub(S::mul(sX, e1Y), S::mul(sY, e1X));
+			typename S::Float v = S::mul(S::add(S::add(S::mul(state.directionX, qX), S::mul(state.directionY, qY)),
+				S::mul(state.directionZ, qZ)), invDet);
+			hit = S::andMask(hit, S::andMask(S::ge(v, low), S::le(S::add(u, v), high)));
+
+			typename S::Float t = S::mul(S::add(S::add(S::mul(e2X, qX), S::mul(e2Y, qY)), S::mul(e2Z, qZ)), invDet);
+			hit = S::andMask(hit, S::andMask(S::lt(state.tMin, t), S::lt(t, state.t)));
+			recordHit(state, hit, t, u, v, primitive);
+		}
+
+		template <typename S>
+		void intersectPlane(PacketState<S>& state, const float* plane, int primitive)
+		{
+			typename S::Float nX = S::set(plane[0]), nY = S::set(plane[1]), nZ = S::set(plane[2]);
+			typename S::Float cosine = S::add(S::add(S::mul(nX, state.directionX), S::mul(nY, state.directionY)), S::mul(nZ, state.directionZ));
+			typename S::Mask hit = S::andMask(S::ge(S::abs(cosine), S::set(PACKET_EPS)), state.active);
+			typename S::Float along = S::add(S::add(S::mul(nX, state.originX), S::mul(nY, state.originY)), S::mul(nZ, state.originZ));
+			typename S::Float t = S::div(S::sub(S::set(plane[3]), along), cosine);
+			hit = S::andMask(hit, S::andMask(S::lt(state.tMin, t), S::lt(t, state.t)));
+			recordHit(state, hit, t, S::set(0.0f), S::set(0.0f), primitive);
+		}
+
+		template <typename S>
+		void intersectPacket(const PacketScene& scene, RayPacket& packet)
+		{
+			PacketState<S> state;
+			state.originX = S::load(packet.originX);
+			state.originY = S::load(packet.originY);
+			state.originZ = S::load(packet.originZ);
+			state.directionX = S::load(packet.directionX);
+			state.directionY = S::load(packet.directionY);
+			state.directionZ = S::load(packet.directionZ);
+			state.invX = S::load(packet.invDirectionX);
+			state.invY = S::load(packet.invDirectionY);
+			state.invZ = S::load(packet.invDirectionZ);
+			state.tMin = S::load(packet.tMin);
+			state.t = S::load(packet.tMax);
+			state.u = S::set(0.0f);
+			state.v = S::set(0.0f);
+			state.primitive = S::setInt(-1);
+			state.active = S::lowLanes(packet.count);
+
+			// Mean direction of the packet, decides which child is visited first
+			float meanDirection[3] = { 0.0f, 0.0f, 0.0f };
+			for (unsigned int i = 0; i < packet.count; i++)
+			{
+				meanDirection[0] += packet.directionX[i];
+				meanDirection[1] += packet.directionY[i];
+				meanDirection[2] += packet.directionZ[i];
+			}
+
+			int firstPlane = (int)(scene.sphereCount + scene.triangleCount);
+			for (unsigned int i = 0; i < scene.planeCount; i++)
+			{
+				intersectPlane(state, scene.planes + i * 4, firstPlane + (int)i);
+			}
+
+			unsigned int stack[65]; // BVH::MAX_DEPTH + 1, each level pushes two nodes and pops one
+			int size = 0;
+			if (scene.nodeCount > 0)
+			{
+				stack[size++] = 0;
+			}
+			while (size > 0)
+			{
+				const PacketNode& node = scene.nodes[stack[--size]];
+				if (!S::any(intersectBox(state, node))) // tested against the closest hits so far
+				{
+					continue;
+				}
+				if (node.count > 0)
+				{
+					for (unsigned int i = node.first; i < node.first + node.count; i++)
+					{
+						unsigned int primitive = scene.primitives[i];
+						if (primitive < scene.sphereCount)
+						{
+							intersectSphere(state, scene.spheres + primitive * 4, (int)primitive);
+						}
+						else
+						{
+							intersectTriangle(state, scene.triangles + (primitive - scene.sphereCount) * 9, (int)primitive);
+						}
+					}
+					continue;
+				}
+
+				const PacketNode& left = scene.nodes[node.first];
+				const PacketNode& right = scene.nodes[node.first + 1];
+				float along = 0.0f;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					along += (right.min[axis] + right.max[axis] - left.min[axis] - left.max[axis]) * meanDirection[axis];
+				}
+				// The far child is pushed first so the near one is popped next
+				if (along >= 0.0f)
+				{
+					stack[size++] = node.first + 1;
+					stack[size++] = node.first;
+				}
+				else
+				{
+					stack[size++] = node.first;
+					stack[size++] = node.first + 1;
+				}
+			}
+
+			S::store(packet.t, state.t);
+			S::store(packet.u, state.u);
+			S::store(packet.v, state.v);
+			S::storeInt(packet.primitive, state.primitive);
+		}
+	}
+}
+
+#endif
\ No newline at end of file
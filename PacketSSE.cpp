@@ -0,0 +1,62 @@
+// SSE2 is part of every x86-64 CPU, no target attribute is needed for this kernel
+#include "RayPacket.h"
+
+#ifdef RAY_TRACING_PACKET_X86
+
+#include <emmintrin.h>
+
+#include "PacketKernel.h"
+
+namespace RayTracing
+{
+	namespace
+	{
+		struct SimdSSE
+		{
+			static const unsigned int WIDTH = 4;
+			typedef __m128 Float;
+			typedef __m128i Int;
+			typedef __m128 Mask;
+
+			static Float load(const float* p) { return _mm_loadu_ps(p); }
+			static void store(float* p, Float a) { _mm_storeu_ps(p, a); }
+			static Float set(float a) { return _mm_set1_ps(a); }
+			static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+			static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+			static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+			static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+			static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+			static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+			static Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+			static Float abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+			static Mask lt(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+			static Mask le(Float a, Float b) { return _mm_cmple_ps(a, b); }
+			static Mask ge(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+			static Mask andMask(Mask a, Mask b) { return _mm_and_ps(a, b); }
+			static Mask orMask(Mask a, Mask b) { return _mm_or_ps(a, b); }
+			static Mask andNotMask(Mask a, Mask b) { return _mm_andnot_ps(b, a); }
+			static bool any(Mask m) { return _mm_movemask_ps(m) != 0; }
+			static Mask lowLanes(unsigned int n)
+			{
+				return _mm_castsi128_ps(_mm_cmplt_epi32(_mm_set_epi32(3, 2, 1, 0), _mm_set1_epi32((int)n)));
+			}
+
+			static Float select(Mask m, Float a, Float b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+			static Int selectInt(Mask m, Int a, Int b)
+			{
+				return _mm_castps_si128(select(m, _mm_castsi128_ps(a), _mm_castsi128_ps(b)));
+			}
+			static Int loadInt(const int* p) { return _mm_loadu_si128((const __m128i*)p); }
+			static void storeInt(int* p, Int a) { _mm_storeu_si128((__m128i*)p, a); }
+			static Int setInt(int a) { return _mm_set1_epi32(a); }
+		};
+	}
+
+	void intersectPacketSSE(const PacketScene& scene, RayPacket& packet)
+	{
+		intersectPacket<SimdSSE>(scene, packet);
+	}
+}
+
+#endif
\ No newline at end of file
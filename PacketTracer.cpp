@@ -0,0 +1,247 @@
+#include "PacketTracer.h"
+#include "Mesh.h"
+
+#include <typeinfo>
+
+#if defined(_MSC_VER) && defined(RAY_TRACING_PACKET_X86)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace RayTracing
+{
+	namespace
+	{
+		void appendVector(std::vector<float>& data, const glm::vec3& v)
+		{
+			data.push_back(v.x);
+			data.push_back(v.y);
+			data.push_back(v.z);
+		}
+	}
+
+	PacketTracer::PacketTracer() : _kernel(nullptr), _width(1), _complete(false)
+	{
+		_view = PacketScene();
+	}
+
+	void PacketTracer::build(const Scene& scene)
+	{
+		_nodes.clear();
+		_primitives.clear();
+		_spheres.clear();
+		_triangles.clear();
+		_planes.clear();
+		_refs.clear();
+		_complete = true;
+
+		// Ids are given type by type so that each type is a contiguous range
+		const EntityStore& store = scene.getStore();
+		std::vector<AABB> bounds;
+		for (unsigned int i = 0; i < store.getSphereCount(); i++)
+		{
+			const SphereRecord& sphere = store.getSphereRecords()[i];
+			appendVector(_spheres, sphere.center);
+			_spheres.push_back(sphere.radiusSquared);
+			_refs.push_back({ &store.getSphere(i), 0, false });
+			bounds.push_back(store.getSphere(i).getBounds());
+		}
+		for (unsigned int i = 0; i < store.getTriangleCount(); i++)
+		{
+			const TriangleRecord& triangle = store.getTriangleRecords()[i];
+			appendVector(_triangles, triangle.A);
+			appendVector(_triangles, triangle.edge1);
+			appendVector(_triangles, triangle.edge2);
+			_refs.push_back({ &store.getTriangle(i), 0, true });
+			bounds.push_back(store.getTriangle(i).getBounds());
+		}
+		for (const Entity* pEntity : scene.getOtherEntitys())
+		{
+			glm::vec3 A, B, C;
+			if (typeid(*pEntity) != typeid(Mesh))
+			{
+				_complete = false;
+			}
+			else
+			{
+				const Mesh* mesh = static_cast<const Mesh*>(pEntity);
+				for (unsigned int i = 0; i < mesh->getTriangleCount(); i++)
+				{
+					A = mesh->getVertex(i, 0);
+					B = mesh->getVertex(i, 1);
+					C = mesh->getVertex(i, 2);
+					appendVector(_triangles, A);
+					appendVector(_triangles, B - A);
+					appendVector(_triangles, C - A);
+					_refs.push_back({ pEntity, i, true });
+					AABB box;
+					box.expand(A);
+					box.expand(B);
+					box.expand(C);
+					bounds.push_back(box);
+				}
+			}
+		}
+		for (unsigned int i = 0; i < store.getPlaneCount(); i++)
+		{
+			const PlaneRecord& plane = store.getPlaneRecords()[i];
+			appendVector(_planes, plane.normal);
+			_planes.push_back(plane.distance);
+			_refs.push_back({ &store.getPlane(i), 0, false });
+		}
+
+		BVH bvh;
+		bvh.build(bounds);
+		for (const BVH::Node& node : bvh.getNodes())
+		{
+			_nodes.push_back({ { node.bounds.min.x, node.bounds.min.y, node.bounds.min.z },
+				{ node.bounds.max.x, node.bounds.max.y, node.bounds.max.z }, node.first, node.count });
+		}
+		_primitives = bvh.getPrimitives();
+
+		_view.nodes = _nodes.data();
+		_view.nodeCount = (unsigned int)_nodes.size();
+		_view.primitives = _primitives.data();
+		_view.spheres = _spheres.data();
+		_view.sphereCount = (unsigned int)(_spheres.size() / 4);
+		_view.triangles = _triangles.data();
+		_view.triangleCount = (unsigned int)(_triangles.size() / 9);
+		_view.planes = _planes.data();
+		_view.planeCount = (unsigned int)(_planes.size() / 4);
+	}
+
+	unsigned int PacketTracer::getSupportedWidth()
+	{
+#if defined(_MSC_VER) && defined(RAY_TRACING_PACKET_X86)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		bool avx2 = false, avx512 = false;
+		if (maxLeaf >= 7)
+		{
+			__cpuidex(info, 7, 0);
+			avx2 = (info[1] & (1 << 5)) != 0;
+			avx512 = (info[1] & (1 << 16)) != 0;
+		}
+		// The OS has to save the wider registers too
+		unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+		bool ymm = (xcr0 & 0x6) == 0x6;
+		bool zmm = (xcr0 & 0xe6) == 0xe6;
+		if (avx512 && avx2 && zmm)
+		{
+			return 16;
+		}
+		if (avx2 && avx && ymm)
+		{
+			return 8;
+		}
+		return 4;
+#elif defined(__GNUC__) && defined(RAY_TRACING_PACKET_X86)
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2"))
+		{
+			return 16;
+		}
+		if (__builtin_cpu_supports("avx2"))
+		{
+			return 8;
+		}
+		return __builtin_cpu_supports("sse2") ? 4 : 1;
+#else
+		return 1;
+#endif
+	}
+
+	void PacketTracer::setWidth(unsigned int width)
+	{
+		unsigned int supported = getSupportedWidth();
+		_width = 1;
+		_kernel = nullptr;
+#ifdef RAY_TRACING_PACKET_X86
+		if (width >= 16 && supported >= 16)
+		{
+			_width = 16;
+			_kernel = intersectPacketAVX512;
+		}
+		else if (width >= 8 && supported >= 8)
+		{
+			_width = 8;
+			_kernel = intersectPacketAVX2;
+		}
+		else if (width >= 4 && supported >= 4)
+		{
+			_width = 4;
+			_kernel = intersectPacketSSE;
+		}
+#endif
+	}
+
+	void PacketTracer::setRay(RayPacket& packet, unsigned int lane, const Ray& ray)
+	{
+		glm::vec3 origin = ray.getVertex();
+		glm::vec3 direction = ray.getDirection();
+		packet.originX[lane] = origin.x;
+		packet.originY[lane] = origin.y;
+		packet.originZ[lane] = origin.z;
+		packet.directionX[lane] = direction.x;
+		packet.directionY[lane] = direction.y;
+		packet.directionZ[lane] = direction.z;
+		packet.invDirectionX[lane] = 1.0f / direction.x;
+		packet.invDirectionY[lane] = 1.0f / direction.y;
+		packet.invDirectionZ[lane] = 1.0f / direction.z;
+		packet.tMin[lane] = ray.getTMin();
+		packet.tMax[lane] = ray.getTMax();
+	}
+
+	void PacketTracer::intersect(RayPacket& packet) const
+	{
+		// Unused lanes still go through the kernel, give them a copy of the first ray
+		for (unsigned int i = packet.count; i < _width; i++)
+		{
+			packet.originX[i] = packet.originX[0];
+			packet.originY[i] = packet.originY[0];
+			packet.originZ[i] = packet.originZ[0];
+			packet.directionX[i] = packet.directionX[0];
+			packet.directionY[i] = packet.directionY[0];
+			packet.directionZ[i] = packet.directionZ[0];
+			packet.invDirectionX[i] = packet.invDirectionX[0];
+			packet.invDirectionY[i] = packet.invDirectionY[0];
+			packet.invDirectionZ[i] = packet.invDirectionZ[0];
+			packet.tMin[i] = packet.tMin[0];
+			packet.tMax[i] = packet.tMax[0];
+		}
+		_kernel(_view, packet);
+	}
+
+	HitRecord PacketTracer::getHitRecord(const RayPacket& packet, unsigned int lane) const
+	{
+		HitRecord hit;
+		if (packet.primitive[lane] < 0)
+		{
+			return hit;
+		}
+		const PrimitiveRef& ref = _refs[packet.primitive[lane]];
+		hit.t = packet.t[lane];
+		hit.entity = ref.entity;
+		hit.primitive = ref.primitive;
+		if (ref.triangle)
+		{
+			hit.uv = glm::vec2(packet.u[lane], packet.v[lane]);
+		}
+		else if ((unsigned int)packet.primitive[lane] < _view.sphereCount)
+		{
+			const Sphere* sphere = static_cast<const Sphere*>(ref.entity);
+			glm::vec3 p = glm::vec3(packet.originX[lane], packet.originY[lane], packet.originZ[lane]) +
+				hit.t * glm::vec3(packet.directionX[lane], packet.directionY[lane], packet.directionZ[lane]);
+			hit.normal = (p - sphere->getCenter()) / sphere->getRadius();
+		}
+		else
+		{
+			hit.normal = static_cast<const Plane*>(ref.entity)->getNormal();
+		}
+		return hit;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+#ifndef RAY_TRACING_PACKET_TRACER_H
+#define RAY_TRACING_PACKET_TRACER_H
+
+#include "RayPacket.h"
+#include "RayTracing.h"
+
+#include <vector>
+
+namespace RayTracing
+{
+	// Closest hit queries for packets of 4, 8 or 16 rays at once, using the widest SIMD
+	// instruction set the CPU supports. Meant for coherent rays such as primary rays:
+	// the whole packet walks the BVH together.
+	// The scene is flattened into its own arrays by build, rebuild after the scene changes.
+	class PacketTracer
+	{
+	public:
+		PacketTracer();
+		// Spheres, planes, triangles and meshes are supported. With any other entity
+		// isComplete() is false and the scalar Scene::getIntersection must be used instead.
+		void build(const Scene& scene);
+		bool isComplete() const { return _complete; }
+		// Widest packet the CPU can trace: 16 (AVX-512), 8 (AVX2), 4 (SSE2) or 1 (no kernel)
+		static unsigned int getSupportedWidth();
+		// Chooses the kernel, width is rounded down to a supported one; 1 turns packets off
+		void setWidth(unsigned int width);
+		unsigned int getWidth() const { return _width; }
+
+		static void setRay(RayPacket& packet, unsigned int lane, const Ray& ray);
+		// Fills t, u, v and primitive of the first packet.count lanes, count <= getWidth()
+		void intersect(RayPacket& packet) const;
+		// The hit of one lane as Scene::getIntersection would report it
+		HitRecord getHitRecord(const RayPacket& packet, unsigned int lane) const;
+	private:
+		struct PrimitiveRef
+		{
+			const Entity* entity;
+			unsigned int primitive; // within the entity, the triangle for meshes
+			bool triangle;
+		};
+		typedef void (*Kernel)(const PacketScene& scene, RayPacket& packet);
+
+		std::vector<PacketNode> _nodes;
+		std::vector<unsigned int> _primitives;
+		std::vector<float> _spheres;
+		std::vector<float> _triangles;
+		std::vector<float> _planes;
+		std::vector<PrimitiveRef> _refs; // indexed by primitive id: spheres, triangles, planes
+		PacketScene _view;
+		Kernel _kernel;
+		unsigned int _width;
+		bool _complete;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -1,33 +1,169 @@
 #include "PhongShader.h"
 
+glm::vec3 Light::phong(
+	const SurfaceColor& surface,
+	const glm::vec3& norm,
+	const glm::vec3& viewDir,
+	const glm::vec3& lightDir,
+	float intensity,
+	float visibility) const
+{
+	glm::vec3 ambient = _ambient * surface.ambient * intensity;
+	if (visibility <= 0.0f)
+	{
+		return ambient;
+	}
+
+	float diff = std::max(dot(norm, lightDir), 0.0f);
+	glm::vec3 diffuse = diff * _diffuse * surface.diffuse * intensity;
+
+	glm::vec3 middle = glm::normalize(-viewDir + lightDir);
+	float spec = glm::pow(std::max(glm::dot(middle, norm), 0.0f), surface.shininess);
+	glm::vec3 specular = _specular * spec * surface.specular * intensity;
+
+	return (ambient + visibility * (diffuse + specular));
+}
+
 DirLight::DirLight(
 	glm::vec3 ambient,
 	glm::vec3 diffuse,
 	glm::vec3 specular,
 	glm::vec3 direction)
-	: _ambient(ambient),
-	_diffuse(diffuse),
-	_specular(specular),
+	: Light(ambient, diffuse, specular),
 	_direction(direction)
 {
 
 }
 
+LightSample DirLight::sample(const glm::vec3& fragPos) const
+{
+	return { normalize(-_direction), RayTracing::FLOAT_INF };
+}
+
 glm::vec3 DirLight::calLight(
-	const Material& material,
+	const SurfaceColor& surface,
 	const glm::vec3& fragPos,
 	const glm::vec3& norm,
-	const glm::vec3& viewDir) const 
+	const glm::vec3& viewDir,
+	const LightSample& light,
+	float visibility) const
 {
-	glm::vec3 ambient = _ambient * material.ambient(fragPos);
+	return phong(surface, norm, viewDir, light.direction, 1.0f, visibility);
+}
 
-	glm::vec3 lightDir = normalize(-_direction);
-	float diff = std::max(dot(norm, lightDir), 0.0f);
-	glm::vec3 diffuse = diff * _diffuse * material.diffuse(fragPos);
+PointLight::PointLight(
+	glm::vec3 ambient,
+	glm::vec3 diffuse,
+	glm::vec3 specular,
+	glm::vec3 position,
+	Attenuation attenuation)
+	: Light(ambient, diffuse, specular),
+	_position(position),
+	_attenuation(attenuation)
+{
 
-	glm::vec3 middle = glm::normalize(-viewDir + lightDir);
-	float spec = glm::pow(std::max(glm::dot(middle, norm), 0.0f), material.shininess(fragPos));
-	glm::vec3 specular = _specular * spec * material.specular(fragPos);
+}
+
+LightSample PointLight::sample(const glm::vec3& fragPos) const
+{
+	glm::vec3 toLight = _position - fragPos;
+	float distance = glm::length(toLight);
+	return { toLight / distance, distance };
+}
 
-	return (ambient + diffuse + specular);
+glm::vec3 PointLight::calLight(
+	const SurfaceColor& surface,
+	const glm::vec3& fragPos,
+	const glm::vec3& norm,
+	const glm::vec3& viewDir,
+	const LightSample& light,
+	float visibility) const
+{
+	return phong(surface, norm, viewDir, light.direction, _attenuation.at(light.distance), visibility);
+}
+
+SpotLight::SpotLight(
+	glm::vec3 ambient,
+	glm::vec3 diffuse,
+	glm::vec3 specular,
+	glm::vec3 position,
+	glm::vec3 direction,
+	float innerAngle,
+	float outerAngle,
+	Attenuation attenuation)
+	: PointLight(ambient, diffuse, specular, position, attenuation),
+	_direction(glm::normalize(direction)),
+	_innerAngle(innerAngle),
+	_outerAngle(std::max(innerAngle, outerAngle)),
+	_cosInner(std::cos(glm::radians(innerAngle))),
+	_cosOuter(std::cos(glm::radians(_outerAngle)))
+{
+
+}
+
+glm::vec3 SpotLight::calLight(
+	const SurfaceColor& surface,
+	const glm::vec3& fragPos,
+	const glm::vec3& norm,
+	const glm::vec3& viewDir,
+	const LightSample& light,
+	float visibility) const
+{
+	// Full strength inside the inner cone, fading to 0 at the outer one, ambient included
+	float cosine = glm::dot(-light.direction, _direction);
+	float cone = _cosInner > _cosOuter ? glm::clamp((cosine - _cosOuter) / (_cosInner - _cosOuter), 0.0f, 1.0f) : (cosine >= _cosOuter ? 1.0f : 0.0f);
+	return phong(surface, norm, viewDir, light.direction, _attenuation.at(light.distance) * cone, visibility);
+}
+
+AreaLight::AreaLight(
+	glm::vec3 ambient,
+	glm::vec3 diffuse,
+	glm::vec3 specular,
+	glm::vec3 corner,
+	glm::vec3 edge1,
+	glm::vec3 edge2,
+	Attenuation attenuation)
+	: Light(ambient, diffuse, specular),
+	_corner(corner),
+	_edge1(edge1),
+	_edge2(edge2),
+	_normal(glm::normalize(glm::cross(edge1, edge2))),
+	_attenuation(attenuation)
+{
+
+}
+
+LightSample AreaLight::sample(const glm::vec3& fragPos) const
+{
+	return sample(fragPos, glm::vec2(0.5f));
+}
+
+LightSample AreaLight::sample(const glm::vec3& fragPos, const glm::vec2& u) const
+{
+	glm::vec3 toLight = _corner + u.x * _edge1 + u.y * _edge2 - fragPos;
+	float distance = glm::length(toLight);
+	return { toLight / distance, distance };
+}
+
+glm::vec3 AreaLight::calLight(
+	const SurfaceColor& surface,
+	const glm::vec3& fragPos,
+	const glm::vec3& norm,
+	const glm::vec3& viewDir,
+	const LightSample& light,
+	float visibility) const
+{
+	// Seen at a slant the area looks smaller, from behind it gives no light
+	float cosine = std::max(glm::dot(-light.direction, _normal), 0.0f);
+	return phong(surface, norm, viewDir, light.direction, _attenuation.at(light.distance) * cosine, visibility);
+}
+
+RayTracing::AABB AreaLight::getBounds() const
+{
+	RayTracing::AABB box;
+	box.expand(_corner);
+	box.expand(_corner + _edge1);
+	box.expand(_corner + _edge2);
+	box.expand(_corner + _edge1 + _edge2);
+	return box;
 }
\ No newline at end of file
@@ -5,30 +5,67 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "AABB.h"
+#include "Material.h"
+#include "Ray.h"
+
 #include <algorithm>
-#include <functional>
-struct Material
+
+// Where a light is seen from a point, used to cast shadow rays
+struct LightSample
 {
-	std::function<glm::vec3 (const glm::vec3& pos)> ambient;
-	std::function<glm::vec3 (const glm::vec3& pos)> diffuse;
-	std::function<glm::vec3 (const glm::vec3& pos)> specular;
-	std::function<float(const glm::vec3& pos)> shininess;
-
-	float kShade;
-	float kReflect;
-	float kRefract;
-	float refractiveIndex;
+	glm::vec3 direction; // unit vector from the point towards the light
+	float distance; // RayTracing::FLOAT_INF for lights at infinity
 };
 
 class Light
 {
 public:
+	Light(glm::vec3 ambient, glm::vec3 diffuse, glm::vec3 specular) : _ambient(ambient), _diffuse(diffuse), _specular(specular) {}
+	virtual ~Light() {}
+	virtual LightSample sample(const glm::vec3& fragPos) const = 0;
+	// A point of the light chosen by u in [0, 1)^2, for lights with an extent. The others ignore u.
+	virtual LightSample sample(const glm::vec3& fragPos, const glm::vec2& u) const { return sample(fragPos); }
+	// Light arriving along a sample of this light. visibility scales the diffuse and specular
+	// terms: 1 when the light is seen, 0 when it is blocked
 	virtual glm::vec3 calLight(
-		const Material& material,
+		const SurfaceColor& surface,
 		const glm::vec3& fragPos,
 		const glm::vec3& norm,
-		const glm::vec3& viewDir) const = 0;
-private:
+		const glm::vec3& viewDir,
+		const LightSample& light,
+		float visibility) const = 0;
+	// calLight towards sample(fragPos)
+	glm::vec3 calLight(
+		const SurfaceColor& surface,
+		const glm::vec3& fragPos,
+		const glm::vec3& norm,
+		const glm::vec3& viewDir,
+		float visibility = 1.0f) const
+	{
+		return calLight(surface, fragPos, norm, viewDir, sample(fragPos), visibility);
+	}
+	// Lights with a position can be picked by the scene's LightTree, lights at infinity are always shaded
+	virtual bool isBounded() const { return true; }
+	virtual RayTracing::AABB getBounds() const = 0;
+	// Brightness used to weigh the light against others, luminance of its colors
+	float getPower() const { return glm::dot(_ambient + _diffuse + _specular, glm::vec3(0.2126f, 0.7152f, 0.0722f)); }
+	glm::vec3 getAmbient() const { return _ambient; }
+	glm::vec3 getDiffuse() const { return _diffuse; }
+	glm::vec3 getSpecular() const { return _specular; }
+protected:
+	// ambient + visibility * (diffuse + specular) for a light from lightDir, all three scaled by intensity
+	glm::vec3 phong(
+		const SurfaceColor& surface,
+		const glm::vec3& norm,
+		const glm::vec3& viewDir,
+		const glm::vec3& lightDir,
+		float intensity,
+		float visibility) const;
+
+	glm::vec3 _ambient;
+	glm::vec3 _diffuse;
+	glm::vec3 _specular;
 };
 
 class DirLight : public Light
@@ -39,18 +76,125 @@ public:
 		glm::vec3 diffuse,
 		glm::vec3 specular,
 		glm::vec3 direction);
+	LightSample sample(const glm::vec3& fragPos) const;
+	using Light::calLight;
 	glm::vec3 calLight(
-		const Material& material,
+		const SurfaceColor& surface,
 		const glm::vec3& fragPos,
 		const glm::vec3& norm,
-		const glm::vec3& viewDir) const;
+		const glm::vec3& viewDir,
+		const LightSample& light,
+		float visibility) const;
+	bool isBounded() const { return false; }
+	RayTracing::AABB getBounds() const { return RayTracing::AABB(glm::vec3(-RayTracing::FLOAT_INF), glm::vec3(RayTracing::FLOAT_INF)); }
+	glm::vec3 getDirection() const { return _direction; }
+private:
+	glm::vec3 _direction;
+};
+
+// Distance falloff of point, spot and area lights: 1 / (constant + linear * d + quadratic * d^2)
+struct Attenuation
+{
+	float constant = 1.0f;
+	float linear = 0.0f;
+	float quadratic = 1.0f;
+
+	float at(float distance) const { return 1.0f / (constant + linear * distance + quadratic * distance * distance); }
+};
+
+class PointLight : public Light
+{
+public:
+	PointLight(
+		glm::vec3 ambient,
+		glm::vec3 diffuse,
+		glm::vec3 specular,
+		glm::vec3 position,
+		Attenuation attenuation = Attenuation());
+	LightSample sample(const glm::vec3& fragPos) const;
+	using Light::calLight;
+	glm::vec3 calLight(
+		const SurfaceColor& surface,
+		const glm::vec3& fragPos,
+		const glm::vec3& norm,
+		const glm::vec3& viewDir,
+		const LightSample& light,
+		float visibility) const;
+	RayTracing::AABB getBounds() const { return RayTracing::AABB(_position, _position); }
+	glm::vec3 getPosition() const { return _position; }
+	Attenuation getAttenuation() const { return _attenuation; }
+protected:
+	glm::vec3 _position;
+	Attenuation _attenuation;
+};
+
+// A point light shining into a cone around direction, fading out between the inner and outer angles
+class SpotLight : public PointLight
+{
+public:
+	SpotLight(
+		glm::vec3 ambient,
+		glm::vec3 diffuse,
+		glm::vec3 specular,
+		glm::vec3 position,
+		glm::vec3 direction,
+		float innerAngle, // degrees from the axis
+		float outerAngle,
+		Attenuation attenuation = Attenuation());
+	using Light::calLight;
+	glm::vec3 calLight(
+		const SurfaceColor& surface,
+		const glm::vec3& fragPos,
+		const glm::vec3& norm,
+		const glm::vec3& viewDir,
+		const LightSample& light,
+		float visibility) const;
+	glm::vec3 getDirection() const { return _direction; }
+	float getInnerAngle() const { return _innerAngle; }
+	float getOuterAngle() const { return _outerAngle; }
 private:
-	glm::vec3 _ambient;
-	glm::vec3 _diffuse;
-	glm::vec3 _specular;
 	glm::vec3 _direction;
+	float _innerAngle;
+	float _outerAngle;
+	float _cosInner;
+	float _cosOuter;
+};
 
-	
+// A parallelogram corner + s * edge1 + t * edge2 lighting the side edge1 x edge2 points to.
+// Its colors are totals for the whole area, so resizing it doesn't change its brightness;
+// every sample picks a point on it, which gives soft shadows over many samples.
+class AreaLight : public Light
+{
+public:
+	AreaLight(
+		glm::vec3 ambient,
+		glm::vec3 diffuse,
+		glm::vec3 specular,
+		glm::vec3 corner,
+		glm::vec3 edge1,
+		glm::vec3 edge2,
+		Attenuation attenuation = Attenuation());
+	LightSample sample(const glm::vec3& fragPos) const; // towards the center
+	LightSample sample(const glm::vec3& fragPos, const glm::vec2& u) const;
+	using Light::calLight;
+	glm::vec3 calLight(
+		const SurfaceColor& surface,
+		const glm::vec3& fragPos,
+		const glm::vec3& norm,
+		const glm::vec3& viewDir,
+		const LightSample& light,
+		float visibility) const;
+	RayTracing::AABB getBounds() const;
+	glm::vec3 getCorner() const { return _corner; }
+	glm::vec3 getEdge1() const { return _edge1; }
+	glm::vec3 getEdge2() const { return _edge2; }
+	Attenuation getAttenuation() const { return _attenuation; }
+private:
+	glm::vec3 _corner;
+	glm::vec3 _edge1;
+	glm::vec3 _edge2;
+	glm::vec3 _normal;
+	Attenuation _attenuation;
 };
 
 #endif
\ No newline at end of file
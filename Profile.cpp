@@ -0,0 +1,174 @@
+#include "Profile.h"
+#include "FrameBuffer.h"
+
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+
+namespace RayTracing
+{
+	unsigned int PixelCounters::getRays() const
+	{
+		unsigned int total = 0;
+		for (unsigned int depth = 0; depth < DEPTH_COUNT; depth++)
+		{
+			total += rays[depth];
+		}
+		return total;
+	}
+
+	unsigned int PixelCounters::getTests() const
+	{
+		unsigned int total = 0;
+		for (int test = 0; test < TEST_COUNT; test++)
+		{
+			total += tests[test];
+		}
+		return total;
+	}
+
+	void PixelCounters::add(const PixelCounters& other)
+	{
+		for (unsigned int depth = 0; depth < DEPTH_COUNT; depth++)
+		{
+			rays[depth] += other.rays[depth];
+		}
+		shadowRays += other.shadowRays;
+		for (int test = 0; test < TEST_COUNT; test++)
+		{
+			tests[test] += other.tests[test];
+		}
+		shades += other.shades;
+		nanoseconds += other.nanoseconds;
+	}
+
+	PixelProfile::PixelProfile(unsigned int width, unsigned int height) :
+		_width(width), _height(height), _pixels(size_t(width) * height)
+	{
+
+	}
+
+	double PixelProfile::getValue(unsigned int x, unsigned int y, Metric metric) const
+	{
+		const PixelCounters& pixel = at(x, y);
+		switch (metric)
+		{
+		case TIME: return pixel.nanoseconds;
+		case RAYS: return pixel.getRays();
+		case SHADOW_RAYS: return pixel.shadowRays;
+		case TESTS: return pixel.getTests();
+		default: return pixel.shades;
+		}
+	}
+
+	void PixelProfile::clear()
+	{
+		std::fill(_pixels.begin(), _pixels.end(), PixelCounters());
+	}
+
+	bool PixelProfile::writeHeatmap(const std::string& path, Metric metric) const
+	{
+		std::vector<double> values;
+		values.reserve(_pixels.size());
+		for (unsigned int y = 0; y < _height; y++)
+		{
+			for (unsigned int x = 0; x < _width; x++)
+			{
+				values.push_back(getValue(x, y, metric));
+			}
+		}
+		std::vector<double> sorted = values;
+		size_t rank = std::min(sorted.size() - 1, sorted.size() * 99 / 100);
+		std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+		double scale = sorted[rank] > 0.0 ? 1.0 / sorted[rank] : 0.0;
+
+		// Black, blue, green, yellow, red at evenly spaced points of [0, 1]
+		static const glm::vec3 colors[] = {
+			glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f)
+		};
+		FrameBuffer image(_width, _height);
+		for (unsigned int y = 0; y < _height; y++)
+		{
+			for (unsigned int x = 0; x < _width; x++)
+			{
+				float position = float(std::min(1.0, values[y * _width + x] * scale)) * 4.0f;
+				int segment = std::min(3, int(position));
+				image.setPixel(x, y, glm::mix(colors[segment], colors[segment + 1], position - segment));
+			}
+		}
+		return image.write(path);
+	}
+
+	void PixelProfile::printSummary(std::ostream& out) const
+	{
+		PixelCounters total;
+		for (const auto& pixel : _pixels)
+		{
+			total.add(pixel);
+		}
+		double pixelCount = double(_pixels.size());
+		out << std::fixed << std::setprecision(2);
+		out << "time per pixel " << total.nanoseconds / pixelCount << " ns" << std::endl;
+		if (!PixelCounters::isCounting())
+		{
+			out << "built without RAY_TRACING_PROFILE, only times were recorded" << std::endl;
+		}
+		else
+		{
+			out << "rays by depth:";
+			for (unsigned int depth = 0; depth < PixelCounters::DEPTH_COUNT; depth++)
+			{
+				out << " " << depth << (depth + 1 == PixelCounters::DEPTH_COUNT ? "+" : "") << ": " << total.rays[depth];
+			}
+			out << std::endl << "shadow rays " << total.shadowRays << ", shading evaluations " << total.shades << std::endl;
+			static const char* testNames[] = { "sphere", "plane", "triangle", "box" };
+			double rays = std::max(1u, total.getRays() + total.shadowRays);
+			out << "tests per ray:";
+			for (int test = 0; test < PixelCounters::TEST_COUNT; test++)
+			{
+				out << " " << testNames[test] << " " << total.tests[test] / rays;
+			}
+			out << std::endl;
+		}
+
+		// Pixels by power of two buckets, bucket k holds values in [2^(k-1), 2^k), bucket 0 the zeros
+		for (Metric metric : { TIME, RAYS, TESTS })
+		{
+			if (metric != TIME && !PixelCounters::isCounting())
+			{
+				continue;
+			}
+			std::vector<unsigned int> buckets;
+			unsigned int largest = 0;
+			for (unsigned int y = 0; y < _height; y++)
+			{
+				for (unsigned int x = 0; x < _width; x++)
+				{
+					double value = getValue(x, y, metric);
+					unsigned int bucket = value < 1.0 ? 0 : unsigned(std::log2(value)) + 1;
+					buckets.resize(std::max<size_t>(buckets.size(), bucket + 1));
+					largest = std::max(largest, ++buckets[bucket]);
+				}
+			}
+			out << getMetricName(metric) << " per pixel" << std::endl;
+			unsigned int first = 0;
+			while (buckets[first] == 0)
+			{
+				first++;
+			}
+			for (unsigned int bucket = first; bucket < buckets.size(); bucket++)
+			{
+				unsigned long long low = bucket == 0 ? 0 : 1ull << (bucket - 1);
+				unsigned long long high = bucket == 0 ? 0 : (1ull << bucket) - 1;
+				out << std::setw(10) << low << " - " << std::setw(10) << high << "  "
+					<< std::setw(7) << buckets[bucket] << "  " << std::string(40ull * buckets[bucket] / largest, '#') << std::endl;
+			}
+		}
+	}
+
+	const char* PixelProfile::getMetricName(Metric metric)
+	{
+		static const char* names[] = { "time", "rays", "shadow", "tests", "shades" };
+		return names[metric];
+	}
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#ifndef RAY_TRACING_PROFILE_H
+#define RAY_TRACING_PROFILE_H
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Counters in the tracing hot path: rays by depth, intersection tests by primitive type and
+// shading evaluations, per pixel. They are compiled in only when RAY_TRACING_PROFILE is defined,
+// otherwise RAY_TRACING_COUNT expands to nothing and the hot path is left as it is.
+#ifdef RAY_TRACING_PROFILE
+#define RAY_TRACING_COUNT(counter) \
+	do { if (RayTracing::PixelCounters* counters_ = RayTracing::PixelCounters::current()) counters_->counter++; } while (0)
+#else
+#define RAY_TRACING_COUNT(counter) do { } while (0)
+#endif
+
+namespace RayTracing
+{
+	struct PixelCounters
+	{
+		enum Test { SPHERE, PLANE, TRIANGLE, BOX, TEST_COUNT }; // BOX counts BVH node tests, those of meshes too
+		static const unsigned int DEPTH_COUNT = 8; // deeper rays are counted in the last bucket
+
+		unsigned int rays[DEPTH_COUNT] = {}; // closest hit rays by depth, the primary ray is depth 0
+		unsigned int shadowRays = 0;
+		unsigned int tests[TEST_COUNT] = {};
+		unsigned int shades = 0;
+		float nanoseconds = 0.0f; // wall time of the pixel, measured with or without RAY_TRACING_PROFILE
+
+		unsigned int getRays() const;
+		unsigned int getTests() const;
+		void add(const PixelCounters& other);
+		static unsigned int depthBucket(unsigned int depth) { return std::min(depth, DEPTH_COUNT - 1); }
+
+		// The counters of the pixel being traced by this thread, nullptr outside a profiled render.
+		// Each thread counts into its own pixel, so counting takes no lock and shares no cache line.
+		static PixelCounters*& current()
+		{
+			thread_local PixelCounters* counters = nullptr;
+			return counters;
+		}
+		static bool isCounting()
+		{
+#ifdef RAY_TRACING_PROFILE
+			return true;
+#else
+			return false;
+#endif
+		}
+	};
+
+	// Counters of every pixel of a frame, filled by a Renderer it is given to
+	class PixelProfile
+	{
+	public:
+		enum Metric { TIME, RAYS, SHADOW_RAYS, TESTS, SHADES, METRIC_COUNT };
+
+		PixelProfile(unsigned int width, unsigned int height);
+		unsigned int getWidth() const { return _width; }
+		unsigned int getHeight() const { return _height; }
+		PixelCounters& at(unsigned int x, unsigned int y) { return _pixels[y * _width + x]; }
+		const PixelCounters& at(unsigned int x, unsigned int y) const { return _pixels[y * _width + x]; }
+		double getValue(unsigned int x, unsigned int y, Metric metric) const;
+		void clear();
+
+		// False color image of one metric: black for 0, then blue, green, yellow and red at the
+		// 99th percentile, so that a few very expensive pixels don't wash out the rest
+		bool writeHeatmap(const std::string& path, Metric metric) const;
+		// Totals over the frame and per pixel histograms of time, rays and tests
+		void printSummary(std::ostream& out) const;
+		static const char* getMetricName(Metric metric);
+	private:
+		unsigned int _width;
+		unsigned int _height;
+		std::vector<PixelCounters> _pixels;
+	};
+}
+
+#endif
\ No newline at end of file
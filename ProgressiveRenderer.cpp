@@ -0,0 +1,193 @@
+#include "ProgressiveRenderer.h"
+
+#include <chrono>
+#include <cmath>
+
+namespace RayTracing
+{
+	namespace
+	{
+		// Rank of (x, y) in a size x size Bayer matrix, consecutive ranks are spread far apart
+		unsigned int bayer(unsigned int x, unsigned int y, unsigned int size)
+		{
+			if (size == 1)
+			{
+				return 0;
+			}
+			static const unsigned int QUADRANT[2][2] = { { 0, 2 }, { 3, 1 } }; // [y][x]
+			unsigned int half = size / 2;
+			return 4 * bayer(x % half, y % half, half) + QUADRANT[y / half][x / half];
+		}
+
+		// Deterministic subpixel offset in [-0.5, 0.5) for the given sample of a pixel
+		glm::vec2 jitter(unsigned int x, unsigned int y, unsigned int sample)
+		{
+			unsigned int h = x * 73856093u ^ y * 19349663u ^ sample * 83492791u;
+			h ^= h >> 16;
+			h *= 0x7feb352du;
+			h ^= h >> 15;
+			h *= 0x846ca68bu;
+			h ^= h >> 16;
+			return glm::vec2(float(h & 0xffff), float(h >> 16)) / 65536.0f - 0.5f;
+		}
+	}
+
+	ProgressiveRenderer::ProgressiveRenderer(const Scene& scene, unsigned int threadCount, unsigned int tileSize) :
+		_scene(scene), _renderer(scene, threadCount, tileSize), _packetWidth(1), _rasterize(false),
+		_width(0), _height(0), _target(nullptr), _aspect(0.0f), _sceneVersion(0), _restart(true),
+		_pass(0), _step(1), _nextStep(1), _budget(0.0), _fullPassSeconds(0.0)
+	{
+
+	}
+
+	void ProgressiveRenderer::setPacketWidth(unsigned int width)
+	{
+		_packetWidth = width;
+		_renderer.setPacketWidth(width);
+		_sceneVersion = _scene.getVersion();
+	}
+
+	void ProgressiveRenderer::setRasterize(bool rasterize)
+	{
+		_rasterize = rasterize;
+		_renderer.setRasterize(rasterize);
+		_sceneVersion = _scene.getVersion();
+	}
+
+	void ProgressiveRenderer::setStep(unsigned int step)
+	{
+		_nextStep = 1;
+		while (_nextStep * 2 <= std::min(step, MAX_STEP))
+		{
+			_nextStep *= 2;
+		}
+	}
+
+	float ProgressiveRenderer::getSamplesPerPixel() const
+	{
+		unsigned long long samples = 0;
+		for (unsigned int count : _counts)
+		{
+			samples += count;
+		}
+		return _counts.empty() ? 0.0f : float(samples) / _counts.size();
+	}
+
+	bool ProgressiveRenderer::cameraChanged(const Camera& camera) const
+	{
+		return camera.getPosition() != _position || camera.getFront() != _front ||
+			camera.getUp() != _up || camera.getAspect() != _aspect;
+	}
+
+	void ProgressiveRenderer::restart(const Camera& camera, unsigned int width, unsigned int height)
+	{
+		if (_scene.getVersion() != _sceneVersion)
+		{
+			// The packet tracer and the rasterizer hold a copy of the scene
+			_renderer.setPacketWidth(_packetWidth);
+			_renderer.setRasterize(_rasterize);
+			_sceneVersion = _scene.getVersion();
+		}
+
+		_width = width;
+		_height = height;
+		_sums.assign((size_t)width * height, glm::vec3(0.0f));
+		_counts.assign((size_t)width * height, 0);
+		_position = camera.getPosition();
+		_front = camera.getFront();
+		_up = camera.getUp();
+		_aspect = camera.getAspect();
+		_restart = false;
+		_pass = 0;
+
+		_step = _nextStep;
+		if (_budget > 0.0 && _fullPassSeconds > 0.0)
+		{
+			_step = 1;
+			while (_step < MAX_STEP && _fullPassSeconds / (_step * _step) > _budget)
+			{
+				_step *= 2;
+			}
+		}
+		_order.assign(_step * _step, glm::uvec2(0, 0));
+		for (unsigned int y = 0; y < _step; y++)
+		{
+			for (unsigned int x = 0; x < _step; x++)
+			{
+				_order[bayer(x, y, _step)] = glm::uvec2(x, y);
+			}
+		}
+	}
+
+	void ProgressiveRenderer::render(const Camera& camera, FrameBuffer& frameBuffer)
+	{
+		unsigned int width = frameBuffer.getWidth();
+		unsigned int height = frameBuffer.getHeight();
+		if (_restart || width != _width || height != _height || cameraChanged(camera) || _scene.getVersion() != _sceneVersion)
+		{
+			restart(camera, width, height);
+		}
+		bool fullWrite = _pass == 0 || &frameBuffer != _target;
+		_target = &frameBuffer;
+
+		// The first sample of a pixel is taken at the pixel position itself, so one pass at
+		// step 1 gives the same image as Renderer
+		glm::uvec2 offset = _order[_pass % _order.size()];
+		SampleGrid grid;
+		grid.width = width;
+		grid.height = height;
+		grid.step = _step;
+		grid.offsetX = offset.x;
+		grid.offsetY = offset.y;
+		// Textures are filtered as wide as the spacing of the samples a pixel has after this pass
+		grid.footprint = 1.0f / std::sqrt(float(_pass / _order.size() + 1));
+		if (_pass >= _order.size())
+		{
+			// Every pixel has its first sample after step * step passes. Until then there is
+			// no jitter, which lets the renderer use the rasterizer
+			grid.jitter = [&](unsigned int x, unsigned int y)
+			{
+				unsigned int count = _counts[(size_t)y * _width + x];
+				return count == 0 ? glm::vec2(0.0f) : jitter(x, y, count);
+			};
+		}
+		grid.store = [&](unsigned int x, unsigned int y, const glm::vec3& color)
+		{
+			size_t index = (size_t)y * _width + x;
+			_sums[index] += color;
+			_counts[index]++;
+			frameBuffer.setPixel(x, y, _sums[index] / float(_counts[index]));
+		};
+
+		auto begin = std::chrono::steady_clock::now();
+		_renderer.renderSamples(camera, grid);
+		auto end = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>(end - begin).count();
+		_fullPassSeconds = seconds * _step * _step;
+
+		if (fullWrite)
+		{
+			fillBlocks(frameBuffer);
+		}
+		_pass++;
+	}
+
+	// Pixels without samples yet show the pixel traced first in their block
+	void ProgressiveRenderer::fillBlocks(FrameBuffer& frameBuffer) const
+	{
+		for (unsigned int y = 0; y < _height; y++)
+		{
+			for (unsigned int x = 0; x < _width; x++)
+			{
+				size_t index = (size_t)y * _width + x;
+				if (_counts[index] > 0)
+				{
+					frameBuffer.setPixel(x, y, _sums[index] / float(_counts[index]));
+					continue;
+				}
+				size_t first = (size_t)(y - y % _step + _order[0].y) * _width + (x - x % _step + _order[0].x);
+				frameBuffer.setPixel(x, y, _counts[first] > 0 ? _sums[first] / float(_counts[first]) : glm::vec3(0.0f));
+			}
+		}
+	}
+}
\ No newline at end of file
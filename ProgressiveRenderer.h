@@ -0,0 +1,62 @@
+#ifndef RAY_TRACING_PROGRESSIVE_RENDERER_H
+#define RAY_TRACING_PROGRESSIVE_RENDERER_H
+
+#include "Renderer.h"
+
+#include <vector>
+
+namespace RayTracing
+{
+	// Renders into an accumulation buffer that keeps refining with jittered samples while
+	// the camera and the scene stay the same, and starts over when either changes.
+	// A pass traces one pixel of every step x step block, in Bayer order, so right after a
+	// change the image appears at reduced resolution and fills in over step * step passes.
+	// With a frame budget the step is chosen at every restart so a pass fits the budget.
+	class ProgressiveRenderer
+	{
+	public:
+		ProgressiveRenderer(const Scene& scene, unsigned int threadCount = 0, unsigned int tileSize = 32);
+		// Traces one pass and writes the current estimate to frameBuffer. Pass the same frame buffer
+		// every time: between restarts only the pixels traced in the pass are written.
+		void render(const Camera& camera, FrameBuffer& frameBuffer);
+		void reset() { _restart = true; } // for changes the scene version does not cover
+		void setPacketWidth(unsigned int width);
+		void setRasterize(bool rasterize); // see Renderer::setRasterize, used until the first jittered pass
+		void setStep(unsigned int step); // rounded down to a power of two, at most MAX_STEP, applied at the next restart
+		void setFrameBudget(double seconds) { _budget = seconds; } // 0 keeps the step fixed
+		unsigned int getStep() const { return _step; }
+		unsigned int getPassCount() const { return _pass; } // since the last restart
+		float getSamplesPerPixel() const;
+		Renderer& getRenderer() { return _renderer; }
+
+		static const unsigned int MAX_STEP = 8;
+	private:
+		bool cameraChanged(const Camera& camera) const;
+		void restart(const Camera& camera, unsigned int width, unsigned int height);
+		void fillBlocks(FrameBuffer& frameBuffer) const;
+
+		const Scene& _scene;
+		Renderer _renderer;
+		unsigned int _packetWidth;
+		bool _rasterize;
+
+		std::vector<glm::vec3> _sums;
+		std::vector<unsigned int> _counts;
+		unsigned int _width;
+		unsigned int _height;
+		const FrameBuffer* _target; // written to in the last pass
+		glm::vec3 _position, _front, _up;
+		float _aspect;
+		unsigned long long _sceneVersion;
+		bool _restart;
+
+		unsigned int _pass;
+		unsigned int _step;
+		unsigned int _nextStep;
+		std::vector<glm::uvec2> _order; // offset inside a block traced by each pass, Bayer order
+		double _budget;
+		double _fullPassSeconds; // estimated cost of tracing every pixel once, 0 until measured
+	};
+}
+
+#endif
\ No newline at end of file
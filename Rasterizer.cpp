@@ -0,0 +1,326 @@
+#include "Rasterizer.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <typeinfo>
+
+namespace RayTracing
+{
+	const unsigned int Rasterizer::NO_TRIANGLE = 0xffffffffu;
+
+	namespace
+	{
+		// First index >= begin of the form offset + k * step
+		unsigned int firstSample(unsigned int begin, unsigned int offset, unsigned int step)
+		{
+			return begin + (offset % step + step - begin % step) % step;
+		}
+
+		// ceil and floor of a pixel coordinate, clamped to [-1, size] first so the cast can't overflow.
+		// Cheaper than std::ceil and std::floor, which are library calls without SSE4.1.
+		int ceilPixel(float x, unsigned int size)
+		{
+			x = std::min(std::max(x, -1.0f), (float)size);
+			int i = (int)x;
+			return (float)i < x ? i + 1 : i;
+		}
+
+		int floorPixel(float x, unsigned int size)
+		{
+			x = std::min(std::max(x, -1.0f), (float)size);
+			int i = (int)x;
+			return (float)i > x ? i - 1 : i;
+		}
+
+		void linear(float* f, const glm::vec3& n, const glm::vec3& dx, const glm::vec3& dy, const glm::vec3& d0)
+		{
+			f[0] = glm::dot(dx, n);
+			f[1] = glm::dot(dy, n);
+			f[2] = glm::dot(d0, n);
+		}
+	}
+
+	Rasterizer::Rasterizer() : _scene(nullptr), _width(0), _height(0), _tileSize(1)
+	{
+
+	}
+
+	void Rasterizer::build(const Scene& scene)
+	{
+		_scene = &scene;
+		_vertices.clear();
+		_indices.clear();
+		_refs.clear();
+		_boundedEntitys.clear();
+		_unboundedEntitys.clear();
+
+		const EntityStore& store = scene.getStore();
+		std::vector<AABB> bounds;
+		for (unsigned int i = 0; i < store.getTriangleCount(); i++)
+		{
+			unsigned int first = (unsigned int)_vertices.size();
+			glm::vec3 A, B, C;
+			store.getTriangle(i).getVertice(A, B, C);
+			_vertices.push_back(A);
+			_vertices.push_back(B);
+			_vertices.push_back(C);
+			for (unsigned int corner = 0; corner < 3; corner++)
+			{
+				_indices.push_back(first + corner);
+			}
+			_refs.push_back({ &store.getTriangle(i), 0 });
+		}
+		for (unsigned int i = 0; i < store.getSphereCount(); i++)
+		{
+			_boundedEntitys.push_back(&store.getSphere(i));
+			bounds.push_back(store.getSphere(i).getBounds());
+		}
+		for (unsigned int i = 0; i < store.getPlaneCount(); i++)
+		{
+			_unboundedEntitys.push_back(&store.getPlane(i));
+		}
+		for (const Entity* pEntity : scene.getOtherEntitys())
+		{
+			unsigned int first = (unsigned int)_vertices.size();
+			if (typeid(*pEntity) == typeid(Mesh))
+			{
+				const Mesh* mesh = static_cast<const Mesh*>(pEntity);
+				_vertices.insert(_vertices.end(), mesh->getPositions().begin(), mesh->getPositions().end());
+				for (unsigned int i = 0; i < mesh->getTriangleCount(); i++)
+				{
+					for (int corner = 0; corner < 3; corner++)
+					{
+						_indices.push_back(first + mesh->getPositionIndex(i, corner));
+					}
+					_refs.push_back({ pEntity, i });
+				}
+			}
+			else if (pEntity->isBounded())
+			{
+				_boundedEntitys.push_back(pEntity);
+				bounds.push_back(pEntity->getBounds());
+			}
+			else
+			{
+				_unboundedEntitys.push_back(pEntity);
+			}
+		}
+		_bvh.build(bounds);
+	}
+
+	void Rasterizer::setup(const Camera& camera, unsigned int width, unsigned int height, unsigned int tileSize)
+	{
+		_width = width;
+		_height = height;
+		_tileSize = std::max(1u, tileSize);
+		unsigned int tilesX = (width + _tileSize - 1) / _tileSize;
+		unsigned int tilesY = (height + _tileSize - 1) / _tileSize;
+		_bins.resize((size_t)tilesX * tilesY);
+		for (auto& bin : _bins)
+		{
+			bin.clear();
+		}
+		_ids.resize((size_t)width * height);
+		_depths.resize((size_t)width * height);
+		_screenTriangles.clear();
+		if (width == 0 || height == 0)
+		{
+			return;
+		}
+
+		// Camera::generateRay(x, y) points along front + x * right * aspect + y * up, and pixel (i, j)
+		// is sampled at x = 2 * i / width - 1, y = 2 * j / height - 1
+		glm::vec3 origin = camera.getPosition();
+		glm::vec3 front = camera.getFront();
+		glm::vec3 right = camera.getRight() * camera.getAspect();
+		glm::vec3 up = camera.getUp();
+		glm::vec3 dx = right * (2.0f / width);
+		glm::vec3 dy = up * (2.0f / height);
+		glm::vec3 d0 = front - right - up;
+
+		// Rows of the inverse of [front right up], giving the coordinates of a point in that basis
+		glm::vec3 rowFront = glm::cross(right, up);
+		glm::vec3 rowRight = glm::cross(up, front);
+		glm::vec3 rowUp = glm::cross(front, right);
+		float det = glm::dot(front, rowFront);
+		if (std::abs(det) < FLOAT_EPS)
+		{
+			return;
+		}
+		rowFront /= det;
+		rowRight /= det;
+		rowUp /= det;
+
+		_projected.resize(_vertices.size());
+		for (size_t i = 0; i < _vertices.size(); i++)
+		{
+			glm::vec3 v = _vertices[i] - origin;
+			float depth = glm::dot(v, rowFront);
+			float inverse = depth > FLOAT_EPS ? 1.0f / depth : 0.0f;
+			_projected[i] = glm::vec3((glm::dot(v, rowRight) * inverse + 1.0f) * 0.5f * width,
+				(glm::dot(v, rowUp) * inverse + 1.0f) * 0.5f * height, depth);
+		}
+
+		for (unsigned int i = 0; i < _refs.size(); i++)
+		{
+			// Pixel bounds from the projected vertices. A triangle reaching behind the camera
+			// may cover any pixel, the edge functions sort it out.
+			const unsigned int* corners = &_indices[i * 3];
+			float minX = FLOAT_INF, minY = FLOAT_INF, maxX = -FLOAT_INF, maxY = -FLOAT_INF;
+			unsigned int behind = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				const glm::vec3& p = _projected[corners[k]];
+				if (p.z <= FLOAT_EPS)
+				{
+					behind++;
+					continue;
+				}
+				minX = std::min(minX, p.x);
+				minY = std::min(minY, p.y);
+				maxX = std::max(maxX, p.x);
+				maxY = std::max(maxY, p.y);
+			}
+			if (behind == 3)
+			{
+				continue;
+			}
+			ScreenTriangle screen;
+			if (behind > 0)
+			{
+				screen.minX = 0;
+				screen.minY = 0;
+				screen.maxX = (int)width - 1;
+				screen.maxY = (int)height - 1;
+			}
+			else
+			{
+				// Pixels are sampled at integer positions, small triangles between them cover none.
+				// The slack is for rounding, coverage is decided by the edge functions.
+				const float SLACK = 1e-3f;
+				screen.minX = std::max(0, ceilPixel(minX - SLACK, width));
+				screen.minY = std::max(0, ceilPixel(minY - SLACK, height));
+				screen.maxX = std::min((int)width - 1, floorPixel(maxX + SLACK, width));
+				screen.maxY = std::min((int)height - 1, floorPixel(maxY + SLACK, height));
+				if (screen.minX > screen.maxX || screen.minY > screen.maxY)
+				{
+					continue;
+				}
+			}
+
+			const glm::vec3 v[3] = { _vertices[corners[0]] - origin, _vertices[corners[1]] - origin, _vertices[corners[2]] - origin };
+			glm::vec3 normal = glm::cross(v[1] - v[0], v[2] - v[0]);
+			if (normal == glm::vec3(0.0f))
+			{
+				continue; // degenerate
+			}
+
+			// A shared edge gives exactly negated edge functions in both triangles, so no pixel falls through
+			linear(screen.edges[0], glm::cross(v[1], v[2]), dx, dy, d0);
+			linear(screen.edges[1], glm::cross(v[2], v[0]), dx, dy, d0);
+			linear(screen.edges[2], glm::cross(v[0], v[1]), dx, dy, d0);
+			linear(screen.denominator, normal, dx, dy, d0);
+			screen.numerator = glm::dot(v[0], normal);
+			screen.triangle = i;
+
+			unsigned int index = (unsigned int)_screenTriangles.size();
+			_screenTriangles.push_back(screen);
+			for (unsigned int ty = screen.minY / _tileSize; ty <= screen.maxY / _tileSize; ty++)
+			{
+				for (unsigned int tx = screen.minX / _tileSize; tx <= screen.maxX / _tileSize; tx++)
+				{
+					_bins[ty * tilesX + tx].push_back(index);
+				}
+			}
+		}
+	}
+
+	void Rasterizer::rasterizeTile(unsigned int tile, unsigned int step, unsigned int offsetX, unsigned int offsetY)
+	{
+		unsigned int tilesX = (_width + _tileSize - 1) / _tileSize;
+		unsigned int x0 = tile % tilesX * _tileSize;
+		unsigned int y0 = tile / tilesX * _tileSize;
+		unsigned int x1 = std::min(x0 + _tileSize, _width);
+		unsigned int y1 = std::min(y0 + _tileSize, _height);
+		unsigned int firstX = firstSample(x0, offsetX, step);
+		unsigned int firstY = firstSample(y0, offsetY, step);
+		for (unsigned int j = firstY; j < y1; j += step)
+		{
+			for (unsigned int i = firstX; i < x1; i += step)
+			{
+				_ids[(size_t)j * _width + i] = NO_TRIANGLE;
+				_depths[(size_t)j * _width + i] = FLOAT_INF;
+			}
+		}
+
+		for (unsigned int index : _bins[tile])
+		{
+			const ScreenTriangle& screen = _screenTriangles[index];
+			unsigned int beginX = firstSample(std::max(x0, (unsigned int)screen.minX), offsetX, step);
+			unsigned int beginY = firstSample(std::max(y0, (unsigned int)screen.minY), offsetY, step);
+			unsigned int endX = std::min(x1, (unsigned int)screen.maxX + 1);
+			unsigned int endY = std::min(y1, (unsigned int)screen.maxY + 1);
+			for (unsigned int j = beginY; j < endY; j += step)
+			{
+				float y = (float)j;
+				for (unsigned int i = beginX; i < endX; i += step)
+				{
+					float x = (float)i;
+					float e0 = screen.edges[0][0] * x + screen.edges[0][1] * y + screen.edges[0][2];
+					float e1 = screen.edges[1][0] * x + screen.edges[1][1] * y + screen.edges[1][2];
+					float e2 = screen.edges[2][0] * x + screen.edges[2][1] * y + screen.edges[2][2];
+					bool inside = (e0 >= 0.0f && e1 >= 0.0f && e2 >= 0.0f) || (e0 <= 0.0f && e1 <= 0.0f && e2 <= 0.0f);
+					if (!inside)
+					{
+						continue;
+					}
+					float denominator = screen.denominator[0] * x + screen.denominator[1] * y + screen.denominator[2];
+					if (denominator == 0.0f)
+					{
+						continue; // seen edge on
+					}
+					float depth = screen.numerator / denominator;
+					size_t pixel = (size_t)j * _width + i;
+					if (depth > 0.0f && depth < _depths[pixel])
+					{
+						_depths[pixel] = depth;
+						_ids[pixel] = screen.triangle;
+					}
+				}
+			}
+		}
+	}
+
+	HitRecord Rasterizer::getHitRecord(unsigned int x, unsigned int y, const Ray& ray) const
+	{
+		HitRecord hit;
+		unsigned int triangle = _ids[(size_t)y * _width + x];
+		if (triangle != NO_TRIANGLE)
+		{
+			// The exact hit comes from the same test the ray caster uses
+			const unsigned int* index = &_indices[triangle * 3];
+			glm::vec3 A = _vertices[index[0]];
+			float t, u, w;
+			if (!Triangle::intersect(ray, A, _vertices[index[1]] - A, _vertices[index[2]] - A, t, u, w) || t < FLOAT_EPS)
+			{
+				return _scene->getIntersection(ray); // on an edge and missed by rounding
+			}
+			hit.t = t;
+			hit.entity = _refs[triangle].entity;
+			hit.primitive = _refs[triangle].primitive;
+			hit.uv = glm::vec2(u, w);
+		}
+
+		_bvh.traverse(ray, hit.t, [&](unsigned int index, float tMax)
+		{
+			_boundedEntitys[index]->rayIntersect(ray, hit);
+			return hit.t;
+		});
+		for (auto pEntity : _unboundedEntitys)
+		{
+			pEntity->rayIntersect(ray, hit);
+		}
+		return hit;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef RAY_TRACING_RASTERIZER_H
+#define RAY_TRACING_RASTERIZER_H
+
+#include "BVH.h"
+#include "Camera.h"
+#include "RayTracing.h"
+
+#include <vector>
+
+namespace RayTracing
+{
+	// First hits of primary rays found by rasterizing the scene's triangles into a visibility
+	// buffer (closest triangle and depth per pixel) instead of tracing a ray per pixel.
+	// All primary rays start at the camera, so every triangle is projected once per frame and only
+	// covers the pixels it actually hits. Pixels are sampled at (x, y) like an unjittered Renderer.
+	// Entities other than triangles and meshes are ray cast per pixel, up to the rasterized depth.
+	// The scene is copied by build, rebuild after the scene changes.
+	class Rasterizer
+	{
+	public:
+		Rasterizer();
+		void build(const Scene& scene);
+		size_t getTriangleCount() const { return _refs.size(); }
+
+		// Projects the triangles for this camera and sorts them into square tiles, numbered
+		// row by row like Renderer's tiles
+		void setup(const Camera& camera, unsigned int width, unsigned int height, unsigned int tileSize);
+		unsigned int getTileCount() const { return (unsigned int)_bins.size(); }
+		// Fills the visibility buffer for the pixels (offsetX + k * step, offsetY + l * step) of one tile.
+		// Different tiles may be rasterized by different threads at once.
+		void rasterizeTile(unsigned int tile, unsigned int step = 1, unsigned int offsetX = 0, unsigned int offsetY = 0);
+		// The closest hit of the primary ray of a rasterized pixel, as Scene::getIntersection would report it
+		HitRecord getHitRecord(unsigned int x, unsigned int y, const Ray& ray) const;
+
+		static const unsigned int NO_TRIANGLE;
+	private:
+		struct TriangleRef
+		{
+			const Entity* entity;
+			unsigned int primitive; // the triangle for meshes
+		};
+		// A triangle projected for the current camera. The edge functions and the denominator are
+		// linear in the pixel position: f(x, y) = a * x + b * y + c
+		struct ScreenTriangle
+		{
+			float edges[3][3]; // a, b, c of dot(direction(x, y), (Vi - O) x (Vj - O)), same sign inside
+			float denominator[3]; // dot(direction(x, y), N)
+			float numerator; // dot(V0 - O, N), t along the unnormalized direction is numerator / denominator
+			int minX, minY, maxX, maxY; // pixel bounds, clamped to the image
+			unsigned int triangle;
+		};
+
+		const Scene* _scene;
+		std::vector<glm::vec3> _vertices; // shared by the triangles of a mesh, so each is projected once
+		std::vector<unsigned int> _indices; // 3 per triangle
+		std::vector<TriangleRef> _refs;
+		BVH _bvh; // over the bounded entities that are not rasterized
+		std::vector<const Entity*> _boundedEntitys;
+		std::vector<const Entity*> _unboundedEntitys;
+
+		// Current frame
+		std::vector<glm::vec3> _projected; // pixel x, y and depth along front of each vertex
+		std::vector<ScreenTriangle> _screenTriangles;
+		std::vector<std::vector<unsigned int>> _bins; // screen triangles overlapping each tile
+		std::vector<unsigned int> _ids; // visibility buffer: triangle per pixel or NO_TRIANGLE
+		std::vector<float> _depths;
+		unsigned int _width;
+		unsigned int _height;
+		unsigned int _tileSize;
+	};
+}
+
+#endif
\ No newline at end of file
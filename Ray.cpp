@@ -2,7 +2,14 @@
 
 namespace RayTracing
 {
-	Ray::Ray(glm::vec3 src, glm::vec3 dest) : _vertex(src), _direction(glm::normalize(dest - src))
+	Ray::Ray(glm::vec3 src, glm::vec3 dest) :
+		_vertex(src), _direction(glm::normalize(dest - src)), _invDirection(1.0f / _direction), _tMin(FLOAT_EPS), _tMax(FLOAT_INF), _hasDifferential(false)
+	{
+
+	}
+
+	Ray::Ray(const glm::vec3& origin, const glm::vec3& direction, UnitDirection, float tMin, float tMax) :
+		_vertex(origin), _direction(direction), _invDirection(1.0f / direction), _tMin(tMin), _tMax(tMax), _hasDifferential(false)
 	{
 
 	}
@@ -10,16 +10,43 @@ namespace RayTracing
 	static const float FLOAT_INF = 100000000.0f;
 	static const float FLOAT_EPS = 1e-5;
 	static const glm::vec3 NULL_POINT(FLOAT_INF, FLOAT_INF, FLOAT_INF);
+
+	// How the origin and direction of a ray change from one pixel to the next in x and y (Igehy's ray
+	// differentials). Followed through reflection and refraction, they give the footprint of a pixel at a hit.
+	struct RayDifferential
+	{
+		glm::vec3 dOdx, dOdy;
+		glm::vec3 dDdx, dDdy;
+	};
+
 	class Ray
 	{
 	public:
+		// Tag of the constructor that takes a direction as it is
+		struct UnitDirection {};
+
 		Ray(glm::vec3 src, glm::vec3 dest);
+		// direction must already be unit length, e.g. the reflection of a unit direction; it isn't normalized again
+		Ray(const glm::vec3& origin, const glm::vec3& direction, UnitDirection, float tMin = FLOAT_EPS, float tMax = FLOAT_INF);
 		glm::vec3 pointAtT(float t) const;
 		glm::vec3 getVertex() const { return _vertex; }
 		glm::vec3 getDirection() const { return _direction; }
+		glm::vec3 getInvDirection() const { return _invDirection; } // for slab tests, infinite along axes the ray is parallel to
+		// Only hits with tMin < t < tMax count. tMin keeps rays leaving a surface from hitting it again.
+		float getTMin() const { return _tMin; }
+		float getTMax() const { return _tMax; }
+		// Optional, rays without differentials are shaded as points
+		void setDifferential(const RayDifferential& differential) { _differential = differential; _hasDifferential = true; }
+		bool hasDifferential() const { return _hasDifferential; }
+		const RayDifferential& getDifferential() const { return _differential; }
 	private:
 		glm::vec3 _vertex;
 		glm::vec3 _direction;
+		glm::vec3 _invDirection;
+		float _tMin;
+		float _tMax;
+		bool _hasDifferential;
+		RayDifferential _differential; // only set if _hasDifferential
 	};
 }
 
@@ -0,0 +1,62 @@
+#ifndef RAY_TRACING_RAY_PACKET_H
+#define RAY_TRACING_RAY_PACKET_H
+
+// Plain data shared with the SIMD kernels. This header must stay free of glm and the
+// standard library: it is included by translation units compiled for AVX2 and AVX-512,
+// and inline functions instantiated there could end up in code that runs on older CPUs.
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define RAY_TRACING_PACKET_X86 // the kernels are only built for x86
+#endif
+
+namespace RayTracing
+{
+	// Structure of arrays, one ray per lane
+	struct alignas(64) RayPacket
+	{
+		static const unsigned int MAX_WIDTH = 16;
+
+		float originX[MAX_WIDTH], originY[MAX_WIDTH], originZ[MAX_WIDTH];
+		float directionX[MAX_WIDTH], directionY[MAX_WIDTH], directionZ[MAX_WIDTH];
+		float invDirectionX[MAX_WIDTH], invDirectionY[MAX_WIDTH], invDirectionZ[MAX_WIDTH];
+		float tMin[MAX_WIDTH], tMax[MAX_WIDTH]; // only hits with tMin < t < tMax count, as for Ray
+
+		// Results: closest t, primitive index (-1 on a miss) and barycentrics for triangles
+		float t[MAX_WIDTH];
+		float u[MAX_WIDTH];
+		float v[MAX_WIDTH];
+		int primitive[MAX_WIDTH];
+
+		unsigned int count; // active lanes, the rest is ignored
+	};
+
+	struct PacketNode
+	{
+		float min[3];
+		float max[3];
+		unsigned int first; // first primitive for a leaf, left child for an interior node (right child is first + 1)
+		unsigned int count; // 0 for interior nodes
+	};
+
+	// Flattened scene. Primitive ids below sphereCount are spheres, the others triangles.
+	// Planes are unbounded and tested against every packet; their ids follow the triangles.
+	struct PacketScene
+	{
+		const PacketNode* nodes;
+		unsigned int nodeCount;
+		const unsigned int* primitives; // in BVH leaf order
+		const float* spheres; // center x, y, z, radius^2
+		unsigned int sphereCount;
+		const float* triangles; // A, B - A, C - A
+		unsigned int triangleCount;
+		const float* planes; // unit normal, distance from the origin along it
+		unsigned int planeCount;
+	};
+
+	// Closest hits of the first width rays, width is the kernel's SIMD width
+	void intersectPacketSSE(const PacketScene& scene, RayPacket& packet); // 4 lanes
+	void intersectPacketAVX2(const PacketScene& scene, RayPacket& packet); // 8 lanes
+	void intersectPacketAVX512(const PacketScene& scene, RayPacket& packet); // 16 lanes
+}
+
+#endif
\ No newline at end of file
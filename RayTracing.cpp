@@ -1,16 +1,74 @@
 #include "RayTracing.h"
+#include "Profile.h"
+
+#include <cmath>
+#include <cstring>
+#include <typeinfo>
 
 namespace RayTracing
 {
+	namespace
+	{
+		unsigned int hash(unsigned int h)
+		{
+			h ^= h >> 16;
+			h *= 0x7feb352du;
+			h ^= h >> 15;
+			h *= 0x846ca68bu;
+			h ^= h >> 16;
+			return h;
+		}
+
+		// [0, 1) state ÿεú
+		float nextRandom(unsigned int& state)
+		{
+			state = hash(state);
+			return (state >> 8) * (1.0f / 16777216.0f);
+		}
+
+		// ΢֣Igehy d ĵΪ ddĵΪ dn ʱ䷽ĵ
+		glm::vec3 reflectDerivative(const glm::vec3& d, const glm::vec3& n, const glm::vec3& dd, const glm::vec3& dn)
+		{
+			return dd - 2.0f * (glm::dot(d, n) * dn + (glm::dot(dd, n) + glm::dot(d, dn)) * n);
+		}
+
+		// glm::refract(d, n, eta) = eta * d - mu * n ĵmu = eta * dot(n, d) + sqrt(k)
+		glm::vec3 refractDerivative(const glm::vec3& d, const glm::vec3& n, float eta, const glm::vec3& dd, const glm::vec3& dn)
+		{
+			float cosine = glm::dot(n, d);
+			float root = std::sqrt(std::max(1.0f - eta * eta * (1.0f - cosine * cosine), 0.0f));
+			float mu = eta * cosine + root;
+			float dmu = (eta + eta * eta * cosine / std::max(root, FLOAT_EPS)) * (glm::dot(dd, n) + glm::dot(d, dn));
+			return eta * dd - (mu * dn + dmu * n);
+		}
+
+		// ѱϵƫ dp д dpdudpdv ϣСˣõƫ
+		glm::vec2 toTexCoord(const glm::vec3& dp, const glm::vec3& dpdu, const glm::vec3& dpdv)
+		{
+			float a = glm::dot(dpdu, dpdu), b = glm::dot(dpdu, dpdv), c = glm::dot(dpdv, dpdv);
+			float det = a * c - b * b;
+			if (std::abs(det) < FLOAT_EPS * FLOAT_EPS)
+			{
+				return glm::vec2(0.0f);
+			}
+			float du = glm::dot(dp, dpdu), dv = glm::dot(dp, dpdv);
+			return glm::vec2(c * du - b * dv, a * dv - b * du) / det;
+		}
+	}
+
 	const unsigned int Scene::MAX_RECURSION_TIME = 5;
+	const float Scene::DEFAULT_MIN_WEIGHT = FLOAT_EPS;
+	const float Scene::SHADOW_BIAS = 1e-4f;
+	const unsigned int Scene::DEFAULT_LIGHT_SAMPLES = 4;
 
-	Scene::Scene()
+	Scene::Scene() : _boundedStoreCount(0), _bvhValid(false), _lightTreeValid(false), _maxDepth(MAX_RECURSION_TIME),
+		_minWeight(DEFAULT_MIN_WEIGHT), _shadows(true), _lightSamples(DEFAULT_LIGHT_SAMPLES), _textureFiltering(true), _version(0)
 	{
 
 	}
 	Scene::~Scene()
 	{
-		for (auto ptr : _entitys)
+		for (auto ptr : _ownedEntitys)
 		{
 			delete ptr;
 		}
@@ -19,38 +77,251 @@ namespace RayTracing
 			delete ptr;
 		}
 	}
-	void Scene::addEntity(Entity* entity)
+	EntityHandle Scene::addSphere(const glm::vec3& center, float radius, unsigned int material)
+	{
+		Sphere sphere(center, radius);
+		sphere.setMaterial(material);
+		return added(_store.addSphere(sphere));
+	}
+	EntityHandle Scene::addPlane(const glm::vec3& aPoint, const glm::vec3& normal, unsigned int material)
+	{
+		Plane plane(aPoint, normal);
+		plane.setMaterial(material);
+		return added(_store.addPlane(plane));
+	}
+	EntityHandle Scene::addTriangle(const glm::vec3& A, const glm::vec3& B, const glm::vec3& C, unsigned int material)
+	{
+		Triangle triangle(A, B, C);
+		triangle.setMaterial(material);
+		return added(_store.addTriangle(triangle));
+	}
+	EntityHandle Scene::addEntity(Entity* entity, bool owned)
+	{
+		// 塢ƽθƵŵУౣԼ麯崦
+		EntityHandle handle;
+		const std::type_info& type = typeid(*entity);
+		if (type == typeid(Sphere))
+		{
+			handle = _store.addSphere(*static_cast<Sphere*>(entity));
+		}
+		else if (type == typeid(Plane))
+		{
+			handle = _store.addPlane(*static_cast<Plane*>(entity));
+		}
+		else if (type == typeid(Triangle))
+		{
+			handle = _store.addTriangle(*static_cast<Triangle*>(entity));
+		}
+		else
+		{
+			_entitys.push_back(entity);
+			if (owned)
+			{
+				_ownedEntitys.push_back(entity);
+			}
+			return added(EntityHandle::make(EntityHandle::OTHER, (unsigned int)_entitys.size() - 1));
+		}
+		if (owned)
+		{
+			delete entity;
+		}
+		return added(handle);
+	}
+	EntityHandle Scene::added(EntityHandle handle)
+	{
+		_bvhValid = false;
+		_version++;
+		return handle;
+	}
+	const Entity* Scene::getEntity(EntityHandle handle) const
+	{
+		if (handle.getType() == EntityHandle::OTHER)
+		{
+			return _entitys[handle.getIndex()];
+		}
+		return _store.getEntity(handle);
+	}
+	size_t Scene::getEntityCount() const
 	{
-		_entitys.push_back(entity);
+		return _store.getSphereCount() + _store.getPlaneCount() + _store.getTriangleCount() + _entitys.size();
 	}
 	void Scene::addLight(Light* light)
 	{
 		_lights.push_back(light);
+		_lightTreeValid = false;
+		_version++;
 	}
-	glm::vec3 Scene::traceRay(const Ray& ray, unsigned int recursionTime)
+	void Scene::buildLightTree()
 	{
-		glm::vec3 lightIntensity(0.0f); // ڷصĹǿȣʼΪ0
+		_lightTree.build(_lights);
+		_unboundedLights.clear();
+		for (auto pLight : _lights)
+		{
+			if (!pLight->isBounded())
+			{
+				_unboundedLights.push_back(pLight);
+			}
+		}
+		_lightTreeValid = true;
+		_version++;
+	}
+	void Scene::buildBVH()
+	{
+		std::vector<AABB> bounds;
+		partitionEntitys(&bounds);
+		_bvh.build(bounds);
 
-		// ݹݹ
-		if (recursionTime >= MAX_RECURSION_TIME)
+		// Ҷڵ˳ΣͬһҶڵеڴ
+		unsigned int sphereCount = (unsigned int)_store.getSphereCount();
+		std::vector<unsigned int> sphereOrder, triangleOrder, map(bounds.size());
+		for (unsigned int primitive : _bvh.getPrimitives())
 		{
-			return lightIntensity;
+			if (primitive < sphereCount)
+			{
+				map[primitive] = (unsigned int)sphereOrder.size();
+				sphereOrder.push_back(primitive);
+			}
+			else if (primitive < _boundedStoreCount)
+			{
+				map[primitive] = sphereCount + (unsigned int)triangleOrder.size();
+				triangleOrder.push_back(primitive - sphereCount);
+			}
+			else
+			{
+				map[primitive] = primitive;
+			}
+		}
+		_store.reorder(sphereOrder, triangleOrder);
+		_bvh.remapPrimitives(map);
+		_bvhValid = true;
+		buildLightTree();
+	}
+	void Scene::setBVH(BVH bvh)
+	{
+		partitionEntitys(nullptr);
+		_bvh = std::move(bvh);
+		_bvhValid = true;
+		buildLightTree();
+	}
+	void Scene::setSphere(EntityHandle handle, const glm::vec3& center, float radius)
+	{
+		_store.setSphere(handle, center, radius);
+		_version++;
+	}
+	void Scene::setPlane(EntityHandle handle, const glm::vec3& aPoint, const glm::vec3& normal)
+	{
+		_store.setPlane(handle, aPoint, normal);
+		_version++;
+	}
+	void Scene::setTriangle(EntityHandle handle, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C)
+	{
+		_store.setTriangle(handle, A, B, C);
+		_version++;
+	}
+	void Scene::refitBVH()
+	{
+		if (!_bvhValid)
+		{
+			buildBVH();
+			return;
+		}
+		// ʱBVHͼԪŲ䣬ֻ°Χ
+		std::vector<AABB> bounds;
+		partitionEntitys(&bounds);
+		_bvh.refit(bounds);
+		_version++;
+	}
+	void Scene::partitionEntitys(std::vector<AABB>* bounds)
+	{
+		// ƽ޽磬BVHBVHе塢κн
+		_boundedStoreCount = (unsigned int)(_store.getSphereCount() + _store.getTriangleCount());
+		_boundedEntitys.clear();
+		_unboundedEntitys.clear();
+		if (bounds != nullptr)
+		{
+			for (unsigned int i = 0; i < _store.getSphereCount(); i++)
+			{
+				bounds->push_back(_store.getSphere(i).getBounds());
+			}
+			for (unsigned int i = 0; i < _store.getTriangleCount(); i++)
+			{
+				bounds->push_back(_store.getTriangle(i).getBounds());
+			}
+		}
+		for (auto pEntity : _entitys)
+		{
+			if (pEntity->isBounded())
+			{
+				_boundedEntitys.push_back(pEntity);
+				if (bounds != nullptr)
+				{
+					bounds->push_back(pEntity->getBounds());
+				}
+			}
+			else
+			{
+				_unboundedEntitys.push_back(pEntity);
+			}
 		}
+	}
+	glm::vec3 Scene::traceRay(const Ray& ray, TraceStats* stats) const
+	{
+		glm::vec3 lightIntensity(0.0f); // ڷصĹǿȣʼΪ0
 
 		// ĽԼ
-		const auto pointAndEntity = getIntersection(ray);
-		const Entity* collidedEntityPtr = pointAndEntity.second;
+		const HitRecord hit = getIntersection(ray);
+		if (stats != nullptr)
+		{
+			stats->rays++;
+		}
+		RAY_TRACING_COUNT(rays[0]);
 
-		// ݹû䵽
-		if (collidedEntityPtr == nullptr)
+		// û䵽
+		if (hit.entity == nullptr)
 		{
 			return lightIntensity;
 		}
-		
-		// 㼰䷨
-		glm::vec3 collidedPoint = pointAndEntity.first;
-		glm::vec3 normal = glm::normalize(collidedEntityPtr->calNormal(collidedPoint));
-		bool enterEntity = collidedEntityPtr->rayInEntity(ray);
+
+		return traceHit(ray, hit, stats);
+	}
+
+	glm::vec3 Scene::traceHit(const Ray& ray, const HitRecord& hit, TraceStats* stats) const
+	{
+		// 䡢߲ٵݹ׷٣ͬȨأɫĹϵһѹջС
+		// ʱÿһ׷ٵĹߣջΪ
+		TraceBranch stack[MAX_TRACE_DEPTH];
+		unsigned int size = 0;
+
+		glm::vec3 lightIntensity = shadeBranch(ray, hit, 1.0f, 0, stack, size, stats);
+		while (size > 0)
+		{
+			TraceBranch branch = stack[--size];
+			Ray branchRay = branch.getRay();
+			HitRecord branchHit = getIntersection(branchRay);
+			if (stats != nullptr)
+			{
+				stats->rays++;
+			}
+			RAY_TRACING_COUNT(rays[PixelCounters::depthBucket(branch.depth)]);
+			if (branchHit.entity != nullptr)
+			{
+				lightIntensity += shadeBranch(branchRay, branchHit, branch.weight, branch.depth, stack, size, stats);
+			}
+		}
+		return lightIntensity;
+	}
+
+	glm::vec3 Scene::shadeBranch(const Ray& ray, HitRecord hit, float weight, unsigned int depth,
+		TraceBranch* stack, unsigned int& size, TraceStats* stats) const
+	{
+		glm::vec3 lightIntensity(0.0f);
+
+		// 㡢ֻһΣֲ뷴䡢߹
+		completeHit(ray, hit);
+		glm::vec3 collidedPoint = hit.point;
+		glm::vec3 normal = hit.normal;
+		const Material& material = _materials.getMaterial(hit.entity->getMaterial(hit));
+		bool enterEntity = !hit.frontFace;
 		if (enterEntity)
 		{
 			// ǴڲģӦȡ
@@ -60,70 +331,290 @@ namespace RayTracing
 		// ǿȵĵһֲ֣ǿ
 		if (!enterEntity)
 		{
-			lightIntensity = collidedEntityPtr->getMaterial().kShade *
-				shade(*collidedEntityPtr, collidedPoint, ray);
+			lightIntensity = weight * material.kShade *
+				shade(hit, ray);
 		}
-		
 
-		// 㷴䷽
-		glm::vec3 reflectDirection = glm::reflect(ray.getDirection(), normal);
-		
-		// ǿȵĵڶ֣ǿ
-		if (collidedEntityPtr->getMaterial().kReflect > FLOAT_EPS) // > 0
+		// ﵽʱٲµĹ
+		if (depth + 1 >= _maxDepth)
 		{
-			lightIntensity += collidedEntityPtr->getMaterial().kReflect *
-				traceRay(Ray(collidedPoint, collidedPoint + reflectDirection), recursionTime + 1);
+			return lightIntensity;
 		}
 
-		// 
-		float currentIndex = 1.0f;
-		float nextIndex = collidedEntityPtr->getMaterial().refractiveIndex;
-		if (enterEntity)
+		// й΢ʱ䡢ߵ΢еƫƺͷ֮ı仯
+		bool differential = ray.hasDifferential();
+		glm::vec3 dndx(0.0f), dndy(0.0f);
+		if (differential && (material.kReflect > FLOAT_EPS || material.kRefract > FLOAT_EPS))
 		{
-			// ǴڲģҪн
-			std::swap(currentIndex, nextIndex);
+			dndx = hit.entity->calNormalDerivative(collidedPoint, hit, hit.dpdx);
+			dndy = hit.entity->calNormalDerivative(collidedPoint, hit, hit.dpdy);
+			if (enterEntity)
+			{
+				dndx = -dndx;
+				dndy = -dndy;
+			}
 		}
+		const glm::vec3& direction = ray.getDirection();
 
-		// ䷽
-		glm::vec3 refractDirection = glm::refract(ray.getDirection(), normal,  currentIndex / nextIndex);
+		// ǿȵĵڶ֣ߣȨعСķֱ֧
+		float reflectWeight = weight * material.kReflect;
+		if (material.kReflect > FLOAT_EPS) // > 0
+		{
+			if (reflectWeight >= _minWeight)
+			{
+				glm::vec3 reflectDirection = glm::reflect(direction, normal);
+				TraceBranch& branch = stack[size++];
+				branch = { collidedPoint, reflectDirection, reflectWeight, depth + 1 };
+				if (differential)
+				{
+					const RayDifferential& d = ray.getDifferential();
+					branch.hasDifferential = true;
+					branch.differential = { hit.dpdx, hit.dpdy,
+						reflectDerivative(direction, normal, d.dDdx, dndx), reflectDerivative(direction, normal, d.dDdy, dndy) };
+				}
+			}
+			else if (stats != nullptr)
+			{
+				stats->culled++;
+			}
+		}
 
-		// ǿȵĵ֣ǿ
-		if (collidedEntityPtr->getMaterial().kRefract > FLOAT_EPS) // > 0
+		// ǿȵĵ֣
+		float refractWeight = weight * material.kRefract;
+		if (material.kRefract > FLOAT_EPS) // > 0
 		{
-			lightIntensity += collidedEntityPtr->getMaterial().kRefract * 
-				traceRay(Ray(collidedPoint, collidedPoint + refractDirection), recursionTime + 1);
+			if (refractWeight >= _minWeight)
+			{
+				// ʣǴڲģҪн
+				float currentIndex = 1.0f;
+				float nextIndex = material.refractiveIndex;
+				if (enterEntity)
+				{
+					std::swap(currentIndex, nextIndex);
+				}
+				float eta = currentIndex / nextIndex;
+				glm::vec3 refractDirection = glm::refract(direction, normal, eta);
+				if (refractDirection != glm::vec3(0.0f)) // ȫʱû
+				{
+					TraceBranch& branch = stack[size++];
+					branch = { collidedPoint, refractDirection, refractWeight, depth + 1 };
+					if (differential)
+					{
+						const RayDifferential& d = ray.getDifferential();
+						branch.hasDifferential = true;
+						branch.differential = { hit.dpdx, hit.dpdy,
+							refractDerivative(direction, normal, eta, d.dDdx, dndx), refractDerivative(direction, normal, eta, d.dDdy, dndy) };
+					}
+				}
+			}
+			else if (stats != nullptr)
+			{
+				stats->culled++;
+			}
 		}
 
 		return lightIntensity;
 	}
 
-	std::pair<const glm::vec3&, const Entity*> Scene::getIntersection(const Ray& ray)
+	void Scene::setMaxDepth(unsigned int depth)
 	{
-		float minT = FLOAT_INF;
-		const Entity* collidedEntity = nullptr;
-		for (auto pEntity : _entitys)
+		_maxDepth = std::max(1u, std::min(depth, MAX_TRACE_DEPTH));
+		_version++;
+	}
+
+	HitRecord Scene::getIntersection(const Ray& ray) const
+	{
+		HitRecord hit;
+		hit.t = ray.getTMax();
+		if (!_bvhValid)
 		{
-			float t = pEntity->rayCollision(ray);
-			if (t > FLOAT_EPS) // >= 0
+			// ûBVHʱ
+			_store.intersectSpheres(ray, hit);
+			_store.intersectTriangles(ray, hit);
+			_store.intersectPlanes(ray, hit);
+			for (auto pEntity : _entitys)
 			{
-				if (t < minT)
-				{
-					minT = t;
-					collidedEntity = pEntity;
-				}				
+				pEntity->rayIntersect(ray, hit);
 			}
+			return hit;
 		}
 
-		return std::make_pair(ray.pointAtT(minT), collidedEntity);
+		unsigned int sphereCount = (unsigned int)_store.getSphereCount();
+		_bvh.traverse(ray, hit.t, [&](unsigned int index, float tMax)
+		{
+			if (index < sphereCount)
+			{
+				_store.intersectSphere(index, ray, hit);
+			}
+			else if (index < _boundedStoreCount)
+			{
+				_store.intersectTriangle(index - sphereCount, ray, hit);
+			}
+			else
+			{
+				_boundedEntitys[index - _boundedStoreCount]->rayIntersect(ray, hit);
+			}
+			return hit.t;
+		});
+		_store.intersectPlanes(ray, hit);
+		for (auto pEntity : _unboundedEntitys)
+		{
+			pEntity->rayIntersect(ray, hit);
+		}
+		return hit;
 	}
 
-	glm::vec3 Scene::shade(const Entity& entity, glm::vec3 fragPos, const Ray& ray)
+	bool Scene::isOccluded(const Ray& ray, float tMax) const
 	{
+		RAY_TRACING_COUNT(shadowRays);
+		// ƽ޽٣Ȳ
+		if (_store.occludedPlanes(ray, tMax))
+		{
+			return true;
+		}
+		for (auto pEntity : _bvhValid ? _unboundedEntitys : _entitys)
+		{
+			if (pEntity->rayOccluded(ray, tMax))
+			{
+				return true;
+			}
+		}
+		if (!_bvhValid)
+		{
+			return _store.occludedSpheres(ray, tMax) || _store.occludedTriangles(ray, tMax);
+		}
+		unsigned int sphereCount = (unsigned int)_store.getSphereCount();
+		return _bvh.traverseAny(ray, tMax, [&](unsigned int index, float tMax)
+		{
+			if (index < sphereCount)
+			{
+				return _store.occludedSphere(index, ray, tMax);
+			}
+			if (index < _boundedStoreCount)
+			{
+				return _store.occludedTriangle(index - sphereCount, ray, tMax);
+			}
+			return _boundedEntitys[index - _boundedStoreCount]->rayOccluded(ray, tMax);
+		});
+	}
+
+	void Scene::completeHit(const Ray& ray, HitRecord& hit) const
+	{
+		const Entity& entity = *hit.entity;
+		hit.point = ray.pointAtT(hit.t);
+		hit.normal = glm::normalize(entity.calNormal(hit.point, hit));
+		hit.texCoord = entity.calUV(hit.point, hit);
+		// ֻзյڲڲĹеǱ棬һν
+		hit.frontFace = !entity.isClosed() || glm::dot(ray.getDirection(), hit.normal) < 0.0f;
+		hit.dpdx = glm::vec3(0.0f);
+		hit.dpdy = glm::vec3(0.0f);
+		if (ray.hasDifferential())
+		{
+			// صĹеƽཻеƫƼΪ dpdxdpdy
+			const RayDifferential& d = ray.getDifferential();
+			float cosine = glm::dot(ray.getDirection(), hit.normal);
+			if (std::abs(cosine) > FLOAT_EPS)
+			{
+				glm::vec3 dx = d.dOdx + hit.t * d.dDdx;
+				glm::vec3 dy = d.dOdy + hit.t * d.dDdy;
+				hit.dpdx = dx - glm::dot(dx, hit.normal) / cosine * ray.getDirection();
+				hit.dpdy = dy - glm::dot(dy, hit.normal) / cosine * ray.getDirection();
+			}
+		}
+	}
+
+	Ray Scene::TraceBranch::getRay() const
+	{
+		// 䡢䷽ǵλٹһ
+		Ray ray(origin, direction, Ray::UnitDirection());
+		if (hasDifferential)
+		{
+			ray.setDifferential(differential);
+		}
+		return ray;
+	}
+
+	glm::vec3 Scene::shade(const HitRecord& hit, const Ray& ray) const
+	{
+		RAY_TRACING_COUNT(shades);
+		// ֻһΣйԴ
+		const glm::vec3& fragPos = hit.point;
+		unsigned int material = hit.entity->getMaterial(hit);
+		const Texture& normalMap = _materials.getMaterial(material).normal;
+		// ظǵķΧ˲λõƫԹ΢֣ƫֻڷֿҪʱ
+		TextureFootprint footprint;
+		footprint.dpdx = hit.dpdx;
+		footprint.dpdy = hit.dpdy;
+		bool footprintUV = (hit.dpdx != glm::vec3(0.0f) || hit.dpdy != glm::vec3(0.0f)) && _materials.usesTexCoordFootprint(material);
+		glm::vec3 dpdu, dpdv;
+		if (footprintUV || normalMap.type != Texture::CONSTANT)
+		{
+			hit.entity->calTangents(fragPos, hit, dpdu, dpdv);
+		}
+		if (footprintUV)
+		{
+			footprint.duvdx = toTexCoord(hit.dpdx, dpdu, dpdv);
+			footprint.duvdy = toTexCoord(hit.dpdy, dpdu, dpdv);
+		}
+		SurfaceColor surface = _materials.evaluate(material, fragPos, hit.texCoord, footprint);
+		glm::vec3 normal = hit.normal;
+		if (normalMap.type != Texture::CONSTANT)
+		{
+			// ͼ߿ռķߡߺͷ任ռ䣬ֻڹա
+			// vķͬ࣬꾵ʱҲȷ
+			glm::vec3 mapped = 2.0f * _materials.evaluate(normalMap, fragPos, hit.texCoord, footprint) - glm::vec3(1.0f);
+			glm::vec3 tangent = glm::normalize(dpdu - glm::dot(dpdu, normal) * normal);
+			glm::vec3 bitangent = glm::cross(normal, tangent);
+			if (glm::dot(bitangent, dpdv) < 0.0f)
+			{
+				bitangent = -bitangent;
+			}
+			normal = glm::normalize(mapped.x * tangent + mapped.y * bitangent + mapped.z * normal);
+		}
 		glm::vec3 result(0.0f);
-		for (auto pLight : _lights)
+
+		// еɣҪ״̬Ⱦÿһе㶼ͬ
+		unsigned int bits[3];
+		std::memcpy(bits, &fragPos, sizeof(bits));
+		unsigned int state = hash(bits[0] ^ hash(bits[1] ^ hash(bits[2])));
+
+		// λõĹԴÿβʱӹԴаѡԱѡеĸʣȻƫ
+		// ԶĹԴȫ
+		bool sampled = _lightTreeValid && _lightSamples > 0 && _lightTree.getLightCount() > _lightSamples;
+		for (auto pLight : sampled ? _unboundedLights : _lights)
 		{
-			result += pLight->calLight(entity.getMaterial(), fragPos, entity.calNormal(fragPos), ray.getDirection());
+			glm::vec2 u(nextRandom(state), nextRandom(state));
+			result += shadeLight(*pLight, surface, fragPos, normal, ray, u);
+		}
+		if (sampled)
+		{
+			float weight = 1.0f / _lightSamples;
+			for (unsigned int i = 0; i < _lightSamples; i++)
+			{
+				float pdf;
+				const Light* pLight = _lightTree.pick(fragPos, nextRandom(state), pdf);
+				glm::vec2 u(nextRandom(state), nextRandom(state));
+				result += weight / pdf * shadeLight(*pLight, surface, fragPos, normal, ray, u);
+			}
 		}
 		return result;
 	}
+
+	glm::vec3 Scene::shadeLight(const Light& light, const SurfaceColor& surface, const glm::vec3& fragPos,
+		const glm::vec3& normal, const Ray& ray, const glm::vec2& u) const
+	{
+		LightSample sample = light.sample(fragPos, u);
+		float visibility = 1.0f;
+		if (_shadows)
+		{
+			// ԴӰߣطƫƵԴһཻ࣬
+			glm::vec3 offset = SHADOW_BIAS * (glm::dot(normal, sample.direction) < 0.0f ? -normal : normal);
+			glm::vec3 origin = fragPos + offset;
+			if (isOccluded(Ray(origin, sample.direction, Ray::UnitDirection(), FLOAT_EPS, sample.distance), sample.distance))
+			{
+				visibility = 0.0f;
+			}
+		}
+		return light.calLight(surface, fragPos, normal, ray.getDirection(), sample, visibility);
+	}
 }
\ No newline at end of file
@@ -4,26 +4,157 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include "BVH.h"
 #include "Entity.h"
+#include "EntityStore.h"
+#include "LightTree.h"
+#include <memory>
 #include <vector>
 
 namespace RayTracing
 {
+	// Counters filled while tracing when a TraceStats is passed in, one per thread
+	struct TraceStats
+	{
+		unsigned long long rays = 0; // primary and secondary rays intersected with the scene
+		unsigned long long culled = 0; // reflection and refraction rays dropped for their small weight
+	};
+
+	// Tracing (traceRay, getIntersection, shade) is const and writes no shared state,
+	// so any number of threads may trace the same Scene at once as long as no entity
+	// or light is added meanwhile.
 	class Scene
 	{
 	public:
 		Scene();
 		~Scene();
-		void addEntity(Entity* entity);
+		// Spheres, planes and triangles are kept by type in the scene's EntityStore
+		EntityHandle addSphere(const glm::vec3& center, float radius, unsigned int material = 0);
+		EntityHandle addPlane(const glm::vec3& aPoint, const glm::vec3& normal, unsigned int material = 0);
+		EntityHandle addTriangle(const glm::vec3& A, const glm::vec3& B, const glm::vec3& C, unsigned int material = 0);
+		// Move a store entity in place. The BVH is stale until refitBVH or buildBVH is called.
+		void setSphere(EntityHandle handle, const glm::vec3& center, float radius);
+		void setPlane(EntityHandle handle, const glm::vec3& aPoint, const glm::vec3& normal);
+		void setTriangle(EntityHandle handle, const glm::vec3& A, const glm::vec3& B, const glm::vec3& C);
+		void reserve(size_t sphereCount, size_t planeCount, size_t triangleCount) { _store.reserve(sphereCount, planeCount, triangleCount); }
+		// Any other entity. A Sphere, Plane or Triangle is copied into the EntityStore instead, and deleted
+		// right away if owned, so the pointer must not be used afterwards; use the handle.
+		// The scene deletes the other owned entities. The rest must outlive it, e.g. by handing their
+		// storage to addStorage.
+		EntityHandle addEntity(Entity* entity, bool owned = true);
+		void addStorage(std::shared_ptr<void> storage) { _storage.push_back(storage); }
+		// The scene deletes its lights. Lights with a position are only picked from the light tree after
+		// buildLightTree, until then every light is shaded at every hit.
 		void addLight(Light* light);
-		glm::vec3 traceRay(const Ray& ray, unsigned int recursionTime = 0);
-		std::pair<const glm::vec3&, const Entity*> getIntersection(const Ray& ray);
-		glm::vec3 shade(const Entity& entity, glm::vec3 fragPos, const Ray& ray);
+		// Also called by buildBVH and setBVH
+		void buildLightTree();
+		const LightTree& getLightTree() const { return _lightTree; }
+		// Entities refer to materials by their index in this table. Taking it for writing counts as a change.
+		MaterialTable& getMaterials() { _version++; return _materials; }
+		const MaterialTable& getMaterials() const { return _materials; }
+		// Call after adding entities and lights, getIntersection falls back to a linear scan until then.
+		// Also reorders the store's spheres and triangles to follow the BVH leaves; handles stay valid.
+		void buildBVH();
+		// Adopts a BVH built earlier over the bounded entities: the store's spheres and triangles in slot order,
+		// then the other bounded ones in the order they were added
+		void setBVH(BVH bvh);
+		// Updates the BVH bounds after entities moved, without rebuilding or reordering.
+		// For animation: far cheaper than buildBVH, but tracing slows down as the tree loosens.
+		void refitBVH();
+		const BVH& getBVH() const { return _bvh; }
+		size_t getBVHNodeCount() const { return _bvh.getNodeCount(); }
+		const Entity* getEntity(EntityHandle handle) const;
+		size_t getEntityCount() const;
+		const EntityStore& getStore() const { return _store; }
+		// Entities outside the EntityStore, e.g. meshes, in the order they were added
+		const std::vector<Entity*>& getOtherEntitys() const { return _entitys; }
+		const std::vector<Light*>& getLights() const { return _lights; }
+		// Reflection and refraction rays are followed up to the max depth (1 traces primary rays only)
+		// as long as their weight, the product of kReflect and kRefract along the way, is at least the min weight
+		glm::vec3 traceRay(const Ray& ray, TraceStats* stats = nullptr) const;
+		// traceRay for a ray whose closest hit is already known, e.g. from PacketTracer
+		glm::vec3 traceHit(const Ray& ray, const HitRecord& hit, TraceStats* stats = nullptr) const;
+		void setMaxDepth(unsigned int depth); // clamped to [1, MAX_TRACE_DEPTH]
+		unsigned int getMaxDepth() const { return _maxDepth; }
+		void setMinWeight(float weight) { _minWeight = weight; _version++; }
+		float getMinWeight() const { return _minWeight; }
+		// Increases with every change made through Scene, so renderers can tell their results are stale.
+		// Changes made directly to an entity are not seen, call touch() after them.
+		unsigned long long getVersion() const { return _version; }
+		void touch() { _version++; }
+		HitRecord getIntersection(const Ray& ray) const;
+		// Any-hit query for shadow rays: true as soon as something is hit with FLOAT_EPS < t < tMax.
+		// Cheaper than getIntersection, which has to keep looking for the closest hit.
+		bool isOccluded(const Ray& ray, float tMax) const;
+		// Lights blocked by an entity only add their ambient term. On by default
+		void setShadows(bool shadows) { _shadows = shadows; _version++; }
+		bool getShadows() const { return _shadows; }
+		// With more lights with a position than this, every hit shades this many lights picked from the light
+		// tree by their contribution instead of all of them: the cost no longer grows with the light count,
+		// the result is right on average but noisy, and converges over progressive passes. 0 shades every light.
+		void setLightSamples(unsigned int samples) { _lightSamples = samples; _version++; }
+		unsigned int getLightSamples() const { return _lightSamples; }
+		// Renderers give primary rays ray differentials, which are followed through reflection and refraction,
+		// and textures are filtered over the footprint of a pixel at every hit: tiled images pick their mip
+		// level and checkerboards are box filtered, without more samples per pixel. On by default
+		void setTextureFiltering(bool filtering) { _textureFiltering = filtering; _version++; }
+		bool getTextureFiltering() const { return _textureFiltering; }
+		// Fills point, normal, texCoord, frontFace, dpdx and dpdy of the closest hit of ray, which getIntersection
+		// and PacketTracer leave out. shadeBranch does it once per hit, shade and the secondary rays share the result.
+		void completeHit(const Ray& ray, HitRecord& hit) const;
+		// Local lighting at a completed hit
+		glm::vec3 shade(const HitRecord& hit, const Ray& ray) const;
 
-		static const unsigned int MAX_RECURSION_TIME;
+		// A reflection or refraction ray waiting to be traced
+		struct TraceBranch
+		{
+			glm::vec3 origin;
+			glm::vec3 direction; // unit length
+			float weight;
+			unsigned int depth;
+			bool hasDifferential = false;
+			RayDifferential differential; // only set if hasDifferential
+			Ray getRay() const; // with the differential if it has one
+		};
+		// The local shading of one hit times weight, completing it first. Its reflection and refraction rays,
+		// at most two, are pushed to stack. traceHit runs them depth first; a tracer may also schedule them itself.
+		glm::vec3 shadeBranch(const Ray& ray, HitRecord hit, float weight, unsigned int depth,
+			TraceBranch* stack, unsigned int& size, TraceStats* stats) const;
+
+		static const unsigned int MAX_RECURSION_TIME; // default max depth
+		static const unsigned int MAX_TRACE_DEPTH = 32;
+		static const float DEFAULT_MIN_WEIGHT;
+		static const float SHADOW_BIAS; // shadow rays start this far off the surface
+		static const unsigned int DEFAULT_LIGHT_SAMPLES;
 	private:
-		std::vector<Entity*> _entitys;
+		// One light's term of shade, the light sampled with u and its shadow ray cast
+		glm::vec3 shadeLight(const Light& light, const SurfaceColor& surface, const glm::vec3& fragPos,
+			const glm::vec3& normal, const Ray& ray, const glm::vec2& u) const;
+
+		// Sorts the entities into bounded and unbounded ones, bounds may be nullptr
+		void partitionEntitys(std::vector<AABB>* bounds);
+		EntityHandle added(EntityHandle handle);
+
+		EntityStore _store;
+		std::vector<Entity*> _entitys; // not in the store
+		std::vector<Entity*> _ownedEntitys;
+		std::vector<std::shared_ptr<void>> _storage;
 		std::vector<Light*> _lights;
+		LightTree _lightTree; // over the lights with a position
+		std::vector<Light*> _unboundedLights; // the others, shaded at every hit
+		MaterialTable _materials;
+		BVH _bvh;
+		unsigned int _boundedStoreCount; // BVH primitives below this are the store's spheres and triangles
+		std::vector<Entity*> _boundedEntitys; // the BVH primitives after them
+		std::vector<Entity*> _unboundedEntitys; // not in the BVH and not in the store; the store's planes aren't either
+		bool _bvhValid;
+		bool _lightTreeValid;
+		unsigned int _maxDepth;
+		float _minWeight;
+		bool _shadows;
+		unsigned int _lightSamples;
+		bool _textureFiltering;
+		unsigned long long _version;
 	};
 }
 
@@ -0,0 +1,362 @@
+#include "Renderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+
+namespace RayTracing
+{
+	namespace
+	{
+		// First index >= begin that is traced by the grid
+		unsigned int firstSample(unsigned int begin, unsigned int offset, unsigned int step)
+		{
+			return begin + (offset % step + step - begin % step) % step;
+		}
+
+		// With the ray differentials of a step of grid.footprint pixels if the scene filters textures
+		Ray sampleRay(const Scene& scene, const Camera& camera, const SampleGrid& grid, unsigned int i, unsigned int j)
+		{
+			glm::vec2 p((float)i, (float)j);
+			if (grid.jitter)
+			{
+				p += grid.jitter(i, j);
+			}
+			float x = p.x * 2 / grid.width - 1.0f, y = p.y * 2 / grid.height - 1.0f;
+			if (scene.getTextureFiltering())
+			{
+				return camera.generateRay(x, y, 2.0f * grid.footprint / grid.width, 2.0f * grid.footprint / grid.height);
+			}
+			return camera.generateRay(x, y);
+		}
+
+		// A ray of a wavefront generation and the sample its color goes to
+		struct StreamRay
+		{
+			Scene::TraceBranch branch;
+			unsigned int sample;
+		};
+
+		// Spreads the low 8 bits of x out to every third bit
+		unsigned int spreadBits(unsigned int x)
+		{
+			x &= 0xff;
+			x = (x | x << 8) & 0x0300f00f;
+			x = (x | x << 4) & 0x030c30c3;
+			x = (x | x << 2) & 0x09249249;
+			return x;
+		}
+
+		// Direction octant in the top 3 bits, then the Morton code of the origin on a 256^3 grid over bounds:
+		// rays next to each other after sorting start close together and head the same way
+		uint32_t streamKey(const Scene::TraceBranch& branch, const AABB& bounds, const glm::vec3& scale)
+		{
+			const glm::vec3& d = branch.direction;
+			uint32_t octant = (d.x < 0.0f ? 4u : 0u) | (d.y < 0.0f ? 2u : 0u) | (d.z < 0.0f ? 1u : 0u);
+			glm::vec3 cell = glm::clamp((branch.origin - bounds.min) * scale, 0.0f, 255.0f);
+			uint32_t morton = spreadBits((unsigned int)cell.x) << 2 | spreadBits((unsigned int)cell.y) << 1 | spreadBits((unsigned int)cell.z);
+			return octant << 29 | morton;
+		}
+	}
+
+	Renderer::Renderer(const Scene& scene, unsigned int threadCount, unsigned int tileSize) :
+		_scene(scene), _rasterize(false), _wavefront(false), _profile(nullptr), _pool(threadCount), _tileSize(std::max(1u, tileSize))
+	{
+
+	}
+
+	void Renderer::render(const Camera& camera, FrameBuffer& frameBuffer)
+	{
+		SampleGrid grid;
+		grid.width = frameBuffer.getWidth();
+		grid.height = frameBuffer.getHeight();
+		grid.store = [&](unsigned int x, unsigned int y, const glm::vec3& color)
+		{
+			frameBuffer.setPixel(x, y, color);
+		};
+		renderSamples(camera, grid);
+	}
+
+	void Renderer::renderSamples(const Camera& camera, const SampleGrid& grid)
+	{
+		unsigned int tilesX = (grid.width + _tileSize - 1) / _tileSize;
+		unsigned int tilesY = (grid.height + _tileSize - 1) / _tileSize;
+		// A sparse grid is traced one ray at a time, its packets would be mostly empty
+		bool packets = getPacketWidth() > 1 && _profile == nullptr && !grid.active;
+		bool raster = _rasterize && !grid.jitter && _profile == nullptr && !grid.active;
+		bool wavefront = _wavefront && _profile == nullptr;
+		if (raster)
+		{
+			_rasterizer.setup(camera, grid.width, grid.height, _tileSize);
+		}
+		unsigned int firstTile = std::min(grid.firstTile, tilesX * tilesY);
+		unsigned int tileCount = std::min(grid.tileCount, tilesX * tilesY - firstTile);
+		_traceStats.assign(getThreadCount(), TraceStats());
+		_pool.run(tileCount, [&](unsigned int index, unsigned int thread)
+		{
+			unsigned int tile = firstTile + index;
+			TraceStats stats;
+			if (raster)
+			{
+				renderTileRaster(camera, grid, tile, stats);
+			}
+			else if (wavefront)
+			{
+				renderTileWavefront(camera, grid, tile, stats);
+			}
+			else if (packets)
+			{
+				renderTilePackets(camera, grid, tile, stats);
+			}
+			else
+			{
+				renderTile(camera, grid, tile, stats);
+			}
+			_traceStats[thread].rays += stats.rays;
+			_traceStats[thread].culled += stats.culled;
+		});
+	}
+
+	TraceStats Renderer::getTraceStats() const
+	{
+		TraceStats total;
+		for (const auto& stats : _traceStats)
+		{
+			total.rays += stats.rays;
+			total.culled += stats.culled;
+		}
+		return total;
+	}
+
+	void Renderer::setPacketWidth(unsigned int width)
+	{
+		_packets.setWidth(width);
+		if (_packets.getWidth() > 1)
+		{
+			_packets.build(_scene);
+		}
+	}
+
+	void Renderer::setRasterize(bool rasterize)
+	{
+		_rasterize = rasterize;
+		if (_rasterize)
+		{
+			_rasterizer.build(_scene);
+		}
+	}
+
+	void Renderer::renderTile(const Camera& camera, const SampleGrid& grid, unsigned int tile, TraceStats& stats) const
+	{
+		unsigned int tilesX = (grid.width + _tileSize - 1) / _tileSize;
+		unsigned int x0 = tile % tilesX * _tileSize;
+		unsigned int y0 = tile / tilesX * _tileSize;
+		unsigned int x1 = std::min(x0 + _tileSize, grid.width);
+		unsigned int y1 = std::min(y0 + _tileSize, grid.height);
+		for (unsigned int j = firstSample(y0, grid.offsetY, grid.step); j < y1; j += grid.step)
+		{
+			for (unsigned int i = firstSample(x0, grid.offsetX, grid.step); i < x1; i += grid.step)
+			{
+				if (grid.active && !grid.active(i, j))
+				{
+					continue;
+				}
+				if (_profile == nullptr)
+				{
+					grid.store(i, j, _scene.traceRay(sampleRay(_scene, camera, grid, i, j), &stats));
+					continue;
+				}
+				// The pixel is counted on the stack of this thread and added to the profile once
+				PixelCounters counters;
+				PixelCounters::current() = &counters;
+				auto begin = std::chrono::steady_clock::now();
+				glm::vec3 color = _scene.traceRay(sampleRay(_scene, camera, grid, i, j), &stats);
+				counters.nanoseconds = std::chrono::duration<float, std::nano>(std::chrono::steady_clock::now() - begin).count();
+				PixelCounters::current() = nullptr;
+				_profile->at(i, j).add(counters);
+				grid.store(i, j, color);
+			}
+		}
+	}
+
+	// Rows of the tile are cut into packets of consecutive samples. Only the closest hit
+	// is found in packets, shading and secondary rays stay scalar.
+	void Renderer::renderTilePackets(const Camera& camera, const SampleGrid& grid, unsigned int tile, TraceStats& stats) const
+	{
+		unsigned int tilesX = (grid.width + _tileSize - 1) / _tileSize;
+		unsigned int x0 = tile % tilesX * _tileSize;
+		unsigned int y0 = tile / tilesX * _tileSize;
+		unsigned int x1 = std::min(x0 + _tileSize, grid.width);
+		unsigned int y1 = std::min(y0 + _tileSize, grid.height);
+		unsigned int packetWidth = _packets.getWidth();
+		unsigned int firstX = firstSample(x0, grid.offsetX, grid.step);
+		RayPacket packet;
+		for (unsigned int j = firstSample(y0, grid.offsetY, grid.step); j < y1; j += grid.step)
+		{
+			for (unsigned int i = firstX; i < x1; i += packetWidth * grid.step)
+			{
+				packet.count = std::min(packetWidth, (x1 - i + grid.step - 1) / grid.step);
+				for (unsigned int lane = 0; lane < packet.count; lane++)
+				{
+					PacketTracer::setRay(packet, lane, sampleRay(_scene, camera, grid, i + lane * grid.step, j));
+				}
+				_packets.intersect(packet);
+				stats.rays += packet.count;
+				for (unsigned int lane = 0; lane < packet.count; lane++)
+				{
+					unsigned int x = i + lane * grid.step;
+					HitRecord hit = _packets.getHitRecord(packet, lane);
+					glm::vec3 color(0.0f);
+					if (hit.entity != nullptr)
+					{
+						color = _scene.traceHit(sampleRay(_scene, camera, grid, x, j), hit, &stats);
+					}
+					grid.store(x, j, color);
+				}
+			}
+		}
+	}
+
+	// The tile is rasterized right before it is shaded, primary hits never go through the BVH
+	void Renderer::renderTileRaster(const Camera& camera, const SampleGrid& grid, unsigned int tile, TraceStats& stats)
+	{
+		_rasterizer.rasterizeTile(tile, grid.step, grid.offsetX, grid.offsetY);
+		unsigned int tilesX = (grid.width + _tileSize - 1) / _tileSize;
+		unsigned int x0 = tile % tilesX * _tileSize;
+		unsigned int y0 = tile / tilesX * _tileSize;
+		unsigned int x1 = std::min(x0 + _tileSize, grid.width);
+		unsigned int y1 = std::min(y0 + _tileSize, grid.height);
+		for (unsigned int j = firstSample(y0, grid.offsetY, grid.step); j < y1; j += grid.step)
+		{
+			for (unsigned int i = firstSample(x0, grid.offsetX, grid.step); i < x1; i += grid.step)
+			{
+				Ray ray = sampleRay(_scene, camera, grid, i, j);
+				HitRecord hit = _rasterizer.getHitRecord(i, j, ray);
+				stats.rays++;
+				grid.store(i, j, hit.entity != nullptr ? _scene.traceHit(ray, hit, &stats) : glm::vec3(0.0f));
+			}
+		}
+	}
+
+	void Renderer::renderTileWavefront(const Camera& camera, const SampleGrid& grid, unsigned int tile, TraceStats& stats) const
+	{
+		unsigned int tilesX = (grid.width + _tileSize - 1) / _tileSize;
+		unsigned int x0 = tile % tilesX * _tileSize;
+		unsigned int y0 = tile / tilesX * _tileSize;
+		unsigned int x1 = std::min(x0 + _tileSize, grid.width);
+		unsigned int y1 = std::min(y0 + _tileSize, grid.height);
+
+		// The first generation holds the primary rays
+		std::vector<unsigned int> pixels; // x, y of every sample
+		std::vector<StreamRay> rays, next;
+		for (unsigned int j = firstSample(y0, grid.offsetY, grid.step); j < y1; j += grid.step)
+		{
+			for (unsigned int i = firstSample(x0, grid.offsetX, grid.step); i < x1; i += grid.step)
+			{
+				if (grid.active && !grid.active(i, j))
+				{
+					continue;
+				}
+				Ray ray = sampleRay(_scene, camera, grid, i, j);
+				Scene::TraceBranch branch = { ray.getVertex(), ray.getDirection(), 1.0f, 0 };
+				if (ray.hasDifferential())
+				{
+					branch.hasDifferential = true;
+					branch.differential = ray.getDifferential();
+				}
+				rays.push_back({ branch, (unsigned int)pixels.size() / 2 });
+				pixels.push_back(i);
+				pixels.push_back(j);
+			}
+		}
+		std::vector<glm::vec3> colors(pixels.size() / 2, glm::vec3(0.0f));
+
+		AABB bounds = _scene.getBVH().getBounds();
+		if (bounds.empty())
+		{
+			bounds = AABB(glm::vec3(-1.0f), glm::vec3(1.0f));
+		}
+		glm::vec3 scale = 256.0f / glm::max(bounds.extent(), glm::vec3(FLOAT_EPS));
+		bool packets = getPacketWidth() > 1;
+		unsigned int packetWidth = _packets.getWidth();
+		std::vector<uint64_t> order; // sort key in the high 32 bits, ray index in the low ones
+		std::vector<StreamRay> sorted;
+		std::vector<HitRecord> hits;
+		RayPacket packet;
+		while (!rays.empty())
+		{
+			// Sort the generation so that neighbouring rays walk the same BVH nodes
+			order.resize(rays.size());
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				order[i] = uint64_t(streamKey(rays[i].branch, bounds, scale)) << 32 | i;
+			}
+			std::sort(order.begin(), order.end());
+			sorted.resize(rays.size());
+			for (size_t i = 0; i < rays.size(); i++)
+			{
+				sorted[i] = rays[order[i] & 0xffffffffu];
+			}
+
+			// Closest hits of the whole generation
+			hits.resize(sorted.size());
+			if (packets)
+			{
+				for (size_t i = 0; i < sorted.size(); i += packetWidth)
+				{
+					packet.count = (unsigned int)std::min<size_t>(packetWidth, sorted.size() - i);
+					for (unsigned int lane = 0; lane < packet.count; lane++)
+					{
+						const Scene::TraceBranch& branch = sorted[i + lane].branch;
+						PacketTracer::setRay(packet, lane, Ray(branch.origin, branch.direction, Ray::UnitDirection()));
+					}
+					_packets.intersect(packet);
+					for (unsigned int lane = 0; lane < packet.count; lane++)
+					{
+						hits[i + lane] = _packets.getHitRecord(packet, lane);
+					}
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < sorted.size(); i++)
+				{
+					const Scene::TraceBranch& branch = sorted[i].branch;
+					hits[i] = _scene.getIntersection(Ray(branch.origin, branch.direction, Ray::UnitDirection()));
+				}
+			}
+			stats.rays += sorted.size();
+
+			// Shade the hits grouped by material, their reflection and refraction rays make the next generation
+			order.clear();
+			for (size_t i = 0; i < hits.size(); i++)
+			{
+				if (hits[i].entity != nullptr)
+				{
+					order.push_back(uint64_t(hits[i].entity->getMaterial(hits[i])) << 32 | i);
+				}
+			}
+			std::sort(order.begin(), order.end());
+			next.clear();
+			for (uint64_t entry : order)
+			{
+				size_t i = entry & 0xffffffffu;
+				const StreamRay& ray = sorted[i];
+				Scene::TraceBranch branches[2];
+				unsigned int count = 0;
+				colors[ray.sample] += _scene.shadeBranch(ray.branch.getRay(), hits[i], ray.branch.weight, ray.branch.depth,
+					branches, count, &stats);
+				for (unsigned int k = 0; k < count; k++)
+				{
+					next.push_back({ branches[k], ray.sample });
+				}
+			}
+			std::swap(rays, next);
+		}
+
+		for (size_t i = 0; i < colors.size(); i++)
+		{
+			grid.store(pixels[i * 2], pixels[i * 2 + 1], colors[i]);
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef RAY_TRACING_RENDERER_H
+#define RAY_TRACING_RENDERER_H
+
+#include "Camera.h"
+#include "FrameBuffer.h"
+#include "PacketTracer.h"
+#include "Profile.h"
+#include "Rasterizer.h"
+#include "RayTracing.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace RayTracing
+{
+	// The pixels one call of Renderer::renderSamples traces and where their colors go
+	struct SampleGrid
+	{
+		unsigned int width;
+		unsigned int height;
+		unsigned int step = 1; // only pixels (offsetX + k * step, offsetY + l * step) are traced
+		unsigned int offsetX = 0;
+		unsigned int offsetY = 0;
+		unsigned int firstTile = 0; // only tiles [firstTile, firstTile + tileCount) are traced. Tiles are numbered
+		unsigned int tileCount = ~0u; // left to right along a row, rows from y = 0 up
+		std::function<glm::vec2(unsigned int x, unsigned int y)> jitter; // offset of the sample in pixels, none if empty
+		// Pixels the ray differentials of a sample span when the scene filters textures. Below 1 with many
+		// samples per pixel, so that the filter shrinks with the spacing of the samples as they add up.
+		float footprint = 1.0f;
+		std::function<bool(unsigned int x, unsigned int y)> active; // pixels of the grid it returns false for are skipped, none if empty
+		std::function<void(unsigned int x, unsigned int y, const glm::vec3& color)> store;
+	};
+
+	// Traces a whole frame into a FrameBuffer, no OpenGL context needed.
+	// The image is split into square tiles which are scheduled over a work stealing thread pool.
+	class Renderer
+	{
+	public:
+		Renderer(const Scene& scene, unsigned int threadCount = 0, unsigned int tileSize = 32);
+		void render(const Camera& camera, FrameBuffer& frameBuffer);
+		// One sample for each pixel of the grid, used by ProgressiveRenderer. store is called from several threads.
+		void renderSamples(const Camera& camera, const SampleGrid& grid);
+		void setTileSize(unsigned int tileSize) { _tileSize = std::max(1u, tileSize); }
+		unsigned int getTileSize() const { return _tileSize; }
+		unsigned int getThreadCount() const { return _pool.getThreadCount(); }
+		// Primary rays are traced in packets of this many rays (see PacketTracer), 1 traces them one by one.
+		// Takes a snapshot of the scene, call again after the scene changes.
+		void setPacketWidth(unsigned int width);
+		unsigned int getPacketWidth() const { return _packets.isComplete() ? _packets.getWidth() : 1; }
+		// Hybrid mode: grids without jitter take their first hits from a Rasterizer visibility buffer,
+		// only secondary rays are traced. Takes a snapshot of the scene like setPacketWidth.
+		void setRasterize(bool rasterize);
+		bool getRasterize() const { return _rasterize; }
+		// Wavefront mode: the rays of a tile are traced one depth at a time instead of one pixel at a time.
+		// Each generation is sorted by direction octant and origin, its closest hits are found in packets
+		// when packets are on, the hits are shaded sorted by material, and their reflection and refraction
+		// rays make up the next generation. The tile size sets how many rays a generation holds.
+		// Hybrid mode takes precedence.
+		void setWavefront(bool wavefront) { _wavefront = wavefront; }
+		bool getWavefront() const { return _wavefront; }
+		// Adds the wall time of every pixel, and its counters when built with RAY_TRACING_PROFILE, to profile,
+		// which must match the grid size; nullptr stops profiling. Profiled frames trace every ray on its own,
+		// packets and the visibility buffer can't be counted per pixel.
+		void setProfile(PixelProfile* profile) { _profile = profile; }
+		const std::vector<ThreadStats>& getThreadStats() const { return _pool.getStats(); } // of the last frame
+		TraceStats getTraceStats() const; // of the last frame, summed over all threads
+	private:
+		void renderTile(const Camera& camera, const SampleGrid& grid, unsigned int tile, TraceStats& stats) const;
+		void renderTilePackets(const Camera& camera, const SampleGrid& grid, unsigned int tile, TraceStats& stats) const;
+		void renderTileRaster(const Camera& camera, const SampleGrid& grid, unsigned int tile, TraceStats& stats);
+		void renderTileWavefront(const Camera& camera, const SampleGrid& grid, unsigned int tile, TraceStats& stats) const;
+		const Scene& _scene;
+		PacketTracer _packets;
+		Rasterizer _rasterizer;
+		bool _rasterize;
+		bool _wavefront;
+		PixelProfile* _profile;
+		std::vector<TraceStats> _traceStats; // per thread, added to once per tile
+		ThreadPool _pool;
+		unsigned int _tileSize;
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,750 @@
+#include "SceneCache.h"
+#include "MappedFile.h"
+#include "Mesh.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <type_traits>
+
+namespace RayTracing
+{
+	namespace
+	{
+		const char CACHE_MAGIC[4] = { 'R', 'T', 'S', 'C' };
+		const uint32_t CACHE_VERSION = 3;
+		const size_t CACHE_ALIGNMENT = 64; // of sections and mesh arrays, so mapped records are aligned
+		const uint64_t NO_ARRAY = ~uint64_t(0);
+
+		static_assert(sizeof(glm::vec3) == 3 * sizeof(float) && sizeof(glm::vec2) == 2 * sizeof(float), "vectors are stored raw");
+		static_assert(std::is_trivially_copyable<BVH::Node>::value && std::is_trivially_copyable<Material>::value,
+			"BVH nodes and materials are stored raw");
+
+		enum CacheSectionType
+		{
+			SECTION_CAMERA,
+			SECTION_LIGHTS,
+			SECTION_MATERIALS,
+			SECTION_CHECKERS,
+			SECTION_IMAGES,
+			SECTION_TEXELS,
+			SECTION_TILED_IMAGES,
+			SECTION_TEXTURE_PATHS, // of the tiled images, referred to by offset
+			SECTION_SPHERES,
+			SECTION_TRIANGLES,
+			SECTION_MESHES,
+			SECTION_SUBMESHES,
+			SECTION_MESH_DATA, // mesh arrays and submesh names, referred to by offset
+			SECTION_PLANES,
+			SECTION_NODES, // scene BVH
+			SECTION_PRIMITIVES,
+			SECTION_COUNT
+		};
+
+		struct CacheSection
+		{
+			uint64_t offset; // bytes from the start of the file
+			uint64_t size; // bytes
+		};
+
+		struct CacheHeader
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t materialSize; // sizeof(Material) and sizeof(BVH::Node) of the build that wrote the file
+			uint32_t nodeSize;
+			uint64_t fileSize;
+			CacheSection sections[SECTION_COUNT];
+		};
+
+		struct CacheCamera
+		{
+			glm::vec3 position;
+			glm::vec3 front;
+			glm::vec3 up;
+		};
+
+		enum CacheLightType : uint32_t { LIGHT_DIRECTIONAL, LIGHT_POINT, LIGHT_SPOT, LIGHT_AREA };
+
+		struct CacheLight
+		{
+			CacheLightType type;
+			glm::vec3 ambient;
+			glm::vec3 diffuse;
+			glm::vec3 specular;
+			glm::vec3 vectors[3]; // direction; position; position, direction; corner, edge1, edge2
+			float attenuation[3];
+			float angles[2]; // inner and outer for spot lights
+		};
+
+		struct CacheChecker
+		{
+			glm::vec3 color1;
+			glm::vec3 color2;
+			float size;
+		};
+
+		struct CacheImage
+		{
+			uint32_t width;
+			uint32_t height;
+			uint64_t firstTexel;
+		};
+
+		struct CacheTiledImage
+		{
+			float size;
+			uint32_t pathLength;
+			uint64_t path; // offset into SECTION_TEXTURE_PATHS
+		};
+
+		struct CacheSphere
+		{
+			glm::vec3 center;
+			float radius;
+			uint32_t material;
+		};
+
+		struct CacheTriangle
+		{
+			glm::vec3 vertices[3];
+			uint32_t material;
+		};
+
+		struct CachePlane
+		{
+			glm::vec3 point;
+			glm::vec3 normal;
+			uint32_t material;
+		};
+
+		// Arrays are byte offsets into SECTION_MESH_DATA, index arrays may be NO_ARRAY
+		struct CacheMesh
+		{
+			uint32_t material;
+			uint32_t submeshCount;
+			uint64_t firstSubmesh;
+			uint64_t positionCount;
+			uint64_t normalCount;
+			uint64_t uvCount;
+			uint64_t triangleCount;
+			uint64_t nodeCount;
+			uint64_t positions;
+			uint64_t normals;
+			uint64_t uvs;
+			uint64_t positionIndices;
+			uint64_t normalIndices;
+			uint64_t uvIndices;
+			uint64_t nodes;
+			uint64_t primitives;
+		};
+
+		struct CacheSubmesh
+		{
+			uint32_t firstTriangle;
+			int32_t material;
+			uint64_t name; // offset into SECTION_MESH_DATA
+			uint64_t nameLength;
+		};
+
+		// Appends size bytes at the next aligned offset of block and returns that offset
+		uint64_t appendAligned(std::vector<unsigned char>& block, const void* data, size_t size)
+		{
+			size_t offset = (block.size() + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+			block.resize(offset + size);
+			if (size > 0)
+			{
+				std::memcpy(block.data() + offset, data, size);
+			}
+			return offset;
+		}
+
+		template <typename T>
+		void appendSection(std::vector<unsigned char>& file, CacheHeader& header, CacheSectionType type, const T* records, size_t count)
+		{
+			header.sections[type].offset = appendAligned(file, records, count * sizeof(T));
+			header.sections[type].size = count * sizeof(T);
+		}
+
+		// Checked views of the sections of a mapped cache
+		class CacheReader
+		{
+		public:
+			CacheReader(const unsigned char* data, size_t size) : _data(data), _size(size) {}
+
+			bool isValid() const
+			{
+				if (_size < sizeof(CacheHeader))
+				{
+					return false;
+				}
+				const CacheHeader& header = getHeader();
+				if (std::memcmp(header.magic, CACHE_MAGIC, 4) != 0 || header.version != CACHE_VERSION ||
+					header.materialSize != sizeof(Material) || header.nodeSize != sizeof(BVH::Node) || header.fileSize != _size)
+				{
+					return false;
+				}
+				for (const CacheSection& section : header.sections)
+				{
+					if (section.offset % CACHE_ALIGNMENT != 0 || section.offset > _size || section.size > _size - section.offset)
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+
+			template <typename T>
+			bool section(CacheSectionType type, const T*& records, size_t& count) const
+			{
+				const CacheSection& section = getHeader().sections[type];
+				records = reinterpret_cast<const T*>(_data + section.offset);
+				count = size_t(section.size / sizeof(T));
+				return section.size % sizeof(T) == 0;
+			}
+
+			// count elements at offset inside a section, nullptr if they don't fit
+			template <typename T>
+			const T* array(CacheSectionType type, uint64_t offset, uint64_t count) const
+			{
+				const CacheSection& section = getHeader().sections[type];
+				if (offset % alignof(T) != 0 || offset > section.size || count > (section.size - offset) / sizeof(T))
+				{
+					return nullptr;
+				}
+				return reinterpret_cast<const T*>(_data + section.offset + offset);
+			}
+		private:
+			const CacheHeader& getHeader() const { return *reinterpret_cast<const CacheHeader*>(_data); }
+
+			const unsigned char* _data;
+			size_t _size;
+		};
+
+		bool fail(const std::string& action, const std::string& path, const std::string& reason)
+		{
+			std::cout << "Failed to " << action << " " << path << ": " << reason << std::endl;
+			return false;
+		}
+
+		// The textures refer to the checkers, images and tiled images loaded with them; functions can't be cached
+		bool validTexture(const Texture& texture, size_t checkerCount, size_t imageCount, size_t tiledImageCount)
+		{
+			switch (texture.type)
+			{
+			case Texture::CONSTANT:
+				return true;
+			case Texture::CHECKER:
+				return texture.index < checkerCount;
+			case Texture::IMAGE:
+				return texture.index < imageCount;
+			case Texture::TILED:
+				return texture.index < tiledImageCount;
+			default:
+				return false;
+			}
+		}
+
+		// Triangles without the attribute have NO_INDEX in their first corner, the others three indices below count
+		bool validIndices(const unsigned int* indices, size_t triangleCount, size_t count, bool optional)
+		{
+			for (size_t i = 0; i < triangleCount * 3; i += 3)
+			{
+				if (optional && indices[i] == Mesh::NO_INDEX)
+				{
+					continue;
+				}
+				if (indices[i] >= count || indices[i + 1] >= count || indices[i + 2] >= count)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		// BVH::traverse trusts the tree: children must follow their parent inside the node array, leaves must
+		// stay inside the leaf order and no path may be deeper than its fixed stack. Leaf entries must be
+		// valid primitive ids.
+		bool validTree(const BVH::Node* nodes, size_t nodeCount, const unsigned int* primitives, size_t primitiveCount, size_t idCount)
+		{
+			std::vector<unsigned int> depth(nodeCount, 0);
+			if (nodeCount > 0)
+			{
+				depth[0] = 1;
+			}
+			for (size_t i = 0; i < nodeCount; i++)
+			{
+				const BVH::Node& node = nodes[i];
+				if (depth[i] > BVH::MAX_DEPTH)
+				{
+					return false;
+				}
+				if (node.count > 0)
+				{
+					if (size_t(node.first) + node.count > primitiveCount)
+					{
+						return false;
+					}
+				}
+				else if (node.first <= i || size_t(node.first) + 1 >= nodeCount)
+				{
+					return false;
+				}
+				else
+				{
+					depth[node.first] = std::max(depth[node.first], depth[i] + 1);
+					depth[node.first + 1] = std::max(depth[node.first + 1], depth[i] + 1);
+				}
+			}
+			for (size_t i = 0; i < primitiveCount; i++)
+			{
+				if (primitives[i] >= idCount)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	}
+
+	bool saveSceneCache(const std::string& path, const Scene& scene, const SceneCamera& camera)
+	{
+		std::vector<unsigned char> file;
+		if (!saveSceneCache(file, scene, camera, path))
+		{
+			return false;
+		}
+		std::FILE* out = std::fopen(path.c_str(), "wb");
+		if (out == nullptr)
+		{
+			return fail("save", path, "cannot open file");
+		}
+		bool written = std::fwrite(file.data(), 1, file.size(), out) == file.size();
+		written = std::fclose(out) == 0 && written;
+		return written || fail("save", path, "cannot write file");
+	}
+
+	bool loadSceneCache(const std::string& path, Scene& scene, SceneCamera& camera)
+	{
+		MappedFile file;
+		if (!file.open(path))
+		{
+			return fail("load", path, "cannot open file");
+		}
+		return loadSceneCache(file.getData(), file.getSize(), scene, camera, path);
+	}
+
+	bool saveSceneCache(std::vector<unsigned char>& file, const Scene& scene, const SceneCamera& camera, const std::string& name)
+	{
+		const MaterialTable& table = scene.getMaterials();
+		if (table.getFunctionCount() > 0)
+		{
+			return fail("save", name, "FUNCTION textures can't be saved");
+		}
+
+		CacheHeader header;
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, CACHE_MAGIC, 4);
+		header.version = CACHE_VERSION;
+		header.materialSize = sizeof(Material);
+		header.nodeSize = sizeof(BVH::Node);
+		file.assign(sizeof(CacheHeader), 0);
+
+		CacheCamera cacheCamera = { camera.position, camera.front, camera.up };
+		appendSection(file, header, SECTION_CAMERA, &cacheCamera, 1);
+
+		std::vector<CacheLight> lights;
+		for (auto light : scene.getLights())
+		{
+			CacheLight cacheLight = {};
+			cacheLight.ambient = light->getAmbient();
+			cacheLight.diffuse = light->getDiffuse();
+			cacheLight.specular = light->getSpecular();
+			Attenuation attenuation;
+			if (auto dirLight = dynamic_cast<const DirLight*>(light))
+			{
+				cacheLight.type = LIGHT_DIRECTIONAL;
+				cacheLight.vectors[0] = dirLight->getDirection();
+			}
+			else if (auto spotLight = dynamic_cast<const SpotLight*>(light))
+			{
+				cacheLight.type = LIGHT_SPOT;
+				cacheLight.vectors[0] = spotLight->getPosition();
+				cacheLight.vectors[1] = spotLight->getDirection();
+				cacheLight.angles[0] = spotLight->getInnerAngle();
+				cacheLight.angles[1] = spotLight->getOuterAngle();
+				attenuation = spotLight->getAttenuation();
+			}
+			else if (auto pointLight = dynamic_cast<const PointLight*>(light))
+			{
+				cacheLight.type = LIGHT_POINT;
+				cacheLight.vectors[0] = pointLight->getPosition();
+				attenuation = pointLight->getAttenuation();
+			}
+			else if (auto areaLight = dynamic_cast<const AreaLight*>(light))
+			{
+				cacheLight.type = LIGHT_AREA;
+				cacheLight.vectors[0] = areaLight->getCorner();
+				cacheLight.vectors[1] = areaLight->getEdge1();
+				cacheLight.vectors[2] = areaLight->getEdge2();
+				attenuation = areaLight->getAttenuation();
+			}
+			else
+			{
+				return fail("save", name, "unknown light type");
+			}
+			cacheLight.attenuation[0] = attenuation.constant;
+			cacheLight.attenuation[1] = attenuation.linear;
+			cacheLight.attenuation[2] = attenuation.quadratic;
+			lights.push_back(cacheLight);
+		}
+		appendSection(file, header, SECTION_LIGHTS, lights.data(), lights.size());
+
+		// Texture indices stay valid as checkers and images are saved in table order
+		std::vector<Material> materials;
+		for (unsigned int i = 0; i < table.getMaterialCount(); i++)
+		{
+			materials.push_back(table.getMaterial(i));
+		}
+		appendSection(file, header, SECTION_MATERIALS, materials.data(), materials.size());
+		std::vector<CacheChecker> checkers(table.getCheckerCount());
+		for (unsigned int i = 0; i < checkers.size(); i++)
+		{
+			table.getChecker(i, checkers[i].color1, checkers[i].color2, checkers[i].size);
+		}
+		appendSection(file, header, SECTION_CHECKERS, checkers.data(), checkers.size());
+		std::vector<CacheImage> images(table.getImageCount());
+		std::vector<glm::vec3> texels;
+		for (unsigned int i = 0; i < images.size(); i++)
+		{
+			const glm::vec3* image = table.getImage(i, images[i].width, images[i].height);
+			images[i].firstTexel = texels.size();
+			texels.insert(texels.end(), image, image + size_t(images[i].width) * images[i].height);
+		}
+		appendSection(file, header, SECTION_IMAGES, images.data(), images.size());
+		appendSection(file, header, SECTION_TEXELS, texels.data(), texels.size());
+		std::vector<CacheTiledImage> tiledImages(table.getTiledImageCount());
+		std::vector<unsigned char> texturePaths;
+		for (unsigned int i = 0; i < tiledImages.size(); i++)
+		{
+			std::string path;
+			table.getTiledImage(i, path, tiledImages[i].size);
+			tiledImages[i].pathLength = (uint32_t)path.size();
+			tiledImages[i].path = appendAligned(texturePaths, path.data(), path.size());
+		}
+		appendSection(file, header, SECTION_TILED_IMAGES, tiledImages.data(), tiledImages.size());
+		appendSection(file, header, SECTION_TEXTURE_PATHS, texturePaths.data(), texturePaths.size());
+
+		// Entities are saved type by type, which is also the order of the scene BVH's primitives:
+		// spheres, triangles, then the meshes
+		const EntityStore& store = scene.getStore();
+		std::vector<CacheSphere> spheres;
+		for (unsigned int i = 0; i < store.getSphereCount(); i++)
+		{
+			const Sphere& sphere = store.getSphere(i);
+			spheres.push_back({ sphere.getCenter(), sphere.getRadius(), sphere.getMaterial() });
+		}
+		std::vector<CacheTriangle> triangles(store.getTriangleCount());
+		for (unsigned int i = 0; i < triangles.size(); i++)
+		{
+			const Triangle& triangle = store.getTriangle(i);
+			triangle.getVertice(triangles[i].vertices[0], triangles[i].vertices[1], triangles[i].vertices[2]);
+			triangles[i].material = triangle.getMaterial();
+		}
+		std::vector<CachePlane> planes;
+		for (unsigned int i = 0; i < store.getPlaneCount(); i++)
+		{
+			const Plane& plane = store.getPlane(i);
+			planes.push_back({ plane.getAPoint(), plane.getNormal(), plane.getMaterial() });
+		}
+		std::vector<CacheMesh> meshes;
+		std::vector<CacheSubmesh> submeshes;
+		std::vector<unsigned char> meshData;
+		for (auto entity : scene.getOtherEntitys())
+		{
+			auto mesh = dynamic_cast<const Mesh*>(entity);
+			if (mesh == nullptr)
+			{
+				return fail("save", name, "unknown entity type");
+			}
+			Mesh::Data data = mesh->getData();
+			CacheMesh record;
+			record.material = mesh->getMaterial();
+			record.submeshCount = (uint32_t)data.submeshCount;
+			record.firstSubmesh = submeshes.size();
+			record.positionCount = data.positionCount;
+			record.normalCount = data.normalCount;
+			record.uvCount = data.uvCount;
+			record.triangleCount = data.triangleCount;
+			record.nodeCount = data.nodeCount;
+			size_t indexSize = data.triangleCount * 3 * sizeof(unsigned int);
+			record.positions = appendAligned(meshData, data.positions, data.positionCount * sizeof(glm::vec3));
+			record.normals = appendAligned(meshData, data.normals, data.normalCount * sizeof(glm::vec3));
+			record.uvs = appendAligned(meshData, data.uvs, data.uvCount * sizeof(glm::vec2));
+			record.positionIndices = appendAligned(meshData, data.positionIndices, indexSize);
+			record.normalIndices = data.normalIndices != nullptr ? appendAligned(meshData, data.normalIndices, indexSize) : NO_ARRAY;
+			record.uvIndices = data.uvIndices != nullptr ? appendAligned(meshData, data.uvIndices, indexSize) : NO_ARRAY;
+			record.nodes = appendAligned(meshData, data.nodes, data.nodeCount * sizeof(BVH::Node));
+			record.primitives = appendAligned(meshData, data.primitives, data.triangleCount * sizeof(unsigned int));
+			for (size_t i = 0; i < data.submeshCount; i++)
+			{
+				const Mesh::Submesh& submesh = data.submeshes[i];
+				uint64_t name = appendAligned(meshData, submesh.name.data(), submesh.name.size());
+				submeshes.push_back({ submesh.firstTriangle, submesh.material, name, submesh.name.size() });
+			}
+			meshes.push_back(record);
+		}
+		appendSection(file, header, SECTION_SPHERES, spheres.data(), spheres.size());
+		appendSection(file, header, SECTION_TRIANGLES, triangles.data(), triangles.size());
+		appendSection(file, header, SECTION_MESHES, meshes.data(), meshes.size());
+		appendSection(file, header, SECTION_SUBMESHES, submeshes.data(), submeshes.size());
+		appendSection(file, header, SECTION_MESH_DATA, meshData.data(), meshData.size());
+		appendSection(file, header, SECTION_PLANES, planes.data(), planes.size());
+
+		const BVH& bvh = scene.getBVH();
+		if (bvh.getPrimitives().size() != spheres.size() + triangles.size() + meshes.size())
+		{
+			return fail("save", name, "the scene BVH is not built");
+		}
+		appendSection(file, header, SECTION_NODES, bvh.getNodes().data(), bvh.getNodes().size());
+		appendSection(file, header, SECTION_PRIMITIVES, bvh.getPrimitives().data(), bvh.getPrimitives().size());
+
+		header.fileSize = file.size();
+		std::memcpy(file.data(), &header, sizeof(header));
+		return true;
+	}
+
+	bool loadSceneCache(const unsigned char* data, size_t size, Scene& scene, SceneCamera& camera, const std::string& name)
+	{
+		if (scene.getEntityCount() > 0 || !scene.getLights().empty() || scene.getMaterials().getMaterialCount() != 1)
+		{
+			return fail("load", name, "the scene is not empty");
+		}
+		CacheReader reader(data, size);
+		if (!reader.isValid())
+		{
+			return fail("load", name, "not a scene cache or written by another version");
+		}
+
+		const CacheCamera* cacheCamera = nullptr;
+		const CacheLight* lights = nullptr;
+		const Material* materials = nullptr;
+		const CacheChecker* checkers = nullptr;
+		const CacheImage* images = nullptr;
+		const glm::vec3* texels = nullptr;
+		const CacheTiledImage* tiledImages = nullptr;
+		const unsigned char* texturePaths = nullptr;
+		const CacheSphere* spheres = nullptr;
+		const CacheTriangle* triangles = nullptr;
+		const CacheMesh* meshes = nullptr;
+		const CacheSubmesh* submeshes = nullptr;
+		const unsigned char* meshData = nullptr;
+		const CachePlane* planes = nullptr;
+		const BVH::Node* nodes = nullptr;
+		const unsigned int* primitives = nullptr;
+		size_t cameraCount = 0, lightCount = 0, materialCount = 0, checkerCount = 0;
+		size_t imageCount = 0, texelCount = 0, tiledImageCount = 0, texturePathsSize = 0;
+		size_t sphereCount = 0, triangleCount = 0;
+		size_t meshCount = 0, submeshCount = 0, meshDataSize = 0, planeCount = 0, nodeCount = 0, primitiveCount = 0;
+		bool valid = reader.section(SECTION_CAMERA, cacheCamera, cameraCount) && cameraCount == 1 &&
+			reader.section(SECTION_LIGHTS, lights, lightCount) &&
+			reader.section(SECTION_MATERIALS, materials, materialCount) && materialCount > 0 &&
+			reader.section(SECTION_CHECKERS, checkers, checkerCount) &&
+			reader.section(SECTION_IMAGES, images, imageCount) &&
+			reader.section(SECTION_TEXELS, texels, texelCount) &&
+			reader.section(SECTION_TILED_IMAGES, tiledImages, tiledImageCount) &&
+			reader.section(SECTION_TEXTURE_PATHS, texturePaths, texturePathsSize) &&
+			reader.section(SECTION_SPHERES, spheres, sphereCount) &&
+			reader.section(SECTION_TRIANGLES, triangles, triangleCount) &&
+			reader.section(SECTION_MESHES, meshes, meshCount) &&
+			reader.section(SECTION_SUBMESHES, submeshes, submeshCount) &&
+			reader.section(SECTION_MESH_DATA, meshData, meshDataSize) &&
+			reader.section(SECTION_PLANES, planes, planeCount) &&
+			reader.section(SECTION_NODES, nodes, nodeCount) &&
+			reader.section(SECTION_PRIMITIVES, primitives, primitiveCount) &&
+			primitiveCount == sphereCount + triangleCount + meshCount;
+		if (!valid)
+		{
+			return fail("load", name, "broken section table");
+		}
+
+		// Everything below indexes with the records' contents, check them all before the scene is touched
+		for (size_t i = 0; i < materialCount; i++)
+		{
+			const Material& m = materials[i];
+			if (!validTexture(m.ambient, checkerCount, imageCount, tiledImageCount) ||
+				!validTexture(m.diffuse, checkerCount, imageCount, tiledImageCount) ||
+				!validTexture(m.specular, checkerCount, imageCount, tiledImageCount) ||
+				!validTexture(m.normal, checkerCount, imageCount, tiledImageCount))
+			{
+				return fail("load", name, "broken material " + std::to_string(i));
+			}
+		}
+		for (size_t i = 0; i < sphereCount; i++)
+		{
+			if (spheres[i].material >= materialCount)
+			{
+				return fail("load", name, "broken sphere " + std::to_string(i));
+			}
+		}
+		for (size_t i = 0; i < triangleCount; i++)
+		{
+			if (triangles[i].material >= materialCount)
+			{
+				return fail("load", name, "broken triangle " + std::to_string(i));
+			}
+		}
+		for (size_t i = 0; i < planeCount; i++)
+		{
+			if (planes[i].material >= materialCount)
+			{
+				return fail("load", name, "broken plane " + std::to_string(i));
+			}
+		}
+		if (!validTree(nodes, nodeCount, primitives, primitiveCount, primitiveCount))
+		{
+			return fail("load", name, "broken scene BVH");
+		}
+
+		camera.position = cacheCamera->position;
+		camera.front = cacheCamera->front;
+		camera.up = cacheCamera->up;
+		for (size_t i = 0; i < lightCount; i++)
+		{
+			const CacheLight& l = lights[i];
+			Attenuation attenuation;
+			attenuation.constant = l.attenuation[0];
+			attenuation.linear = l.attenuation[1];
+			attenuation.quadratic = l.attenuation[2];
+			switch (l.type)
+			{
+			case LIGHT_DIRECTIONAL:
+				scene.addLight(new DirLight(l.ambient, l.diffuse, l.specular, l.vectors[0]));
+				break;
+			case LIGHT_POINT:
+				scene.addLight(new PointLight(l.ambient, l.diffuse, l.specular, l.vectors[0], attenuation));
+				break;
+			case LIGHT_SPOT:
+				scene.addLight(new SpotLight(l.ambient, l.diffuse, l.specular, l.vectors[0], l.vectors[1], l.angles[0], l.angles[1], attenuation));
+				break;
+			case LIGHT_AREA:
+				scene.addLight(new AreaLight(l.ambient, l.diffuse, l.specular, l.vectors[0], l.vectors[1], l.vectors[2], attenuation));
+				break;
+			default:
+				return fail("load", name, "unknown light type");
+			}
+		}
+
+		MaterialTable& table = scene.getMaterials();
+		for (size_t i = 0; i < checkerCount; i++)
+		{
+			table.addChecker(checkers[i].color1, checkers[i].color2, checkers[i].size);
+		}
+		for (size_t i = 0; i < imageCount; i++)
+		{
+			size_t size = size_t(images[i].width) * images[i].height;
+			if (images[i].firstTexel > texelCount || size > texelCount - images[i].firstTexel)
+			{
+				return fail("load", name, "broken image");
+			}
+			const glm::vec3* first = texels + images[i].firstTexel;
+			table.addImage(images[i].width, images[i].height, std::vector<glm::vec3>(first, first + size));
+		}
+		for (size_t i = 0; i < tiledImageCount; i++)
+		{
+			const char* path = reader.array<char>(SECTION_TEXTURE_PATHS, tiledImages[i].path, tiledImages[i].pathLength);
+			Texture texture;
+			if (path == nullptr)
+			{
+				return fail("load", name, "broken tiled image");
+			}
+			if (!table.addTiledImage(std::string(path, tiledImages[i].pathLength), texture, tiledImages[i].size))
+			{
+				return fail("load", name, "missing texture file");
+			}
+		}
+		table.getMaterial(0) = materials[0];
+		for (size_t i = 1; i < materialCount; i++)
+		{
+			table.addMaterial(materials[i]);
+		}
+
+		// Spheres, triangles and planes go straight into the scene's EntityStore, the meshes share one
+		// array kept alive by the scene. Spheres, triangles and meshes are added in the order the BVH refers to.
+		scene.reserve(sphereCount, planeCount, triangleCount);
+		for (size_t i = 0; i < sphereCount; i++)
+		{
+			scene.addSphere(spheres[i].center, spheres[i].radius, spheres[i].material);
+		}
+		for (size_t i = 0; i < triangleCount; i++)
+		{
+			const glm::vec3* vertices = triangles[i].vertices;
+			scene.addTriangle(vertices[0], vertices[1], vertices[2], triangles[i].material);
+		}
+		for (size_t i = 0; i < planeCount; i++)
+		{
+			scene.addPlane(planes[i].point, planes[i].normal, planes[i].material);
+		}
+		auto meshStorage = std::make_shared<std::vector<Mesh>>(meshCount);
+		for (size_t i = 0; i < meshCount; i++)
+		{
+			const CacheMesh& record = meshes[i];
+			Mesh::Data data;
+			data.positionCount = record.positionCount;
+			data.normalCount = record.normalCount;
+			data.uvCount = record.uvCount;
+			data.triangleCount = record.triangleCount;
+			data.nodeCount = record.nodeCount;
+			data.positions = reader.array<glm::vec3>(SECTION_MESH_DATA, record.positions, record.positionCount);
+			data.normals = reader.array<glm::vec3>(SECTION_MESH_DATA, record.normals, record.normalCount);
+			data.uvs = reader.array<glm::vec2>(SECTION_MESH_DATA, record.uvs, record.uvCount);
+			data.positionIndices = reader.array<unsigned int>(SECTION_MESH_DATA, record.positionIndices, record.triangleCount * 3);
+			data.normalIndices = record.normalIndices == NO_ARRAY ? nullptr :
+				reader.array<unsigned int>(SECTION_MESH_DATA, record.normalIndices, record.triangleCount * 3);
+			data.uvIndices = record.uvIndices == NO_ARRAY ? nullptr :
+				reader.array<unsigned int>(SECTION_MESH_DATA, record.uvIndices, record.triangleCount * 3);
+			data.nodes = reader.array<BVH::Node>(SECTION_MESH_DATA, record.nodes, record.nodeCount);
+			data.primitives = reader.array<unsigned int>(SECTION_MESH_DATA, record.primitives, record.triangleCount);
+			bool broken = !data.positions || !data.normals || !data.uvs || !data.positionIndices || !data.nodes || !data.primitives ||
+				(record.normalIndices != NO_ARRAY && !data.normalIndices) || (record.uvIndices != NO_ARRAY && !data.uvIndices) ||
+				record.firstSubmesh > submeshCount || record.submeshCount > submeshCount - record.firstSubmesh ||
+				record.material >= materialCount;
+			broken = broken || !validIndices(data.positionIndices, data.triangleCount, data.positionCount, false) ||
+				(data.normalIndices && !validIndices(data.normalIndices, data.triangleCount, data.normalCount, true)) ||
+				(data.uvIndices && !validIndices(data.uvIndices, data.triangleCount, data.uvCount, true)) ||
+				!validTree(data.nodes, data.nodeCount, data.primitives, data.triangleCount, data.triangleCount);
+			std::vector<Mesh::Submesh> meshSubmeshes;
+			for (size_t j = 0; j < record.submeshCount && !broken; j++)
+			{
+				const CacheSubmesh& submesh = submeshes[record.firstSubmesh + j];
+				const char* name = reader.array<char>(SECTION_MESH_DATA, submesh.name, submesh.nameLength);
+				broken = name == nullptr || (submesh.material >= 0 && size_t(submesh.material) >= materialCount);
+				if (!broken)
+				{
+					meshSubmeshes.push_back({ submesh.firstTriangle, std::string(name, submesh.nameLength), submesh.material });
+				}
+			}
+			if (broken)
+			{
+				return fail("load", name, "broken mesh " + std::to_string(i));
+			}
+			data.submeshes = meshSubmeshes.data();
+			data.submeshCount = meshSubmeshes.size();
+			(*meshStorage)[i].assign(data);
+			(*meshStorage)[i].setMaterial(record.material);
+		}
+		for (auto& mesh : *meshStorage)
+		{
+			scene.addEntity(&mesh, false);
+		}
+		scene.addStorage(meshStorage);
+
+		BVH bvh;
+		bvh.assign(nodes, nodeCount, primitives, primitiveCount);
+		scene.setBVH(std::move(bvh));
+		return true;
+	}
+}
\ No newline at end of file
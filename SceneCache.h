@@ -0,0 +1,28 @@
+#ifndef RAY_TRACING_SCENE_CACHE_H
+#define RAY_TRACING_SCENE_CACHE_H
+
+#include "SceneLoader.h"
+
+#include <string>
+#include <vector>
+
+namespace RayTracing
+{
+	// Binary snapshot of a loaded scene, meant to be written once and mapped on every later start.
+	// All records are fixed size and grouped in sections; mesh buffers and BVHs are stored as they
+	// are in memory, so loading copies whole arrays and builds nothing. Entities of one type share
+	// one allocation. The file holds raw structs and is only read back by builds with the same layout,
+	// a version or layout mismatch fails the load and the text scene has to be loaded instead.
+	// Scenes with FUNCTION textures or instances can't be saved. Tiled images are saved as the paths
+	// of their texture files, which must still be there when the cache is loaded.
+	// On failure the reason is printed and false is returned.
+	bool saveSceneCache(const std::string& path, const Scene& scene, const SceneCamera& camera);
+	// scene must be empty
+	bool loadSceneCache(const std::string& path, Scene& scene, SceneCamera& camera);
+	// The same in memory, e.g. to ship a scene to another process; name only appears in messages.
+	// data needs the alignment of a heap block.
+	bool saveSceneCache(std::vector<unsigned char>& data, const Scene& scene, const SceneCamera& camera, const std::string& name = "scene");
+	bool loadSceneCache(const unsigned char* data, size_t size, Scene& scene, SceneCamera& camera, const std::string& name = "scene");
+}
+
+#endif
\ No newline at end of file
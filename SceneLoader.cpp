@@ -0,0 +1,687 @@
+#include "SceneLoader.h"
+#include "Animation.h"
+#include "Instance.h"
+#include "FileReader.h"
+#include "MeshLoader.h"
+#include "SceneCache.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+
+namespace RayTracing
+{
+	namespace
+	{
+		// The words of one statement. Parsing stops at the first error, which is kept for the message.
+		class LineParser
+		{
+		public:
+			LineParser(const char* begin, const char* end) : _p(begin), _end(end) {}
+
+			bool atEnd()
+			{
+				skipSpaces(_p);
+				return _p >= _end || *_p == '#';
+			}
+			std::string word()
+			{
+				skipSpaces(_p);
+				const char* begin = _p;
+				while (_p < _end && *_p != ' ' && *_p != '\t')
+				{
+					_p++;
+				}
+				return std::string(begin, _p);
+			}
+			// True if a number follows, without reading it
+			bool peekNumber()
+			{
+				skipSpaces(_p);
+				return _p < _end && (isDigit(*_p) || *_p == '-' || *_p == '+' || *_p == '.');
+			}
+			// Reads the next key, false at the end of the line
+			bool key(std::string& key)
+			{
+				if (atEnd())
+				{
+					return false;
+				}
+				key = word();
+				return true;
+			}
+			bool name(std::string& name)
+			{
+				name = atEnd() ? std::string() : word();
+				return !name.empty() || fail("expected a name");
+			}
+			bool number(float& value)
+			{
+				if (!peekNumber())
+				{
+					return fail("expected a number");
+				}
+				value = parseFloat(_p);
+				return _p >= _end || *_p == ' ' || *_p == '\t' || fail("bad number");
+			}
+			bool vec3(glm::vec3& value)
+			{
+				return number(value.x) && number(value.y) && number(value.z);
+			}
+			bool unknownKey(const std::string& key) { return fail("unknown key " + key); }
+			bool fail(const std::string& error)
+			{
+				_error = error;
+				return false;
+			}
+			const std::string& getError() const { return _error; }
+		private:
+			const char* _p;
+			const char* _end;
+			std::string _error;
+		};
+
+		struct SceneState
+		{
+			Scene* scene;
+			SceneCamera* camera;
+			std::string directory; // of the scene file, mesh and texture paths are relative to it
+			std::map<std::string, unsigned int> materials;
+			std::map<std::string, Texture> textures; // checkers and tiled images
+			std::map<std::string, EntityHandle> entitys; // named spheres, planes and triangles
+			std::map<std::string, std::shared_ptr<const Entity>> geometries; // meshes placed by instances
+			Animation* animation; // nullptr if keyframes are ignored
+
+			bool material(LineParser& line, unsigned int& material) const
+			{
+				std::string name;
+				if (!line.name(name))
+				{
+					return false;
+				}
+				auto found = materials.find(name);
+				if (found == materials.end())
+				{
+					return line.fail("unknown material " + name);
+				}
+				material = found->second;
+				return true;
+			}
+			// A color or the name of a checker or tiled image
+			bool texture(LineParser& line, Texture& texture) const
+			{
+				if (line.peekNumber())
+				{
+					glm::vec3 color;
+					if (!line.vec3(color))
+					{
+						return false;
+					}
+					texture = Texture(color);
+					return true;
+				}
+				std::string name;
+				if (!line.name(name))
+				{
+					return false;
+				}
+				auto found = textures.find(name);
+				if (found == textures.end())
+				{
+					return line.fail("unknown texture " + name);
+				}
+				texture = found->second;
+				return true;
+			}
+			bool named(LineParser& line, const std::string& name, EntityHandle handle)
+			{
+				if (name.empty())
+				{
+					return true;
+				}
+				if (name == "camera")
+				{
+					return line.fail("camera is not an entity name");
+				}
+				if (!entitys.emplace(name, handle).second)
+				{
+					return line.fail("entity " + name + " defined twice");
+				}
+				return true;
+			}
+		};
+
+		bool parseCamera(LineParser& line, SceneState& state)
+		{
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "position") ok = line.vec3(state.camera->position);
+				else if (key == "front") ok = line.vec3(state.camera->front);
+				else if (key == "up") ok = line.vec3(state.camera->up);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+		bool parseDirLight(LineParser& line, SceneState& state)
+		{
+			glm::vec3 ambient(0.2f), diffuse(0.6f), specular(1.0f), direction(0.0f, -1.0f, 0.0f);
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "ambient") ok = line.vec3(ambient);
+				else if (key == "diffuse") ok = line.vec3(diffuse);
+				else if (key == "specular") ok = line.vec3(specular);
+				else if (key == "direction") ok = line.vec3(direction);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			state.scene->addLight(new DirLight(ambient, diffuse, specular, direction));
+			return true;
+		}
+
+		bool attenuation(LineParser& line, Attenuation& value)
+		{
+			return line.number(value.constant) && line.number(value.linear) && line.number(value.quadratic);
+		}
+
+		bool parsePointLight(LineParser& line, SceneState& state)
+		{
+			glm::vec3 ambient(0.0f), diffuse(1.0f), specular(1.0f), position(0.0f);
+			Attenuation falloff;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "ambient") ok = line.vec3(ambient);
+				else if (key == "diffuse") ok = line.vec3(diffuse);
+				else if (key == "specular") ok = line.vec3(specular);
+				else if (key == "position") ok = line.vec3(position);
+				else if (key == "attenuation") ok = attenuation(line, falloff);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			state.scene->addLight(new PointLight(ambient, diffuse, specular, position, falloff));
+			return true;
+		}
+
+		bool parseSpotLight(LineParser& line, SceneState& state)
+		{
+			glm::vec3 ambient(0.0f), diffuse(1.0f), specular(1.0f), position(0.0f), direction(0.0f, -1.0f, 0.0f);
+			float inner = 20.0f, outer = 30.0f;
+			Attenuation falloff;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "ambient") ok = line.vec3(ambient);
+				else if (key == "diffuse") ok = line.vec3(diffuse);
+				else if (key == "specular") ok = line.vec3(specular);
+				else if (key == "position") ok = line.vec3(position);
+				else if (key == "direction") ok = line.vec3(direction);
+				else if (key == "inner") ok = line.number(inner);
+				else if (key == "outer") ok = line.number(outer);
+				else if (key == "attenuation") ok = attenuation(line, falloff);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			state.scene->addLight(new SpotLight(ambient, diffuse, specular, position, direction, inner, outer, falloff));
+			return true;
+		}
+
+		bool parseAreaLight(LineParser& line, SceneState& state)
+		{
+			glm::vec3 ambient(0.0f), diffuse(1.0f), specular(1.0f);
+			glm::vec3 corner(-0.5f, 0.0f, -0.5f), edge1(1.0f, 0.0f, 0.0f), edge2(0.0f, 0.0f, 1.0f); // facing down
+			Attenuation falloff;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "ambient") ok = line.vec3(ambient);
+				else if (key == "diffuse") ok = line.vec3(diffuse);
+				else if (key == "specular") ok = line.vec3(specular);
+				else if (key == "corner") ok = line.vec3(corner);
+				else if (key == "edge1") ok = line.vec3(edge1);
+				else if (key == "edge2") ok = line.vec3(edge2);
+				else if (key == "attenuation") ok = attenuation(line, falloff);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			state.scene->addLight(new AreaLight(ambient, diffuse, specular, corner, edge1, edge2, falloff));
+			return true;
+		}
+
+		bool parseChecker(LineParser& line, SceneState& state)
+		{
+			std::string name;
+			if (!line.name(name))
+			{
+				return false;
+			}
+			glm::vec3 color1(1.0f), color2(0.0f);
+			float size = 1.0f;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "color1") ok = line.vec3(color1);
+				else if (key == "color2") ok = line.vec3(color2);
+				else if (key == "size") ok = line.number(size);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			if (size <= 0.0f)
+			{
+				return line.fail("checker size must be positive");
+			}
+			state.textures[name] = state.scene->getMaterials().addChecker(color1, color2, size);
+			return true;
+		}
+
+		bool parseTexture(LineParser& line, SceneState& state)
+		{
+			std::string name, path;
+			if (!line.name(name))
+			{
+				return false;
+			}
+			float size = 1.0f;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "path") ok = line.name(path);
+				else if (key == "size") ok = line.number(size);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			if (path.empty())
+			{
+				return line.fail("texture without a path");
+			}
+			if (size <= 0.0f)
+			{
+				return line.fail("texture size must be positive");
+			}
+			Texture texture;
+			if (!state.scene->getMaterials().addTiledImage(state.directory + path, texture, size))
+			{
+				return line.fail("cannot load texture " + path);
+			}
+			state.textures[name] = texture;
+			return true;
+		}
+
+		bool parseMaterial(LineParser& line, SceneState& state)
+		{
+			std::string name;
+			if (!line.name(name))
+			{
+				return false;
+			}
+			Material material;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "ambient") ok = state.texture(line, material.ambient);
+				else if (key == "diffuse") ok = state.texture(line, material.diffuse);
+				else if (key == "specular") ok = state.texture(line, material.specular);
+				else if (key == "normal") ok = state.texture(line, material.normal);
+				else if (key == "shininess") ok = line.number(material.shininess);
+				else if (key == "shade") ok = line.number(material.kShade);
+				else if (key == "reflect") ok = line.number(material.kReflect);
+				else if (key == "refract") ok = line.number(material.kRefract);
+				else if (key == "ior") ok = line.number(material.refractiveIndex);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			state.materials[name] = state.scene->getMaterials().addMaterial(material);
+			return true;
+		}
+
+		bool parseSphere(LineParser& line, SceneState& state)
+		{
+			std::string name;
+			glm::vec3 center(0.0f);
+			float radius = 1.0f;
+			unsigned int material = 0;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "center") ok = line.vec3(center);
+				else if (key == "radius") ok = line.number(radius);
+				else if (key == "material") ok = state.material(line, material);
+				else if (key == "name") ok = line.name(name);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			return state.named(line, name, state.scene->addSphere(center, radius, material));
+		}
+
+		bool parsePlane(LineParser& line, SceneState& state)
+		{
+			std::string name;
+			glm::vec3 point(0.0f), normal(0.0f, 1.0f, 0.0f);
+			unsigned int material = 0;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "point") ok = line.vec3(point);
+				else if (key == "normal") ok = line.vec3(normal);
+				else if (key == "material") ok = state.material(line, material);
+				else if (key == "name") ok = line.name(name);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			return state.named(line, name, state.scene->addPlane(point, normal, material));
+		}
+
+		bool parseTriangle(LineParser& line, SceneState& state)
+		{
+			std::string name;
+			glm::vec3 A(0.0f), B(1.0f, 0.0f, 0.0f), C(0.0f, 1.0f, 0.0f);
+			unsigned int material = 0;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "a") ok = line.vec3(A);
+				else if (key == "b") ok = line.vec3(B);
+				else if (key == "c") ok = line.vec3(C);
+				else if (key == "material") ok = state.material(line, material);
+				else if (key == "name") ok = line.name(name);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			return state.named(line, name, state.scene->addTriangle(A, B, C, material));
+		}
+
+		// A mesh and its material, from the keys of a mesh or geometry statement
+		bool loadMeshKeys(LineParser& line, SceneState& state, Mesh*& mesh)
+		{
+			std::string path;
+			unsigned int material = 0;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "path") ok = line.name(path);
+				else if (key == "material") ok = state.material(line, material);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			if (path.empty())
+			{
+				return line.fail("mesh without a path");
+			}
+			mesh = new Mesh;
+			if (!loadMesh(state.directory + path, *mesh))
+			{
+				delete mesh;
+				return line.fail("cannot load mesh " + path);
+			}
+			mesh->build();
+			mesh->setMaterial(material);
+			return true;
+		}
+
+		bool parseMesh(LineParser& line, SceneState& state)
+		{
+			Mesh* mesh;
+			if (!loadMeshKeys(line, state, mesh))
+			{
+				return false;
+			}
+			state.scene->addEntity(mesh);
+			return true;
+		}
+
+		// Like a mesh, but only placed through instances
+		bool parseGeometry(LineParser& line, SceneState& state)
+		{
+			std::string name;
+			Mesh* mesh;
+			if (!line.name(name) || !loadMeshKeys(line, state, mesh))
+			{
+				return false;
+			}
+			state.geometries[name] = std::shared_ptr<const Entity>(mesh);
+			return true;
+		}
+
+		bool parseInstance(LineParser& line, SceneState& state)
+		{
+			std::string name;
+			if (!line.name(name))
+			{
+				return false;
+			}
+			auto geometry = state.geometries.find(name);
+			if (geometry == state.geometries.end())
+			{
+				return line.fail("unknown geometry " + name);
+			}
+			glm::vec3 translation(0.0f), axis(0.0f, 1.0f, 0.0f), scale(1.0f);
+			float angle = 0.0f;
+			unsigned int material = 0;
+			bool hasMaterial = false;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "translate") ok = line.vec3(translation);
+				else if (key == "rotate") ok = line.number(angle);
+				else if (key == "axis") ok = line.vec3(axis);
+				else if (key == "scale") ok = line.vec3(scale);
+				else if (key == "material") ok = hasMaterial = state.material(line, material);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			if (scale.x == 0.0f || scale.y == 0.0f || scale.z == 0.0f || glm::length(axis) < FLOAT_EPS)
+			{
+				return line.fail("instance transform can't be inverted");
+			}
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), translation);
+			transform = glm::rotate(transform, glm::radians(angle), axis);
+			transform = glm::scale(transform, scale);
+			Instance* instance = new Instance(geometry->second, transform);
+			if (hasMaterial)
+			{
+				instance->overrideMaterial(material);
+			}
+			state.scene->addEntity(instance);
+			return true;
+		}
+
+		bool parseFrames(LineParser& line, SceneState& state)
+		{
+			float count;
+			if (!line.number(count))
+			{
+				return false;
+			}
+			if (count < 1.0f)
+			{
+				return line.fail("frame count must be positive");
+			}
+			if (state.animation != nullptr)
+			{
+				state.animation->setFrameCount((unsigned int)count);
+			}
+			return true;
+		}
+
+		// Camera keys start from the camera statement, entity keys from the identity transform
+		bool parseKeyframe(LineParser& line, SceneState& state)
+		{
+			std::string name;
+			if (!line.name(name))
+			{
+				return false;
+			}
+			bool isCamera = name == "camera";
+			auto entity = state.entitys.find(name);
+			if (!isCamera && entity == state.entitys.end())
+			{
+				return line.fail("unknown entity " + name);
+			}
+			float frame = -1.0f;
+			SceneCamera camera = *state.camera;
+			Animation::Transform transform;
+			std::string key;
+			while (line.key(key))
+			{
+				bool ok;
+				if (key == "frame") ok = line.number(frame);
+				else if (isCamera && key == "position") ok = line.vec3(camera.position);
+				else if (isCamera && key == "front") ok = line.vec3(camera.front);
+				else if (isCamera && key == "up") ok = line.vec3(camera.up);
+				else if (!isCamera && key == "translate") ok = line.vec3(transform.translation);
+				else if (!isCamera && key == "rotate") ok = line.number(transform.angle);
+				else if (!isCamera && key == "axis") ok = line.vec3(transform.axis);
+				else if (!isCamera && key == "scale") ok = line.number(transform.scale);
+				else ok = line.unknownKey(key);
+				if (!ok)
+				{
+					return false;
+				}
+			}
+			if (frame < 0.0f)
+			{
+				return line.fail("keyframe without a frame");
+			}
+			if (state.animation == nullptr)
+			{
+				return true;
+			}
+			if (isCamera)
+			{
+				state.animation->addCameraKey(frame, camera);
+			}
+			else
+			{
+				state.animation->addEntityKey(*state.scene, entity->second, frame, transform);
+			}
+			return true;
+		}
+
+		bool fail(const std::string& path, const std::string& reason)
+		{
+			std::cout << "Failed to load " << path << ": " << reason << std::endl;
+			return false;
+		}
+	}
+
+	bool loadScene(const std::string& path, Scene& scene, SceneCamera& camera, Animation* animation)
+	{
+		FileReader reader(path);
+		if (!reader.isOpen())
+		{
+			return fail(path, "cannot open file");
+		}
+
+		SceneState state;
+		state.scene = &scene;
+		state.camera = &camera;
+		state.animation = animation;
+		state.directory = path.substr(0, path.find_last_of("/\\") + 1);
+		state.materials["default"] = 0;
+
+		size_t lineNumber = 0;
+		const char* begin;
+		const char* end;
+		while (reader.readLine(begin, end))
+		{
+			lineNumber++;
+			LineParser line(begin, end);
+			if (line.atEnd())
+			{
+				continue;
+			}
+			std::string keyword = line.word();
+			bool ok;
+			if (keyword == "sphere") ok = parseSphere(line, state);
+			else if (keyword == "triangle") ok = parseTriangle(line, state);
+			else if (keyword == "plane") ok = parsePlane(line, state);
+			else if (keyword == "mesh") ok = parseMesh(line, state);
+			else if (keyword == "geometry") ok = parseGeometry(line, state);
+			else if (keyword == "instance") ok = parseInstance(line, state);
+			else if (keyword == "material") ok = parseMaterial(line, state);
+			else if (keyword == "checker") ok = parseChecker(line, state);
+			else if (keyword == "texture") ok = parseTexture(line, state);
+			else if (keyword == "dirlight") ok = parseDirLight(line, state);
+			else if (keyword == "pointlight") ok = parsePointLight(line, state);
+			else if (keyword == "spotlight") ok = parseSpotLight(line, state);
+			else if (keyword == "arealight") ok = parseAreaLight(line, state);
+			else if (keyword == "camera") ok = parseCamera(line, state);
+			else if (keyword == "frames") ok = parseFrames(line, state);
+			else if (keyword == "keyframe") ok = parseKeyframe(line, state);
+			else ok = line.fail("unknown statement " + keyword);
+			if (!ok)
+			{
+				return fail(path, line.getError() + " on line " + std::to_string(lineNumber));
+			}
+		}
+
+		scene.buildBVH();
+		return true;
+	}
+
+	bool loadSceneFile(const std::string& path, Scene& scene, SceneCamera& camera, Animation* animation)
+	{
+		std::string extension = path.substr(path.find_last_of('.') + 1);
+		std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+		if (extension == "rtsc")
+		{
+			return loadSceneCache(path, scene, camera);
+		}
+		return loadScene(path, scene, camera, animation);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef RAY_TRACING_SCENE_LOADER_H
+#define RAY_TRACING_SCENE_LOADER_H
+
+#include "RayTracing.h"
+
+#include <string>
+
+namespace RayTracing
+{
+	class Animation;
+
+	// Where the scene is looked at from, defaults match the built-in scene
+	struct SceneCamera
+	{
+		glm::vec3 position = glm::vec3(0.0f, 2.0f, 3.0f);
+		glm::vec3 front = glm::vec3(0.0f, 0.0f, -1.0f);
+		glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+	};
+
+	// Text scene description, one statement per line, '#' starts a comment:
+	//   camera position x y z front x y z up x y z
+	//   dirlight ambient r g b diffuse r g b specular r g b direction x y z
+	//   pointlight ambient r g b diffuse r g b specular r g b position x y z attenuation constant linear quadratic
+	//   spotlight <pointlight keys> direction x y z inner degrees outer degrees
+	//   arealight <pointlight colors and attenuation> corner x y z edge1 x y z edge2 x y z
+	//   checker <name> color1 r g b color2 r g b size s
+	//   texture <name> path <tiled texture file (see writeTiledTexture), relative to the scene file> size s
+	//   material <name> ambient <r g b | checker | texture> diffuse ... specular ... normal <texture>
+	//            shininess s shade k reflect k refract k ior n
+	//   sphere center x y z radius r material <name> name <entity>
+	//   plane point x y z normal x y z material <name> name <entity>
+	//   triangle a x y z b x y z c x y z material <name> name <entity>
+	//   mesh path <OBJ or PLY file, relative to the scene file> material <name>
+	//   geometry <name> path <OBJ or PLY file> material <name>
+	//   instance <geometry> translate x y z rotate degrees axis x y z scale x y z material <name>
+	//   frames n
+	//   keyframe camera frame f position x y z front x y z up x y z
+	//   keyframe <entity> frame f translate x y z rotate degrees axis x y z scale s
+	// Area lights shine towards edge1 x edge2. A texture repeats every size units of uv; planes have uv in
+	// world units. A normal map holds tangent space normals, see Material::normal.
+	// A geometry is a mesh that only appears through the instances placing it, which share it (see
+	// Instance); an instance's material replaces the mesh's.
+	// Keys may come in any order and may be left out. Names must be defined before they are used,
+	// "default" is the plain white material 0. Meshes and the scene BVH are built after loading.
+	// Keyframes (see Animation) go to animation; with nullptr they are checked and dropped. Camera keys start
+	// from the last camera statement before them, entity keys need the entity to be named.
+	// On failure the reason is printed and false is returned, the scene may be partly filled.
+	bool loadScene(const std::string& path, Scene& scene, SceneCamera& camera, Animation* animation = nullptr);
+	// loadScene or loadSceneCache, chosen by extension (.rtsc for caches). Caches keep no keyframes.
+	bool loadSceneFile(const std::string& path, Scene& scene, SceneCamera& camera, Animation* animation = nullptr);
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,530 @@
+#include "TextureCache.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace RayTracing
+{
+	namespace
+	{
+		const char TEXTURE_MAGIC[4] = { 'R', 'T', 'T', 'X' };
+		const uint32_t TEXTURE_VERSION = 1;
+		const size_t TILE_BYTES = TextureCache::TILE_SIZE * TextureCache::TILE_SIZE * 4;
+		const unsigned int MAX_TEXTURE_SIZE = 1u << 26; // tile coordinates must fit in 21 bits of a key
+		const unsigned int MAX_LEVELS = 32;
+
+		// The header and the level table fill the first tile sized block of the file, the tiles follow
+		struct TextureHeader
+		{
+			char magic[4];
+			uint32_t version;
+			uint32_t width;
+			uint32_t height;
+			uint32_t levelCount;
+			uint32_t tileSize;
+		};
+
+		struct TextureLevel
+		{
+			uint32_t width;
+			uint32_t height;
+			uint32_t tilesX;
+			uint32_t tilesY;
+			uint64_t firstTile;
+		};
+
+		static_assert(sizeof(TextureHeader) + MAX_LEVELS * sizeof(TextureLevel) <= TILE_BYTES, "the header fits in one block");
+
+		bool fail(const std::string& action, const std::string& path, const std::string& reason)
+		{
+			std::cout << "Failed to " << action << " " << path << ": " << reason << std::endl;
+			return false;
+		}
+
+		// Spreads the low 16 bits of x to the even bits
+		unsigned int spreadBits(unsigned int x)
+		{
+			x = (x | (x << 8)) & 0x00ff00ffu;
+			x = (x | (x << 4)) & 0x0f0f0f0fu;
+			x = (x | (x << 2)) & 0x33333333u;
+			x = (x | (x << 1)) & 0x55555555u;
+			return x;
+		}
+
+		// Texels of a tile in Morton order: the 2x2 texels of a bilinear lookup are at most a few
+		// cache lines apart, whichever direction the rays walk over the texture
+		unsigned int mortonIndex(unsigned int x, unsigned int y)
+		{
+			return spreadBits(x) | (spreadBits(y) << 1);
+		}
+
+		uint64_t tileKey(unsigned int texture, unsigned int level, unsigned int tileX, unsigned int tileY)
+		{
+			return (uint64_t(texture) << 48) | (uint64_t(level) << 42) | (uint64_t(tileY) << 21) | tileX;
+		}
+
+		unsigned int wrap(int x, unsigned int size)
+		{
+			return (unsigned int)(x < 0 ? x + (int)size : x >= (int)size ? x - (int)size : x);
+		}
+
+		// Box filter over 2x2 texels, the last row or column is repeated for odd sizes
+		std::vector<glm::vec3> downsample(const std::vector<glm::vec3>& texels, unsigned int width, unsigned int height)
+		{
+			unsigned int nextWidth = std::max(1u, width / 2), nextHeight = std::max(1u, height / 2);
+			std::vector<glm::vec3> next(size_t(nextWidth) * nextHeight);
+			for (unsigned int y = 0; y < nextHeight; y++)
+			{
+				unsigned int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+				for (unsigned int x = 0; x < nextWidth; x++)
+				{
+					unsigned int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+					next[size_t(y) * nextWidth + x] = 0.25f * (texels[size_t(y0) * width + x0] + texels[size_t(y0) * width + x1] +
+						texels[size_t(y1) * width + x0] + texels[size_t(y1) * width + x1]);
+				}
+			}
+			return next;
+		}
+
+		unsigned char toByte(float value)
+		{
+			return (unsigned char)(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+		}
+
+		// Next header token of a PPM file, comments skipped
+		bool readPPMToken(std::istream& stream, std::string& token)
+		{
+			token.clear();
+			int c;
+			while ((c = stream.get()) != EOF)
+			{
+				if (c == '#')
+				{
+					while ((c = stream.get()) != EOF && c != '\n');
+				}
+				else if (!std::isspace(c))
+				{
+					token += char(c);
+				}
+				else if (!token.empty())
+				{
+					return true; // the single whitespace after the last token is consumed here
+				}
+			}
+			return !token.empty();
+		}
+
+		// The whole token as a decimal number; sizes too large to fit are caught by the size limit
+		bool parsePPMSize(const std::string& token, unsigned long& value)
+		{
+			char* end = nullptr;
+			value = std::strtoul(token.c_str(), &end, 10);
+			return std::isdigit((unsigned char)token[0]) && *end == '\0';
+		}
+	}
+
+	bool writeTiledTexture(const std::string& path, unsigned int width, unsigned int height, const std::vector<glm::vec3>& texels)
+	{
+		if (width == 0 || height == 0 || width > MAX_TEXTURE_SIZE || height > MAX_TEXTURE_SIZE ||
+			texels.size() < size_t(width) * height)
+		{
+			return fail("write", path, "bad image size");
+		}
+		const unsigned int T = TextureCache::TILE_SIZE;
+		std::vector<TextureLevel> levels;
+		uint64_t tileCount = 0;
+		for (unsigned int w = width, h = height; ; w = std::max(1u, w / 2), h = std::max(1u, h / 2))
+		{
+			TextureLevel level = { w, h, (w + T - 1) / T, (h + T - 1) / T, tileCount };
+			tileCount += uint64_t(level.tilesX) * level.tilesY;
+			levels.push_back(level);
+			if (w == 1 && h == 1)
+			{
+				break;
+			}
+		}
+
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		if (file == nullptr)
+		{
+			return fail("write", path, "cannot open file");
+		}
+		std::vector<unsigned char> block(TILE_BYTES, 0);
+		TextureHeader header;
+		std::memcpy(header.magic, TEXTURE_MAGIC, 4);
+		header.version = TEXTURE_VERSION;
+		header.width = width;
+		header.height = height;
+		header.levelCount = (uint32_t)levels.size();
+		header.tileSize = T;
+		std::memcpy(block.data(), &header, sizeof(header));
+		std::memcpy(block.data() + sizeof(header), levels.data(), levels.size() * sizeof(TextureLevel));
+		bool written = std::fwrite(block.data(), 1, TILE_BYTES, file) == TILE_BYTES;
+
+		std::vector<glm::vec3> level(texels.begin(), texels.begin() + size_t(width) * height);
+		for (size_t l = 0; l < levels.size() && written; l++)
+		{
+			unsigned int w = levels[l].width, h = levels[l].height;
+			for (unsigned int tileY = 0; tileY < levels[l].tilesY && written; tileY++)
+			{
+				for (unsigned int tileX = 0; tileX < levels[l].tilesX && written; tileX++)
+				{
+					// Texels past the edge of the level are never sampled and stay 0
+					std::fill(block.begin(), block.end(), 0);
+					for (unsigned int y = 0; y < T && tileY * T + y < h; y++)
+					{
+						for (unsigned int x = 0; x < T && tileX * T + x < w; x++)
+						{
+							const glm::vec3& color = level[size_t(tileY * T + y) * w + tileX * T + x];
+							unsigned char* texel = &block[mortonIndex(x, y) * 4];
+							texel[0] = toByte(color.x);
+							texel[1] = toByte(color.y);
+							texel[2] = toByte(color.z);
+							texel[3] = 255;
+						}
+					}
+					written = std::fwrite(block.data(), 1, TILE_BYTES, file) == TILE_BYTES;
+				}
+			}
+			if (l + 1 < levels.size())
+			{
+				level = downsample(level, w, h);
+			}
+		}
+		written = std::fclose(file) == 0 && written;
+		return written || fail("write", path, "write error");
+	}
+
+	bool convertTexture(const std::string& imagePath, const std::string& texturePath)
+	{
+		std::ifstream stream(imagePath, std::ios::binary);
+		if (!stream)
+		{
+			return fail("load", imagePath, "cannot open file");
+		}
+		std::string magic, width, height, maxValue;
+		if (!readPPMToken(stream, magic) || magic != "P6" || !readPPMToken(stream, width) ||
+			!readPPMToken(stream, height) || !readPPMToken(stream, maxValue) || maxValue != "255")
+		{
+			return fail("load", imagePath, "not an 8 bit binary PPM file");
+		}
+		unsigned long w = 0, h = 0;
+		if (!parsePPMSize(width, w) || !parsePPMSize(height, h) || w == 0 || h == 0 || w > MAX_TEXTURE_SIZE || h > MAX_TEXTURE_SIZE)
+		{
+			return fail("load", imagePath, "bad image size");
+		}
+		// The header alone must not decide how much is allocated
+		std::streampos start = stream.tellg();
+		stream.seekg(0, std::ios::end);
+		std::streamoff left = stream.tellg() - start;
+		stream.seekg(start);
+		if (!stream || left < 0 || uint64_t(left) < uint64_t(w) * h * 3)
+		{
+			return fail("load", imagePath, "unexpected end of file");
+		}
+		std::vector<unsigned char> bytes(size_t(w) * h * 3);
+		if (!stream.read(reinterpret_cast<char*>(bytes.data()), bytes.size()))
+		{
+			return fail("load", imagePath, "unexpected end of file");
+		}
+		// PPM rows go from the top down, row 0 of a texture is at the bottom
+		std::vector<glm::vec3> texels(size_t(w) * h);
+		for (unsigned int y = 0; y < h; y++)
+		{
+			const unsigned char* row = &bytes[size_t(h - 1 - y) * w * 3];
+			for (unsigned int x = 0; x < w; x++)
+			{
+				texels[size_t(y) * w + x] = glm::vec3(row[x * 3], row[x * 3 + 1], row[x * 3 + 2]) * (1.0f / 255.0f);
+			}
+		}
+		return writeTiledTexture(texturePath, w, h, texels);
+	}
+
+	TextureCache::TextureCache(size_t budget) : _budget(0)
+	{
+		setBudget(budget);
+	}
+
+	TextureCache::~TextureCache()
+	{
+		closeFiles();
+	}
+
+	void TextureCache::setBudget(size_t bytes)
+	{
+		_budget = bytes;
+		unsigned int capacity = (unsigned int)std::max<size_t>(1, bytes / TILE_BYTES / SHARD_COUNT);
+		for (Shard& shard : _shards)
+		{
+			shard.tiles.clear();
+			shard.keys.clear();
+			shard.referenced.clear();
+			shard.slots.clear();
+			shard.capacity = capacity;
+			shard.hand = 0;
+		}
+		resetStats();
+	}
+
+	bool TextureCache::addTexture(const std::string& path, unsigned int& index)
+	{
+		if (_files.size() >= (size_t(1) << 16))
+		{
+			return fail("load", path, "too many textures");
+		}
+		File file;
+		file.path = path;
+		uint64_t fileSize = 0;
+#ifdef _WIN32
+		file.handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		LARGE_INTEGER size;
+		if (file.handle == INVALID_HANDLE_VALUE)
+		{
+			return fail("load", path, "cannot open file");
+		}
+		if (GetFileSizeEx(file.handle, &size))
+		{
+			fileSize = uint64_t(size.QuadPart);
+		}
+#else
+		file.descriptor = ::open(path.c_str(), O_RDONLY);
+		if (file.descriptor < 0)
+		{
+			return fail("load", path, "cannot open file");
+		}
+		struct stat info;
+		if (fstat(file.descriptor, &info) == 0)
+		{
+			fileSize = uint64_t(info.st_size);
+		}
+#endif
+		TextureHeader header;
+		TextureLevel levels[MAX_LEVELS];
+		bool valid = read(file, 0, &header, sizeof(header)) && std::memcmp(header.magic, TEXTURE_MAGIC, 4) == 0 &&
+			header.version == TEXTURE_VERSION && header.tileSize == TILE_SIZE &&
+			header.levelCount > 0 && header.levelCount <= MAX_LEVELS &&
+			read(file, sizeof(header), levels, header.levelCount * sizeof(TextureLevel));
+		uint64_t tileCount = 0;
+		for (unsigned int l = 0; valid && l < header.levelCount; l++)
+		{
+			const TextureLevel& level = levels[l];
+			valid = level.width > 0 && level.height > 0 && level.width <= MAX_TEXTURE_SIZE && level.height <= MAX_TEXTURE_SIZE &&
+				level.tilesX == (level.width + TILE_SIZE - 1) / TILE_SIZE && level.tilesY == (level.height + TILE_SIZE - 1) / TILE_SIZE &&
+				level.firstTile == tileCount;
+			tileCount += uint64_t(level.tilesX) * level.tilesY;
+			file.levels.push_back({ level.width, level.height, level.tilesX, level.firstTile });
+		}
+		if (!valid || fileSize < (tileCount + 1) * TILE_BYTES)
+		{
+			closeFile(file);
+			return fail("load", path, "not a tiled texture or written by another version");
+		}
+		index = (unsigned int)_files.size();
+		_files.push_back(file);
+		return true;
+	}
+
+	glm::vec3 TextureCache::sample(unsigned int texture, const glm::vec2& uv, float lod) const
+	{
+		float top = float(_files[texture].levels.size() - 1);
+		lod = std::min(std::max(lod, 0.0f), top);
+		unsigned int level = (unsigned int)lod;
+		float blend = lod - float(level);
+		glm::vec3 color = sampleLevel(texture, level, uv);
+		if (blend > 0.0f)
+		{
+			color = (1.0f - blend) * color + blend * sampleLevel(texture, level + 1, uv);
+		}
+		return color;
+	}
+
+	float TextureCache::getLevelOfDetail(unsigned int texture, float footprint) const
+	{
+		const Level& level = _files[texture].levels[0];
+		float texels = footprint * float(std::max(level.width, level.height));
+		return texels > 1.0f ? std::log2(texels) : 0.0f;
+	}
+
+	glm::vec3 TextureCache::sampleLevel(unsigned int texture, unsigned int level, const glm::vec2& uv) const
+	{
+		// Repeat outside [0, 1), texel centers at half integers, as MaterialTable's images
+		const Level& l = _files[texture].levels[level];
+		float x = (uv.x - std::floor(uv.x)) * l.width - 0.5f;
+		float y = (uv.y - std::floor(uv.y)) * l.height - 0.5f;
+		float fx = std::floor(x), fy = std::floor(y);
+		float wx = x - fx, wy = y - fy;
+		unsigned int xs[2] = { wrap((int)fx, l.width), wrap((int)fx + 1, l.width) };
+		unsigned int ys[2] = { wrap((int)fy, l.height), wrap((int)fy + 1, l.height) };
+
+		// Texel i is at xs[i & 1], ys[i >> 1]. The texels of one tile are read under one lock,
+		// which is all four unless the lookup straddles a tile edge.
+		glm::vec3 texels[4];
+		for (unsigned int i = 0; i < 4;)
+		{
+			unsigned int tileX = xs[i & 1] / TILE_SIZE, tileY = ys[i >> 1] / TILE_SIZE;
+			uint64_t key = tileKey(texture, level, tileX, tileY);
+			Shard& shard = _shards[((key * 0x9e3779b97f4a7c15ull) >> 32) % SHARD_COUNT];
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			const unsigned char* tile = findTile(shard, key, texture, level, tileX, tileY);
+			do
+			{
+				const unsigned char* texel = tile + mortonIndex(xs[i & 1] % TILE_SIZE, ys[i >> 1] % TILE_SIZE) * 4;
+				texels[i] = glm::vec3(texel[0], texel[1], texel[2]) * (1.0f / 255.0f);
+				i++;
+			} while (i < 4 && xs[i & 1] / TILE_SIZE == tileX && ys[i >> 1] / TILE_SIZE == tileY);
+		}
+		return (1.0f - wy) * ((1.0f - wx) * texels[0] + wx * texels[1]) + wy * ((1.0f - wx) * texels[2] + wx * texels[3]);
+	}
+
+	const unsigned char* TextureCache::findTile(Shard& shard, uint64_t key, unsigned int texture, unsigned int level,
+		unsigned int tileX, unsigned int tileY) const
+	{
+		shard.lookups++;
+		auto found = shard.slots.find(key);
+		if (found != shard.slots.end())
+		{
+			shard.referenced[found->second] = 1;
+			return shard.tiles[found->second].get();
+		}
+
+		shard.misses++;
+		unsigned int slot;
+		if (shard.keys.size() < shard.capacity)
+		{
+			slot = (unsigned int)shard.keys.size();
+			shard.tiles.emplace_back(new unsigned char[TILE_BYTES]);
+			shard.keys.push_back(key);
+			shard.referenced.push_back(1);
+		}
+		else
+		{
+			// Clock sweep: a tile used since the hand last passed it gets a second chance
+			while (shard.referenced[shard.hand])
+			{
+				shard.referenced[shard.hand] = 0;
+				shard.hand = (shard.hand + 1) % shard.capacity;
+			}
+			slot = shard.hand;
+			shard.hand = (shard.hand + 1) % shard.capacity;
+			shard.slots.erase(shard.keys[slot]);
+			shard.keys[slot] = key;
+			shard.referenced[slot] = 1;
+			shard.evictions++;
+		}
+		shard.slots[key] = slot;
+
+		const File& file = _files[texture];
+		const Level& l = file.levels[level];
+		uint64_t tile = l.firstTile + uint64_t(tileY) * l.tilesX + tileX;
+		unsigned char* data = shard.tiles[slot].get();
+		if (read(file, (tile + 1) * TILE_BYTES, data, TILE_BYTES))
+		{
+			shard.readBytes += TILE_BYTES;
+		}
+		else
+		{
+			std::memset(data, 0, TILE_BYTES); // the file was checked when it was added, a failed read samples black
+		}
+		return data;
+	}
+
+	TextureCache::Stats TextureCache::getStats() const
+	{
+		Stats stats = {};
+		stats.budgetBytes = _budget;
+		for (Shard& shard : _shards)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			stats.lookups += shard.lookups;
+			stats.misses += shard.misses;
+			stats.evictions += shard.evictions;
+			stats.readBytes += shard.readBytes;
+			stats.residentBytes += shard.keys.size() * TILE_BYTES;
+		}
+		return stats;
+	}
+
+	void TextureCache::resetStats()
+	{
+		for (Shard& shard : _shards)
+		{
+			std::lock_guard<std::mutex> lock(shard.mutex);
+			shard.lookups = 0;
+			shard.misses = 0;
+			shard.evictions = 0;
+			shard.readBytes = 0;
+		}
+	}
+
+	void TextureCache::closeFiles()
+	{
+		for (File& file : _files)
+		{
+			closeFile(file);
+		}
+		_files.clear();
+	}
+
+#ifdef _WIN32
+	bool TextureCache::read(const File& file, uint64_t offset, void* data, size_t size)
+	{
+		// Reads at an offset don't move a shared file position, so threads may read at the same time
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = DWORD(offset);
+		overlapped.OffsetHigh = DWORD(offset >> 32);
+		DWORD count;
+		return ReadFile(file.handle, data, DWORD(size), &count, &overlapped) && count == size;
+	}
+
+	void TextureCache::closeFile(File& file)
+	{
+		CloseHandle(file.handle);
+		file.handle = INVALID_HANDLE_VALUE;
+	}
+#else
+	bool TextureCache::read(const File& file, uint64_t offset, void* data, size_t size)
+	{
+		// Reads at an offset don't move a shared file position, so threads may read at the same time
+		unsigned char* bytes = (unsigned char*)data;
+		while (size > 0)
+		{
+			ssize_t count = pread(file.descriptor, bytes, size, off_t(offset));
+			if (count < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (count <= 0)
+			{
+				return false;
+			}
+			bytes += count;
+			offset += uint64_t(count);
+			size -= size_t(count);
+		}
+		return true;
+	}
+
+	void TextureCache::closeFile(File& file)
+	{
+		::close(file.descriptor);
+		file.descriptor = -1;
+	}
+#endif
+}
\ No newline at end of file
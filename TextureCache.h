@@ -0,0 +1,116 @@
+#ifndef RAY_TRACING_TEXTURE_CACHE_H
+#define RAY_TRACING_TEXTURE_CACHE_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace RayTracing
+{
+	// Writes an image as a tiled texture file (.rttx): the whole mip chain down to 1x1, box filtered, every
+	// level cut into TextureCache::TILE_SIZE square tiles of 8 bit RGBA texels stored in Morton order.
+	// Colors are clamped to [0, 1]. Row 0 is at v = 0, as for MaterialTable::addImage.
+	bool writeTiledTexture(const std::string& path, unsigned int width, unsigned int height, const std::vector<glm::vec3>& texels);
+	// Converts a binary 8 bit PPM (P6) to a tiled texture file. On failure the reason is printed.
+	bool convertTexture(const std::string& imagePath, const std::string& texturePath);
+
+	// Tiled texture files sampled through a fixed memory budget. Only the headers are read when a
+	// texture is added; tiles are read from disk the first time a lookup needs them and evicted by a
+	// clock sweep once the budget is used up, so the textures of a scene may be far larger than the budget.
+	// The tiles are spread over shards by a hash of their key, each with its own lock, so render threads
+	// rarely wait for each other. Sampling is thread safe, adding textures and setting the budget are not.
+	class TextureCache
+	{
+	public:
+		static const unsigned int TILE_SIZE = 32; // texels per side, a tile is 4 KB
+		static const size_t DEFAULT_BUDGET = size_t(64) << 20;
+
+		struct Stats
+		{
+			uint64_t lookups; // tiles looked up, one per sampled level unless the texels straddle tiles
+			uint64_t misses; // tiles read from disk
+			uint64_t evictions;
+			uint64_t readBytes;
+			size_t residentBytes; // tiles held now
+			size_t budgetBytes;
+			double getHitRate() const { return lookups > 0 ? 1.0 - double(misses) / lookups : 1.0; }
+		};
+
+		explicit TextureCache(size_t budget = DEFAULT_BUDGET);
+		~TextureCache();
+		TextureCache(const TextureCache&) = delete;
+		TextureCache& operator=(const TextureCache&) = delete;
+
+		// Drops every tile. The cache holds at least one tile per shard whatever the budget.
+		void setBudget(size_t bytes);
+		size_t getBudget() const { return _budget; }
+		// Opens a file written by writeTiledTexture. On failure the reason is printed and false is returned.
+		bool addTexture(const std::string& path, unsigned int& index);
+		size_t getTextureCount() const { return _files.size(); }
+		const std::string& getPath(unsigned int texture) const { return _files[texture].path; }
+		unsigned int getWidth(unsigned int texture) const { return _files[texture].levels[0].width; }
+		unsigned int getHeight(unsigned int texture) const { return _files[texture].levels[0].height; }
+		unsigned int getLevelCount(unsigned int texture) const { return (unsigned int)_files[texture].levels.size(); }
+
+		// Bilinear and repeating. Level of detail 0 is the full resolution, fractions blend two levels.
+		glm::vec3 sample(unsigned int texture, const glm::vec2& uv, float lod) const;
+		// The level whose texels are footprint wide, footprint in uv units; 0 for anything under a texel
+		float getLevelOfDetail(unsigned int texture, float footprint) const;
+
+		Stats getStats() const;
+		void resetStats();
+	private:
+		struct Level
+		{
+			unsigned int width;
+			unsigned int height;
+			unsigned int tilesX;
+			uint64_t firstTile; // index of the level's first tile in the file, tiles are in row order
+		};
+		struct File
+		{
+			std::string path;
+			std::vector<Level> levels;
+#ifdef _WIN32
+			void* handle;
+#else
+			int descriptor;
+#endif
+		};
+		struct Shard
+		{
+			std::mutex mutex;
+			std::vector<std::unique_ptr<unsigned char[]>> tiles; // allocated as slots are first used
+			std::vector<uint64_t> keys; // of the tile in each used slot
+			std::vector<unsigned char> referenced; // clock bits
+			std::unordered_map<uint64_t, unsigned int> slots; // key to slot
+			unsigned int capacity;
+			unsigned int hand;
+			uint64_t lookups;
+			uint64_t misses;
+			uint64_t evictions;
+			uint64_t readBytes;
+		};
+
+		static const unsigned int SHARD_COUNT = 16;
+
+		glm::vec3 sampleLevel(unsigned int texture, unsigned int level, const glm::vec2& uv) const;
+		// Texel data of a tile, read in if needed; the shard must be locked
+		const unsigned char* findTile(Shard& shard, uint64_t key, unsigned int texture, unsigned int level,
+			unsigned int tileX, unsigned int tileY) const;
+		static bool read(const File& file, uint64_t offset, void* data, size_t size);
+		static void closeFile(File& file);
+		void closeFiles();
+
+		std::vector<File> _files;
+		size_t _budget;
+		mutable Shard _shards[SHARD_COUNT];
+	};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,142 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace RayTracing
+{
+	ThreadPool::ThreadPool(unsigned int threadCount) :
+		_task(nullptr), _generation(0), _running(0), _quit(false)
+	{
+		if (threadCount == 0)
+		{
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		for (unsigned int i = 0; i < threadCount; i++)
+		{
+			_queues.emplace_back(new TaskQueue());
+		}
+		_stats.resize(threadCount);
+		for (unsigned int i = 1; i < threadCount; i++)
+		{
+			_threads.emplace_back(&ThreadPool::workerLoop, this, i);
+		}
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_quit = true;
+		}
+		_start.notify_all();
+		for (auto& thread : _threads)
+		{
+			thread.join();
+		}
+	}
+
+	void ThreadPool::run(unsigned int count, const std::function<void(unsigned int, unsigned int)>& task)
+	{
+		// Neighbouring tasks go to the same thread, so a thread that finishes early
+		// steals from the far end of another thread's range
+		unsigned int threadCount = getThreadCount();
+		for (unsigned int i = 0; i < threadCount; i++)
+		{
+			std::lock_guard<std::mutex> lock(_queues[i]->mutex);
+			_queues[i]->tasks.clear();
+			unsigned int first = (unsigned int)((unsigned long long)count * i / threadCount);
+			unsigned int last = (unsigned int)((unsigned long long)count * (i + 1) / threadCount);
+			for (unsigned int index = first; index < last; index++)
+			{
+				_queues[i]->tasks.push_back(index);
+			}
+			_stats[i] = ThreadStats();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_task = &task;
+			_running = threadCount - 1;
+			_generation++;
+		}
+		_start.notify_all();
+
+		work(0);
+
+		std::unique_lock<std::mutex> lock(_mutex);
+		_finish.wait(lock, [this]() { return _running == 0; });
+		_task = nullptr;
+	}
+
+	void ThreadPool::workerLoop(unsigned int thread)
+	{
+		unsigned long long generation = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				_start.wait(lock, [&]() { return _quit || _generation != generation; });
+				if (_quit)
+				{
+					return;
+				}
+				generation = _generation;
+			}
+
+			work(thread);
+
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (--_running == 0)
+			{
+				_finish.notify_one();
+			}
+		}
+	}
+
+	void ThreadPool::work(unsigned int thread)
+	{
+		ThreadStats& stats = _stats[thread];
+		unsigned int index;
+		bool stolen;
+		while (popTask(thread, index, stolen))
+		{
+			auto begin = std::chrono::steady_clock::now();
+			(*_task)(index, thread);
+			auto end = std::chrono::steady_clock::now();
+
+			stats.tasks++;
+			stats.stolen += stolen ? 1 : 0;
+			stats.busySeconds += std::chrono::duration<double>(end - begin).count();
+		}
+	}
+
+	bool ThreadPool::popTask(unsigned int thread, unsigned int& index, bool& stolen)
+	{
+		{
+			TaskQueue& own = *_queues[thread];
+			std::lock_guard<std::mutex> lock(own.mutex);
+			if (!own.tasks.empty())
+			{
+				index = own.tasks.front();
+				own.tasks.pop_front();
+				stolen = false;
+				return true;
+			}
+		}
+		unsigned int threadCount = getThreadCount();
+		for (unsigned int i = 1; i < threadCount; i++)
+		{
+			TaskQueue& victim = *_queues[(thread + i) % threadCount];
+			std::lock_guard<std::mutex> lock(victim.mutex);
+			if (!victim.tasks.empty())
+			{
+				index = victim.tasks.back();
+				victim.tasks.pop_back();
+				stolen = true;
+				return true;
+			}
+		}
+		return false;
+	}
+}
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef RAY_TRACING_THREAD_POOL_H
+#define RAY_TRACING_THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RayTracing
+{
+	struct ThreadStats
+	{
+		unsigned int tasks = 0; // tasks executed by this thread
+		unsigned int stolen = 0; // how many of them were stolen from another thread
+		double busySeconds = 0.0;
+	};
+
+	// Fixed set of worker threads. Every thread owns a queue of task indices and
+	// steals from the back of the other queues when its own one runs dry.
+	class ThreadPool
+	{
+	public:
+		explicit ThreadPool(unsigned int threadCount = 0); // 0 means one thread per hardware thread
+		~ThreadPool();
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		unsigned int getThreadCount() const { return (unsigned int)_queues.size(); }
+		// Calls task(index, thread) for every index in [0, count) and blocks until all of them are done.
+		// The calling thread works as thread 0.
+		void run(unsigned int count, const std::function<void(unsigned int, unsigned int)>& task);
+		const std::vector<ThreadStats>& getStats() const { return _stats; } // of the last run
+	private:
+		struct TaskQueue
+		{
+			std::mutex mutex;
+			std::deque<unsigned int> tasks;
+		};
+		void workerLoop(unsigned int thread);
+		void work(unsigned int thread);
+		bool popTask(unsigned int thread, unsigned int& index, bool& stolen);
+
+		std::vector<std::unique_ptr<TaskQueue>> _queues;
+		std::vector<std::thread> _threads;
+		std::vector<ThreadStats> _stats;
+		const std::function<void(unsigned int, unsigned int)>* _task;
+
+		std::mutex _mutex;
+		std::condition_variable _start;
+		std::condition_variable _finish;
+		unsigned long long _generation;
+		unsigned int _running;
+		bool _quit;
+	};
+}
+
+#endif
\ No newline at end of file
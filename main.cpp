@@ -6,18 +6,94 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
 #include <cmath>
+#include <cstdlib>
+#include <string>
+#include <thread>
 #include <vector>
 #include <iostream>
 
 #include "Shader/Shader.h"
 #include "RayTracing.h"
+#include "AdaptiveRenderer.h"
+#include "Animation.h"
+#include "DistributedRenderer.h"
+#include "ProgressiveRenderer.h"
+#include "Renderer.h"
+#include "SceneCache.h"
+#include "Benchmark.h"
 
 const unsigned int SCR_WIDTH = 640;
 const unsigned int SCR_HEIGHT = 480;
 
 void resizeGL(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
+void buildScene(RayTracing::Scene& scene);
+
+struct Options
+{
+	std::string outputPath;
+	std::string profilePath; // ؼͼԴΪǰ׺д򿪴
+	std::string scenePath; // ļıƻ棩Ϊʱʹó
+	std::string cachePath; // ѳΪƻ˳
+	std::string convertImagePath; // PPMͼƬתΪֿļ˳
+	std::string convertTexturePath;
+	unsigned int textureBudget = 0; // ڴޣMB0ʾʹĬֵ
+	std::string animationPath; // ȾļеĶi֡д·λ֡ţframe.ppmдΪframe0000.ppm
+	unsigned int frameCount = 0; // ֡0ʾʹóļе֡
+	bool pipelined = true; // Ⱦʱһ֡ĳºһ֡д뵱ǰ֡׷ͬʱ
+	unsigned int threadCount = 0; // Ⱦ߳0ʾÿӲ߳һ
+	unsigned int workerCount = 0; // 0ʱ޴Ⱦѷָֿộÿһ
+	bool worker = false; // ΪУӱ׼ճͷֿ飬Ⱦд׼
+	std::string programPath; // ·
+	unsigned int tileSize = 32;
+	unsigned int packetWidth = 16; // ߰ĿȣȡCPUֵ֧ȣ1ʾ׷
+	unsigned int maxDepth = RayTracing::Scene::MAX_RECURSION_TIME; // 䡢
+	float minWeight = RayTracing::Scene::DEFAULT_MIN_WEIGHT; // Ȩصڴֵķ䡢߲׷
+	unsigned int samples = 1; // ޴ȾʱÿصĲӦʱΪ
+	float adaptiveThreshold = 0.0f; // 0ʱ޴ȾʹӦڴֵټӲ
+	float frameBudget = 33.0f; // ģʽÿ֡ʱԤ㣨룩0ʾÿ֡׷
+	bool shadows = true; // ǷԴӰ
+	bool textureFiltering = true; // ɹ΢ֵõصĸǷΧ˲
+	unsigned int lightSamples = RayTracing::Scene::DEFAULT_LIGHT_SAMPLES; // Դ϶ʱÿӹԴѡĹԴ0ʾйԴ
+	bool rasterize = false; // ģʽߵ׸ɹդõֻ׷ٷ䡢
+	bool wavefront = false; // ׷٣ÿֿͬһȵĹ󽻡ʳɫ
+	std::string error; // ϲϷʱʾǿʱӡ˳
+	bool benchmarkScene = false;
+	bool benchmarkRaster = false;
+	bool benchmarkShadow = false;
+	bool benchmarkLights = false;
+	bool benchmarkProgressive = false;
+	bool benchmarkAdaptive = false;
+	unsigned int benchmarkThreads = 0;
+	bool benchmarkBVH = false;
+	bool benchmarkAnimation = false;
+	bool benchmarkInstance = false;
+	bool benchmarkLayout = false;
+	bool benchmarkTriangle = false;
+	bool benchmarkPrimitive = false;
+	bool benchmarkMesh = false;
+	std::string benchmarkMeshPath;
+	bool benchmarkPacket = false;
+	bool benchmarkMaterial = false;
+	bool benchmarkTexture = false;
+	bool benchmarkFiltering = false;
+	bool benchmarkTrace = false;
+	bool benchmarkWavefront = false;
+	bool benchmarkDistributed = false;
+	bool benchmarkSuite = false;
+	std::string benchmarkJSONPath; // ׼ĽJSONʽдļ
+	std::string benchmarkBaselinePath; // ֮ȽϵĲ׼
+	float benchmarkThreshold = 10.0f; // Ȼ׼˰ٷֱȼΪ˻
+};
+Options parseOptions(int argc, char* argv[]);
+int renderHeadless(const Options& options);
+int renderProfile(const Options& options);
+int renderAnimation(const Options& options);
+void printTextureStats(const RayTracing::Scene& scene);
 
 glm::mat4 model;
 glm::mat4 view;
@@ -28,9 +104,209 @@ glm::vec3 viewFront = glm::vec3(0, 0, -1);
 glm::vec3 viewUp = glm::vec3(0.0f, 1.0f, 0.0f);
 
 RayTracing::Scene scene;
+RayTracing::Animation animation;
 
-int main()
+int main(int argc, char* argv[])
 {
+	// вָļʱ
+	Options options = parseOptions(argc, argv);
+	if (!options.error.empty())
+	{
+		std::cout << options.error << std::endl;
+		return -1;
+	}
+	if (options.worker)
+	{
+		return RayTracing::runWorker(options.threadCount) ? 0 : -1;
+	}
+
+	if (options.benchmarkSuite)
+	{
+		bool passed = options.benchmarkBaselinePath.empty() ?
+			RayTracing::benchmarkSuite(options.benchmarkJSONPath, std::cout) :
+			RayTracing::compareBenchmarkSuite(options.benchmarkBaselinePath, options.benchmarkThreshold / 100.0,
+				options.benchmarkJSONPath, std::cout);
+		return passed ? 0 : 1;
+	}
+
+	if (options.benchmarkBVH)
+	{
+		RayTracing::benchmarkBVH(std::cout);
+		return 0;
+	}
+
+	if (options.benchmarkLights)
+	{
+		RayTracing::benchmarkLights(std::cout);
+		return 0;
+	}
+
+	if (options.benchmarkAnimation)
+	{
+		RayTracing::benchmarkAnimation(std::cout);
+		return 0;
+	}
+
+	if (options.benchmarkInstance)
+	{
+		RayTracing::benchmarkInstance(std::cout);
+		return 0;
+	}
+
+	if (options.benchmarkLayout)
+	{
+		RayTracing::benchmarkLayout(std::cout);
+		return 0;
+	}
+
+	if (options.benchmarkTriangle)
+	{
+		RayTracing::benchmarkTriangle(std::cout);
+		return 0;
+	}
+
+	if (options.benchmarkPrimitive)
+	{
+		RayTracing::benchmarkPrimitive(std::cout);
+		return 0;
+	}
+
+	if (options.benchmarkMesh)
+	{
+		RayTracing::benchmarkMesh(options.benchmarkMeshPath, std::cout);
+		return 0;
+	}
+
+	if (options.benchmarkMaterial)
+	{
+		RayTracing::benchmarkMaterial(std::cout);
+		return 0;
+	}
+
+	if (options.benchmarkTexture)
+	{
+		RayTracing::benchmarkTexture(std::cout);
+		return 0;
+	}
+
+	if (options.benchmarkScene)
+	{
+		RayTracing::benchmarkScene(std::cout);
+		return 0;
+	}
+
+	if (!options.convertImagePath.empty())
+	{
+		return RayTracing::convertTexture(options.convertImagePath, options.convertTexturePath) ? 0 : -1;
+	}
+
+	// ӳļ볡δָʱʹó
+	if (!options.scenePath.empty())
+	{
+		RayTracing::SceneCamera sceneCamera;
+		if (!RayTracing::loadSceneFile(options.scenePath, scene, sceneCamera, &animation))
+		{
+			return -1;
+		}
+		viewPos = sceneCamera.position;
+		viewFront = sceneCamera.front;
+		viewUp = sceneCamera.up;
+	}
+	else
+	{
+		buildScene(scene);
+	}
+	if (!options.cachePath.empty())
+	{
+		RayTracing::SceneCamera sceneCamera;
+		sceneCamera.position = viewPos;
+		sceneCamera.front = viewFront;
+		sceneCamera.up = viewUp;
+		return RayTracing::saveSceneCache(options.cachePath, scene, sceneCamera) ? 0 : -1;
+	}
+	scene.setMaxDepth(options.maxDepth);
+	scene.setMinWeight(options.minWeight);
+	scene.setShadows(options.shadows);
+	scene.setTextureFiltering(options.textureFiltering);
+	scene.setLightSamples(options.lightSamples);
+	if (options.textureBudget > 0)
+	{
+		scene.getMaterials().getTextureCache().setBudget(size_t(options.textureBudget) << 20);
+	}
+	if (options.benchmarkThreads > 0)
+	{
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		RayTracing::benchmarkScaling(scene, camera, SCR_WIDTH, SCR_HEIGHT,
+			options.benchmarkThreads, options.tileSize, std::cout);
+		return 0;
+	}
+	if (options.benchmarkProgressive)
+	{
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		RayTracing::benchmarkProgressive(scene, camera, SCR_WIDTH, SCR_HEIGHT, std::cout);
+		return 0;
+	}
+	if (options.benchmarkAdaptive)
+	{
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		RayTracing::benchmarkAdaptive(scene, camera, SCR_WIDTH, SCR_HEIGHT, std::cout);
+		return 0;
+	}
+	if (options.benchmarkTrace)
+	{
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		RayTracing::benchmarkTrace(scene, camera, SCR_WIDTH, SCR_HEIGHT, std::cout);
+		return 0;
+	}
+	if (options.benchmarkDistributed)
+	{
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		RayTracing::benchmarkDistributed(scene, camera, SCR_WIDTH * 2, SCR_HEIGHT * 2, options.programPath, std::cout);
+		return 0;
+	}
+	if (options.benchmarkFiltering)
+	{
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		RayTracing::benchmarkFiltering(scene, camera, SCR_WIDTH, SCR_HEIGHT, std::cout);
+		return 0;
+	}
+	if (options.benchmarkWavefront)
+	{
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		RayTracing::benchmarkWavefront(scene, camera, SCR_WIDTH, SCR_HEIGHT, std::cout);
+		return 0;
+	}
+	if (options.benchmarkRaster)
+	{
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		RayTracing::benchmarkRaster(scene, camera, SCR_WIDTH, SCR_HEIGHT, std::cout);
+		return 0;
+	}
+	if (options.benchmarkShadow)
+	{
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		RayTracing::benchmarkShadow(scene, camera, SCR_WIDTH, SCR_HEIGHT, std::cout);
+		return 0;
+	}
+	if (options.benchmarkPacket)
+	{
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		RayTracing::benchmarkPacket(scene, camera, SCR_WIDTH, SCR_HEIGHT, std::cout);
+		return 0;
+	}
+	if (!options.animationPath.empty())
+	{
+		return renderAnimation(options);
+	}
+	if (!options.profilePath.empty())
+	{
+		return renderProfile(options);
+	}
+	if (!options.outputPath.empty())
+	{
+		return renderHeadless(options);
+	}
+
 	// ʼOpenGL
 	glfwInit();
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -56,155 +332,544 @@ int main()
 	// ʼɫ	
 	Shader shader("Shader/Vertex", "Shader/Fragment");
 
-	// Ϊɫ
-	float point[] = { 0, 0, 0 };
+	// ȫľΪɫÿ֡ĽΪ
+	float quad[] = {
+		// λ       // 
+		-1.0f, -1.0f, 0.0f, 0.0f,
+		 1.0f, -1.0f, 1.0f, 0.0f,
+		-1.0f,  1.0f, 0.0f, 1.0f,
+		 1.0f,  1.0f, 1.0f, 1.0f
+	};
 
 	GLuint VBO;
 	glGenBuffers(1, &VBO);
 	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(point), point, GL_STATIC_DRAW);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
 	GLuint VAO;
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
 
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
 	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+
+	// ʼϴ֡
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
+
+	shader.use();
+	shader.setInt("frame", 0);
+
+	// ͳʱ֡ۻƶʱԽϵ͵ķֱʾʹÿ֡ʱ䱣Ԥ֮
+	RayTracing::FrameBuffer frameBuffer(SCR_WIDTH, SCR_HEIGHT);
+	RayTracing::ProgressiveRenderer renderer(scene, options.threadCount, options.tileSize);
+	renderer.setPacketWidth(options.packetWidth);
+	renderer.setRasterize(options.rasterize);
+	renderer.getRenderer().setWavefront(options.wavefront);
+	renderer.setFrameBudget(options.frameBudget / 1000.0);
 
-	// ùߡƽ桢ĲǼ볡
-	scene.addLight(new DirLight(
-		glm::vec3(0.2f, 0.2f, 0.2f),
-		glm::vec3(0.6f, 0.6f, 0.6f),
-		glm::vec3(1.0f, 1.0f, 1.0f),
-		glm::vec3(-0.5f, -1.0f, -1.0f)
-	));
-	Material planeMaterial;
-	planeMaterial.kShade = 0.7f;
-	planeMaterial.kReflect = 0.3f;
-	planeMaterial.kRefract = 0.0f;
-	auto isBlack = [](const glm::vec3& pos)
+	while (!glfwWindowShouldClose(window))
 	{
-		return fmod(floor(pos.x) + floor(pos.z), 2) == 0;
-	};
-	planeMaterial.ambient = [=](const glm::vec3& pos)->glm::vec3
+		// Ϣʼ塢任
+		processInput(window);
+
+		glClearColor(0.3, 0.3, 0.3, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		model = glm::mat4(1.0f);
+		view = glm::lookAt(viewPos, viewPos + viewFront, viewUp);
+		projection = glm::perspective(glm::radians(90.0f), (float)SCR_WIDTH / SCR_HEIGHT, 0.1f, 100.0f);
+
+		// һֹ׷٣ۻд֡
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		renderer.render(camera, frameBuffer);
+
+		// һϴ֡岢ȫ
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, SCR_WIDTH, SCR_HEIGHT, GL_RGB, GL_FLOAT, frameBuffer.getData());
+
+		shader.use();
+		glBindVertexArray(VAO);
+		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+		glfwSwapBuffers(window);
+		glfwPollEvents();
+	}
+	glDeleteTextures(1, &texture);
+	glDeleteVertexArrays(1, &VAO);
+	glDeleteBuffers(1, &VBO);
+	glfwTerminate();
+	return 0;
+}
+
+// ǷǸʱoptions.errorмµһ󲢷0
+unsigned int parseUnsigned(const std::string& option, const char* value, Options& options)
+{
+	char* end = nullptr;
+	errno = 0;
+	unsigned long result = std::strtoul(value, &end, 10);
+	if (!std::isdigit((unsigned char)value[0]) || *end != '\0' || errno == ERANGE || result > UINT_MAX)
 	{
-		glm::vec3 color(1.0f, 1.0f, 1.0f);
-		if (isBlack(pos))
+		if (options.error.empty())
 		{
-			return color;
+			options.error = "Failed to parse the options: " + option + " needs a non-negative integer, not " + value;
 		}
-		else
+		return 0;
+	}
+	return (unsigned int)result;
+}
+
+// ǷǸʱoptions.errorмµһ󲢷0
+float parseFloat(const std::string& option, const char* value, Options& options)
+{
+	char* end = nullptr;
+	float result = std::strtof(value, &end);
+	if (end == value || *end != '\0' || !std::isfinite(result) || result < 0.0f)
+	{
+		if (options.error.empty())
 		{
-			return glm::vec3(1.0f, 1.0f, 1.0f) - color;
+			options.error = "Failed to parse the options: " + option + " needs a non-negative number, not " + value;
 		}
-	};
-	planeMaterial.diffuse = [=](const glm::vec3& pos)->glm::vec3
+		return 0.0f;
+	}
+	return result;
+}
+
+Options parseOptions(int argc, char* argv[])
+{
+	Options options;
+	options.programPath = RayTracing::ChildProcess::getProgramPath();
+	if (options.programPath.empty())
 	{
-		glm::vec3 color(1.0f, 1.0f, 1.0f);
-		if (isBlack(pos))
+		options.programPath = argv[0];
+	}
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if ((arg == "--headless" || arg == "-o") && hasValue)
 		{
-			return color;
+			options.outputPath = argv[++i];
 		}
-		else
+		else if (arg == "--profile" && hasValue)
 		{
-			return glm::vec3(1.0f, 1.0f, 1.0f) - color;
+			options.profilePath = argv[++i];
 		}
-	};
-	planeMaterial.specular = [=](const glm::vec3& pos)->glm::vec3
-	{
-		glm::vec3 color(1.0f, 1.0f, 1.0f);
-		if (isBlack(pos))
+		else if (arg == "--animate" && hasValue)
 		{
-			return color;
+			options.animationPath = argv[++i];
 		}
-		else
+		else if (arg == "--frames" && hasValue)
 		{
-			return glm::vec3(1.0f, 1.0f, 1.0f) - color;
+			options.frameCount = parseUnsigned(arg, argv[++i], options);
 		}
-	};
-	planeMaterial.shininess = [](const glm::vec3& pos)->float
+		else if (arg == "--no-pipeline")
+		{
+			options.pipelined = false;
+		}
+		else if (arg == "--threads" && hasValue)
+		{
+			options.threadCount = parseUnsigned(arg, argv[++i], options);
+		}
+		else if (arg == "--workers" && hasValue)
+		{
+			options.workerCount = parseUnsigned(arg, argv[++i], options);
+		}
+		else if (arg == "--worker")
+		{
+			options.worker = true;
+		}
+		else if (arg == "--bench-distributed")
+		{
+			options.benchmarkDistributed = true;
+		}
+		else if (arg == "--tile" && hasValue)
+		{
+			options.tileSize = parseUnsigned(arg, argv[++i], options);
+		}
+		else if (arg == "--packet" && hasValue)
+		{
+			options.packetWidth = parseUnsigned(arg, argv[++i], options);
+		}
+		else if (arg == "--bench-packet")
+		{
+			options.benchmarkPacket = true;
+		}
+		else if (arg == "--samples" && hasValue)
+		{
+			options.samples = std::max(1u, parseUnsigned(arg, argv[++i], options));
+		}
+		else if (arg == "--budget" && hasValue)
+		{
+			options.frameBudget = parseFloat(arg, argv[++i], options);
+		}
+		else if (arg == "--bench-progressive")
+		{
+			options.benchmarkProgressive = true;
+		}
+		else if (arg == "--adaptive" && hasValue)
+		{
+			options.adaptiveThreshold = parseFloat(arg, argv[++i], options);
+		}
+		else if (arg == "--bench-adaptive")
+		{
+			options.benchmarkAdaptive = true;
+		}
+		else if (arg == "--depth" && hasValue)
+		{
+			options.maxDepth = parseUnsigned(arg, argv[++i], options);
+		}
+		else if (arg == "--min-weight" && hasValue)
+		{
+			options.minWeight = parseFloat(arg, argv[++i], options);
+		}
+		else if (arg == "--scene" && hasValue)
+		{
+			options.scenePath = argv[++i];
+		}
+		else if (arg == "--compile-scene" && hasValue)
+		{
+			options.cachePath = argv[++i];
+		}
+		else if (arg == "--bench-scene")
+		{
+			options.benchmarkScene = true;
+		}
+		else if (arg == "--raster")
+		{
+			options.rasterize = true;
+		}
+		else if (arg == "--bench-raster")
+		{
+			options.benchmarkRaster = true;
+		}
+		else if (arg == "--no-shadows")
+		{
+			options.shadows = false;
+		}
+		else if (arg == "--no-filtering")
+		{
+			options.textureFiltering = false;
+		}
+		else if (arg == "--bench-filtering")
+		{
+			options.benchmarkFiltering = true;
+		}
+		else if (arg == "--bench-shadow")
+		{
+			options.benchmarkShadow = true;
+		}
+		else if (arg == "--light-samples" && hasValue)
+		{
+			options.lightSamples = parseUnsigned(arg, argv[++i], options);
+		}
+		else if (arg == "--bench-lights")
+		{
+			options.benchmarkLights = true;
+		}
+		else if (arg == "--wavefront")
+		{
+			options.wavefront = true;
+		}
+		else if (arg == "--bench-wavefront")
+		{
+			options.benchmarkWavefront = true;
+		}
+		else if (arg == "--bench-trace")
+		{
+			options.benchmarkTrace = true;
+		}
+		else if (arg == "--bench-material")
+		{
+			options.benchmarkMaterial = true;
+		}
+		else if (arg == "--convert-texture" && i + 2 < argc)
+		{
+			options.convertImagePath = argv[++i];
+			options.convertTexturePath = argv[++i];
+		}
+		else if (arg == "--texture-cache" && hasValue)
+		{
+			options.textureBudget = parseUnsigned(arg, argv[++i], options);
+		}
+		else if (arg == "--bench-texture")
+		{
+			options.benchmarkTexture = true;
+		}
+		else if (arg == "--bench-suite")
+		{
+			options.benchmarkSuite = true;
+			if (hasValue && argv[i + 1][0] != '-')
+			{
+				options.benchmarkJSONPath = argv[++i];
+			}
+		}
+		else if (arg == "--bench-compare" && hasValue)
+		{
+			options.benchmarkSuite = true;
+			options.benchmarkBaselinePath = argv[++i];
+		}
+		else if (arg == "--threshold" && hasValue)
+		{
+			options.benchmarkThreshold = parseFloat(arg, argv[++i], options);
+		}
+		else if (arg == "--bench-bvh")
+		{
+			options.benchmarkBVH = true;
+		}
+		else if (arg == "--bench-animation")
+		{
+			options.benchmarkAnimation = true;
+		}
+		else if (arg == "--bench-instance")
+		{
+			options.benchmarkInstance = true;
+		}
+		else if (arg == "--bench-layout")
+		{
+			options.benchmarkLayout = true;
+		}
+		else if (arg == "--bench-triangle")
+		{
+			options.benchmarkTriangle = true;
+		}
+		else if (arg == "--bench-primitive")
+		{
+			options.benchmarkPrimitive = true;
+		}
+		else if (arg == "--bench-mesh")
+		{
+			options.benchmarkMesh = true;
+			if (hasValue && argv[i + 1][0] != '-')
+			{
+				options.benchmarkMeshPath = argv[++i];
+			}
+		}
+		else if (arg == "--bench-scaling")
+		{
+			options.benchmarkThreads = std::max(1u, std::thread::hardware_concurrency());
+			if (hasValue && std::isdigit(argv[i + 1][0]))
+			{
+				options.benchmarkThreads = parseUnsigned(arg, argv[++i], options);
+			}
+		}
+	}
+
+	// ֻÿһ׷٣ҲãЩᱻ
+	if (options.workerCount > 0)
 	{
-		return 32.0f;
-	};
-	RayTracing::Plane* plane = new RayTracing::Plane(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-	plane->setMaterial(planeMaterial);
-	scene.addEntity(plane);
+		std::string ignored;
+		ignored += options.samples > 1 ? " --samples" : "";
+		ignored += options.adaptiveThreshold > 0.0f ? " --adaptive" : "";
+		ignored += options.rasterize ? " --raster" : "";
+		ignored += options.wavefront ? " --wavefront" : "";
+		ignored += options.textureBudget > 0 ? " --texture-cache" : "";
+		if (!ignored.empty() && options.error.empty())
+		{
+			options.error = "Failed to parse the options: --workers can't be combined with" + ignored;
+		}
+	}
+	return options;
+}
 
-	Material ballMaterial;
-	ballMaterial.kShade = 0.6f;
-	ballMaterial.kReflect = 0.2f;
-	ballMaterial.kRefract = 0.2f;
-	ballMaterial.refractiveIndex = 1.5f;
-	ballMaterial.ambient = [](const glm::vec3& pos)->glm::vec3
+int renderHeadless(const Options& options)
+{
+	if (options.workerCount > 0)
 	{
-		return { 1.0f, 1.0f, 1.0f };
-	};
-	ballMaterial.diffuse = [](const glm::vec3& pos)->glm::vec3
+		// ֻһΣ֮̿ʱȡһηֿ飻ĳ˳ʱķֿ齻Ľ
+		unsigned int threads = options.threadCount > 0 ? options.threadCount :
+			std::max(1u, std::thread::hardware_concurrency() / options.workerCount);
+		RayTracing::FrameBuffer frameBuffer(SCR_WIDTH, SCR_HEIGHT);
+		RayTracing::DistributedRenderer renderer(options.programPath, options.workerCount, threads, options.tileSize);
+		renderer.setPacketWidth(options.packetWidth);
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		if (!renderer.setScene(scene) || !renderer.render(camera, frameBuffer))
+		{
+			return -1;
+		}
+		if (!frameBuffer.write(options.outputPath))
+		{
+			std::cout << "Failed to write " << options.outputPath << std::endl;
+			return -1;
+		}
+		return 0;
+	}
+	if (options.adaptiveThreshold > 0.0f)
 	{
-		return { 1.0f, 1.0f, 1.0f };
-	};
-	ballMaterial.specular = [](const glm::vec3& pos)->glm::vec3
+		// ȸÿֻ֮أԵ̸߽磩Ӳ
+		RayTracing::FrameBuffer frameBuffer(SCR_WIDTH, SCR_HEIGHT);
+		RayTracing::AdaptiveRenderer renderer(scene, options.threadCount, options.tileSize);
+		renderer.setPacketWidth(options.packetWidth);
+		renderer.getRenderer().setWavefront(options.wavefront);
+		renderer.setThreshold(options.adaptiveThreshold);
+		renderer.setSampleCounts(RayTracing::AdaptiveRenderer::DEFAULT_BASE_SAMPLES,
+			options.samples > 1 ? options.samples : RayTracing::AdaptiveRenderer::DEFAULT_MAX_SAMPLES);
+		RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+		renderer.render(camera, frameBuffer);
+		std::cout << renderer.getSamplesPerPixel() << " samples per pixel" << std::endl;
+		printTextureStats(scene);
+		if (!frameBuffer.write(options.outputPath))
+		{
+			std::cout << "Failed to write " << options.outputPath << std::endl;
+			return -1;
+		}
+		return 0;
+	}
+
+	// βʱһͨȾ֮ͬÿƫ
+	RayTracing::FrameBuffer frameBuffer(SCR_WIDTH, SCR_HEIGHT);
+	RayTracing::ProgressiveRenderer renderer(scene, options.threadCount, options.tileSize);
+	renderer.setPacketWidth(options.packetWidth);
+	renderer.setRasterize(options.rasterize);
+	renderer.getRenderer().setWavefront(options.wavefront);
+	RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+	for (unsigned int i = 0; i < options.samples; i++)
 	{
-		return  { 0.6f, 0.6f, 0.6f };
-	};
-	ballMaterial.shininess = [](const glm::vec3& pos)->float
+		renderer.render(camera, frameBuffer);
+	}
+	printTextureStats(scene);
+	if (!frameBuffer.write(options.outputPath))
 	{
-		return 32.0f;
-	};
-	auto ball = new RayTracing::Sphere(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f);
-	ball->setMaterial(ballMaterial);
-	scene.addEntity(ball);
-
-
+		std::cout << "Failed to write " << options.outputPath << std::endl;
+		return -1;
+	}
+	return 0;
+}
 
-	while (!glfwWindowShouldClose(window))
+int renderProfile(const Options& options)
+{
+	// ׷ÿصĹߣ¼ʱͼдÿָͼӡͳ
+	RayTracing::FrameBuffer frameBuffer(SCR_WIDTH, SCR_HEIGHT);
+	RayTracing::PixelProfile profile(SCR_WIDTH, SCR_HEIGHT);
+	RayTracing::ProgressiveRenderer renderer(scene, options.threadCount, options.tileSize);
+	renderer.getRenderer().setProfile(&profile);
+	RayTracing::Camera camera(viewPos, viewFront, viewUp, float(SCR_WIDTH) / SCR_HEIGHT);
+	for (unsigned int i = 0; i < options.samples; i++)
 	{
-		// Ϣʼ塢任
-		processInput(window);
-
-		glClearColor(0.3, 0.3, 0.3, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		model = glm::mat4(1.0f);
-		view = glm::lookAt(viewPos, viewPos + viewFront, viewUp);
-		projection = glm::perspective(glm::radians(90.0f), (float)SCR_WIDTH / SCR_HEIGHT, 0.1f, 100.0f);
-
-		// ʼ۲
-		glm::vec3 viewRight = glm::normalize(glm::cross(viewFront, viewUp));
-
-		// Ϊƶ
-		shader.use();
-		glBindVertexArray(VAO);
-
-		// öĻÿһ
-		for (unsigned int i = 0; i < SCR_WIDTH; i++)
+		renderer.render(camera, frameBuffer);
+	}
+	profile.printSummary(std::cout);
+	for (int metric = 0; metric < RayTracing::PixelProfile::METRIC_COUNT; metric++)
+	{
+		if (metric != RayTracing::PixelProfile::TIME && !RayTracing::PixelCounters::isCounting())
 		{
-			for (unsigned int j = 0; j < SCR_HEIGHT; j++)
-			{
-				// ӳ䵽[0, 1]
-				glm::vec3 pos(float(i) * 2 / SCR_WIDTH - 1.0f, float(j) * 2 / SCR_HEIGHT - 1.0f, 0.0f);
-				shader.setVec2("screenPos", pos.x, pos.y);
+			continue;
+		}
+		auto m = RayTracing::PixelProfile::Metric(metric);
+		std::string path = options.profilePath + "_" + RayTracing::PixelProfile::getMetricName(m) + ".ppm";
+		if (!profile.writeHeatmap(path, m))
+		{
+			std::cout << "Failed to write " << path << std::endl;
+			return -1;
+		}
+	}
+	return 0;
+}
 
-				// еλ
-				glm::vec3 globalPos = viewPos + viewFront + pos.x * viewRight * (float(SCR_WIDTH) / SCR_HEIGHT) + pos.y * viewUp;
+int renderAnimation(const Options& options)
+{
+	// ֻԳļٶһͬĳݳ׷ٺ͸
+	if (animation.empty())
+	{
+		std::cout << "Failed to render the animation: the scene has no keyframes" << std::endl;
+		return -1;
+	}
+	RayTracing::Scene nextScene;
+	RayTracing::SceneCamera sceneCamera;
+	if (!RayTracing::loadSceneFile(options.scenePath, nextScene, sceneCamera))
+	{
+		return -1;
+	}
+	nextScene.setMaxDepth(options.maxDepth);
+	nextScene.setMinWeight(options.minWeight);
+	nextScene.setShadows(options.shadows);
+	nextScene.setTextureFiltering(options.textureFiltering);
+	nextScene.setLightSamples(options.lightSamples);
+	if (options.frameCount > 0)
+	{
+		animation.setFrameCount(options.frameCount);
+	}
 
-				// ߲й׷
-				RayTracing::Ray ray(viewPos, globalPos);
-				glm::vec3 color = scene.traceRay(ray);
+	size_t dot = options.animationPath.find_last_of('.');
+	size_t slash = options.animationPath.find_last_of("/\\");
+	bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+	std::string prefix = hasExtension ? options.animationPath.substr(0, dot) : options.animationPath;
+	std::string extension = hasExtension ? options.animationPath.substr(dot) : ".ppm";
+
+	RayTracing::AnimationRenderer renderer(scene, nextScene, animation, options.threadCount, options.tileSize);
+	renderer.setPipelined(options.pipelined);
+	bool written = renderer.render(SCR_WIDTH, SCR_HEIGHT, sceneCamera, prefix, extension);
+	const RayTracing::AnimationRenderer::Stats& stats = renderer.getStats();
+	std::cout << stats.frames << " frames in " << stats.seconds << " s, " << stats.getFramesPerMinute() << " frames per minute" << std::endl;
+	std::cout << "per frame: trace " << 1000.0 * stats.traceSeconds / stats.frames << " ms, update "
+		<< 1000.0 * stats.updateSeconds / stats.frames << " ms, write " << 1000.0 * stats.writeSeconds / stats.frames << " ms"
+		<< (options.pipelined ? " (update and write overlap the trace)" : "") << std::endl;
+	return written ? 0 : -1;
+}
 
-				// Ƹô
-				shader.setVec3("vertexColor", color);
-				glDrawArrays(GL_POINTS, 0, 1);
-			}
-		}
+void printTextureStats(const RayTracing::Scene& scene)
+{
+	// õֿʱӡʺռõڴ
+	const RayTracing::TextureCache& cache = scene.getMaterials().getTextureCache();
+	if (cache.getTextureCount() == 0)
+	{
+		return;
+	}
+	RayTracing::TextureCache::Stats stats = cache.getStats();
+	std::cout << "texture cache: " << stats.lookups << " tile lookups, " << stats.getHitRate() * 100.0 << "% hits, "
+		<< double(stats.residentBytes) / (1 << 20) << " of " << double(stats.budgetBytes) / (1 << 20) << " MB resident, "
+		<< double(stats.readBytes) / (1 << 20) << " MB read, " << stats.evictions << " evictions" << std::endl;
+}
 
+void buildScene(RayTracing::Scene& scene)
+{
+	// ùߡƽ桢ĲǼ볡
+	scene.addLight(new DirLight(
+		glm::vec3(0.2f, 0.2f, 0.2f),
+		glm::vec3(0.6f, 0.6f, 0.6f),
+		glm::vec3(1.0f, 1.0f, 1.0f),
+		glm::vec3(-0.5f, -1.0f, -1.0f)
+	));
+	// ݵʽ볡Ĳʱֻʵ±
+	MaterialTable& materials = scene.getMaterials();
 
+	// ƽʹúڰ̸
+	Material planeMaterial;
+	planeMaterial.kShade = 0.7f;
+	planeMaterial.kReflect = 0.3f;
+	planeMaterial.kRefract = 0.0f;
+	Texture checker = materials.addChecker(glm::vec3(1.0f, 1.0f, 1.0f), glm::vec3(0.0f, 0.0f, 0.0f));
+	planeMaterial.ambient = checker;
+	planeMaterial.diffuse = checker;
+	planeMaterial.specular = checker;
+	planeMaterial.shininess = 32.0f;
+	RayTracing::Plane* plane = new RayTracing::Plane(glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	plane->setMaterial(materials.addMaterial(planeMaterial));
+	scene.addEntity(plane);
 
+	Material ballMaterial;
+	ballMaterial.kShade = 0.6f;
+	ballMaterial.kReflect = 0.2f;
+	ballMaterial.kRefract = 0.2f;
+	ballMaterial.refractiveIndex = 1.5f;
+	ballMaterial.ambient = glm::vec3(1.0f, 1.0f, 1.0f);
+	ballMaterial.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+	ballMaterial.specular = glm::vec3(0.6f, 0.6f, 0.6f);
+	ballMaterial.shininess = 32.0f;
+	auto ball = new RayTracing::Sphere(glm::vec3(0.0f, 1.0f, 0.0f), 1.0f);
+	ball->setMaterial(materials.addMaterial(ballMaterial));
+	scene.addEntity(ball);
 
-		glfwSwapBuffers(window);
-		glfwPollEvents();
-	}
-	glfwTerminate();
-	return 0;
+	scene.buildBVH();
 }
 
 void resizeGL(GLFWwindow* window, int width, int height)
@@ -218,4 +883,32 @@ void processInput(GLFWwindow* window)
 	{
 		glfwSetWindowShouldClose(window, true);
 	}
+
+	// WASDǰƶQEƶ
+	const float speed = 0.05f;
+	glm::vec3 right = glm::normalize(glm::cross(viewFront, viewUp));
+	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+	{
+		viewPos += speed * viewFront;
+	}
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+	{
+		viewPos -= speed * viewFront;
+	}
+	if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+	{
+		viewPos -= speed * right;
+	}
+	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+	{
+		viewPos += speed * right;
+	}
+	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS)
+	{
+		viewPos -= speed * viewUp;
+	}
+	if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS)
+	{
+		viewPos += speed * viewUp;
+	}
 }
\ No newline at end of file